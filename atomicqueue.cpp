@@ -0,0 +1,88 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stddef.h>
+
+#include "atomicqueue.h"
+
+/* Items are pushed onto a stack with compare-and-swap and the consumer
+ * swaps the whole stack out, so nodes are never popped one at a time
+ * and a node can’t be recycled under a pusher’s feet. */
+
+/* Reads *HEAD, as it may be changed by other threads meanwhile. */
+static AtomicQueueNode *
+AtomicQueueLoadHead(AtomicQueueNode *volatile *head)
+{
+#ifdef _MSC_VER
+        return *head;
+#else
+        return __atomic_load_n(head, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Replaces *HEAD with NODE if it’s still EXPECTED, publishing NODE.
+ * Returns 1 if it was, otherwise setting EXPECTED to *HEAD. */
+static int
+AtomicQueueSwapHead(AtomicQueueNode *volatile *head, AtomicQueueNode **expected, AtomicQueueNode *node)
+{
+#ifdef _MSC_VER
+        PVOID seen = InterlockedCompareExchangePointer((PVOID volatile *)head, node, *expected);
+        if (seen == *expected)
+                return 1;
+        *expected = (AtomicQueueNode *)seen;
+        return 0;
+#else
+        return __atomic_compare_exchange_n(head, expected, node, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Replaces *HEAD with NULL, returning what it was. */
+static AtomicQueueNode *
+AtomicQueueClearHead(AtomicQueueNode *volatile *head)
+{
+#ifdef _MSC_VER
+        return (AtomicQueueNode *)InterlockedExchangePointer((PVOID volatile *)head, NULL);
+#else
+        return __atomic_exchange_n(head, (AtomicQueueNode *)NULL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Sets up QUEUE to be empty. */
+void
+AtomicQueueInit(AtomicQueue *queue)
+{
+        queue->head = NULL;
+}
+
+/* Pushes NODE onto QUEUE.  May be called from any thread.  Returns 1 if
+ * QUEUE was empty, i.e., if its consumer should be told to take it. */
+int
+AtomicQueuePush(AtomicQueue *queue, AtomicQueueNode *node)
+{
+        AtomicQueueNode *head = AtomicQueueLoadHead(&queue->head);
+
+        do {
+                node->next = head;
+        } while (!AtomicQueueSwapHead(&queue->head, &head, node));
+
+        return head == NULL;
+}
+
+/* Takes all nodes off QUEUE, returning them linked in the order they
+ * were pushed, or NULL if QUEUE is empty.  Only one thread may take
+ * nodes off QUEUE at a time. */
+AtomicQueueNode *
+AtomicQueueTake(AtomicQueue *queue)
+{
+        AtomicQueueNode *node = AtomicQueueClearHead(&queue->head);
+
+        AtomicQueueNode *taken = NULL;
+        while (node != NULL) {
+                AtomicQueueNode *next = node->next;
+                node->next = taken;
+                taken = node;
+                node = next;
+        }
+
+        return taken;
+}
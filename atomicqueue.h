@@ -0,0 +1,25 @@
+﻿/* A queue that any number of threads may push onto without taking a
+ * lock, emptied all at once by a single consumer.  Its nodes are
+ * embedded in the items queued, so that pushing never allocates and
+ * can’t fail.  Like the pixel kernels, it only depends on the C runtime
+ * and the compiler’s atomic operations. */
+typedef struct _AtomicQueue AtomicQueue;
+
+/* A link of an AtomicQueue, embedded in each item queued. */
+typedef struct _AtomicQueueNode AtomicQueueNode;
+
+struct _AtomicQueueNode
+{
+        AtomicQueueNode *next;
+};
+
+/* HEAD is the node pushed last, the others following it in the reverse
+ * of the order they were pushed. */
+struct _AtomicQueue
+{
+        AtomicQueueNode *volatile head;
+};
+
+void AtomicQueueInit(AtomicQueue *queue);
+int AtomicQueuePush(AtomicQueue *queue, AtomicQueueNode *node);
+AtomicQueueNode *AtomicQueueTake(AtomicQueue *queue);
@@ -1,5 +1,7 @@
 ﻿#include <stdafx.h>
 
+#include "pixels.h"
+#include "resample.h"
 #include "bitmap.h"
 
 /* Gets the width and height of BITMAP, returning any Status reported
@@ -29,12 +31,96 @@ BitmapLockAll(Bitmap *bitmap, BitmapData *locked_data)
         return bitmap->LockBits(&Rect(0, 0, width, height), ImageLockModeRead, format, locked_data);
 }
 
-/* Iterates over a non-alpha, i.e., < 32-bit, BITMAP.  We do this by using
- * GetPixel(), as it will do the right thing.  Returns a GDI+ Status of how the iteration
- * fared.  WAS_STOPPED will be set to TRUE if iteration ended before all pixels of the bitmap
- * were iterated over. */
-Status
-NonAlphaBitmapIterate(Bitmap *bitmap, BitmapIterator iterator, VOID *closure, BOOL *was_stopped)
+/* Converts rows of a non-alpha bitmap from its native pixel format into
+ * ARGB.  FORMAT is the bitmap’s PixelFormat and PALETTE is its palette,
+ * expanded to cover every index a pixel may hold, if it has one. */
+typedef struct _RowConverter RowConverter;
+
+struct _RowConverter
+{
+        PixelFormat format;
+        ARGB palette[256];
+};
+
+/* Expands the palette of BITMAP into CONVERTER’s palette.  Indexes beyond
+ * the end of the palette are taken to be black. */
+static Status
+RowConverterExpandPalette(RowConverter *converter, Bitmap *bitmap)
+{
+        for (UINT i = 0; i < _countof(converter->palette); i++)
+                converter->palette[i] = Color::Black;
+
+        INT size = bitmap->GetPaletteSize();
+        RETURN_GDI_FAILURE(bitmap->GetLastStatus());
+        if (size <= 0)
+                return Ok;
+
+        ColorPalette *palette = (ColorPalette *)ALLOC_N(BYTE, size);
+        if (palette == NULL)
+                return OutOfMemory;
+
+        Status status = bitmap->GetPalette(palette, size);
+        if (status == Ok)
+                CopyMemory(converter->palette, palette->Entries,
+                           min(palette->Count, _countof(converter->palette)) * sizeof(ARGB));
+
+        FREE(palette);
+
+        return status;
+}
+
+/* Sets up CONVERTER for converting the rows of BITMAP.  IS_SUPPORTED is
+ * set to FALSE if there’s no converter for BITMAP’s pixel format. */
+static Status
+RowConverterInit(RowConverter *converter, Bitmap *bitmap, BOOL *is_supported)
+{
+        converter->format = bitmap->GetPixelFormat();
+        RETURN_GDI_FAILURE(bitmap->GetLastStatus());
+
+        *is_supported = TRUE;
+
+        switch (converter->format) {
+        case PixelFormat1bppIndexed:
+        case PixelFormat4bppIndexed:
+        case PixelFormat8bppIndexed:
+                return RowConverterExpandPalette(converter, bitmap);
+        case PixelFormat16bppRGB555:
+        case PixelFormat16bppRGB565:
+        case PixelFormat24bppRGB:
+                return Ok;
+        default:
+                *is_supported = FALSE;
+                return Ok;
+        }
+}
+
+/* Converts the WIDTH pixels of SOURCE into DESTINATION using CONVERTER. */
+static void
+RowConverterConvert(RowConverter const *converter, ARGB *destination, BYTE const *source, UINT width)
+{
+        switch (converter->format) {
+        case PixelFormat1bppIndexed:
+        case PixelFormat4bppIndexed:
+        case PixelFormat8bppIndexed:
+                PixelsFromIndexed(destination, source, GetPixelFormatSize(converter->format),
+                                  converter->palette, width);
+                break;
+        case PixelFormat16bppRGB555:
+                PixelsFromRGB555(destination, (USHORT const *)source, width);
+                break;
+        case PixelFormat16bppRGB565:
+                PixelsFromRGB565(destination, (USHORT const *)source, width);
+                break;
+        case PixelFormat24bppRGB:
+                PixelsFromRGB24(destination, source, width);
+                break;
+        }
+}
+
+/* Iterates over a non-alpha BITMAP in a pixel format we have no converter
+ * for by using GetPixel(), as it will do the right thing. */
+static Status
+NonAlphaBitmapIterateByPixel(Bitmap *bitmap, BitmapIterator iterator, VOID *closure, BOOL *was_stopped)
 {
         *was_stopped = FALSE;
 
@@ -58,6 +144,62 @@ NonAlphaBitmapIterate(Bitmap *bitmap, BitmapIterator iterator, VOID *closure, BO
         return Ok;
 }
 
+/* Iterates over the locked DATA of a non-alpha bitmap, converting each row
+ * into ROW using CONVERTER before passing its pixels to ITERATOR. */
+static Status
+NonAlphaBitmapDataIterate(BitmapData *data, RowConverter const *converter, ARGB *row,
+                          BitmapIterator iterator, VOID *closure, BOOL *was_stopped)
+{
+        IterationState state = IterationContinue;
+
+        for (UINT y = 0; y < data->Height; y++) {
+                RowConverterConvert(converter, row, BitmapDataRowBytes(data, y), data->Width);
+
+                for (UINT x = 0; x < data->Width; x++) {
+                        RETURN_GDI_FAILURE(iterator(Point(x, y), row[x], closure, &state));
+                        if (state == IterationStop) {
+                                *was_stopped = TRUE;
+                                return Ok;
+                        }
+                }
+        }
+
+        return Ok;
+}
+
+/* Iterates over a non-alpha, i.e., < 32-bit, BITMAP.  Its rows are
+ * converted into ARGB one at a time, falling back to GetPixel() for pixel
+ * formats we have no converter for.  Returns a GDI+ Status of how the
+ * iteration fared.  WAS_STOPPED will be set to TRUE if iteration ended
+ * before all pixels of the bitmap were iterated over. */
+Status
+NonAlphaBitmapIterate(Bitmap *bitmap, BitmapIterator iterator, VOID *closure, BOOL *was_stopped)
+{
+        *was_stopped = FALSE;
+
+        RowConverter converter;
+        BOOL is_supported;
+        RETURN_GDI_FAILURE(RowConverterInit(&converter, bitmap, &is_supported));
+        if (!is_supported)
+                return NonAlphaBitmapIterateByPixel(bitmap, iterator, closure, was_stopped);
+
+        BitmapData data;
+        RETURN_GDI_FAILURE(BitmapLockAll(bitmap, &data));
+
+        ARGB *row = ALLOC_N(ARGB, data.Width);
+        Status status = (row == NULL) ? OutOfMemory :
+                NonAlphaBitmapDataIterate(&data, &converter, row, iterator, closure, was_stopped);
+
+        if (row != NULL)
+                FREE(row);
+
+        Status unlock_status = bitmap->UnlockBits(&data);
+        if (status != Ok)
+                return status;
+
+        return unlock_status;
+}
+
 /* Iterates over an alpha, i.e., 32-bit, bitmap’s data.  Here we can use the
  * raw data easily. */
 static Status
@@ -119,15 +261,32 @@ BitmapHasAlphaIterator(Point point, ARGB pixel, VOID *closure, IterationState *s
         return Ok;
 }
 
+/* Determines whether BITMAP has 32 bits per pixel, in which case its
+ * locked rows can be handed to the pixel kernels as they are. */
+static BOOL
+BitmapIs32Bit(Bitmap *bitmap)
+{
+        return GetPixelFormatSize(bitmap->GetPixelFormat()) == 32;
+}
+
 /* Checks if BITMAP has any pixels with an alpha-channel. */
 Status
 BitmapHasAlpha(Bitmap *bitmap, BOOL *has_alpha)
 {
         *has_alpha = FALSE;
 
-        BOOL was_stopped;
+        if (!BitmapIs32Bit(bitmap)) {
+                BOOL was_stopped;
+                return BitmapIterate(bitmap, BitmapHasAlphaIterator, has_alpha, &was_stopped);
+        }
+
+        BitmapData data;
+        RETURN_GDI_FAILURE(BitmapLockAll(bitmap, &data));
+
+        for (UINT y = 0; y < data.Height && !*has_alpha; y++)
+                *has_alpha = PixelsHaveAlpha(BitmapDataRow(&data, y), data.Width);
 
-        return BitmapIterate(bitmap, BitmapHasAlphaIterator, has_alpha, &was_stopped);
+        return bitmap->UnlockBits(&data);
 }
 
 /* Iterates over SOURCE, creating a copy by calling BLOCK to generate the copy. */
@@ -176,6 +335,85 @@ BitmapCopyGenericIterator(Point point, ARGB pixel, VOID *closure, IterationState
         return Ok;
 }
 
+/* Copies SOURCE into a new 32-bit bitmap COPY of FORMAT, which is either
+ * PixelFormat32bppARGB or PixelFormat32bppPARGB, a row at a time, calling
+ * F with each row, in whatever format SOURCE stores it in, and CLOSURE to
+ * fill it in. */
+static Status
+BitmapCopyNativeRows(Bitmap *source, PixelFormat format, BitmapRowFunc f, VOID *closure, Bitmap **copy)
+{
+        BitmapData source_data;
+        RETURN_GDI_FAILURE(BitmapLockAll(source, &source_data));
+
+        *copy = new Bitmap(source_data.Width, source_data.Height, format);
+        Status status = (*copy == NULL) ? OutOfMemory : (*copy)->GetLastStatus();
+
+        BitmapData copy_data;
+        Rect area(0, 0, source_data.Width, source_data.Height);
+        if (status == Ok)
+                status = (*copy)->LockBits(&area, ImageLockModeWrite, format, &copy_data);
+
+        if (status == Ok) {
+                for (UINT y = 0; y < source_data.Height; y++)
+                        f(BitmapDataRow(&copy_data, y), BitmapDataRow(&source_data, y), y, source_data.Width, closure);
+
+                status = (*copy)->UnlockBits(&copy_data);
+        }
+
+        Status unlock_status = source->UnlockBits(&source_data);
+        if (status == Ok)
+                status = unlock_status;
+
+        if (status != Ok && *copy != NULL)
+                delete *copy;
+
+        return status;
+}
+
+/* Copies the 32-bit bitmap SOURCE into a new 32-bit ARGB bitmap COPY a
+ * row at a time, calling F with each row and CLOSURE to fill it in.
+ * The rows of SOURCE are passed as they are stored, without converting
+ * them to ARGB. */
+Status
+BitmapCopyRows(Bitmap *source, BitmapRowFunc f, VOID *closure, Bitmap **copy)
+{
+        if (!BitmapIs32Bit(source))
+                return InvalidParameter;
+
+        return BitmapCopyNativeRows(source, PixelFormat32bppARGB, f, closure, copy);
+}
+
+/* Row function for BitmapCopyNativeRows() converting the rows of a
+ * non-alpha bitmap using the RowConverter CLOSURE. */
+static void
+NonAlphaBitmapCopyRow(ARGB *destination, ARGB const *source, UINT y, UINT width, VOID *closure)
+{
+        UNREFERENCED_PARAMETER(y);
+
+        RowConverterConvert((RowConverter const *)closure, destination, (BYTE const *)source, width);
+}
+
+/* Row function for BitmapCopyRows() copying rows as they are. */
+static void
+BitmapCopyRow(ARGB *destination, ARGB const *source, UINT y, UINT width, VOID *closure)
+{
+        UNREFERENCED_PARAMETER(y);
+        UNREFERENCED_PARAMETER(closure);
+
+        PixelsCopy(destination, source, width);
+}
+
+/* Row function for BitmapPremultiply() premultiplying rows of ARGB
+ * pixels. */
+static void
+BitmapPremultiplyRow(ARGB *destination, ARGB const *source, UINT y, UINT width, VOID *closure)
+{
+        UNREFERENCED_PARAMETER(y);
+        UNREFERENCED_PARAMETER(closure);
+
+        PixelsPremultiply(destination, source, width);
+}
+
 /* Copies SOURCE through BLOCK. */
 static Status
 BitmapCopyGeneric(Bitmap *source, BitmapIterateFunc block, Bitmap **copy)
@@ -183,16 +421,231 @@ BitmapCopyGeneric(Bitmap *source, BitmapIterateFunc block, Bitmap **copy)
         return BitmapIterateForCopy(source, block, BitmapCopyGenericIterator, NULL, copy);
 }
 
-/* Creates an alpha bitmap copy of the non-alpha bitmap SOURCE. */
+/* Creates an alpha bitmap copy of the non-alpha bitmap SOURCE, converting
+ * it a row at a time if we have a converter for its pixel format. */
 Status
 NonAlphaBitmapCopy(Bitmap *source, Bitmap **copy)
 {
-        return BitmapCopyGeneric(source, NonAlphaBitmapIterate, copy);
+        RowConverter converter;
+        BOOL is_supported;
+        RETURN_GDI_FAILURE(RowConverterInit(&converter, source, &is_supported));
+        if (!is_supported)
+                return BitmapCopyGeneric(source, NonAlphaBitmapIterate, copy);
+
+        return BitmapCopyNativeRows(source, PixelFormat32bppARGB, NonAlphaBitmapCopyRow, &converter, copy);
 }
 
 /* Creates a copy of the alpha-bitmap SOURCE. */
 Status
 BitmapCopy(Bitmap *source, Bitmap **copy)
 {
+        if (BitmapIs32Bit(source))
+                return BitmapCopyRows(source, BitmapCopyRow, NULL, copy);
+
         return BitmapCopyGeneric(source, BitmapIterate, copy);
 }
+
+/* Constants of the 64-bit FNV-1a hash. */
+#define FNV_OFFSET_BASIS        14695981039346656037ULL
+#define FNV_PRIME               1099511628211ULL
+
+/* Hashes the SIZE bytes at DATA into HASH. */
+static ULONGLONG
+FnvHash(ULONGLONG hash, VOID const *data, SIZE_T size)
+{
+        BYTE const *bytes = (BYTE const *)data;
+        for (SIZE_T i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * FNV_PRIME;
+
+        return hash;
+}
+
+/* Creates a copy PREMULTIPLIED of the 32-bit ARGB bitmap SOURCE in
+ * PixelFormat32bppPARGB, premultiplying its pixels with the pixel kernels
+ * once, rather than leaving it to GDI+ whenever it’s locked or drawn.
+ * SOURCE may be premultiplied already, in which case it’s just copied. */
+Status
+BitmapPremultiply(Bitmap *source, Bitmap **premultiplied)
+{
+        PixelFormat format = source->GetPixelFormat();
+        if (format == PixelFormat32bppPARGB)
+                return BitmapCopyNativeRows(source, PixelFormat32bppPARGB, BitmapCopyRow, NULL, premultiplied);
+        if (format != PixelFormat32bppARGB)
+                return InvalidParameter;
+
+        return BitmapCopyNativeRows(source, PixelFormat32bppPARGB, BitmapPremultiplyRow, NULL, premultiplied);
+}
+
+/* Gets the 32-bit format to lock BITMAP in so that GDI+ doesn’t have to
+ * convert its pixels: premultiplied ARGB if that’s how it stores them and
+ * ARGB otherwise. */
+static PixelFormat
+BitmapLockFormat(Bitmap *bitmap)
+{
+        return bitmap->GetPixelFormat() == PixelFormat32bppPARGB ? PixelFormat32bppPARGB : PixelFormat32bppARGB;
+}
+
+/* Works out a HASH of the dimensions and pixels of BITMAP, so that
+ * bitmaps with the same pixels get the same hash.  Pixels are hashed as
+ * they’re stored, so the same pixels stored premultiplied and straight
+ * get different hashes. */
+Status
+BitmapHash(Bitmap *bitmap, ULONGLONG *hash)
+{
+        UINT width, height;
+        RETURN_GDI_FAILURE(BitmapGetDimensions(bitmap, &width, &height));
+
+        BitmapData data;
+        Rect area(0, 0, width, height);
+        RETURN_GDI_FAILURE(bitmap->LockBits(&area, ImageLockModeRead, BitmapLockFormat(bitmap), &data));
+
+        *hash = FnvHash(FNV_OFFSET_BASIS, &width, sizeof(width));
+        *hash = FnvHash(*hash, &height, sizeof(height));
+        for (UINT y = 0; y < height; y++)
+                *hash = FnvHash(*hash, BitmapDataRow(&data, y), width * sizeof(ARGB));
+
+        return bitmap->UnlockBits(&data);
+}
+
+/* Resamples SOURCE into a new premultiplied 32-bit bitmap SCALED of WIDTH
+ * by HEIGHT pixels using RESAMPLER, which must resample from the size of
+ * SOURCE to WIDTH by HEIGHT.  SOURCE should be premultiplied already, as
+ * GDI+ would otherwise have to premultiply it when it’s locked. */
+Status
+BitmapResample(Bitmap *source, Resampler const *resampler, UINT width, UINT height, Bitmap **scaled)
+{
+        UINT source_width, source_height;
+        RETURN_GDI_FAILURE(BitmapGetDimensions(source, &source_width, &source_height));
+
+        BitmapData source_data;
+        Rect source_area(0, 0, source_width, source_height);
+        RETURN_GDI_FAILURE(source->LockBits(&source_area, ImageLockModeRead, PixelFormat32bppPARGB, &source_data));
+
+        *scaled = new Bitmap(width, height, PixelFormat32bppPARGB);
+        Status status = (*scaled == NULL) ? OutOfMemory : (*scaled)->GetLastStatus();
+
+        BitmapData scaled_data;
+        Rect area(0, 0, width, height);
+        if (status == Ok)
+                status = (*scaled)->LockBits(&area, ImageLockModeWrite, PixelFormat32bppPARGB, &scaled_data);
+
+        if (status == Ok) {
+                if (!ResamplerRun(resampler, (ARGB *)scaled_data.Scan0, scaled_data.Stride,
+                                  (ARGB const *)source_data.Scan0, source_data.Stride))
+                        status = OutOfMemory;
+
+                Status unlock_status = (*scaled)->UnlockBits(&scaled_data);
+                if (status == Ok)
+                        status = unlock_status;
+        }
+
+        Status unlock_status = source->UnlockBits(&source_data);
+        if (status == Ok)
+                status = unlock_status;
+
+        if (status != Ok && *scaled != NULL)
+                delete *scaled;
+
+        return status;
+}
+
+/* Creates a new premultiplied 32-bit BITMAP of WIDTH by HEIGHT pixels
+ * from the rows of PIXELS, which are premultiplied already if
+ * IS_PREMULTIPLIED. */
+static Status
+BitmapFromRows(UINT width, UINT height, ARGB const *pixels, BOOL is_premultiplied, Bitmap **bitmap)
+{
+        *bitmap = new Bitmap(width, height, PixelFormat32bppPARGB);
+        if (*bitmap == NULL)
+                return OutOfMemory;
+
+        BitmapData data;
+        Rect area(0, 0, width, height);
+        Status status = (*bitmap)->GetLastStatus();
+        if (status == Ok)
+                status = (*bitmap)->LockBits(&area, ImageLockModeWrite, PixelFormat32bppPARGB, &data);
+
+        if (status == Ok) {
+                for (UINT y = 0; y < height; y++) {
+                        if (is_premultiplied)
+                                PixelsCopy(BitmapDataRow(&data, y), pixels + y * width, width);
+                        else
+                                PixelsPremultiply(BitmapDataRow(&data, y), pixels + y * width, width);
+                }
+                status = (*bitmap)->UnlockBits(&data);
+        }
+
+        if (status != Ok)
+                delete *bitmap;
+
+        return status;
+}
+
+/* Creates a new premultiplied 32-bit BITMAP of WIDTH by HEIGHT pixels
+ * from the rows of ARGB PIXELS. */
+Status
+BitmapFromPixels(UINT width, UINT height, ARGB const *pixels, Bitmap **bitmap)
+{
+        return BitmapFromRows(width, height, pixels, FALSE, bitmap);
+}
+
+/* Creates a new premultiplied 32-bit BITMAP of WIDTH by HEIGHT pixels
+ * from the rows of premultiplied ARGB PIXELS. */
+Status
+BitmapFromPremultipliedPixels(UINT width, UINT height, ARGB const *pixels, Bitmap **bitmap)
+{
+        return BitmapFromRows(width, height, pixels, TRUE, bitmap);
+}
+
+/* Copies the pixels of BITMAP into PIXELS as 32-bit ARGB, row after row,
+ * premultiplied if PREMULTIPLY, setting WIDTH and HEIGHT to its
+ * dimensions.  Pixels are converted with the pixel kernels if BITMAP
+ * stores them otherwise. */
+static Status
+BitmapGetRows(Bitmap *bitmap, BOOL premultiply, UINT *width, UINT *height, ARGB **pixels)
+{
+        RETURN_GDI_FAILURE(BitmapGetDimensions(bitmap, width, height));
+
+        PixelFormat format = BitmapLockFormat(bitmap);
+        BOOL is_premultiplied = format == PixelFormat32bppPARGB;
+        BitmapData data;
+        Rect area(0, 0, *width, *height);
+        RETURN_GDI_FAILURE(bitmap->LockBits(&area, ImageLockModeRead, format, &data));
+
+        *pixels = ALLOC_N(ARGB, max(*width * *height, 1));
+        for (UINT y = 0; *pixels != NULL && y < *height; y++) {
+                if (is_premultiplied == premultiply)
+                        CopyMemory(*pixels + y * *width, BitmapDataRow(&data, y), *width * sizeof(ARGB));
+                else if (premultiply)
+                        PixelsPremultiply(*pixels + y * *width, BitmapDataRow(&data, y), *width);
+                else
+                        PixelsUnpremultiply(*pixels + y * *width, BitmapDataRow(&data, y), *width);
+        }
+
+        Status status = bitmap->UnlockBits(&data);
+        if (*pixels == NULL)
+                return OutOfMemory;
+        if (status != Ok)
+                FREE(*pixels);
+
+        return status;
+}
+
+/* Copies the pixels of BITMAP into PIXELS as 32-bit ARGB, row after row,
+ * setting WIDTH and HEIGHT to its dimensions.  Premultiplied bitmaps are
+ * unpremultiplied with the pixel kernels.  PIXELS should be freed with
+ * FREE(). */
+Status
+BitmapGetPixels(Bitmap *bitmap, UINT *width, UINT *height, ARGB **pixels)
+{
+        return BitmapGetRows(bitmap, FALSE, width, height, pixels);
+}
+
+/* Copies the pixels of BITMAP into PIXELS as premultiplied 32-bit ARGB,
+ * row after row, setting WIDTH and HEIGHT to its dimensions.  PIXELS
+ * should be freed with FREE(). */
+Status
+BitmapGetPremultipliedPixels(Bitmap *bitmap, UINT *width, UINT *height, ARGB **pixels)
+{
+        return BitmapGetRows(bitmap, TRUE, width, height, pixels);
+}
@@ -1,4 +1,6 @@
-﻿/* Alpha value for total transparency. */
+﻿typedef struct _Resampler Resampler;
+
+/* Alpha value for total transparency. */
 #define ALPHA_TRANSPARENT       (0x00)
 
 /* Alpha value for no transparency at all. */
@@ -24,12 +26,24 @@ struct _BitmapIterateForCopyClosure
 /* A bitmap-iteration function for use with BitmapIterateForCopy(). */
 typedef Status (*BitmapIterateFunc)(Bitmap *, BitmapIterator, VOID *, BOOL *);
 
+/* A function filling in row Y of a copy, DESTINATION, from the same row of
+ * the bitmap being copied, SOURCE, both being WIDTH pixels wide.  CLOSURE
+ * is the closure passed to BitmapCopyRows(). */
+typedef void (*BitmapRowFunc)(ARGB *destination, ARGB const *source, UINT y, UINT width, VOID *closure);
+
 /* Gets an ARGB pointer into DATA starting at the first pixel in ROW. */
 static inline ARGB *BitmapDataRow(BitmapData *data, UINT row)
 {
         return (ARGB *)((BYTE *)data->Scan0 + (row * data->Stride));
 }
 
+/* Gets a BYTE pointer into DATA starting at the first byte of ROW, for
+ * bitmaps with less than 32 bits per pixel. */
+static inline BYTE *BitmapDataRowBytes(BitmapData *data, UINT row)
+{
+        return (BYTE *)data->Scan0 + (row * data->Stride);
+}
+
 /* Gets the RGB value from an ARGB value, i.e., removes the alpha channel’s value. */
 static inline ARGB ARGBGetRGB(ARGB pixel)
 {
@@ -48,5 +62,13 @@ Status BitmapIterate(Bitmap *bitmap, BitmapIterator iterator, VOID *closure, BOO
 Status BitmapHasAlpha(Bitmap *bitmap, BOOL *has_alpha);
 Status BitmapIterateForCopy(Bitmap *source, BitmapIterateFunc block, BitmapIterator iterator,
                             VOID *inner_closure, Bitmap **copy);
+Status BitmapCopyRows(Bitmap *source, BitmapRowFunc f, VOID *closure, Bitmap **copy);
 Status NonAlphaBitmapCopy(Bitmap *source, Bitmap **copy);
 Status BitmapCopy(Bitmap *source, Bitmap **copy);
+Status BitmapPremultiply(Bitmap *source, Bitmap **premultiplied);
+Status BitmapHash(Bitmap *bitmap, ULONGLONG *hash);
+Status BitmapResample(Bitmap *source, Resampler const *resampler, UINT width, UINT height, Bitmap **scaled);
+Status BitmapFromPixels(UINT width, UINT height, ARGB const *pixels, Bitmap **bitmap);
+Status BitmapFromPremultipliedPixels(UINT width, UINT height, ARGB const *pixels, Bitmap **bitmap);
+Status BitmapGetPixels(Bitmap *bitmap, UINT *width, UINT *height, ARGB **pixels);
+Status BitmapGetPremultipliedPixels(Bitmap *bitmap, UINT *width, UINT *height, ARGB **pixels);
@@ -15,13 +15,29 @@
  * CONTENTS stores the text.
  * ALLOCATED is the number of TCHARs allocated in CONTENTS.
  * OFFSET is the number of TCHARs used in CONTENTS.
- * LISTENERS is a list of BufferListeners for event callbacks. */
+ * LISTENERS is a list of BufferListeners for event callbacks.
+ * BATCHING determines whether BUFFER_ON_CHANGE events are held back
+ * until BufferFlush() is called.
+ * PENDING is TRUE if a change has been made that listeners haven’t
+ * been told about yet.
+ * PENDING_OFFSET is the OFFSET at the time of the first pending change.
+ * PENDING_START is the lowest offset touched by any pending change.
+ * DELTA is the net change in length reported by the latest event.
+ * START is the lowest offset changed as reported by the latest event.
+ * COUNTERS keeps track of coalesced and delivered events. */
 struct _Buffer
 {
         LPTSTR contents;
         size_t allocated;
         size_t offset;
         List *listeners;
+        BOOL batching;
+        BOOL pending;
+        size_t pending_offset;
+        size_t pending_start;
+        int delta;
+        size_t start;
+        BufferEventCounters counters;
 };
 
 /* A BufferListener represents a listener of BufferEvents.
@@ -172,11 +188,35 @@ BufferSetOffsetSilently(Buffer *buffer, size_t new_offset)
         buffer->contents[buffer->offset] = L'\0';
 }
 
+/* Sends the BUFFER_ON_CHANGE event for all changes made since
+ * PENDING_OFFSET. */
+static void
+BufferDeliverChange(Buffer *buffer)
+{
+        buffer->delta = (int)buffer->offset - (int)buffer->pending_offset;
+        buffer->start = buffer->pending_start;
+        buffer->pending = FALSE;
+        buffer->counters.delivered++;
+        BufferSendEvent(buffer, BUFFER_ON_CHANGE);
+}
+
 static void
 BufferSetOffset(Buffer *buffer, size_t new_offset)
 {
+        size_t start = min(buffer->offset, new_offset);
+        if (buffer->pending) {
+                buffer->counters.coalesced++;
+                buffer->pending_start = min(buffer->pending_start, start);
+        } else {
+                buffer->pending_offset = buffer->offset;
+                buffer->pending_start = start;
+        }
+        buffer->pending = TRUE;
+
         BufferSetOffsetSilently(buffer, new_offset);
-        BufferSendEvent(buffer, BUFFER_ON_CHANGE);
+
+        if (!buffer->batching)
+                BufferDeliverChange(buffer);
 }
 
 UINT
@@ -185,9 +225,11 @@ BufferLength(Buffer const *buffer)
         return (UINT)buffer->offset;
 }
 
+/* Resets BUFFER without telling anyone, dropping any pending change. */
 void
 BufferReset(Buffer *buffer)
 {
+        buffer->pending = FALSE;
         BufferSetOffsetSilently(buffer, 0);
 }
 
@@ -251,3 +293,48 @@ BufferContents(Buffer const *buffer)
 {
         return buffer->contents;
 }
+
+/* Gets the net change in length of BUFFER reported by the latest
+ * BUFFER_ON_CHANGE event.  Only meaningful inside a listener. */
+int
+BufferChangeDelta(Buffer const *buffer)
+{
+        return buffer->delta;
+}
+
+/* Gets the lowest offset in BUFFER whose contents were changed, as
+ * reported by the latest BUFFER_ON_CHANGE event.  Everything before
+ * this offset is the same as it was before the change.  Only meaningful
+ * inside a listener. */
+UINT
+BufferChangeStart(Buffer const *buffer)
+{
+        return (UINT)buffer->start;
+}
+
+/* Turns batching of BUFFER_ON_CHANGE events on or off.  While batching,
+ * any number of changes are coalesced into one event that is sent by
+ * BufferFlush().  Turning batching off flushes any pending change. */
+void
+BufferSetBatching(Buffer *buffer, BOOL batching)
+{
+        buffer->batching = batching;
+        if (!batching)
+                BufferFlush(buffer);
+}
+
+/* Sends a single BUFFER_ON_CHANGE event for all changes made to BUFFER
+ * since the last flush, if any. */
+void
+BufferFlush(Buffer *buffer)
+{
+        if (buffer->pending)
+                BufferDeliverChange(buffer);
+}
+
+/* Gets the event COUNTERS of BUFFER. */
+void
+BufferEventCountersGet(Buffer const *buffer, BufferEventCounters *counters)
+{
+        *counters = buffer->counters;
+}
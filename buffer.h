@@ -1,5 +1,6 @@
 ﻿typedef struct _Buffer Buffer;
 typedef struct _BufferListener BufferListener;
+typedef struct _BufferEventCounters BufferEventCounters;
 
 /* Events sent by a Buffer.
  *
@@ -8,6 +9,17 @@ typedef enum {
         BUFFER_ON_CHANGE = 1 << 0,
 } BufferEvent;
 
+/* Counters kept by a Buffer for its BUFFER_ON_CHANGE events.
+ *
+ * COALESCED is the number of changes that were folded into a pending
+ * event while batching.
+ * DELIVERED is the number of events actually sent to listeners. */
+struct _BufferEventCounters
+{
+        UINT coalesced;
+        UINT delivered;
+};
+
 /* A callback for Buffer events. */
 typedef void (*BufferListenerCallback)(Buffer *, BufferEvent, VOID *closure);
 
@@ -19,5 +31,10 @@ UINT BufferLength(Buffer const *buffer);
 BOOL BufferPopChar(Buffer *buffer, UINT n);
 BOOL BufferPushChar(Buffer *buffer, TCHAR c, UINT n);
 LPCTSTR BufferContents(Buffer const *buffer);
+int BufferChangeDelta(Buffer const *buffer);
+UINT BufferChangeStart(Buffer const *buffer);
+void BufferSetBatching(Buffer *buffer, BOOL batching);
+void BufferFlush(Buffer *buffer);
+void BufferEventCountersGet(Buffer const *buffer, BufferEventCounters *counters);
 BOOL BufferRegisterListener(Buffer *buffer, BufferEvent event, BufferListenerCallback callback, VOID *closure);
 void BufferUnregisterListener(Buffer *buffer, BufferEvent event, BufferListenerCallback callback);
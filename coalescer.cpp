@@ -0,0 +1,207 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "coalescer.h"
+
+/* The number of keys there’s room for to begin with.  Must be a power
+ * of two. */
+#define COALESCER_INITIAL_CAPACITY      16
+
+/* A key waiting to become due at DUE. */
+typedef struct _CoalescerEntry CoalescerEntry;
+
+struct _CoalescerEntry
+{
+        unsigned long long key;
+        unsigned long due;
+};
+
+/* ENTRIES is a ring of CAPACITY entries, the N_ENTRIES waiting ones
+ * starting at FIRST, in the order they were posted, which is the order
+ * they become due in.  SLOTS is an open-addressed set of the keys
+ * waiting, with twice as many slots as there’s room for entries, each
+ * slot holding the index into ENTRIES plus one, or 0 if it’s free. */
+struct _Coalescer
+{
+        unsigned long delay;
+        CoalescerEntry *entries;
+        unsigned int capacity;
+        unsigned int first;
+        unsigned int n_entries;
+        unsigned int *slots;
+};
+
+/* Mixes the bits of KEY, so that handles and pointers, which share most
+ * of their bits, spread over the slots. */
+static unsigned int
+CoalescerHash(unsigned long long key)
+{
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+
+        return (unsigned int)key;
+}
+
+static unsigned int
+CoalescerSlotMask(Coalescer const *coalescer)
+{
+        return 2 * coalescer->capacity - 1;
+}
+
+/* Finds the slot of KEY in COALESCER, or the free slot it would go in. */
+static unsigned int
+CoalescerFindSlot(Coalescer const *coalescer, unsigned long long key)
+{
+        unsigned int mask = CoalescerSlotMask(coalescer);
+        unsigned int i = CoalescerHash(key) & mask;
+
+        while (coalescer->slots[i] != 0 && coalescer->entries[coalescer->slots[i] - 1].key != key)
+                i = (i + 1) & mask;
+
+        return i;
+}
+
+/* Frees slot I of COALESCER, moving the slots after it that would
+ * otherwise no longer be found back into place. */
+static void
+CoalescerFreeSlot(Coalescer *coalescer, unsigned int i)
+{
+        unsigned int mask = CoalescerSlotMask(coalescer);
+        unsigned int j = i;
+
+        for (;;) {
+                coalescer->slots[i] = 0;
+                for (;;) {
+                        j = (j + 1) & mask;
+                        if (coalescer->slots[j] == 0)
+                                return;
+
+                        unsigned int home = CoalescerHash(coalescer->entries[coalescer->slots[j] - 1].key) & mask;
+                        if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+                                break;
+                }
+                coalescer->slots[i] = coalescer->slots[j];
+                i = j;
+        }
+}
+
+/* Gives COALESCER room for twice as many entries, moving the waiting
+ * ones to the start of the ring.  Returns 0 if we run out of memory. */
+static int
+CoalescerGrow(Coalescer *coalescer)
+{
+        unsigned int capacity = 2 * coalescer->capacity;
+        CoalescerEntry *entries = (CoalescerEntry *)malloc(capacity * sizeof(CoalescerEntry));
+        unsigned int *slots = (unsigned int *)calloc(2 * capacity, sizeof(unsigned int));
+        if (entries == NULL || slots == NULL) {
+                free(entries);
+                free(slots);
+                return 0;
+        }
+
+        for (unsigned int i = 0; i < coalescer->n_entries; i++)
+                entries[i] = coalescer->entries[(coalescer->first + i) & (coalescer->capacity - 1)];
+
+        free(coalescer->entries);
+        free(coalescer->slots);
+        coalescer->entries = entries;
+        coalescer->slots = slots;
+        coalescer->capacity = capacity;
+        coalescer->first = 0;
+
+        for (unsigned int i = 0; i < coalescer->n_entries; i++)
+                coalescer->slots[CoalescerFindSlot(coalescer, entries[i].key)] = i + 1;
+
+        return 1;
+}
+
+/* Creates a Coalescer whose keys become due DELAY milliseconds after
+ * they’re posted.  Returns NULL if we run out of memory. */
+Coalescer *
+CoalescerNew(unsigned long delay)
+{
+        Coalescer *coalescer = (Coalescer *)calloc(1, sizeof(Coalescer));
+        if (coalescer == NULL)
+                return NULL;
+
+        coalescer->delay = delay;
+        coalescer->capacity = COALESCER_INITIAL_CAPACITY;
+        coalescer->entries = (CoalescerEntry *)malloc(coalescer->capacity * sizeof(CoalescerEntry));
+        coalescer->slots = (unsigned int *)calloc(2 * coalescer->capacity, sizeof(unsigned int));
+        if (coalescer->entries == NULL || coalescer->slots == NULL) {
+                CoalescerFree(coalescer);
+                return NULL;
+        }
+
+        return coalescer;
+}
+
+/* Frees COALESCER, forgetting the keys waiting. */
+void
+CoalescerFree(Coalescer *coalescer)
+{
+        free(coalescer->entries);
+        free(coalescer->slots);
+        free(coalescer);
+}
+
+/* Posts KEY to COALESCER at NOW, making it due DELAY milliseconds later
+ * unless it’s waiting already.  Returns 0 if we run out of memory. */
+int
+CoalescerPost(Coalescer *coalescer, unsigned long long key, unsigned long now)
+{
+        if (coalescer->slots[CoalescerFindSlot(coalescer, key)] != 0)
+                return 1;
+
+        if (coalescer->n_entries == coalescer->capacity && !CoalescerGrow(coalescer))
+                return 0;
+
+        unsigned int i = (coalescer->first + coalescer->n_entries) & (coalescer->capacity - 1);
+        coalescer->entries[i].key = key;
+        coalescer->entries[i].due = now + coalescer->delay;
+        coalescer->slots[CoalescerFindSlot(coalescer, key)] = i + 1;
+        coalescer->n_entries++;
+
+        return 1;
+}
+
+/* Takes the KEY that’s been waiting the longest off COALESCER if it’s
+ * due at NOW.  Returns 0 if no key is due. */
+int
+CoalescerTake(Coalescer *coalescer, unsigned long now, unsigned long long *key)
+{
+        if (coalescer->n_entries == 0 || CoalescerNextDue(coalescer, now) > 0)
+                return 0;
+
+        *key = coalescer->entries[coalescer->first].key;
+        CoalescerFreeSlot(coalescer, CoalescerFindSlot(coalescer, *key));
+        coalescer->first = (coalescer->first + 1) & (coalescer->capacity - 1);
+        coalescer->n_entries--;
+
+        return 1;
+}
+
+/* Gets the number of milliseconds from NOW until the next key of
+ * COALESCER is due, which is 0 if one is due already or none are
+ * waiting. */
+unsigned long
+CoalescerNextDue(Coalescer const *coalescer, unsigned long now)
+{
+        if (coalescer->n_entries == 0)
+                return 0;
+
+        long left = (long)(coalescer->entries[coalescer->first].due - now);
+
+        return left > 0 ? (unsigned long)left : 0;
+}
+
+/* Gets the number of keys waiting in COALESCER. */
+unsigned int
+CoalescerLength(Coalescer const *coalescer)
+{
+        return coalescer->n_entries;
+}
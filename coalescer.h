@@ -0,0 +1,15 @@
+﻿/* A coalescer of notifications about keys, such as windows whose icons
+ * changed, so that a storm of them about the same key is handled once
+ * per period.  A key posted becomes due DELAY milliseconds later, and
+ * posting it again until then changes nothing.  Keys become due in the
+ * order they were posted.  Times are in milliseconds, as given by a
+ * clock that may wrap around, such as GetTickCount().  Like the pixel
+ * kernels, it only depends on the C runtime. */
+typedef struct _Coalescer Coalescer;
+
+Coalescer *CoalescerNew(unsigned long delay);
+void CoalescerFree(Coalescer *coalescer);
+int CoalescerPost(Coalescer *coalescer, unsigned long long key, unsigned long now);
+int CoalescerTake(Coalescer *coalescer, unsigned long now, unsigned long long *key);
+unsigned long CoalescerNextDue(Coalescer const *coalescer, unsigned long now);
+unsigned int CoalescerLength(Coalescer const *coalescer);
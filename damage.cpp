@@ -0,0 +1,207 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stdlib.h>
+
+#include "damage.h"
+
+/* RECTS holds the N_RECTS rectangles of the damage, with room for one
+ * more than the MAX_RECTS kept, for the one being added. */
+struct _Damage
+{
+        DamageRect *rects;
+        unsigned int n_rects;
+        unsigned int max_rects;
+};
+
+static long long
+DamageRectArea(DamageRect const *r)
+{
+        return (long long)r->width * r->height;
+}
+
+/* Sets U to the smallest rectangle covering both A and B. */
+static void
+DamageRectUnion(DamageRect const *a, DamageRect const *b, DamageRect *u)
+{
+        int left = (a->x < b->x) ? a->x : b->x;
+        int top = (a->y < b->y) ? a->y : b->y;
+        int right = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+        int bottom = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+
+        u->x = left;
+        u->y = top;
+        u->width = right - left;
+        u->height = bottom - top;
+}
+
+/* Gets the area the union of A and B covers beyond what A and B cover,
+ * which is at most zero if they can be merged for free. */
+static long long
+DamageRectWaste(DamageRect const *a, DamageRect const *b)
+{
+        DamageRect u;
+        DamageRectUnion(a, b, &u);
+
+        return DamageRectArea(&u) - DamageRectArea(a) - DamageRectArea(b);
+}
+
+static void
+DamageRemove(Damage *damage, unsigned int i)
+{
+        damage->rects[i] = damage->rects[--damage->n_rects];
+}
+
+/* Adds R to DAMAGE, first merging it with every rectangle its union with
+ * which covers nothing more, including those it contains or is contained
+ * in.  This may leave DAMAGE with one rectangle too many. */
+static void
+DamageAbsorb(Damage *damage, DamageRect r)
+{
+        unsigned int i = 0;
+        while (i < damage->n_rects) {
+                if (DamageRectWaste(&damage->rects[i], &r) <= 0) {
+                        DamageRectUnion(&damage->rects[i], &r, &r);
+                        DamageRemove(damage, i);
+                        i = 0;
+                } else {
+                        i++;
+                }
+        }
+
+        damage->rects[damage->n_rects++] = r;
+}
+
+/* Merges the two rectangles of DAMAGE whose union covers the least area
+ * beyond theirs. */
+static void
+DamageMergeCheapest(Damage *damage)
+{
+        unsigned int best_i = 0, best_j = 1;
+        long long best_waste = DamageRectWaste(&damage->rects[0], &damage->rects[1]);
+        for (unsigned int i = 0; i < damage->n_rects; i++) {
+                for (unsigned int j = i + 1; j < damage->n_rects; j++) {
+                        long long waste = DamageRectWaste(&damage->rects[i], &damage->rects[j]);
+                        if (waste < best_waste) {
+                                best_waste = waste;
+                                best_i = i;
+                                best_j = j;
+                        }
+                }
+        }
+
+        DamageRect u;
+        DamageRectUnion(&damage->rects[best_i], &damage->rects[best_j], &u);
+        DamageRemove(damage, best_j);
+        DamageRemove(damage, best_i);
+        DamageAbsorb(damage, u);
+}
+
+/* Creates an empty Damage kept as at most MAX_RECTS rectangles, at least
+ * one.  Returns NULL if we run out of memory. */
+Damage *
+DamageNew(unsigned int max_rects)
+{
+        Damage *damage = (Damage *)calloc(1, sizeof(Damage));
+        if (damage == NULL)
+                return NULL;
+
+        damage->max_rects = (max_rects > 0) ? max_rects : 1;
+        damage->rects = (DamageRect *)malloc((damage->max_rects + 1) * sizeof(DamageRect));
+        if (damage->rects == NULL) {
+                free(damage);
+                return NULL;
+        }
+
+        return damage;
+}
+
+void
+DamageFree(Damage *damage)
+{
+        free(damage->rects);
+        free(damage);
+}
+
+/* Forgets all of DAMAGE, e.g., after it’s been drawn anew. */
+void
+DamageClear(Damage *damage)
+{
+        damage->n_rects = 0;
+}
+
+/* Adds the rectangle of WIDTH by HEIGHT at X and Y to DAMAGE.  Empty
+ * rectangles are ignored. */
+void
+DamageAdd(Damage *damage, int x, int y, int width, int height)
+{
+        if (width <= 0 || height <= 0)
+                return;
+
+        DamageRect r = { x, y, width, height };
+        DamageAbsorb(damage, r);
+        while (damage->n_rects > damage->max_rects)
+                DamageMergeCheapest(damage);
+}
+
+/* Limits DAMAGE to the rectangle of WIDTH by HEIGHT at X and Y, e.g.,
+ * the bounds of the surface. */
+void
+DamageClip(Damage *damage, int x, int y, int width, int height)
+{
+        unsigned int i = 0;
+        while (i < damage->n_rects) {
+                DamageRect *r = &damage->rects[i];
+                int left = (r->x > x) ? r->x : x;
+                int top = (r->y > y) ? r->y : y;
+                int right = (r->x + r->width < x + width) ? r->x + r->width : x + width;
+                int bottom = (r->y + r->height < y + height) ? r->y + r->height : y + height;
+                if (right <= left || bottom <= top) {
+                        DamageRemove(damage, i);
+                        continue;
+                }
+
+                r->x = left;
+                r->y = top;
+                r->width = right - left;
+                r->height = bottom - top;
+                i++;
+        }
+}
+
+int
+DamageIsEmpty(Damage const *damage)
+{
+        return damage->n_rects == 0;
+}
+
+/* Gets the number of rectangles of DAMAGE, as returned by
+ * DamageRects(). */
+unsigned int
+DamageLength(Damage const *damage)
+{
+        return damage->n_rects;
+}
+
+/* Gets the rectangles of DAMAGE, which don’t necessarily stay put as
+ * more are added. */
+DamageRect const *
+DamageRects(Damage const *damage)
+{
+        return damage->rects;
+}
+
+/* Sets BOUNDS to the smallest rectangle covering all of DAMAGE.  Returns
+ * 0 if DAMAGE is empty. */
+int
+DamageBounds(Damage const *damage, DamageRect *bounds)
+{
+        if (damage->n_rects == 0)
+                return 0;
+
+        *bounds = damage->rects[0];
+        for (unsigned int i = 1; i < damage->n_rects; i++)
+                DamageRectUnion(bounds, &damage->rects[i], bounds);
+
+        return 1;
+}
@@ -0,0 +1,29 @@
+﻿/* The damage of a surface: the areas of it that need drawing anew, kept
+ * as at most a given number of rectangles.  Rectangles added that touch
+ * or overlap others so that their union covers nothing more are merged
+ * with them, and once there are too many, the two whose union covers the
+ * least area beyond theirs are merged.  The rectangles thus always cover
+ * everything added and never stray outside the bounds of what was.
+ * Like the pixel kernels, it only depends on the C runtime. */
+typedef struct _Damage Damage;
+typedef struct _DamageRect DamageRect;
+
+/* A rectangle of WIDTH by HEIGHT pixels whose top-left corner is at X
+ * and Y. */
+struct _DamageRect
+{
+        int x;
+        int y;
+        int width;
+        int height;
+};
+
+Damage *DamageNew(unsigned int max_rects);
+void DamageFree(Damage *damage);
+void DamageClear(Damage *damage);
+void DamageAdd(Damage *damage, int x, int y, int width, int height);
+void DamageClip(Damage *damage, int x, int y, int width, int height);
+int DamageIsEmpty(Damage const *damage);
+unsigned int DamageLength(Damage const *damage);
+DamageRect const *DamageRects(Damage const *damage);
+int DamageBounds(Damage const *damage, DamageRect *bounds);
@@ -0,0 +1,276 @@
+﻿#include "stdafx.h"
+#include <shlobj.h>
+
+#include "pixels.h"
+#include "bitmap.h"
+#include "iconstore.h"
+#include "diskcache.h"
+
+/* The most icons kept on disk.  Icons remembered during a run come
+ * first, and those kept from earlier runs fill up what’s left. */
+#define DISK_CACHE_MAX_ICONS    512
+
+/* The longest key an icon is kept under, including its size. */
+#define DISK_CACHE_MAX_KEY      (MAX_PATH + 512)
+
+/* The cache file, under the local application-data folder, and the file
+ * it’s written to before replacing it. */
+#define DISK_CACHE_DIRECTORY    L"\\Window Prefix"
+#define DISK_CACHE_FILE         L"\\icons.cache"
+#define DISK_CACHE_NEW_FILE     L"\\icons.cache.new"
+
+/* The icons on disk.
+ *
+ * FILE, MAPPING, and VIEW map the cache file into memory, and STORE reads
+ * it; they’re all NULL if there was no cache file or it was corrupt.
+ * REMEMBERED holds the icons to write back to disk, and IS_DIRTY is set
+ * once any of them differs from what’s on disk. */
+struct _DiskCache
+{
+        HANDLE file;
+        HANDLE mapping;
+        VOID const *view;
+        IconStore *store;
+        IconStoreWriter *remembered;
+        BOOL is_dirty;
+};
+
+/* Gets the PATH of the directory of the cache file, creating the
+ * directory if it doesn’t exist. */
+static BOOL
+DiskCacheDirectory(TCHAR path[MAX_PATH])
+{
+        if (FAILED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA |
+                                      CSIDL_FLAG_CREATE, NULL,
+                                      SHGFP_TYPE_CURRENT, path)))
+                return FALSE;
+
+        if (FAILED(StringCchCat(path, MAX_PATH, DISK_CACHE_DIRECTORY)))
+                return FALSE;
+
+        return CreateDirectory(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+/* Gets the PATH of the cache file, or of the one it’s written to if
+ * IS_NEW. */
+static BOOL
+DiskCachePath(TCHAR path[MAX_PATH], BOOL is_new)
+{
+        return DiskCacheDirectory(path) &&
+               SUCCEEDED(StringCchCat(path, MAX_PATH, is_new ? DISK_CACHE_NEW_FILE : DISK_CACHE_FILE));
+}
+
+/* Maps the cache file into CACHE and opens it.  Leaves CACHE empty if
+ * there’s no cache file or if it’s corrupt or of some other version. */
+static void
+DiskCacheMap(DiskCache *cache)
+{
+        TCHAR path[MAX_PATH];
+        if (!DiskCachePath(path, FALSE))
+                return;
+
+        cache->file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (cache->file == INVALID_HANDLE_VALUE) {
+                cache->file = NULL;
+                return;
+        }
+
+        DWORD size = GetFileSize(cache->file, NULL);
+        if (size != INVALID_FILE_SIZE && size > 0)
+                cache->mapping = CreateFileMapping(cache->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (cache->mapping != NULL)
+                cache->view = MapViewOfFile(cache->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (cache->view != NULL)
+                cache->store = IconStoreOpen(cache->view, size);
+}
+
+/* Unmaps the cache file from CACHE. */
+static void
+DiskCacheUnmap(DiskCache *cache)
+{
+        IconStoreClose(cache->store);
+        cache->store = NULL;
+
+        if (cache->view != NULL)
+                UnmapViewOfFile(cache->view);
+        cache->view = NULL;
+
+        if (cache->mapping != NULL)
+                CloseHandle(cache->mapping);
+        cache->mapping = NULL;
+
+        if (cache->file != NULL)
+                CloseHandle(cache->file);
+        cache->file = NULL;
+}
+
+/* Opens the icons on disk.  Returns NULL if we run out of memory; a
+ * missing or corrupt cache file just leaves the cache empty. */
+DiskCache *
+DiskCacheOpen(VOID)
+{
+        DiskCache *cache = ALLOC_STRUCT(DiskCache);
+        if (cache == NULL)
+                return NULL;
+
+        cache->remembered = IconStoreWriterNew();
+        if (cache->remembered == NULL) {
+                FREE(cache);
+                return NULL;
+        }
+
+        DiskCacheMap(cache);
+
+        return cache;
+}
+
+/* Sets FULL_KEY to the key of the icon of WIDTH by HEIGHT pixels kept
+ * under KEY, setting SIZE to its size in bytes. */
+static BOOL
+DiskCacheKey(LPCTSTR key, UINT width, UINT height, TCHAR full_key[DISK_CACHE_MAX_KEY], size_t *size)
+{
+        size_t length;
+        if (FAILED(StringCchPrintf(full_key, DISK_CACHE_MAX_KEY, L"%s|%ux%u", key, width, height)) ||
+            FAILED(StringCchLength(full_key, DISK_CACHE_MAX_KEY, &length)))
+                return FALSE;
+
+        *size = length * sizeof(TCHAR);
+
+        return TRUE;
+}
+
+/* Writes the SIZE bytes of DATA to the cache file, replacing it only once
+ * all of them have been written. */
+static BOOL
+DiskCacheWrite(VOID const *data, size_t size)
+{
+        TCHAR path[MAX_PATH], new_path[MAX_PATH];
+        if (!DiskCachePath(path, FALSE) || !DiskCachePath(new_path, TRUE))
+                return FALSE;
+
+        HANDLE file = CreateFile(new_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+                return FALSE;
+
+        DWORD n_written;
+        BOOL is_written = WriteFile(file, data, (DWORD)size, &n_written, NULL) && n_written == size;
+        CloseHandle(file);
+
+        if (is_written && MoveFileEx(new_path, path, MOVEFILE_REPLACE_EXISTING))
+                return TRUE;
+
+        DeleteFile(new_path);
+
+        return FALSE;
+}
+
+/* Adds the icons kept on disk that weren’t remembered during this run to
+ * the icons of CACHE to be written back, as long as there’s room. */
+static void
+DiskCacheKeepOld(DiskCache *cache)
+{
+        if (cache->store == NULL)
+                return;
+
+        UINT n = IconStoreLength(cache->store);
+        for (UINT i = 0; i < n && IconStoreWriterLength(cache->remembered) < DISK_CACHE_MAX_ICONS; i++) {
+                VOID const *key;
+                size_t key_size;
+                UINT width, height;
+                PixelsARGB const *pixels;
+                if (IconStoreEntry(cache->store, i, &key, &key_size, &width, &height, &pixels) &&
+                    !IconStoreWriterHas(cache->remembered, key, key_size))
+                        IconStoreWriterAdd(cache->remembered, key, key_size, width, height, pixels);
+        }
+}
+
+/* Writes the icons remembered in CACHE back to disk, if any of them are
+ * new, and closes it. */
+void
+DiskCacheClose(DiskCache *cache)
+{
+        if (cache == NULL)
+                return;
+
+        VOID *data = NULL;
+        size_t size;
+        if (cache->is_dirty) {
+                DiskCacheKeepOld(cache);
+                if (!IconStoreWriterFinish(cache->remembered, &data, &size))
+                        data = NULL;
+        }
+
+        DiskCacheUnmap(cache);
+
+        if (data != NULL) {
+                DiskCacheWrite(data, size);
+                free(data);
+        }
+
+        IconStoreWriterFree(cache->remembered);
+        FREE(cache);
+}
+
+/* Sets ICON to a new bitmap of the icon of WIDTH by HEIGHT pixels kept
+ * under KEY in CACHE.  Returns FALSE if there’s no such icon.  It only
+ * reads the icons read from disk, so it may be called from the loader
+ * threads while icons are being remembered. */
+BOOL
+DiskCacheGet(DiskCache *cache, LPCTSTR key, UINT width, UINT height, Bitmap **icon)
+{
+        if (cache == NULL || cache->store == NULL)
+                return FALSE;
+
+        TCHAR full_key[DISK_CACHE_MAX_KEY];
+        size_t key_size;
+        if (!DiskCacheKey(key, width, height, full_key, &key_size))
+                return FALSE;
+
+        UINT stored_width, stored_height;
+        PixelsARGB const *pixels;
+        if (!IconStoreLookup(cache->store, full_key, key_size, &stored_width, &stored_height, &pixels) ||
+            stored_width != width || stored_height != height)
+                return FALSE;
+
+        return BitmapFromPixels(width, height, pixels, icon) == Ok;
+}
+
+/* Determines whether the PIXELS of an icon of WIDTH by HEIGHT pixels are
+ * what’s kept on disk under the KEY_SIZE bytes of KEY in CACHE already. */
+static BOOL
+DiskCacheIsStored(DiskCache *cache, VOID const *key, size_t key_size, UINT width, UINT height,
+                  PixelsARGB const *pixels)
+{
+        UINT stored_width, stored_height;
+        PixelsARGB const *stored_pixels;
+
+        return cache->store != NULL &&
+               IconStoreLookup(cache->store, key, key_size, &stored_width, &stored_height, &stored_pixels) &&
+               stored_width == width && stored_height == height &&
+               memcmp(stored_pixels, pixels, width * height * sizeof(ARGB)) == 0;
+}
+
+/* Remembers ICON as the icon kept under KEY in CACHE, to be written to
+ * disk when CACHE is closed. */
+void
+DiskCacheRemember(DiskCache *cache, LPCTSTR key, Bitmap *icon)
+{
+        if (cache == NULL)
+                return;
+
+        UINT width, height;
+        ARGB *pixels;
+        if (BitmapGetPixels(icon, &width, &height, &pixels) != Ok)
+                return;
+
+        TCHAR full_key[DISK_CACHE_MAX_KEY];
+        size_t key_size;
+        if (DiskCacheKey(key, width, height, full_key, &key_size) &&
+            (IconStoreWriterLength(cache->remembered) < DISK_CACHE_MAX_ICONS ||
+             IconStoreWriterHas(cache->remembered, full_key, key_size)) &&
+            IconStoreWriterAdd(cache->remembered, full_key, key_size, width, height, pixels) &&
+            !DiskCacheIsStored(cache, full_key, key_size, width, height, pixels))
+                cache->is_dirty = TRUE;
+
+        FREE(pixels);
+}
@@ -0,0 +1,10 @@
+﻿/* A cache of scaled icons on disk, so that windows get their own icons
+ * straight away on the first window list after starting up.  Icons are
+ * kept under keys given by WindowSourceIconKey() and the size they’re
+ * scaled to. */
+typedef struct _DiskCache DiskCache;
+
+DiskCache *DiskCacheOpen(VOID);
+void DiskCacheClose(DiskCache *cache);
+BOOL DiskCacheGet(DiskCache *cache, LPCTSTR key, UINT width, UINT height, Bitmap **icon);
+void DiskCacheRemember(DiskCache *cache, LPCTSTR key, Bitmap *icon);
@@ -0,0 +1,318 @@
+﻿#include "stdafx.h"
+#include <process.h>
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "requestslot.h"
+#include "filter.h"
+
+/* A Filter matches a WindowList against a prefix on a worker thread, so
+ * that the message loop keeps running while an expensive match is being
+ * done.  Requests are handed over through a RequestSlot, which tags each
+ * of them with a generation.  Submitting a new request or cancelling
+ * bumps the generation, which makes the worker abandon any match in
+ * progress and makes stale results be ignored once they are posted
+ * back.  All that’s left here is the worker thread and waiting for it. */
+
+/* A request for filtering LIST by PREFIX.  N_ITEMS is the length of LIST
+ * at the time of the request. */
+typedef struct _FilterRequest FilterRequest;
+
+struct _FilterRequest
+{
+        WindowList *list;
+        int n_items;
+        LPTSTR prefix;
+};
+
+/* The result of a FilterRequest made at GENERATION for LIST, MATCHES
+ * being the result of WindowListMatch(). */
+struct _FilterResult
+{
+        LONG generation;
+        WindowList *list;
+        BOOL *matches;
+};
+
+/* A worker filtering window lists.
+ *
+ * WINDOW is the window WM_FILTERDONE is posted to.
+ * THREAD is the worker thread.
+ * WAKE is signalled whenever there is something for the worker to do.
+ * IDLE is signalled while the worker isn’t looking at any WindowList.
+ * LOCK protects SLOT, apart from checking its generation, and QUIT.
+ * SLOT holds the request waiting to be picked up by the worker.
+ * QUIT tells the worker to exit. */
+struct _Filter
+{
+        HWND window;
+        HANDLE thread;
+        HANDLE wake;
+        HANDLE idle;
+        CRITICAL_SECTION lock;
+        RequestSlot slot;
+        BOOL quit;
+};
+
+static FilterRequest *
+FilterRequestNew(WindowList *list, LPCTSTR prefix)
+{
+        FilterRequest *request = ALLOC_STRUCT(FilterRequest);
+        if (request == NULL)
+                return NULL;
+
+        size_t length;
+        if (FAILED(StringCchLength(prefix, STRSAFE_MAX_CCH, &length)))
+                goto cleanup;
+
+        request->prefix = ALLOC_N(TCHAR, ZERO_TERMINATE(length));
+        if (request->prefix == NULL)
+                goto cleanup;
+
+        if (FAILED(StringCchCopy(request->prefix, ZERO_TERMINATE(length), prefix)))
+                goto cleanup;
+
+        request->list = list;
+        request->n_items = WindowListLength(list);
+
+        return request;
+
+cleanup:
+        if (request->prefix != NULL)
+                FREE(request->prefix);
+        FREE(request);
+
+        return NULL;
+}
+
+static void
+FilterRequestFree(FilterRequest *request)
+{
+        if (request == NULL)
+                return;
+
+        FREE(request->prefix);
+        FREE(request);
+}
+
+/* Frees a FilterResult received through WM_FILTERDONE. */
+void
+FilterResultFree(FilterResult *result)
+{
+        if (result->matches != NULL)
+                FREE(result->matches);
+        FREE(result);
+}
+
+/* Closure used to check if a request has been superseded. */
+typedef struct _FilterCancelledClosure FilterCancelledClosure;
+
+struct _FilterCancelledClosure
+{
+        Filter *filter;
+        LONG generation;
+};
+
+static BOOL
+FilterCancelled(void *v_closure)
+{
+        FilterCancelledClosure *closure = (FilterCancelledClosure *)v_closure;
+
+        return !RequestSlotIsCurrent(&closure->filter->slot, closure->generation);
+}
+
+/* Runs REQUEST, made at GENERATION, returning NULL if it was cancelled
+ * or we ran out of memory. */
+static FilterResult *
+FilterRun(Filter *filter, FilterRequest *request, LONG generation)
+{
+        FilterResult *result = ALLOC_STRUCT(FilterResult);
+        if (result == NULL)
+                return NULL;
+
+        result->generation = generation;
+        result->list = request->list;
+        result->matches = ALLOC_N(BOOL, max(request->n_items, 1));
+
+        FilterCancelledClosure closure = { filter, generation };
+        if (result->matches != NULL &&
+            WindowListMatch(request->list, request->prefix, result->matches,
+                            FilterCancelled, &closure))
+                return result;
+
+        FilterResultFree(result);
+
+        return NULL;
+}
+
+/* Takes the pending request, if any, setting GENERATION to the one it
+ * was made at and marking the worker as busy if there is one.  Sets
+ * QUIT if the worker should exit. */
+static FilterRequest *
+FilterTakeRequest(Filter *filter, LONG *generation, BOOL *quit)
+{
+        EnterCriticalSection(&filter->lock);
+
+        FilterRequest *request = (FilterRequest *)RequestSlotTake(&filter->slot, generation);
+        *quit = filter->quit;
+        if (request != NULL && !*quit)
+                ResetEvent(filter->idle);
+
+        LeaveCriticalSection(&filter->lock);
+
+        return request;
+}
+
+/* Marks the worker as done with the request it took at GENERATION.
+ * Returns FALSE if the request has been superseded or cancelled since. */
+static BOOL
+FilterFinishRequest(Filter *filter, LONG generation)
+{
+        EnterCriticalSection(&filter->lock);
+        BOOL is_current = RequestSlotFinish(&filter->slot, generation);
+        LeaveCriticalSection(&filter->lock);
+
+        return is_current;
+}
+
+static unsigned __stdcall
+FilterThreadProc(void *closure)
+{
+        Filter *filter = (Filter *)closure;
+
+        while (WaitForSingleObject(filter->wake, INFINITE) == WAIT_OBJECT_0) {
+                LONG generation;
+                BOOL quit;
+                FilterRequest *request = FilterTakeRequest(filter, &generation, &quit);
+                if (quit) {
+                        FilterRequestFree(request);
+                        break;
+                }
+
+                if (request == NULL)
+                        continue;
+
+                FilterResult *result = FilterRun(filter, request, generation);
+                FilterRequestFree(request);
+
+                BOOL is_current = FilterFinishRequest(filter, generation);
+                if (result != NULL &&
+                    (!is_current || !PostMessage(filter->window, WM_FILTERDONE, 0, (LPARAM)result)))
+                        FilterResultFree(result);
+
+                SetEvent(filter->idle);
+        }
+
+        return 0;
+}
+
+/* Creates a new Filter, posting results to WINDOW. */
+Filter *
+FilterNew(HWND window)
+{
+        Filter *filter = ALLOC_STRUCT(Filter);
+        if (filter == NULL)
+                return NULL;
+
+        filter->window = window;
+        InitializeCriticalSection(&filter->lock);
+        RequestSlotInit(&filter->slot);
+
+        filter->wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (filter->wake == NULL)
+                goto cleanup;
+
+        filter->idle = CreateEvent(NULL, TRUE, TRUE, NULL);
+        if (filter->idle == NULL)
+                goto cleanup;
+
+        filter->thread = (HANDLE)_beginthreadex(NULL, 0, FilterThreadProc, filter, 0, NULL);
+        if (filter->thread == NULL)
+                goto cleanup;
+
+        return filter;
+
+cleanup:
+        FilterFree(filter);
+
+        return NULL;
+}
+
+/* Stops the worker of FILTER and frees it. */
+void
+FilterFree(Filter *filter)
+{
+        if (filter->thread != NULL) {
+                FilterCancel(filter);
+
+                EnterCriticalSection(&filter->lock);
+                filter->quit = TRUE;
+                LeaveCriticalSection(&filter->lock);
+
+                SetEvent(filter->wake);
+                WaitForSingleObject(filter->thread, INFINITE);
+                CloseHandle(filter->thread);
+        }
+
+        if (filter->idle != NULL)
+                CloseHandle(filter->idle);
+        if (filter->wake != NULL)
+                CloseHandle(filter->wake);
+
+        FilterRequestFree((FilterRequest *)RequestSlotCancel(&filter->slot));
+        DeleteCriticalSection(&filter->lock);
+        FREE(filter);
+}
+
+/* Asks FILTER to match LIST against PREFIX, superseding any earlier
+ * request.  Returns FALSE if the request couldn’t be made, in which
+ * case the caller should filter LIST itself. */
+BOOL
+FilterSubmit(Filter *filter, WindowList *list, LPCTSTR prefix)
+{
+        FilterRequest *request = FilterRequestNew(list, prefix);
+        if (request == NULL) {
+                FilterCancel(filter);
+                return FALSE;
+        }
+
+        EnterCriticalSection(&filter->lock);
+        FilterRequest *superseded = (FilterRequest *)RequestSlotPost(&filter->slot, request);
+        LeaveCriticalSection(&filter->lock);
+
+        FilterRequestFree(superseded);
+
+        SetEvent(filter->wake);
+
+        return TRUE;
+}
+
+/* Cancels any outstanding request of FILTER and waits until the worker
+ * has let go of the WindowList it was looking at.  This must be called
+ * before a WindowList that has been submitted is changed or freed. */
+void
+FilterCancel(Filter *filter)
+{
+        EnterCriticalSection(&filter->lock);
+        FilterRequest *cancelled = (FilterRequest *)RequestSlotCancel(&filter->slot);
+        LeaveCriticalSection(&filter->lock);
+
+        FilterRequestFree(cancelled);
+
+        WaitForSingleObject(filter->idle, INFINITE);
+}
+
+/* Applies RESULT to the WindowList it was calculated for, unless a newer
+ * request has been made or FILTER has been cancelled since.  Returns
+ * TRUE if RESULT was applied. */
+BOOL
+FilterResultApply(Filter *filter, FilterResult *result)
+{
+        if (!RequestSlotIsCurrent(&filter->slot, result->generation))
+                return FALSE;
+
+        WindowListApplyMatches(result->list, result->matches);
+
+        return TRUE;
+}
@@ -0,0 +1,19 @@
+﻿typedef struct _Filter Filter;
+typedef struct _FilterResult FilterResult;
+
+/* Message posted to the window given to FilterNew() whenever a filtering
+ * has finished.  The FilterResult must be passed to FilterResultFree(). */
+#define WM_FILTERDONE       (WM_USER + 346)
+
+/* void Cls_OnFilterDone(HWND hwnd, FilterResult *result) */
+#define HANDLE_WM_FILTERDONE(hwnd, wParam, lParam, fn) \
+        ((fn)((hwnd), (FilterResult *)(lParam)), 0L)
+#define FORWARD_WM_FILTERDONE(hwnd, result, fn) \
+        (void)(fn)((hwnd), WM_FILTERDONE, 0, (LPARAM)(result))
+
+Filter *FilterNew(HWND window);
+void FilterFree(Filter *filter);
+BOOL FilterSubmit(Filter *filter, WindowList *list, LPCTSTR prefix);
+void FilterCancel(Filter *filter);
+BOOL FilterResultApply(Filter *filter, FilterResult *result);
+void FilterResultFree(FilterResult *result);
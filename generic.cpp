@@ -8,6 +8,26 @@
 
 typedef BOOL (WINAPI *IsHungAppWindowFunc)(HWND);
 
+/* UPDATELAYEREDWINDOWINFO and UpdateLayeredWindowIndirect(), which are
+ * only declared for Windows Vista and later. */
+typedef struct _LayeredWindowUpdate LayeredWindowUpdate;
+
+struct _LayeredWindowUpdate
+{
+        DWORD cbSize;
+        HDC hdcDst;
+        POINT const *pptDst;
+        SIZE const *psize;
+        HDC hdcSrc;
+        POINT const *pptSrc;
+        COLORREF crKey;
+        BLENDFUNCTION const *pblend;
+        DWORD dwFlags;
+        RECT const *prcDirty;
+};
+
+typedef BOOL (WINAPI *UpdateLayeredWindowIndirectFunc)(HWND, LayeredWindowUpdate const *);
+
 /* A FreeFunc that does nothing. */
 void
 NullFreeFunc(void *data)
@@ -154,6 +174,42 @@ MySwitchToThisWindow(HWND window)
         return success;
 }
 
+/* Updates the layered WINDOW with the pixels of DC, of SIZE, blending
+ * them as BLEND says, like UpdateLayeredWindow().  Only the pixels in
+ * DIRTY are updated, unless it’s NULL or UpdateLayeredWindowIndirect()
+ * isn’t available, as before Windows Vista. */
+BOOL
+MyUpdateLayeredWindow(HWND window, SIZE *size, HDC dc, BLENDFUNCTION *blend, RECT const *dirty)
+{
+        static UpdateLayeredWindowIndirectFunc update_layered_window_indirect;
+        static BOOL tried_loading_update_layered_window_indirect;
+
+        if (!tried_loading_update_layered_window_indirect) {
+                HINSTANCE user32dll = LoadLibrary(L"user32.dll");
+                update_layered_window_indirect = (UpdateLayeredWindowIndirectFunc)GetProcAddress(user32dll, "UpdateLayeredWindowIndirect");
+                tried_loading_update_layered_window_indirect = TRUE;
+        }
+
+        POINT origin;
+        origin.x = 0;
+        origin.y = 0;
+
+        if (dirty != NULL && update_layered_window_indirect != NULL) {
+                LayeredWindowUpdate update;
+                INITSTRUCT(update, TRUE);
+                update.psize = size;
+                update.hdcSrc = dc;
+                update.pptSrc = &origin;
+                update.pblend = blend;
+                update.dwFlags = ULW_ALPHA;
+                update.prcDirty = dirty;
+                if (update_layered_window_indirect(window, &update))
+                        return TRUE;
+        }
+
+        return UpdateLayeredWindow(window, NULL, NULL, size, dc, &origin, 0, blend, ULW_ALPHA);
+}
+
 /* Gets WINDOW’s title-string and stores it in TITLE, allocating fresh memory
  * for it.
  *
@@ -67,6 +67,9 @@ typedef void (*FreeFunc)(void *);
 typedef BOOL (*EqualityFunc)(void *, void *);
 typedef BOOL (*PredicateFunc)(void *);
 
+/* Called with each AREA of a surface that needs drawing anew. */
+typedef void (*DamageFunc)(RectF const *area, VOID *closure);
+
 typedef enum
 {
         IterationContinue,
@@ -78,6 +81,7 @@ BOOL PointerEqualityFunc(void *p1, void *p2);
 BOOL LastErrorWasTimeout(VOID);
 BOOL MyIsHungAppWindow(HWND window);
 BOOL MySwitchToThisWindow(HWND window);
+BOOL MyUpdateLayeredWindow(HWND window, SIZE *size, HDC dc, BLENDFUNCTION *blend, RECT const *dirty);
 BOOL IsToolWindow(HWND window);
 BOOL EnumTaskBarWindows(WNDENUMPROC f, LPARAM lParam);
 BOOL GetWindowTitle(HWND window, LPTSTR *title);
@@ -0,0 +1,234 @@
+﻿#include "stdafx.h"
+
+#include "hashtable.h"
+
+/* A HashTable maps HashKeys, such as window handles, to pointers.  It
+ * uses open addressing with linear probing, so lookups touch a handful
+ * of adjacent slots at most. */
+
+/* The number of slots allocated for a new HashTable.  Must be a power
+ * of two. */
+#define HASHTABLE_DEFAULT_SIZE  32
+
+typedef enum
+{
+        HashSlotEmpty,
+        HashSlotUsed,
+        HashSlotRemoved
+} HashSlotState;
+
+/* A slot in a HashTable, holding VALUE for KEY if STATE is
+ * HashSlotUsed.  Removed slots are kept as markers, so that probing
+ * continues past them. */
+typedef struct _HashSlot HashSlot;
+
+struct _HashSlot
+{
+        HashKey key;
+        void *value;
+        HashSlotState state;
+};
+
+/* A HashTable with N_SLOTS SLOTS, N_USED of them holding values and
+ * N_REMOVED of them being markers of removed values. */
+struct _HashTable
+{
+        HashSlot *slots;
+        int n_slots;
+        int n_used;
+        int n_removed;
+};
+
+/* Mixes the bits of KEY, so that handles, which tend to differ only in
+ * a few bits, spread over all slots. */
+static inline ULONGLONG
+HashKeyHash(HashKey key)
+{
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+
+        return key;
+}
+
+static BOOL
+HashTableAllocateSlots(HashTable *table, int n_slots)
+{
+        HashSlot *slots = (HashSlot *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                                sizeof(HashSlot) * n_slots);
+        if (slots == NULL)
+                return FALSE;
+
+        table->slots = slots;
+        table->n_slots = n_slots;
+        table->n_used = 0;
+        table->n_removed = 0;
+
+        return TRUE;
+}
+
+HashTable *
+HashTableNew(void)
+{
+        HashTable *table = ALLOC_STRUCT(HashTable);
+        if (table == NULL)
+                return NULL;
+
+        if (!HashTableAllocateSlots(table, HASHTABLE_DEFAULT_SIZE)) {
+                FREE(table);
+                return NULL;
+        }
+
+        return table;
+}
+
+/* Frees TABLE, calling F on each value. */
+void
+HashTableFree(HashTable *table, FreeFunc f)
+{
+        for (int i = 0; i < table->n_slots; i++)
+                if (table->slots[i].state == HashSlotUsed)
+                        f(table->slots[i].value);
+
+        FREE(table->slots);
+        FREE(table);
+}
+
+/* Finds the slot holding KEY in TABLE, or NULL if there is none. */
+static HashSlot *
+HashTableFindSlot(HashTable const *table, HashKey key)
+{
+        int mask = table->n_slots - 1;
+
+        for (int i = (int)(HashKeyHash(key) & mask); ; i = (i + 1) & mask) {
+                HashSlot *slot = &table->slots[i];
+                if (slot->state == HashSlotEmpty)
+                        return NULL;
+                if (slot->state == HashSlotUsed && slot->key == key)
+                        return slot;
+        }
+}
+
+/* Finds the slot where KEY should be inserted in TABLE. */
+static HashSlot *
+HashTableFindFreeSlot(HashTable *table, HashKey key)
+{
+        int mask = table->n_slots - 1;
+
+        for (int i = (int)(HashKeyHash(key) & mask); ; i = (i + 1) & mask)
+                if (table->slots[i].state != HashSlotUsed)
+                        return &table->slots[i];
+}
+
+/* Rehashes TABLE into N_SLOTS slots, dropping removal markers. */
+static BOOL
+HashTableResize(HashTable *table, int n_slots)
+{
+        HashSlot *old_slots = table->slots;
+        int n_old_slots = table->n_slots;
+
+        if (!HashTableAllocateSlots(table, n_slots))
+                return FALSE;
+
+        for (int i = 0; i < n_old_slots; i++) {
+                if (old_slots[i].state != HashSlotUsed)
+                        continue;
+
+                HashSlot *slot = HashTableFindFreeSlot(table, old_slots[i].key);
+                *slot = old_slots[i];
+                table->n_used++;
+        }
+
+        FREE(old_slots);
+
+        return TRUE;
+}
+
+/* Asserts that there’s room for one more value in TABLE, keeping it at
+ * most three quarters full, counting removal markers. */
+static BOOL
+HashTableAssertBigEnough(HashTable *table)
+{
+        if ((table->n_used + table->n_removed + 1) * 4 <= table->n_slots * 3)
+                return TRUE;
+
+        int n_slots = table->n_slots;
+        if ((table->n_used + 1) * 2 > n_slots)
+                n_slots *= 2;
+        if (n_slots < table->n_slots)
+                return FALSE;
+
+        return HashTableResize(table, n_slots);
+}
+
+/* Maps KEY to VALUE in TABLE, replacing any previous value for KEY.
+ * Returns FALSE if we run out of memory. */
+BOOL
+HashTableInsert(HashTable *table, HashKey key, void *value)
+{
+        HashSlot *slot = HashTableFindSlot(table, key);
+        if (slot != NULL) {
+                slot->value = value;
+                return TRUE;
+        }
+
+        if (!HashTableAssertBigEnough(table))
+                return FALSE;
+
+        slot = HashTableFindFreeSlot(table, key);
+        if (slot->state == HashSlotRemoved)
+                table->n_removed--;
+        slot->key = key;
+        slot->value = value;
+        slot->state = HashSlotUsed;
+        table->n_used++;
+
+        return TRUE;
+}
+
+/* Gets the value for KEY in TABLE, or NULL if there is none. */
+void *
+HashTableLookup(HashTable const *table, HashKey key)
+{
+        HashSlot *slot = HashTableFindSlot(table, key);
+        if (slot == NULL)
+                return NULL;
+
+        return slot->value;
+}
+
+/* Removes KEY from TABLE, returning its value, or NULL if there was
+ * none. */
+void *
+HashTableRemove(HashTable *table, HashKey key)
+{
+        HashSlot *slot = HashTableFindSlot(table, key);
+        if (slot == NULL)
+                return NULL;
+
+        slot->state = HashSlotRemoved;
+        table->n_used--;
+        table->n_removed++;
+
+        return slot->value;
+}
+
+/* Gets the number of values in TABLE. */
+int
+HashTableSize(HashTable const *table)
+{
+        return table->n_used;
+}
+
+/* Iterates over the keys and values of TABLE, in no particular order,
+ * calling F with CLOSURE.  F may remove the key it is called with. */
+void
+HashTableIterate(HashTable *table, HashTableIterator f, void *closure)
+{
+        for (int i = 0; i < table->n_slots; i++)
+                if (table->slots[i].state == HashSlotUsed &&
+                    f(table->slots[i].key, table->slots[i].value, closure) == IterationStop)
+                        break;
+}
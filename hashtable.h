@@ -0,0 +1,17 @@
+﻿typedef struct _HashTable HashTable;
+
+/* Keys of a HashTable.  Use HASH_KEY() to turn a handle or pointer into
+ * a key. */
+typedef ULONGLONG HashKey;
+
+#define HASH_KEY(pointer)       ((HashKey)(ULONG_PTR)(pointer))
+
+typedef IterationState (*HashTableIterator)(HashKey, void *, void *);
+
+HashTable *HashTableNew(void);
+void HashTableFree(HashTable *table, FreeFunc f);
+BOOL HashTableInsert(HashTable *table, HashKey key, void *value);
+void *HashTableLookup(HashTable const *table, HashKey key);
+void *HashTableRemove(HashTable *table, HashKey key);
+int HashTableSize(HashTable const *table);
+void HashTableIterate(HashTable *table, HashTableIterator f, void *closure);
@@ -3,9 +3,7 @@
 #include "hook.h"
 
 #pragma data_seg(".HOOKDATA")
-#if 0
 HHOOK s_shell_hook = NULL;
-#endif
 HHOOK s_window_proc_hook = NULL;
 HWND s_window = NULL;
 #pragma data_seg()
@@ -20,7 +18,6 @@ BOOL APIENTRY DllMain(HINSTANCE module, DWORD reason_for_call, LPVOID reserved)
         return TRUE;
 } 
 
-#if 0
 static BOOL PostMessageIfInteresting(int code, WPARAM wParam, LPARAM lParam)
 {
         static struct {
@@ -28,9 +25,11 @@ static BOOL PostMessageIfInteresting(int code, WPARAM wParam, LPARAM lParam)
                 UINT message;
         } codes[] = {
                 { HSHELL_WINDOWACTIVATED, WM_WPHOOK_WINDOW_ACTIVATED },
+                { HSHELL_RUDEAPPACTIVATED, WM_WPHOOK_WINDOW_ACTIVATED },
                 { HSHELL_WINDOWCREATED, WM_WPHOOK_WINDOW_CREATED },
                 { HSHELL_WINDOWDESTROYED, WM_WPHOOK_WINDOW_DESTROYED },
                 { HSHELL_WINDOWREPLACED, WM_WPHOOK_WINDOW_REPLACED },
+                { HSHELL_REDRAW, WM_WPHOOK_WINDOW_TITLE_CHANGED },
         };
 
         for (int i = 0; i < _countof(codes); i++)
@@ -47,7 +46,6 @@ static LRESULT CALLBACK ShellProc(int code, WPARAM wParam, LPARAM lParam)
 
         return CallNextHookEx(s_shell_hook, code, wParam, lParam);
 }
-#endif
 
 static BOOL PostMessageIfSetIcon(PCWPRETSTRUCT message)
 {
@@ -72,11 +70,9 @@ static LRESULT CALLBACK CallWndRetProc(int code, WPARAM wParam, LPARAM lParam)
 BOOL WPHookRegister(HWND window)
 {
         s_window = window;
-#if 0
         s_shell_hook = SetWindowsHookEx(WH_SHELL, ShellProc, s_module, 0);
         if (s_shell_hook == NULL)
                 return FALSE;
-#endif
         s_window_proc_hook = SetWindowsHookEx(WH_CALLWNDPROCRET, CallWndRetProc, s_module, 0);
         return s_window_proc_hook != NULL;
 }
@@ -88,10 +84,8 @@ BOOL WPHookUnregister()
         if (!UnhookWindowsHookEx(s_window_proc_hook))
                 unhooked_all = FALSE;
 
-#if 0
         if (!UnhookWindowsHookEx(s_shell_hook))
                 unhooked_all = FALSE;
-#endif
 
         return unhooked_all;
 }
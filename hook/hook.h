@@ -22,7 +22,7 @@
 #define HANDLE_WM_WPHOOK_WINDOW_CREATED(window, wParam, lParam, fn) \
     ((fn)((window), (HWND)(wParam)), 0L)
 #define FORWARD_WM_WPHOOK_WINDOW_CREATED(window, created_window, fn) \
-    (void)(fn)((window), WM_WPHOOK_WINDOW_CREATED, (WPARAM)(Created_window), (LPARAM)0L)
+    (void)(fn)((window), WM_WPHOOK_WINDOW_CREATED, (WPARAM)(created_window), (LPARAM)0L)
 
 /* void Cls_OnWPHookWindowDestroyed(HWND window, HWND destroyed_window) */
 #define HANDLE_WM_WPHOOK_WINDOW_DESTROYED(window, wParam, lParam, fn) \
@@ -34,7 +34,7 @@
 #define HANDLE_WM_WPHOOK_WINDOW_REPLACED(window, wParam, lParam, fn) \
     ((fn)((window), (HWND)(wParam), (HWND)(lParam)), 0L)
 #define FORWARD_WM_WPHOOK_WINDOW_REPLACED(window, replaced_window, new_window, fn) \
-    (void)(fn)((window), WM_WPHOOK_WINDOW_DESTROYED, (WPARAM)(replaced_window), (LPARAM)(new_window))
+    (void)(fn)((window), WM_WPHOOK_WINDOW_REPLACED, (WPARAM)(replaced_window), (LPARAM)(new_window))
 
 /* void Cls_OnWPHookWindowIconChanged(HWND window, HWND changed_window) */
 #define HANDLE_WM_WPHOOK_WINDOW_ICON_CHANGED(window, wParam, lParam, fn) \
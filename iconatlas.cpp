@@ -0,0 +1,179 @@
+﻿#include "stdafx.h"
+
+#include "pixels.h"
+#include "bitmap.h"
+#include "shelfpack.h"
+#include "iconatlas.h"
+
+/* The tallest an atlas is allowed to grow. */
+#define ICON_ATLAS_MAX_HEIGHT       4096
+
+/* An atlas of icons.
+ *
+ * SURFACE holds the icons, premultiplied, as that’s what GDI+ draws
+ * fastest.
+ * PACKER keeps track of where on SURFACE there’s room. */
+struct _IconAtlas
+{
+        Bitmap *surface;
+        ShelfPacker *packer;
+};
+
+/* Creates a surface WIDTH by HEIGHT, setting it to NULL if we run out of
+ * memory. */
+static Status
+IconAtlasSurfaceNew(UINT width, UINT height, Bitmap **surface)
+{
+        *surface = new Bitmap(width, height, PixelFormat32bppPARGB);
+        if (*surface == NULL)
+                return OutOfMemory;
+
+        Status status = (*surface)->GetLastStatus();
+        if (status != Ok) {
+                delete *surface;
+                *surface = NULL;
+        }
+
+        return status;
+}
+
+/* Creates an IconAtlas WIDTH by HEIGHT to begin with.  It grows taller
+ * as icons are added to it.  Returns NULL if it couldn’t be created. */
+IconAtlas *
+IconAtlasNew(UINT width, UINT height)
+{
+        IconAtlas *atlas = ALLOC_STRUCT(IconAtlas);
+        if (atlas == NULL)
+                return NULL;
+
+        atlas->packer = ShelfPackerNew(width, height);
+        if (atlas->packer == NULL || IconAtlasSurfaceNew(width, height, &atlas->surface) != Ok) {
+                IconAtlasFree(atlas);
+                return NULL;
+        }
+
+        return atlas;
+}
+
+void
+IconAtlasFree(IconAtlas *atlas)
+{
+        if (atlas->surface != NULL)
+                delete atlas->surface;
+        ShelfPackerFree(atlas->packer);
+        FREE(atlas);
+}
+
+/* Copies the AREA of SOURCE into the same AREA of DESTINATION.  Both are
+ * locked as premultiplied pixels, so that no conversion takes place. */
+static Status
+IconAtlasCopyArea(Bitmap *destination, Bitmap *source, Rect const *area)
+{
+        BitmapData source_data;
+        RETURN_GDI_FAILURE(source->LockBits(area, ImageLockModeRead, PixelFormat32bppPARGB, &source_data));
+
+        BitmapData destination_data;
+        Status status = destination->LockBits(area, ImageLockModeWrite, PixelFormat32bppPARGB, &destination_data);
+        if (status == Ok) {
+                for (UINT y = 0; y < source_data.Height; y++)
+                        PixelsCopy(BitmapDataRow(&destination_data, y), BitmapDataRow(&source_data, y),
+                                   source_data.Width);
+
+                status = destination->UnlockBits(&destination_data);
+        }
+
+        Status unlock_status = source->UnlockBits(&source_data);
+        if (status == Ok)
+                status = unlock_status;
+
+        return status;
+}
+
+/* Makes ATLAS twice as tall, copying the icons on it onto a new surface.
+ * Returns OutOfMemory if it’s already as tall as we allow. */
+static Status
+IconAtlasGrow(IconAtlas *atlas)
+{
+        UINT width, height;
+        RETURN_GDI_FAILURE(BitmapGetDimensions(atlas->surface, &width, &height));
+        if (height * 2 > ICON_ATLAS_MAX_HEIGHT)
+                return OutOfMemory;
+
+        Bitmap *surface;
+        RETURN_GDI_FAILURE(IconAtlasSurfaceNew(width, height * 2, &surface));
+
+        Rect area(0, 0, width, height);
+        Status status = IconAtlasCopyArea(surface, atlas->surface, &area);
+        if (status != Ok) {
+                delete surface;
+                return status;
+        }
+
+        delete atlas->surface;
+        atlas->surface = surface;
+        ShelfPackerGrow(atlas->packer, height * 2);
+
+        return Ok;
+}
+
+/* Copies ICON onto ATLAS, storing the Rect it occupies there in SLOT.
+ * ICON is left alone and may be freed afterwards.  ICON should be
+ * premultiplied, so that its rows may be copied as they are. */
+Status
+IconAtlasAdd(IconAtlas *atlas, Bitmap *icon, Rect *slot)
+{
+        UINT width, height;
+        RETURN_GDI_FAILURE(BitmapGetDimensions(icon, &width, &height));
+
+        ShelfSlot shelf_slot;
+        while (!ShelfPackerAlloc(atlas->packer, width, height, &shelf_slot))
+                RETURN_GDI_FAILURE(IconAtlasGrow(atlas));
+
+        *slot = Rect(shelf_slot.x, shelf_slot.y, shelf_slot.width, shelf_slot.height);
+
+        Rect icon_area(0, 0, width, height);
+        BitmapData icon_data;
+        Status status = icon->LockBits(&icon_area, ImageLockModeRead, PixelFormat32bppPARGB, &icon_data);
+        if (status == Ok) {
+                BitmapData slot_data;
+                status = atlas->surface->LockBits(slot, ImageLockModeWrite, PixelFormat32bppPARGB, &slot_data);
+                if (status == Ok) {
+                        for (UINT y = 0; y < height; y++)
+                                PixelsCopy(BitmapDataRow(&slot_data, y), BitmapDataRow(&icon_data, y), width);
+
+                        status = atlas->surface->UnlockBits(&slot_data);
+                }
+
+                Status unlock_status = icon->UnlockBits(&icon_data);
+                if (status == Ok)
+                        status = unlock_status;
+        }
+
+        if (status != Ok)
+                IconAtlasRemove(atlas, slot);
+
+        return status;
+}
+
+/* Removes the icon occupying SLOT from ATLAS, so that its room may be
+ * reused by icons added later. */
+void
+IconAtlasRemove(IconAtlas *atlas, Rect const *slot)
+{
+        ShelfSlot shelf_slot = {
+                (unsigned int)slot->X, (unsigned int)slot->Y,
+                (unsigned int)slot->Width, (unsigned int)slot->Height
+        };
+
+        ShelfPackerRelease(atlas->packer, &shelf_slot);
+}
+
+/* Draws the icon occupying SLOT of ATLAS on GRAPHICS at X and Y. */
+Status
+IconAtlasDraw(IconAtlas *atlas, Graphics *graphics, Rect const *slot, INT x, INT y)
+{
+        Rect destination(x, y, slot->Width, slot->Height);
+
+        return graphics->DrawImage(atlas->surface, destination, slot->X, slot->Y, slot->Width, slot->Height,
+                                   UnitPixel);
+}
@@ -0,0 +1,10 @@
+﻿/* A surface holding many icons, so that they may all be drawn from the
+ * same Bitmap.  Icons are placed on it by a ShelfPacker and referred to
+ * by the Rect they occupy. */
+typedef struct _IconAtlas IconAtlas;
+
+IconAtlas *IconAtlasNew(UINT width, UINT height);
+void IconAtlasFree(IconAtlas *atlas);
+Status IconAtlasAdd(IconAtlas *atlas, Bitmap *icon, Rect *slot);
+void IconAtlasRemove(IconAtlas *atlas, Rect const *slot);
+Status IconAtlasDraw(IconAtlas *atlas, Graphics *graphics, Rect const *slot, INT x, INT y);
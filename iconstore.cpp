@@ -0,0 +1,501 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "iconstore.h"
+
+#define HEADER_SIZE             24
+#define ENTRY_SIZE              24
+
+#define FNV32_OFFSET_BASIS      2166136261U
+#define FNV32_PRIME             16777619U
+
+/* The fewest slots an IconIndex has. */
+#define ICON_INDEX_MIN_SLOTS    16
+
+/* An index of the entries of an IconStore or an IconStoreWriter by the
+ * hashes of their keys.  It’s an open-addressed table of N_SLOTS slots, a
+ * power of two at least twice the number of entries, each holding one
+ * more than the index of an entry, or 0 if empty.  Entries are found by
+ * probing the slots following the one their hash picks. */
+typedef struct _IconIndex IconIndex;
+
+struct _IconIndex
+{
+        unsigned int *slots;
+        unsigned int n_slots;
+};
+
+/* An entry of an IconStore, as read from its entry table. */
+typedef struct _IconStoreEntryData IconStoreEntryData;
+
+struct _IconStoreEntryData
+{
+        unsigned char const *key;
+        size_t key_size;
+        unsigned int key_hash;
+        PixelsARGB const *pixels;
+        unsigned int width;
+        unsigned int height;
+        unsigned int checksum;
+};
+
+/* A file of icons read from DATA, whose N_ENTRIES entries are in
+ * ENTRIES and indexed by INDEX. */
+struct _IconStore
+{
+        unsigned char const *data;
+        IconStoreEntryData *entries;
+        unsigned int n_entries;
+        IconIndex index;
+};
+
+static unsigned int
+Checksum(void const *data, size_t size)
+{
+        unsigned char const *bytes = (unsigned char const *)data;
+        unsigned int hash = FNV32_OFFSET_BASIS;
+        for (size_t i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * FNV32_PRIME;
+
+        return hash;
+}
+
+/* Sets up INDEX with room for N entries.  Returns 0 if we run out of
+ * memory. */
+static int
+IconIndexInit(IconIndex *index, unsigned int n)
+{
+        unsigned int n_slots = ICON_INDEX_MIN_SLOTS;
+        while (n_slots / 2 < n)
+                n_slots *= 2;
+
+        index->slots = (unsigned int *)calloc(n_slots, sizeof(*index->slots));
+        if (index->slots == NULL)
+                return 0;
+        index->n_slots = n_slots;
+
+        return 1;
+}
+
+static void
+IconIndexFinalize(IconIndex *index)
+{
+        free(index->slots);
+}
+
+/* Gets the slot of INDEX that probing for HASH starts at. */
+static inline unsigned int
+IconIndexStart(IconIndex const *index, unsigned int hash)
+{
+        return hash & (index->n_slots - 1);
+}
+
+/* Gets the slot of INDEX probed after SLOT. */
+static inline unsigned int
+IconIndexNext(IconIndex const *index, unsigned int slot)
+{
+        return (slot + 1) & (index->n_slots - 1);
+}
+
+/* Adds entry I, whose key hashes to HASH, to INDEX, which must have room
+ * for it.  Entries under the same key are found in the order they were
+ * added. */
+static void
+IconIndexAdd(IconIndex *index, unsigned int hash, unsigned int i)
+{
+        unsigned int slot = IconIndexStart(index, hash);
+        while (index->slots[slot] != 0)
+                slot = IconIndexNext(index, slot);
+
+        index->slots[slot] = i + 1;
+}
+
+static unsigned int
+GetU16(unsigned char const *p)
+{
+        return p[0] | (p[1] << 8);
+}
+
+static unsigned int
+GetU32(unsigned char const *p)
+{
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void
+PutU16(unsigned char *p, unsigned int value)
+{
+        p[0] = (unsigned char)value;
+        p[1] = (unsigned char)(value >> 8);
+}
+
+static void
+PutU32(unsigned char *p, unsigned int value)
+{
+        PutU16(p, value & 0xffff);
+        PutU16(p + 2, value >> 16);
+}
+
+/* Determines whether the SIZE bytes at OFFSET lie within the LENGTH
+ * bytes of a file, past its entry table ending at START. */
+static int
+InBounds(size_t start, size_t length, size_t offset, size_t size)
+{
+        return offset >= start && offset <= length && size <= length - offset;
+}
+
+/* Reads entry I of the entry table of the SIZE bytes at DATA, whose
+ * entry table ends at TABLE_END, into ENTRY.  Returns 0 if the entry
+ * points outside the file or describes an icon we don’t keep. */
+static int
+IconStoreReadEntry(unsigned char const *data, size_t size, size_t table_end, unsigned int i,
+                   IconStoreEntryData *entry)
+{
+        unsigned char const *p = data + HEADER_SIZE + (size_t)i * ENTRY_SIZE;
+        size_t key_offset = GetU32(p);
+        size_t key_size = GetU32(p + 4);
+        size_t pixels_offset = GetU32(p + 8);
+        entry->width = GetU16(p + 12);
+        entry->height = GetU16(p + 14);
+        entry->checksum = GetU32(p + 16);
+
+        if (entry->width == 0 || entry->width > ICON_STORE_MAX_DELTA ||
+            entry->height == 0 || entry->height > ICON_STORE_MAX_DELTA ||
+            pixels_offset % 4 != 0 || GetU32(p + 20) != 0)
+                return 0;
+
+        size_t pixels_size = (size_t)entry->width * entry->height * sizeof(PixelsARGB);
+        if (!InBounds(table_end, size, key_offset, key_size) ||
+            !InBounds(table_end, size, pixels_offset, pixels_size))
+                return 0;
+
+        entry->key = data + key_offset;
+        entry->key_size = key_size;
+        entry->key_hash = Checksum(entry->key, key_size);
+        entry->pixels = (PixelsARGB const *)(data + pixels_offset);
+
+        return 1;
+}
+
+/* Opens the SIZE bytes of an icon file at DATA, which must be aligned to
+ * four bytes and stay put until the store is closed.  Returns NULL if
+ * they aren’t a file of the version we know of, if the file is corrupt,
+ * or if we run out of memory.  The pixels of an entry are only checked
+ * once the entry is asked for. */
+IconStore *
+IconStoreOpen(void const *data, size_t size)
+{
+        unsigned char const *bytes = (unsigned char const *)data;
+        if (size < HEADER_SIZE || GetU32(bytes) != ICON_STORE_MAGIC || GetU32(bytes + 4) != ICON_STORE_VERSION ||
+            GetU32(bytes + 16) != size || GetU32(bytes + 20) != 0)
+                return NULL;
+
+        unsigned int n_entries = GetU32(bytes + 8);
+        if (n_entries > (size - HEADER_SIZE) / ENTRY_SIZE)
+                return NULL;
+
+        size_t table_end = HEADER_SIZE + (size_t)n_entries * ENTRY_SIZE;
+        if (Checksum(bytes + HEADER_SIZE, table_end - HEADER_SIZE) != GetU32(bytes + 12))
+                return NULL;
+
+        IconStore *store = (IconStore *)calloc(1, sizeof(*store));
+        if (store == NULL)
+                return NULL;
+
+        store->data = bytes;
+        store->entries = (IconStoreEntryData *)malloc((n_entries > 0 ? n_entries : 1) * sizeof(*store->entries));
+        if (store->entries == NULL) {
+                free(store);
+                return NULL;
+        }
+
+        if (!IconIndexInit(&store->index, n_entries)) {
+                IconStoreClose(store);
+                return NULL;
+        }
+
+        for ( ; store->n_entries < n_entries; store->n_entries++) {
+                IconStoreEntryData *entry = &store->entries[store->n_entries];
+                if (!IconStoreReadEntry(bytes, size, table_end, store->n_entries, entry)) {
+                        IconStoreClose(store);
+                        return NULL;
+                }
+                IconIndexAdd(&store->index, entry->key_hash, store->n_entries);
+        }
+
+        return store;
+}
+
+void
+IconStoreClose(IconStore *store)
+{
+        if (store == NULL)
+                return;
+
+        IconIndexFinalize(&store->index);
+        free(store->entries);
+        free(store);
+}
+
+/* Gets the number of entries of STORE. */
+unsigned int
+IconStoreLength(IconStore const *store)
+{
+        return store->n_entries;
+}
+
+/* Gets the KEY of KEY_SIZE bytes, the WIDTH and HEIGHT, and the PIXELS of
+ * entry I of STORE.  Returns 0 if the pixels don’t match their checksum. */
+int
+IconStoreEntry(IconStore const *store, unsigned int i, void const **key, size_t *key_size,
+               unsigned int *width, unsigned int *height, PixelsARGB const **pixels)
+{
+        IconStoreEntryData const *entry = &store->entries[i];
+        if (Checksum(entry->pixels, (size_t)entry->width * entry->height * sizeof(PixelsARGB)) != entry->checksum)
+                return 0;
+
+        *key = entry->key;
+        *key_size = entry->key_size;
+        *width = entry->width;
+        *height = entry->height;
+        *pixels = entry->pixels;
+
+        return 1;
+}
+
+/* Looks up the icon kept under the KEY_SIZE bytes of KEY in STORE,
+ * setting WIDTH, HEIGHT, and PIXELS to it.  Returns 0 if there’s none or
+ * if its pixels are corrupt. */
+int
+IconStoreLookup(IconStore const *store, void const *key, size_t key_size,
+                unsigned int *width, unsigned int *height, PixelsARGB const **pixels)
+{
+        unsigned int hash = Checksum(key, key_size);
+        for (unsigned int slot = IconIndexStart(&store->index, hash); store->index.slots[slot] != 0;
+             slot = IconIndexNext(&store->index, slot)) {
+                unsigned int i = store->index.slots[slot] - 1;
+                IconStoreEntryData const *entry = &store->entries[i];
+                if (entry->key_hash == hash && entry->key_size == key_size &&
+                    memcmp(entry->key, key, key_size) == 0) {
+                        void const *entry_key;
+                        size_t entry_key_size;
+                        return IconStoreEntry(store, i, &entry_key, &entry_key_size, width, height, pixels);
+                }
+        }
+
+        return 0;
+}
+
+/* An icon added to an IconStoreWriter, with copies of its KEY and
+ * PIXELS. */
+typedef struct _IconStoreWriterEntry IconStoreWriterEntry;
+
+struct _IconStoreWriterEntry
+{
+        unsigned char *key;
+        size_t key_size;
+        unsigned int key_hash;
+        unsigned int width;
+        unsigned int height;
+        PixelsARGB *pixels;
+};
+
+/* The N_ENTRIES entries of a writer are in ENTRIES, which has room for
+ * N_ALLOCATED_ENTRIES, as does INDEX. */
+struct _IconStoreWriter
+{
+        IconStoreWriterEntry *entries;
+        unsigned int n_entries;
+        unsigned int n_allocated_entries;
+        IconIndex index;
+};
+
+IconStoreWriter *
+IconStoreWriterNew(void)
+{
+        IconStoreWriter *writer = (IconStoreWriter *)calloc(1, sizeof(IconStoreWriter));
+        if (writer == NULL)
+                return NULL;
+
+        if (!IconIndexInit(&writer->index, 0)) {
+                free(writer);
+                return NULL;
+        }
+
+        return writer;
+}
+
+void
+IconStoreWriterFree(IconStoreWriter *writer)
+{
+        if (writer == NULL)
+                return;
+
+        for (unsigned int i = 0; i < writer->n_entries; i++) {
+                free(writer->entries[i].key);
+                free(writer->entries[i].pixels);
+        }
+        free(writer->entries);
+        IconIndexFinalize(&writer->index);
+        free(writer);
+}
+
+/* Gets the number of icons added to WRITER. */
+unsigned int
+IconStoreWriterLength(IconStoreWriter const *writer)
+{
+        return writer->n_entries;
+}
+
+/* Finds the entry of WRITER under the KEY_SIZE bytes of KEY, which hash
+ * to HASH, returning N_ENTRIES if there’s none. */
+static unsigned int
+IconStoreWriterFind(IconStoreWriter const *writer, void const *key, size_t key_size, unsigned int hash)
+{
+        for (unsigned int slot = IconIndexStart(&writer->index, hash); writer->index.slots[slot] != 0;
+             slot = IconIndexNext(&writer->index, slot)) {
+                unsigned int i = writer->index.slots[slot] - 1;
+                IconStoreWriterEntry const *entry = &writer->entries[i];
+                if (entry->key_hash == hash && entry->key_size == key_size &&
+                    memcmp(entry->key, key, key_size) == 0)
+                        return i;
+        }
+
+        return writer->n_entries;
+}
+
+/* Makes room in WRITER for N entries, reindexing them.  Returns 0 if we
+ * run out of memory, in which case WRITER is left alone. */
+static int
+IconStoreWriterReserve(IconStoreWriter *writer, unsigned int n)
+{
+        IconStoreWriterEntry *entries = (IconStoreWriterEntry *)realloc(writer->entries, n * sizeof(*entries));
+        if (entries == NULL)
+                return 0;
+        writer->entries = entries;
+
+        IconIndex index;
+        if (!IconIndexInit(&index, n))
+                return 0;
+        for (unsigned int i = 0; i < writer->n_entries; i++)
+                IconIndexAdd(&index, writer->entries[i].key_hash, i);
+        IconIndexFinalize(&writer->index);
+        writer->index = index;
+        writer->n_allocated_entries = n;
+
+        return 1;
+}
+
+/* Determines whether an icon has been added to WRITER under the KEY_SIZE
+ * bytes of KEY. */
+int
+IconStoreWriterHas(IconStoreWriter const *writer, void const *key, size_t key_size)
+{
+        return IconStoreWriterFind(writer, key, key_size, Checksum(key, key_size)) < writer->n_entries;
+}
+
+/* Adds the PIXELS of an icon WIDTH by HEIGHT to WRITER under the KEY_SIZE
+ * bytes of KEY, replacing any icon already added under it.  Returns 0 if
+ * the icon is too large to be kept or if we run out of memory. */
+int
+IconStoreWriterAdd(IconStoreWriter *writer, void const *key, size_t key_size,
+                   unsigned int width, unsigned int height, PixelsARGB const *pixels)
+{
+        if (width == 0 || width > ICON_STORE_MAX_DELTA || height == 0 || height > ICON_STORE_MAX_DELTA)
+                return 0;
+
+        size_t pixels_size = (size_t)width * height * sizeof(PixelsARGB);
+        IconStoreWriterEntry entry = {
+                (unsigned char *)malloc(key_size > 0 ? key_size : 1), key_size, Checksum(key, key_size),
+                width, height, (PixelsARGB *)malloc(pixels_size)
+        };
+        if (entry.key == NULL || entry.pixels == NULL) {
+                free(entry.key);
+                free(entry.pixels);
+                return 0;
+        }
+        memcpy(entry.key, key, key_size);
+        memcpy(entry.pixels, pixels, pixels_size);
+
+        unsigned int i = IconStoreWriterFind(writer, key, key_size, entry.key_hash);
+        if (i < writer->n_entries) {
+                free(writer->entries[i].key);
+                free(writer->entries[i].pixels);
+                writer->entries[i] = entry;
+                return 1;
+        }
+
+        if (writer->n_entries == writer->n_allocated_entries) {
+                unsigned int n = writer->n_allocated_entries == 0 ? 16 : writer->n_allocated_entries * 2;
+                if (!IconStoreWriterReserve(writer, n)) {
+                        free(entry.key);
+                        free(entry.pixels);
+                        return 0;
+                }
+        }
+
+        IconIndexAdd(&writer->index, entry.key_hash, writer->n_entries);
+        writer->entries[writer->n_entries++] = entry;
+
+        return 1;
+}
+
+static size_t
+AlignToFour(size_t offset)
+{
+        return (offset + 3) & ~(size_t)3;
+}
+
+/* Puts the icons added to WRITER together into a file, setting DATA to
+ * its SIZE bytes, to be freed with free().  Returns 0 if the file would
+ * be too large or if we run out of memory. */
+int
+IconStoreWriterFinish(IconStoreWriter const *writer, void **data, size_t *size)
+{
+        size_t length = HEADER_SIZE + (size_t)writer->n_entries * ENTRY_SIZE;
+        for (unsigned int i = 0; i < writer->n_entries; i++) {
+                IconStoreWriterEntry const *entry = &writer->entries[i];
+                length = AlignToFour(length + entry->key_size) +
+                         (size_t)entry->width * entry->height * sizeof(PixelsARGB);
+        }
+        if (length > 0xffffffffU)
+                return 0;
+
+        unsigned char *bytes = (unsigned char *)calloc(1, length);
+        if (bytes == NULL)
+                return 0;
+
+        size_t offset = HEADER_SIZE + (size_t)writer->n_entries * ENTRY_SIZE;
+        for (unsigned int i = 0; i < writer->n_entries; i++) {
+                IconStoreWriterEntry const *entry = &writer->entries[i];
+                size_t pixels_size = (size_t)entry->width * entry->height * sizeof(PixelsARGB);
+                unsigned char *p = bytes + HEADER_SIZE + (size_t)i * ENTRY_SIZE;
+
+                PutU32(p, (unsigned int)offset);
+                PutU32(p + 4, (unsigned int)entry->key_size);
+                memcpy(bytes + offset, entry->key, entry->key_size);
+                offset = AlignToFour(offset + entry->key_size);
+
+                PutU32(p + 8, (unsigned int)offset);
+                PutU16(p + 12, entry->width);
+                PutU16(p + 14, entry->height);
+                PutU32(p + 16, Checksum(entry->pixels, pixels_size));
+                memcpy(bytes + offset, entry->pixels, pixels_size);
+                offset += pixels_size;
+        }
+
+        PutU32(bytes, ICON_STORE_MAGIC);
+        PutU32(bytes + 4, ICON_STORE_VERSION);
+        PutU32(bytes + 8, writer->n_entries);
+        PutU32(bytes + 12, Checksum(bytes + HEADER_SIZE, (size_t)writer->n_entries * ENTRY_SIZE));
+        PutU32(bytes + 16, (unsigned int)length);
+
+        *data = bytes;
+        *size = length;
+
+        return 1;
+}
@@ -0,0 +1,39 @@
+﻿/* The format of files of scaled icons, each kept under a key of bytes
+ * chosen by the caller.  An IconStore reads such a file from memory,
+ * checking it for corruption, and an IconStoreWriter puts one together.
+ * Both only depend on the C runtime, so that they may be built and fed
+ * arbitrary files outside of the application.
+ *
+ * Every number is stored little-endian.  A file starts with a header of
+ * six 32-bit numbers: the magic number ICON_STORE_MAGIC, the version
+ * ICON_STORE_VERSION, the number of entries, a checksum of the entry
+ * table, the size of the file, and zero.  The entry table follows, with
+ * an entry of 24 bytes for each icon: the offsets and size of its key,
+ * the offset of its pixels, its 16-bit width and height, a checksum of
+ * its pixels, and zero.  Keys and pixels fill the rest of the file,
+ * pixels being 32-bit ARGB values aligned to four bytes.  Checksums are
+ * 32-bit FNV-1a hashes. */
+#define ICON_STORE_MAGIC        0x43495057
+#define ICON_STORE_VERSION      1
+
+/* The largest icon an IconStore keeps, in either dimension. */
+#define ICON_STORE_MAX_DELTA    256
+
+typedef struct _IconStore IconStore;
+typedef struct _IconStoreWriter IconStoreWriter;
+
+IconStore *IconStoreOpen(void const *data, size_t size);
+void IconStoreClose(IconStore *store);
+unsigned int IconStoreLength(IconStore const *store);
+int IconStoreEntry(IconStore const *store, unsigned int i, void const **key, size_t *key_size,
+                   unsigned int *width, unsigned int *height, PixelsARGB const **pixels);
+int IconStoreLookup(IconStore const *store, void const *key, size_t key_size,
+                    unsigned int *width, unsigned int *height, PixelsARGB const **pixels);
+
+IconStoreWriter *IconStoreWriterNew(void);
+void IconStoreWriterFree(IconStoreWriter *writer);
+unsigned int IconStoreWriterLength(IconStoreWriter const *writer);
+int IconStoreWriterHas(IconStoreWriter const *writer, void const *key, size_t key_size);
+int IconStoreWriterAdd(IconStoreWriter *writer, void const *key, size_t key_size,
+                       unsigned int width, unsigned int height, PixelsARGB const *pixels);
+int IconStoreWriterFinish(IconStoreWriter const *writer, void **data, size_t *size);
@@ -0,0 +1,185 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "mipchain.h"
+
+/* The most levels a chain may have, which is plenty for icons of up to
+ * 2^(MIP_MAX_LEVELS - 1) pixels on a side. */
+#define MIP_MAX_LEVELS          16
+
+/* A level of a MipChain, WIDTH by HEIGHT PIXELS, row after row. */
+typedef struct _MipLevel MipLevel;
+
+struct _MipLevel
+{
+        unsigned int width;
+        unsigned int height;
+        PixelsARGB *pixels;
+};
+
+/* LEVELS holds the N_LEVELS levels of the chain, the first being the
+ * icon as it was decoded and each following one half as large as the
+ * one before it. */
+struct _MipChain
+{
+        int n_levels;
+        MipLevel levels[MIP_MAX_LEVELS];
+};
+
+/* Picks which of N sizes, WIDTHS[I] by HEIGHTS[I], an icon is best scaled
+ * to WIDTH by HEIGHT from: one that’s exactly WIDTH by HEIGHT, otherwise
+ * the smallest one that’s at least as large, as scaling down loses less
+ * than scaling up, and otherwise the largest one.  Returns its index, or
+ * -1 if N is 0. */
+int
+MipPickSource(unsigned int const *widths, unsigned int const *heights, int n,
+              unsigned int width, unsigned int height)
+{
+        int best = -1;
+        int best_covers = 0;
+
+        for (int i = 0; i < n; i++) {
+                if (widths[i] == width && heights[i] == height)
+                        return i;
+
+                int covers = widths[i] >= width && heights[i] >= height;
+                unsigned long area = (unsigned long)widths[i] * heights[i];
+                unsigned long best_area = best < 0 ? 0 : (unsigned long)widths[best] * heights[best];
+                if (best < 0 ||
+                    (covers && !best_covers) ||
+                    (covers && best_covers && area < best_area) ||
+                    (!covers && !best_covers && area > best_area)) {
+                        best = i;
+                        best_covers = covers;
+                }
+        }
+
+        return best;
+}
+
+/* Averages each two-by-two block of the premultiplied pixels of SOURCE
+ * into a pixel of DESTINATION, which is half as large, rounding down.
+ * The last row or column of a SOURCE of an odd size is repeated. */
+static void
+MipHalve(PixelsARGB *destination, unsigned int width, unsigned int height,
+         PixelsARGB const *source, unsigned int source_width, unsigned int source_height)
+{
+        for (unsigned int y = 0; y < height; y++) {
+                PixelsARGB const *top = source + (2 * y) * source_width;
+                PixelsARGB const *bottom = source + (2 * y + 1 < source_height ? 2 * y + 1 : 2 * y) * source_width;
+                for (unsigned int x = 0; x < width; x++) {
+                        unsigned int left = 2 * x;
+                        unsigned int right = left + 1 < source_width ? left + 1 : left;
+                        PixelsARGB pixel = 0;
+                        for (int shift = 0; shift < 32; shift += 8) {
+                                unsigned int sum = ((top[left] >> shift) & 0xff) + ((top[right] >> shift) & 0xff) +
+                                                   ((bottom[left] >> shift) & 0xff) + ((bottom[right] >> shift) & 0xff);
+                                pixel |= (PixelsARGB)((sum + 2) >> 2) << shift;
+                        }
+                        destination[y * width + x] = pixel;
+                }
+        }
+}
+
+/* Creates a chain from the WIDTH by HEIGHT premultiplied PIXELS, which
+ * are copied, halving them for as long as the result is at least
+ * MIN_WIDTH by MIN_HEIGHT.  Returns NULL if we run out of memory. */
+MipChain *
+MipChainNew(unsigned int width, unsigned int height, PixelsARGB const *pixels,
+            unsigned int min_width, unsigned int min_height)
+{
+        MipChain *chain = (MipChain *)calloc(1, sizeof(MipChain));
+        if (chain == NULL)
+                return NULL;
+
+        size_t n = (size_t)width * height;
+        chain->levels[0].pixels = (PixelsARGB *)malloc((n > 0 ? n : 1) * sizeof(PixelsARGB));
+        if (chain->levels[0].pixels == NULL) {
+                free(chain);
+                return NULL;
+        }
+        memcpy(chain->levels[0].pixels, pixels, n * sizeof(PixelsARGB));
+        chain->levels[0].width = width;
+        chain->levels[0].height = height;
+        chain->n_levels = 1;
+
+        while (chain->n_levels < MIP_MAX_LEVELS) {
+                MipLevel const *last = &chain->levels[chain->n_levels - 1];
+                MipLevel *next = &chain->levels[chain->n_levels];
+                next->width = last->width / 2;
+                next->height = last->height / 2;
+                if (next->width == 0 || next->height == 0 || next->width < min_width || next->height < min_height)
+                        break;
+
+                next->pixels = (PixelsARGB *)malloc((size_t)next->width * next->height * sizeof(PixelsARGB));
+                if (next->pixels == NULL) {
+                        MipChainFree(chain);
+                        return NULL;
+                }
+                MipHalve(next->pixels, next->width, next->height, last->pixels, last->width, last->height);
+                chain->n_levels++;
+        }
+
+        return chain;
+}
+
+/* Frees CHAIN. */
+void
+MipChainFree(MipChain *chain)
+{
+        for (int i = 0; i < chain->n_levels; i++)
+                free(chain->levels[i].pixels);
+        free(chain);
+}
+
+/* Gets the number of levels of CHAIN, which is at least 1. */
+int
+MipChainLength(MipChain const *chain)
+{
+        return chain->n_levels;
+}
+
+/* Gets the pixels of LEVEL of CHAIN, setting WIDTH and HEIGHT to its
+ * dimensions. */
+PixelsARGB const *
+MipChainLevel(MipChain const *chain, int level, unsigned int *width, unsigned int *height)
+{
+        *width = chain->levels[level].width;
+        *height = chain->levels[level].height;
+
+        return chain->levels[level].pixels;
+}
+
+/* Picks the level of CHAIN to scale to WIDTH by HEIGHT from: the smallest
+ * one that’s a whole multiple of that size, as those are scaled down with
+ * a box filter, otherwise the smallest one that’s at least as large, or
+ * the first, largest, one if none are. */
+int
+MipChainPick(MipChain const *chain, unsigned int width, unsigned int height)
+{
+        int level = 0;
+        while (level + 1 < chain->n_levels &&
+               chain->levels[level + 1].width >= width && chain->levels[level + 1].height >= height)
+                level++;
+
+        for (int i = level; i >= 0 && width > 0 && height > 0; i--)
+                if (chain->levels[i].width % width == 0 && chain->levels[i].height % height == 0)
+                        return i;
+
+        return level;
+}
+
+/* Gets the number of bytes taken up by the pixels of CHAIN. */
+unsigned long
+MipChainBytes(MipChain const *chain)
+{
+        unsigned long bytes = 0;
+        for (int i = 0; i < chain->n_levels; i++)
+                bytes += (unsigned long)chain->levels[i].width * chain->levels[i].height * sizeof(PixelsARGB);
+
+        return bytes;
+}
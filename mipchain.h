@@ -0,0 +1,17 @@
+﻿/* Chains of copies of an icon, each half the size of the one before
+ * it, so that the icon may be scaled to any size from the copy closest
+ * to it without decoding it anew, and the picking of which of the sizes
+ * an application offers an icon in it’s best scaled from.  Pixels are
+ * premultiplied 32-bit ARGB.  Like the pixel kernels, it only depends on
+ * the C runtime. */
+typedef struct _MipChain MipChain;
+
+int MipPickSource(unsigned int const *widths, unsigned int const *heights, int n,
+                  unsigned int width, unsigned int height);
+MipChain *MipChainNew(unsigned int width, unsigned int height, PixelsARGB const *pixels,
+                      unsigned int min_width, unsigned int min_height);
+void MipChainFree(MipChain *chain);
+int MipChainLength(MipChain const *chain);
+PixelsARGB const *MipChainLevel(MipChain const *chain, int level, unsigned int *width, unsigned int *height);
+int MipChainPick(MipChain const *chain, unsigned int width, unsigned int height);
+unsigned long MipChainBytes(MipChain const *chain);
@@ -0,0 +1,680 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#  include <intrin.h>
+#endif
+#include <string.h>
+
+#include "pixels.h"
+
+/* Each kernel comes in a scalar version, which is always available, and
+ * in versions using SSE2 and AVX2 where the compiler supports them.  The
+ * best version the processor supports is picked the first time a kernel
+ * is called. */
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#  define PIXELS_HAVE_SSE2
+#  include <emmintrin.h>
+#  if (defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__GNUC__)
+#    define PIXELS_HAVE_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
+
+#ifdef __GNUC__
+#  define PIXELS_TARGET(isa)    __attribute__((target(isa)))
+#else
+#  define PIXELS_TARGET(isa)
+#endif
+
+#define PIXELS_ALPHA_SHIFT      24
+#define PIXELS_RGB_MASK         0x00ffffff
+#define PIXELS_OPAQUE           0xff000000
+
+/* A set of kernels implemented using the same instruction set. */
+typedef struct _PixelsKernels PixelsKernels;
+
+struct _PixelsKernels
+{
+        int (*have_alpha)(PixelsARGB const *pixels, unsigned int n);
+        void (*copy)(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
+        void (*set_alpha)(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n);
+        void (*from_rgb24)(PixelsARGB *destination, unsigned char const *source, unsigned int n);
+        void (*premultiply)(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
+        void (*unpremultiply)(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
+};
+
+/* Channels are premultiplied by working out C * A / 255, rounded, as
+ * (T + (T >> 8)) >> 8, where T is C * A + 128, which is exact and fits in
+ * 16 bits.  They’re unpremultiplied by working out C * 255 / A, rounded,
+ * as (C * R + 0x8000) >> 16, where R is S_UNPREMULTIPLY[A], which is exact
+ * for every premultiplied channel and may be worked out in 16-bit halves.
+ * Colors that exceed their alpha value, which premultiplied pixels never
+ * have, are unpremultiplied to 0xff, and transparent pixels to 0. */
+#define UNPREMULTIPLY_FACTOR(a) ((a) == 0 ? 0 : ((255U << 16) + (a) / 2) / ((a) + !(a)))
+#define UNPREMULTIPLY_ROW(e, a) e(a), e((a) + 1), e((a) + 2), e((a) + 3)
+#define UNPREMULTIPLY_ROWS16(e, a)      UNPREMULTIPLY_ROW(e, a), UNPREMULTIPLY_ROW(e, (a) + 4), \
+                                        UNPREMULTIPLY_ROW(e, (a) + 8), UNPREMULTIPLY_ROW(e, (a) + 12)
+#define UNPREMULTIPLY_ROWS64(e, a)      UNPREMULTIPLY_ROWS16(e, a), UNPREMULTIPLY_ROWS16(e, (a) + 16), \
+                                        UNPREMULTIPLY_ROWS16(e, (a) + 32), UNPREMULTIPLY_ROWS16(e, (a) + 48)
+#define UNPREMULTIPLY_TABLE(e)  UNPREMULTIPLY_ROWS64(e, 0), UNPREMULTIPLY_ROWS64(e, 64), \
+                                UNPREMULTIPLY_ROWS64(e, 128), UNPREMULTIPLY_ROWS64(e, 192)
+
+static unsigned int const s_unpremultiply[256] = {
+        UNPREMULTIPLY_TABLE(UNPREMULTIPLY_FACTOR)
+};
+
+static inline int
+PixelHasAlpha(PixelsARGB pixel)
+{
+        PixelsARGB alpha = pixel >> PIXELS_ALPHA_SHIFT;
+
+        return alpha != 0x00 && alpha != 0xff;
+}
+
+static int
+PixelsHaveAlphaScalar(PixelsARGB const *pixels, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++)
+                if (PixelHasAlpha(pixels[i]))
+                        return 1;
+
+        return 0;
+}
+
+static void
+PixelsCopyScalar(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        memcpy(destination, source, n * sizeof(*source));
+}
+
+static void
+PixelsSetAlphaScalar(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++)
+                destination[i] = (source[i] & PIXELS_RGB_MASK) | ((PixelsARGB)alpha[i] << PIXELS_ALPHA_SHIFT);
+}
+
+static void
+PixelsFromRGB24Scalar(PixelsARGB *destination, unsigned char const *source, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++, source += 3)
+                destination[i] = PIXELS_OPAQUE |
+                                 ((PixelsARGB)source[2] << 16) | ((PixelsARGB)source[1] << 8) | source[0];
+}
+
+static inline PixelsARGB
+ChannelPremultiply(PixelsARGB pixel, unsigned int shift, unsigned int alpha)
+{
+        unsigned int t = ((pixel >> shift) & 0xff) * alpha + 128;
+
+        return (PixelsARGB)((t + (t >> 8)) >> 8) << shift;
+}
+
+static void
+PixelsPremultiplyScalar(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++) {
+                PixelsARGB pixel = source[i];
+                unsigned int alpha = pixel >> PIXELS_ALPHA_SHIFT;
+                destination[i] = (pixel & ~PIXELS_RGB_MASK) | ChannelPremultiply(pixel, 16, alpha) |
+                                 ChannelPremultiply(pixel, 8, alpha) | ChannelPremultiply(pixel, 0, alpha);
+        }
+}
+
+static inline PixelsARGB
+ChannelUnpremultiply(PixelsARGB pixel, unsigned int shift, unsigned int factor)
+{
+        unsigned int value = (((pixel >> shift) & 0xff) * factor + 0x8000) >> 16;
+
+        return (PixelsARGB)(value < 0xff ? value : 0xff) << shift;
+}
+
+static void
+PixelsUnpremultiplyScalar(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++) {
+                PixelsARGB pixel = source[i];
+                unsigned int factor = s_unpremultiply[pixel >> PIXELS_ALPHA_SHIFT];
+                destination[i] = (pixel & ~PIXELS_RGB_MASK) | ChannelUnpremultiply(pixel, 16, factor) |
+                                 ChannelUnpremultiply(pixel, 8, factor) | ChannelUnpremultiply(pixel, 0, factor);
+        }
+}
+
+static PixelsKernels const s_scalar_kernels = {
+        PixelsHaveAlphaScalar,
+        PixelsCopyScalar,
+        PixelsSetAlphaScalar,
+        PixelsFromRGB24Scalar,
+        PixelsPremultiplyScalar,
+        PixelsUnpremultiplyScalar,
+};
+
+#ifdef PIXELS_HAVE_SSE2
+static int
+PixelsHaveAlphaSSE2(PixelsARGB const *pixels, unsigned int n)
+{
+        __m128i const transparent = _mm_setzero_si128();
+        __m128i const opaque = _mm_set1_epi32(0xff);
+
+        unsigned int i = 0;
+        for ( ; i + 4 <= n; i += 4) {
+                __m128i alpha = _mm_srli_epi32(_mm_loadu_si128((__m128i const *)(pixels + i)), PIXELS_ALPHA_SHIFT);
+                __m128i binary = _mm_or_si128(_mm_cmpeq_epi32(alpha, transparent),
+                                              _mm_cmpeq_epi32(alpha, opaque));
+                if (_mm_movemask_epi8(binary) != 0xffff)
+                        return 1;
+        }
+
+        return PixelsHaveAlphaScalar(pixels + i, n - i);
+}
+
+static void
+PixelsCopySSE2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        unsigned int i = 0;
+        for ( ; i + 4 <= n; i += 4)
+                _mm_storeu_si128((__m128i *)(destination + i),
+                                 _mm_loadu_si128((__m128i const *)(source + i)));
+
+        PixelsCopyScalar(destination + i, source + i, n - i);
+}
+
+static void
+PixelsSetAlphaSSE2(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n)
+{
+        __m128i const rgb_mask = _mm_set1_epi32(PIXELS_RGB_MASK);
+        __m128i const zero = _mm_setzero_si128();
+
+        unsigned int i = 0;
+        for ( ; i + 4 <= n; i += 4) {
+                int four_alphas;
+                memcpy(&four_alphas, alpha + i, sizeof(four_alphas));
+                __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(four_alphas), zero);
+                a = _mm_slli_epi32(_mm_unpacklo_epi16(a, zero), PIXELS_ALPHA_SHIFT);
+                __m128i rgb = _mm_and_si128(_mm_loadu_si128((__m128i const *)(source + i)), rgb_mask);
+                _mm_storeu_si128((__m128i *)(destination + i), _mm_or_si128(rgb, a));
+        }
+
+        PixelsSetAlphaScalar(destination + i, source + i, alpha + i, n - i);
+}
+
+/* Premultiplies the CHANNELS of two pixels spread over 16-bit lanes.  The
+ * alpha lanes are multiplied by 0xff, which leaves them alone. */
+static inline __m128i
+PremultiplySSE2(__m128i channels)
+{
+        __m128i const alpha_lanes = _mm_setr_epi16(0, 0, 0, 0xff, 0, 0, 0, 0xff);
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)),
+                                            _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(channels, _mm_or_si128(alpha, alpha_lanes)), _mm_set1_epi16(128));
+
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void
+PixelsPremultiplySSE2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        __m128i const zero = _mm_setzero_si128();
+
+        unsigned int i = 0;
+        for ( ; i + 4 <= n; i += 4) {
+                __m128i pixels = _mm_loadu_si128((__m128i const *)(source + i));
+                _mm_storeu_si128((__m128i *)(destination + i),
+                                 _mm_packus_epi16(PremultiplySSE2(_mm_unpacklo_epi8(pixels, zero)),
+                                                  PremultiplySSE2(_mm_unpackhi_epi8(pixels, zero))));
+        }
+
+        PixelsPremultiplyScalar(destination + i, source + i, n - i);
+}
+
+/* The factors of S_UNPREMULTIPLY split into their HIGH and LOW halves,
+ * each spread over the 16-bit lanes of a pixel.  The alpha lanes get a
+ * factor of 0x10000, which leaves them alone. */
+typedef struct _UnpremultiplyLanes UnpremultiplyLanes;
+
+struct _UnpremultiplyLanes
+{
+        unsigned long long high;
+        unsigned long long low;
+};
+
+#define UNPREMULTIPLY_SPREAD(factor, alpha_factor)      \
+        ((unsigned long long)(factor) * 0x000100010001ULL | ((unsigned long long)(alpha_factor) << 48))
+#define UNPREMULTIPLY_LANES(a)                          \
+        { UNPREMULTIPLY_SPREAD(UNPREMULTIPLY_FACTOR(a) >> 16, 1), UNPREMULTIPLY_SPREAD(UNPREMULTIPLY_FACTOR(a) & 0xffff, 0) }
+
+static UnpremultiplyLanes const s_unpremultiply_lanes[256] = {
+        UNPREMULTIPLY_TABLE(UNPREMULTIPLY_LANES)
+};
+
+/* Gets the high or low halves, as picked by HALF, of the factors of the
+ * pixels FIRST and SECOND. */
+#define UNPREMULTIPLY_FACTORS(first, second, half)                                                      \
+        _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i const *)&s_unpremultiply_lanes[(first) >> PIXELS_ALPHA_SHIFT].half), \
+                           _mm_loadl_epi64((__m128i const *)&s_unpremultiply_lanes[(second) >> PIXELS_ALPHA_SHIFT].half))
+
+/* Unpremultiplies the CHANNELS of the pixels FIRST and SECOND spread over
+ * 16-bit lanes, multiplying them by the high and low halves of their
+ * factors separately. */
+static inline __m128i
+UnpremultiplySSE2(__m128i channels, PixelsARGB first, PixelsARGB second)
+{
+        __m128i high_factors = UNPREMULTIPLY_FACTORS(first, second, high);
+        __m128i low_factors = UNPREMULTIPLY_FACTORS(first, second, low);
+
+        __m128i low = _mm_mullo_epi16(channels, low_factors);
+        __m128i value = _mm_add_epi16(_mm_mullo_epi16(channels, high_factors), _mm_mulhi_epu16(channels, low_factors));
+        value = _mm_add_epi16(value, _mm_srli_epi16(low, 15));
+
+        return _mm_sub_epi16(value, _mm_subs_epu16(value, _mm_set1_epi16(0xff)));
+}
+
+static void
+PixelsUnpremultiplySSE2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        __m128i const zero = _mm_setzero_si128();
+
+        unsigned int i = 0;
+        for ( ; i + 4 <= n; i += 4) {
+                __m128i pixels = _mm_loadu_si128((__m128i const *)(source + i));
+                __m128i low = UnpremultiplySSE2(_mm_unpacklo_epi8(pixels, zero), source[i], source[i + 1]);
+                __m128i high = UnpremultiplySSE2(_mm_unpackhi_epi8(pixels, zero), source[i + 2], source[i + 3]);
+                _mm_storeu_si128((__m128i *)(destination + i), _mm_packus_epi16(low, high));
+        }
+
+        PixelsUnpremultiplyScalar(destination + i, source + i, n - i);
+}
+
+/* NOTE: Spreading 24-bit pixels out takes a byte shuffle, which SSE2
+ * lacks, so that conversion is left to the scalar kernel at this level. */
+static PixelsKernels const s_sse2_kernels = {
+        PixelsHaveAlphaSSE2,
+        PixelsCopySSE2,
+        PixelsSetAlphaSSE2,
+        PixelsFromRGB24Scalar,
+        PixelsPremultiplySSE2,
+        PixelsUnpremultiplySSE2,
+};
+#endif
+
+#ifdef PIXELS_HAVE_AVX2
+PIXELS_TARGET("avx2") static int
+PixelsHaveAlphaAVX2(PixelsARGB const *pixels, unsigned int n)
+{
+        __m256i const transparent = _mm256_setzero_si256();
+        __m256i const opaque = _mm256_set1_epi32(0xff);
+
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8) {
+                __m256i alpha = _mm256_srli_epi32(_mm256_loadu_si256((__m256i const *)(pixels + i)), PIXELS_ALPHA_SHIFT);
+                __m256i binary = _mm256_or_si256(_mm256_cmpeq_epi32(alpha, transparent),
+                                                 _mm256_cmpeq_epi32(alpha, opaque));
+                if (_mm256_movemask_epi8(binary) != -1)
+                        return 1;
+        }
+
+        return PixelsHaveAlphaScalar(pixels + i, n - i);
+}
+
+PIXELS_TARGET("avx2") static void
+PixelsCopyAVX2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8)
+                _mm256_storeu_si256((__m256i *)(destination + i),
+                                    _mm256_loadu_si256((__m256i const *)(source + i)));
+
+        PixelsCopyScalar(destination + i, source + i, n - i);
+}
+
+PIXELS_TARGET("avx2") static void
+PixelsSetAlphaAVX2(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n)
+{
+        __m256i const rgb_mask = _mm256_set1_epi32(PIXELS_RGB_MASK);
+
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8) {
+                __m256i a = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(alpha + i))),
+                                              PIXELS_ALPHA_SHIFT);
+                __m256i rgb = _mm256_and_si256(_mm256_loadu_si256((__m256i const *)(source + i)), rgb_mask);
+                _mm256_storeu_si256((__m256i *)(destination + i), _mm256_or_si256(rgb, a));
+        }
+
+        PixelsSetAlphaScalar(destination + i, source + i, alpha + i, n - i);
+}
+
+/* Spreads eight 24-bit pixels at a time over 32 bits by loading four
+ * pixels into each 128-bit lane and shuffling them into place.  Each load
+ * reads 16 bytes for the 12 it uses, so the loop stops early enough for
+ * the last one to stay within SOURCE. */
+PIXELS_TARGET("avx2") static void
+PixelsFromRGB24AVX2(PixelsARGB *destination, unsigned char const *source, unsigned int n)
+{
+        __m256i const spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        __m256i const opaque = _mm256_set1_epi32((int)PIXELS_OPAQUE);
+
+        unsigned int i = 0;
+        for ( ; i + 10 <= n; i += 8) {
+                __m128i low = _mm_loadu_si128((__m128i const *)(source + 3 * i));
+                __m128i high = _mm_loadu_si128((__m128i const *)(source + 3 * i + 12));
+                __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+                _mm256_storeu_si256((__m256i *)(destination + i),
+                                    _mm256_or_si256(_mm256_shuffle_epi8(rgb, spread), opaque));
+        }
+
+        PixelsFromRGB24Scalar(destination + i, source + 3 * i, n - i);
+}
+
+PIXELS_TARGET("avx2") static inline __m256i
+PremultiplyAVX2(__m256i channels)
+{
+        __m256i const alpha_lanes = _mm256_setr_epi16(0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff);
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)),
+                                               _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(channels, _mm256_or_si256(alpha, alpha_lanes)),
+                                     _mm256_set1_epi16(128));
+
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+PIXELS_TARGET("avx2") static void
+PixelsPremultiplyAVX2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        __m256i const zero = _mm256_setzero_si256();
+
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8) {
+                __m256i pixels = _mm256_loadu_si256((__m256i const *)(source + i));
+                _mm256_storeu_si256((__m256i *)(destination + i),
+                                    _mm256_packus_epi16(PremultiplyAVX2(_mm256_unpacklo_epi8(pixels, zero)),
+                                                        PremultiplyAVX2(_mm256_unpackhi_epi8(pixels, zero))));
+        }
+
+        PixelsPremultiplyScalar(destination + i, source + i, n - i);
+}
+
+/* Unpremultiplies the CHANNELS of the four PIXELS spread over the 16-bit
+ * lanes of both halves, like UnpremultiplySSE2().  Unpacking works within
+ * each half, so PIXELS are the first two of one half and the first two of
+ * the other, or the last two of each. */
+PIXELS_TARGET("avx2") static inline __m256i
+UnpremultiplyAVX2(__m256i channels, PixelsARGB const *pixels)
+{
+        __m256i high_factors = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(UNPREMULTIPLY_FACTORS(pixels[0], pixels[1], high)),
+                UNPREMULTIPLY_FACTORS(pixels[2], pixels[3], high), 1);
+        __m256i low_factors = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(UNPREMULTIPLY_FACTORS(pixels[0], pixels[1], low)),
+                UNPREMULTIPLY_FACTORS(pixels[2], pixels[3], low), 1);
+
+        __m256i low = _mm256_mullo_epi16(channels, low_factors);
+        __m256i value = _mm256_add_epi16(_mm256_mullo_epi16(channels, high_factors),
+                                         _mm256_mulhi_epu16(channels, low_factors));
+        value = _mm256_add_epi16(value, _mm256_srli_epi16(low, 15));
+
+        return _mm256_sub_epi16(value, _mm256_subs_epu16(value, _mm256_set1_epi16(0xff)));
+}
+
+PIXELS_TARGET("avx2") static void
+PixelsUnpremultiplyAVX2(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        __m256i const zero = _mm256_setzero_si256();
+
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8) {
+                __m256i pixels = _mm256_loadu_si256((__m256i const *)(source + i));
+                PixelsARGB const low_pixels[4] = { source[i], source[i + 1], source[i + 4], source[i + 5] };
+                PixelsARGB const high_pixels[4] = { source[i + 2], source[i + 3], source[i + 6], source[i + 7] };
+                __m256i low = UnpremultiplyAVX2(_mm256_unpacklo_epi8(pixels, zero), low_pixels);
+                __m256i high = UnpremultiplyAVX2(_mm256_unpackhi_epi8(pixels, zero), high_pixels);
+                _mm256_storeu_si256((__m256i *)(destination + i), _mm256_packus_epi16(low, high));
+        }
+
+        PixelsUnpremultiplyScalar(destination + i, source + i, n - i);
+}
+
+static PixelsKernels const s_avx2_kernels = {
+        PixelsHaveAlphaAVX2,
+        PixelsCopyAVX2,
+        PixelsSetAlphaAVX2,
+        PixelsFromRGB24AVX2,
+        PixelsPremultiplyAVX2,
+        PixelsUnpremultiplyAVX2,
+};
+#endif
+
+/* The alpha values of the eight pixels of each byte of a 1-bit mask,
+ * most significant bit first, set bits being transparent and clear bits
+ * being opaque. */
+#define MASK_ALPHA(byte, bit)   (((byte) & (0x80 >> (bit))) ? 0x00 : 0xff)
+#define MASK_ROW(b)             { MASK_ALPHA(b, 0), MASK_ALPHA(b, 1), MASK_ALPHA(b, 2), MASK_ALPHA(b, 3), \
+                                  MASK_ALPHA(b, 4), MASK_ALPHA(b, 5), MASK_ALPHA(b, 6), MASK_ALPHA(b, 7) }
+#define MASK_ROWS4(b)           MASK_ROW(b), MASK_ROW((b) + 1), MASK_ROW((b) + 2), MASK_ROW((b) + 3)
+#define MASK_ROWS16(b)          MASK_ROWS4(b), MASK_ROWS4((b) + 4), MASK_ROWS4((b) + 8), MASK_ROWS4((b) + 12)
+#define MASK_ROWS64(b)          MASK_ROWS16(b), MASK_ROWS16((b) + 16), MASK_ROWS16((b) + 32), MASK_ROWS16((b) + 48)
+
+static unsigned char const s_mask_alpha[256][8] = {
+        MASK_ROWS64(0), MASK_ROWS64(64), MASK_ROWS64(128), MASK_ROWS64(192)
+};
+
+/* The kernels in use, or NULL until the first kernel is called. */
+static PixelsKernels const *s_kernels;
+
+#if defined(PIXELS_HAVE_AVX2) && defined(_MSC_VER)
+/* Determines whether the processor and the operating system support
+ * AVX2. */
+static int
+ProcessorSupportsAVX2(void)
+{
+        int info[4];
+
+        __cpuid(info, 0);
+        if (info[0] < 7)
+                return 0;
+
+        /* NOTE: OSXSAVE and AVX must be set, and the operating system
+         * must save the YMM registers on context switches. */
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 ||
+            (_xgetbv(0) & 0x6) != 0x6)
+                return 0;
+
+        __cpuidex(info, 7, 0);
+
+        return (info[1] & (1 << 5)) != 0;
+}
+#elif defined(PIXELS_HAVE_AVX2)
+static int
+ProcessorSupportsAVX2(void)
+{
+        return __builtin_cpu_supports("avx2");
+}
+#endif
+
+/* Determines the best PixelsLevel supported by both the processor and the
+ * compiler. */
+PixelsLevel
+PixelsSupportedLevel(void)
+{
+#ifdef PIXELS_HAVE_AVX2
+        if (ProcessorSupportsAVX2())
+                return PIXELS_AVX2;
+#endif
+#ifdef PIXELS_HAVE_SSE2
+        /* NOTE: Every processor capable of running x64 has SSE2, and we
+         * don’t support x86 processors without it. */
+        return PIXELS_SSE2;
+#else
+        return PIXELS_SCALAR;
+#endif
+}
+
+/* Uses the kernels implemented for LEVEL from now on.  Returns 0 if LEVEL
+ * isn’t supported, in which case the kernels in use are left alone. */
+int
+PixelsUseLevel(PixelsLevel level)
+{
+        if (level > PixelsSupportedLevel())
+                return 0;
+
+        switch (level) {
+#ifdef PIXELS_HAVE_AVX2
+        case PIXELS_AVX2:
+                s_kernels = &s_avx2_kernels;
+                return 1;
+#endif
+#ifdef PIXELS_HAVE_SSE2
+        case PIXELS_SSE2:
+                s_kernels = &s_sse2_kernels;
+                return 1;
+#endif
+        default:
+                s_kernels = &s_scalar_kernels;
+                return 1;
+        }
+}
+
+/* Gets the kernels in use, picking the best ones if none have been
+ * picked yet.  Picking them more than once from different threads is
+ * harmless, as they all pick the same ones. */
+static inline PixelsKernels const *
+PixelsKernelsGet(void)
+{
+        if (s_kernels == NULL)
+                PixelsUseLevel(PixelsSupportedLevel());
+
+        return s_kernels;
+}
+
+/* Determines whether any of the N PIXELS has an alpha value other than
+ * completely transparent or completely opaque.  Stops looking as soon as
+ * one is found. */
+int
+PixelsHaveAlpha(PixelsARGB const *pixels, unsigned int n)
+{
+        return PixelsKernelsGet()->have_alpha(pixels, n);
+}
+
+/* Copies N pixels from SOURCE to DESTINATION. */
+void
+PixelsCopy(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        PixelsKernelsGet()->copy(destination, source, n);
+}
+
+/* Expands the first N bits of the 1-bit MASK into ALPHA, one byte per
+ * bit, most significant bit first.  Set bits, i.e., transparent pixels,
+ * become 0x00 and clear bits, i.e., opaque pixels, become 0xff. */
+void
+PixelsExpandMask(unsigned char *alpha, unsigned char const *mask, unsigned int n)
+{
+        unsigned int i = 0;
+        for ( ; i + 8 <= n; i += 8)
+                memcpy(alpha + i, s_mask_alpha[mask[i / 8]], 8);
+
+        if (i < n)
+                memcpy(alpha + i, s_mask_alpha[mask[i / 8]], n - i);
+}
+
+/* Copies N pixels from SOURCE to DESTINATION, replacing their alpha values
+ * by those in ALPHA. */
+void
+PixelsSetAlpha(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n)
+{
+        PixelsKernelsGet()->set_alpha(destination, source, alpha, n);
+}
+
+/* Converts N palette indexes of BITS_PER_PIXEL bits each, which must be
+ * 1, 4, or 8, packed most significant bits first in SOURCE, by looking
+ * them up in PALETTE, which must have room for any index SOURCE may
+ * hold. */
+void
+PixelsFromIndexed(PixelsARGB *destination, unsigned char const *source, unsigned int bits_per_pixel,
+                  PixelsARGB const *palette, unsigned int n)
+{
+        unsigned int i = 0;
+
+        switch (bits_per_pixel) {
+        case 8:
+                for ( ; i < n; i++)
+                        destination[i] = palette[source[i]];
+                break;
+        case 4:
+                for ( ; i + 2 <= n; i += 2) {
+                        destination[i] = palette[source[i / 2] >> 4];
+                        destination[i + 1] = palette[source[i / 2] & 0x0f];
+                }
+                if (i < n)
+                        destination[i] = palette[source[i / 2] >> 4];
+                break;
+        case 1:
+                for ( ; i < n; i++)
+                        destination[i] = palette[(source[i / 8] >> (7 - i % 8)) & 0x01];
+                break;
+        }
+}
+
+/* Expands the 5-bit channel of PIXEL at SHIFT to 8 bits, repeating its
+ * top bits in the bottom ones so that 0x1f becomes 0xff. */
+static inline PixelsARGB
+Channel5To8(unsigned int pixel, unsigned int shift)
+{
+        unsigned int value = (pixel >> shift) & 0x1f;
+
+        return (value << 3) | (value >> 2);
+}
+
+/* Expands the 6-bit channel of PIXEL at SHIFT to 8 bits. */
+static inline PixelsARGB
+Channel6To8(unsigned int pixel, unsigned int shift)
+{
+        unsigned int value = (pixel >> shift) & 0x3f;
+
+        return (value << 2) | (value >> 4);
+}
+
+/* Converts N 16-bit pixels with five bits each for red, green, and blue. */
+void
+PixelsFromRGB555(PixelsARGB *destination, unsigned short const *source, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++)
+                destination[i] = PIXELS_OPAQUE | (Channel5To8(source[i], 10) << 16) |
+                                 (Channel5To8(source[i], 5) << 8) | Channel5To8(source[i], 0);
+}
+
+/* Converts N 16-bit pixels with five bits for red and blue and six for
+ * green. */
+void
+PixelsFromRGB565(PixelsARGB *destination, unsigned short const *source, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++)
+                destination[i] = PIXELS_OPAQUE | (Channel5To8(source[i], 11) << 16) |
+                                 (Channel6To8(source[i], 5) << 8) | Channel5To8(source[i], 0);
+}
+
+/* Converts N 24-bit pixels, stored blue, green, red, into opaque ARGB
+ * pixels. */
+void
+PixelsFromRGB24(PixelsARGB *destination, unsigned char const *source, unsigned int n)
+{
+        PixelsKernelsGet()->from_rgb24(destination, source, n);
+}
+
+/* Premultiplies the colors of N pixels from SOURCE by their alpha values
+ * into DESTINATION, which may be SOURCE. */
+void
+PixelsPremultiply(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        PixelsKernelsGet()->premultiply(destination, source, n);
+}
+
+/* Divides the colors of N premultiplied pixels from SOURCE by their alpha
+ * values into DESTINATION, which may be SOURCE.  Unpremultiplying a pixel
+ * that PixelsPremultiply() produced and premultiplying it again gives
+ * back the same pixel. */
+void
+PixelsUnpremultiply(PixelsARGB *destination, PixelsARGB const *source, unsigned int n)
+{
+        PixelsKernelsGet()->unpremultiply(destination, source, n);
+}
@@ -0,0 +1,32 @@
+﻿/* Kernels working on rows of 32-bit ARGB pixels, as laid out in the
+ * BitmapData of a 32-bit bitmap, and converting rows of other formats
+ * into them.  They only depend on the C runtime, so that they may be
+ * built and compared outside of the application. */
+
+/* A 32-bit ARGB pixel, the same as GDI+’s ARGB on Windows. */
+#ifdef _WIN32
+typedef DWORD PixelsARGB;
+#else
+typedef unsigned int PixelsARGB;
+#endif
+
+/* The instruction sets that kernels may be implemented with. */
+typedef enum {
+        PIXELS_SCALAR,
+        PIXELS_SSE2,
+        PIXELS_AVX2,
+} PixelsLevel;
+
+PixelsLevel PixelsSupportedLevel(void);
+int PixelsUseLevel(PixelsLevel level);
+int PixelsHaveAlpha(PixelsARGB const *pixels, unsigned int n);
+void PixelsCopy(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
+void PixelsSetAlpha(PixelsARGB *destination, PixelsARGB const *source, unsigned char const *alpha, unsigned int n);
+void PixelsExpandMask(unsigned char *alpha, unsigned char const *mask, unsigned int n);
+void PixelsFromIndexed(PixelsARGB *destination, unsigned char const *source, unsigned int bits_per_pixel,
+                       PixelsARGB const *palette, unsigned int n);
+void PixelsFromRGB555(PixelsARGB *destination, unsigned short const *source, unsigned int n);
+void PixelsFromRGB565(PixelsARGB *destination, unsigned short const *source, unsigned int n);
+void PixelsFromRGB24(PixelsARGB *destination, unsigned char const *source, unsigned int n);
+void PixelsPremultiply(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
+void PixelsUnpremultiply(PixelsARGB *destination, PixelsARGB const *source, unsigned int n);
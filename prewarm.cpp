@@ -0,0 +1,156 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "prewarm.h"
+
+/* A Prewarm decides when to warm up the window list in idle time, that
+ * is, bring it in line with the desktop and measure it, so that it’s
+ * ready by the time the hotkey is pressed.  Warming up is rate-limited
+ * and paused while running on battery or while the processor is busy,
+ * as a stale list is repaired when displayed anyway. */
+
+/* The percentage of processor time in use above which the processor is
+ * considered busy. */
+#define PREWARM_BUSY_PERCENT    50
+
+/* A Prewarm warming up at most every INTERVAL milliseconds.  LAST_WARMED
+ * is the tick count of the last warm-up, or zero if there hasn’t been
+ * one.  IDLE_TIME and TOTAL_TIME are the processor times sampled when
+ * last checking whether the processor was busy. */
+struct _Prewarm
+{
+        DWORD interval;
+        DWORD last_warmed;
+        ULONGLONG idle_time;
+        ULONGLONG total_time;
+        PrewarmCounters counters;
+};
+
+static inline ULONGLONG
+FileTimeToULongLong(FILETIME const *time)
+{
+        return ((ULONGLONG)time->dwHighDateTime << 32) | time->dwLowDateTime;
+}
+
+/* Determines whether the computer is running on battery. */
+static BOOL
+IsOnBattery(VOID)
+{
+        SYSTEM_POWER_STATUS status;
+        if (!GetSystemPowerStatus(&status))
+                return FALSE;
+
+        return status.ACLineStatus == 0;
+}
+
+/* Determines whether more than PREWARM_BUSY_PERCENT of the processor
+ * time since the last check was in use.  The first check only takes a
+ * sample, and so reports the processor as busy. */
+static BOOL
+PrewarmIsBusy(Prewarm *prewarm)
+{
+        FILETIME idle, kernel, user;
+        if (!GetSystemTimes(&idle, &kernel, &user))
+                return FALSE;
+
+        /* NOTE: Kernel time includes idle time. */
+        ULONGLONG idle_time = FileTimeToULongLong(&idle);
+        ULONGLONG total_time = FileTimeToULongLong(&kernel) + FileTimeToULongLong(&user);
+
+        ULONGLONG idle_delta = idle_time - prewarm->idle_time;
+        ULONGLONG total_delta = total_time - prewarm->total_time;
+        BOOL sampled = prewarm->total_time != 0;
+
+        prewarm->idle_time = idle_time;
+        prewarm->total_time = total_time;
+
+        if (!sampled || total_delta == 0)
+                return TRUE;
+
+        return (total_delta - idle_delta) * 100 > total_delta * PREWARM_BUSY_PERCENT;
+}
+
+/* Creates a new Prewarm that warms up the window list at most every
+ * INTERVAL milliseconds. */
+Prewarm *
+PrewarmNew(DWORD interval)
+{
+        Prewarm *prewarm = ALLOC_STRUCT(Prewarm);
+        if (prewarm == NULL)
+                return NULL;
+
+        prewarm->interval = interval;
+        PrewarmIsBusy(prewarm);
+
+        return prewarm;
+}
+
+void
+PrewarmFree(Prewarm *prewarm)
+{
+        FREE(prewarm);
+}
+
+/* Determines whether the window list should be warmed up now.  This is
+ * meant to be called periodically, as it also keeps track of how busy
+ * the processor is. */
+BOOL
+PrewarmIsDue(Prewarm *prewarm)
+{
+        BOOL busy = PrewarmIsBusy(prewarm);
+
+        if (prewarm->last_warmed != 0 &&
+            GetTickCount() - prewarm->last_warmed < prewarm->interval)
+                return FALSE;
+
+        if (IsOnBattery()) {
+                prewarm->counters.skipped_on_battery++;
+                return FALSE;
+        }
+
+        if (busy) {
+                prewarm->counters.skipped_busy++;
+                return FALSE;
+        }
+
+        return TRUE;
+}
+
+/* Records that the window list was warmed up. */
+void
+PrewarmWarmed(Prewarm *prewarm)
+{
+        prewarm->last_warmed = max(GetTickCount(), 1);
+        prewarm->counters.warmed++;
+}
+
+/* Records that the window list was displayed, after REPAIRED items had
+ * to be added, removed, or changed. */
+void
+PrewarmDisplayed(Prewarm *prewarm, WindowListDiff const *repaired)
+{
+        PrewarmCounters *counters = &prewarm->counters;
+
+        int n_repaired = repaired->added + repaired->removed + repaired->changed;
+
+        counters->displayed++;
+        if (n_repaired == 0)
+                counters->displayed_warm++;
+        counters->repaired += n_repaired;
+
+        if (prewarm->last_warmed == 0)
+                return;
+
+        DWORD staleness = GetTickCount() - prewarm->last_warmed;
+        counters->staleness += staleness;
+        counters->max_staleness = max(counters->max_staleness, staleness);
+}
+
+/* Gets the counters kept by PREWARM. */
+void
+PrewarmCountersGet(Prewarm const *prewarm, PrewarmCounters *counters)
+{
+        *counters = prewarm->counters;
+}
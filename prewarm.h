@@ -0,0 +1,32 @@
+﻿typedef struct _Prewarm Prewarm;
+typedef struct _PrewarmCounters PrewarmCounters;
+
+/* Counters kept by a Prewarm.
+ *
+ * WARMED is the number of times the window list was warmed up.
+ * SKIPPED_ON_BATTERY and SKIPPED_BUSY are the number of warm-ups that
+ * were skipped because the computer was running on battery or because
+ * the processor was busy.
+ * DISPLAYED is the number of times the window list was displayed, and
+ * DISPLAYED_WARM the number of those that needed no repairs.
+ * REPAIRED is the total number of items that were repaired on display.
+ * STALENESS is the total, and MAX_STALENESS the largest, number of
+ * milliseconds between the last warm-up and a display. */
+struct _PrewarmCounters
+{
+        UINT warmed;
+        UINT skipped_on_battery;
+        UINT skipped_busy;
+        UINT displayed;
+        UINT displayed_warm;
+        UINT repaired;
+        ULONGLONG staleness;
+        DWORD max_staleness;
+};
+
+Prewarm *PrewarmNew(DWORD interval);
+void PrewarmFree(Prewarm *prewarm);
+BOOL PrewarmIsDue(Prewarm *prewarm);
+void PrewarmWarmed(Prewarm *prewarm);
+void PrewarmDisplayed(Prewarm *prewarm, WindowListDiff const *repaired);
+void PrewarmCountersGet(Prewarm const *prewarm, PrewarmCounters *counters);
@@ -0,0 +1,603 @@
+﻿#include "stdafx.h"
+
+#include "list.h"
+#include "hashtable.h"
+#include "windowsource.h"
+#include "recording.h"
+
+/* A Recording is a snapshot of a WindowSource, written to and read from
+ * a file, so that the window list can be built from a desktop captured
+ * elsewhere, e.g., for profiling the building of lists of a couple of
+ * thousand windows.  A Recording read back in is itself a WindowSource,
+ * which replays the titles, icons, hung windows, and icon latencies of
+ * the windows that were recorded.  Replayed windows are only handles, as
+ * far as this desktop is concerned, so replaying never asks Windows
+ * about them, and icons are handed over as the pixels that were
+ * recorded.
+ *
+ * A recording consists of a header followed by one record per window,
+ * in z-order.  Integers are stored in little-endian byte order.
+ *
+ *   header:  magic (u32, RECORDING_MAGIC), version (u32), shell window
+ *            (u64), number of windows (u32)
+ *   window:  window (u64), owner (u64), extended style (u64), flags
+ *            (u32, RECORDING_*), microseconds it took to get the icon
+ *            (u32), title length (u32), title (UTF-16 without a
+ *            terminating zero) and, if RECORDING_HAS_ICON is set, icon
+ *            width (u32), icon height (u32), color bits, and mask bits,
+ *            as in a WindowSourceIcon */
+
+#define RECORDING_MAGIC         0x53575057
+#define RECORDING_VERSION       1
+
+#define RECORDING_VISIBLE       (1 << 0)
+#define RECORDING_HUNG          (1 << 1)
+#define RECORDING_HAS_ICON      (1 << 2)
+
+/* The largest icon dimension accepted when reading a recording. */
+#define RECORDING_MAX_ICON_DELTA        256
+
+typedef struct _RecordedWindow RecordedWindow;
+
+/* A recorded WINDOW, owned by OWNER, with extended style EX_STYLE and
+ * RECORDING_* FLAGS.  LATENCY is the number of microseconds it took to
+ * get its icon.  TITLE is NULL if it has none, and ICON is only set if
+ * RECORDING_HAS_ICON is. */
+struct _RecordedWindow
+{
+        HWND window;
+        HWND owner;
+        LONG_PTR ex_style;
+        DWORD flags;
+        DWORD latency;
+        LPTSTR title;
+        WindowSourceIcon icon;
+};
+
+/* A recording of N_WINDOWS WINDOWS, in z-order, which are indexed by
+ * window in INDEX.  SHELL is the shell’s desktop window. */
+struct _Recording
+{
+        WindowSource source;
+        HWND shell;
+        RecordedWindow *windows;
+        UINT n_windows;
+        HashTable *index;
+};
+
+/* A buffer that a recording is written to before being saved.  FAILED
+ * is set if memory ran out. */
+typedef struct _RecordingWriter RecordingWriter;
+
+struct _RecordingWriter
+{
+        BYTE *data;
+        SIZE_T size;
+        SIZE_T allocated;
+        BOOL failed;
+};
+
+static void
+RecordingWriterPut(RecordingWriter *writer, VOID const *data, SIZE_T size)
+{
+        if (writer->failed)
+                return;
+
+        if (writer->size + size > writer->allocated) {
+                SIZE_T allocated = max(max(writer->allocated * 2, writer->size + size), 4096);
+                BYTE *grown = REALLOC_N(BYTE, writer->data, allocated);
+                if (grown == NULL) {
+                        writer->failed = TRUE;
+                        return;
+                }
+                writer->data = grown;
+                writer->allocated = allocated;
+        }
+
+        CopyMemory(writer->data + writer->size, data, size);
+        writer->size += size;
+}
+
+static void
+RecordingWriterPutU32(RecordingWriter *writer, DWORD value)
+{
+        RecordingWriterPut(writer, &value, sizeof(value));
+}
+
+static void
+RecordingWriterPutU64(RecordingWriter *writer, ULONGLONG value)
+{
+        RecordingWriterPut(writer, &value, sizeof(value));
+}
+
+static void
+RecordingWriterPutHWND(RecordingWriter *writer, HWND window)
+{
+        RecordingWriterPutU64(writer, (ULONGLONG)(ULONG_PTR)window);
+}
+
+static ULONGLONG
+MicrosecondsBetween(LARGE_INTEGER const *start, LARGE_INTEGER const *end, LARGE_INTEGER const *frequency)
+{
+        return (ULONGLONG)(end->QuadPart - start->QuadPart) * 1000000 / frequency->QuadPart;
+}
+
+/* Writes the record of WINDOW of SOURCE to WRITER. */
+static void
+RecordingWriterPutWindow(RecordingWriter *writer, WindowSource *source, HWND window)
+{
+        DWORD flags = 0;
+        if (WindowSourceIsVisible(source, window))
+                flags |= RECORDING_VISIBLE;
+
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        WindowSourceIcon icon;
+        BOOL was_hung;
+        BOOL has_icon = WindowSourceSmallIcon(source, window, &icon, &was_hung);
+
+        QueryPerformanceCounter(&end);
+
+        if (was_hung)
+                flags |= RECORDING_HUNG;
+        else if (has_icon)
+                flags |= RECORDING_HAS_ICON;
+
+        LPTSTR title;
+        BOOL has_title = WindowSourceTitle(source, window, &title);
+        DWORD title_length = has_title ? lstrlen(title) : 0;
+
+        RecordingWriterPutHWND(writer, window);
+        RecordingWriterPutHWND(writer, WindowSourceOwner(source, window));
+        RecordingWriterPutU64(writer, (ULONGLONG)WindowSourceExStyle(source, window));
+        RecordingWriterPutU32(writer, flags);
+        RecordingWriterPutU32(writer, (DWORD)min(MicrosecondsBetween(&start, &end, &frequency), MAXDWORD));
+        RecordingWriterPutU32(writer, title_length);
+        if (has_title) {
+                RecordingWriterPut(writer, title, title_length * sizeof(TCHAR));
+                FREE(title);
+        }
+
+        if (flags & RECORDING_HAS_ICON) {
+                RecordingWriterPutU32(writer, icon.width);
+                RecordingWriterPutU32(writer, icon.height);
+                RecordingWriterPut(writer, icon.color, WindowSourceIconColorSize(icon.width, icon.height));
+                RecordingWriterPut(writer, icon.mask, WindowSourceIconMaskSize(icon.width, icon.height));
+                WindowSourceIconFree(&icon);
+        }
+}
+
+static BOOL CALLBACK
+RecordingCollectProc(HWND window, LPARAM lParam)
+{
+        return ListCons((List **)lParam, window);
+}
+
+/* Records the windows of SOURCE to the file at PATH.  Returns FALSE if
+ * the recording couldn’t be written. */
+BOOL
+RecordingWrite(WindowSource *source, LPCTSTR path)
+{
+        List *windows = ListNew();
+        WindowSourceEnumerate(source, RecordingCollectProc, (LPARAM)&windows);
+        windows = ListReverse(windows);
+
+        RecordingWriter writer = { NULL, 0, 0, FALSE };
+        RecordingWriterPutU32(&writer, RECORDING_MAGIC);
+        RecordingWriterPutU32(&writer, RECORDING_VERSION);
+        RecordingWriterPutHWND(&writer, WindowSourceShell(source));
+        RecordingWriterPutU32(&writer, ListLength(windows));
+        for (List *p = windows; p != NULL; p = p->next)
+                RecordingWriterPutWindow(&writer, source, (HWND)p->item);
+
+        ListFree(windows, NullFreeFunc);
+
+        BOOL written = FALSE;
+        if (!writer.failed) {
+                HANDLE file = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (file != INVALID_HANDLE_VALUE) {
+                        DWORD n_written;
+                        written = WriteFile(file, writer.data, (DWORD)writer.size, &n_written, NULL) &&
+                                  n_written == writer.size;
+                        CloseHandle(file);
+                }
+        }
+
+        if (writer.data != NULL)
+                FREE(writer.data);
+
+        return written;
+}
+
+/* A cursor over the LEFT bytes at P of a recording being read. */
+typedef struct _RecordingReader RecordingReader;
+
+struct _RecordingReader
+{
+        BYTE const *p;
+        SIZE_T left;
+};
+
+/* Takes the next SIZE bytes off READER, setting DATA to point to them.
+ * Returns FALSE if there aren’t that many left. */
+static BOOL
+RecordingReaderTake(RecordingReader *reader, SIZE_T size, BYTE const **data)
+{
+        if (size > reader->left)
+                return FALSE;
+
+        *data = reader->p;
+        reader->p += size;
+        reader->left -= size;
+
+        return TRUE;
+}
+
+static BOOL
+RecordingReaderGetU32(RecordingReader *reader, DWORD *value)
+{
+        BYTE const *data;
+        if (!RecordingReaderTake(reader, sizeof(*value), &data))
+                return FALSE;
+
+        CopyMemory(value, data, sizeof(*value));
+
+        return TRUE;
+}
+
+static BOOL
+RecordingReaderGetU64(RecordingReader *reader, ULONGLONG *value)
+{
+        BYTE const *data;
+        if (!RecordingReaderTake(reader, sizeof(*value), &data))
+                return FALSE;
+
+        CopyMemory(value, data, sizeof(*value));
+
+        return TRUE;
+}
+
+static BOOL
+RecordingReaderGetHWND(RecordingReader *reader, HWND *window)
+{
+        ULONGLONG value;
+        if (!RecordingReaderGetU64(reader, &value))
+                return FALSE;
+
+        *window = (HWND)(ULONG_PTR)value;
+
+        return TRUE;
+}
+
+/* Reads the title of WINDOW off READER. */
+static BOOL
+RecordingReaderGetTitle(RecordingReader *reader, RecordedWindow *window)
+{
+        DWORD length;
+        BYTE const *data;
+        if (!RecordingReaderGetU32(reader, &length) ||
+            length > reader->left / sizeof(TCHAR) ||
+            !RecordingReaderTake(reader, length * sizeof(TCHAR), &data))
+                return FALSE;
+
+        if (length == 0)
+                return TRUE;
+
+        window->title = ALLOC_N(TCHAR, ZERO_TERMINATE(length));
+        if (window->title == NULL)
+                return FALSE;
+
+        CopyMemory(window->title, data, length * sizeof(TCHAR));
+        window->title[length] = L'\0';
+
+        return TRUE;
+}
+
+/* Reads the icon of WINDOW off READER. */
+static BOOL
+RecordingReaderGetIcon(RecordingReader *reader, RecordedWindow *window)
+{
+        DWORD width, height;
+        if (!RecordingReaderGetU32(reader, &width) ||
+            !RecordingReaderGetU32(reader, &height) ||
+            width == 0 || width > RECORDING_MAX_ICON_DELTA ||
+            height == 0 || height > RECORDING_MAX_ICON_DELTA)
+                return FALSE;
+
+        BYTE const *color, *mask;
+        if (!RecordingReaderTake(reader, WindowSourceIconColorSize(width, height), &color) ||
+            !RecordingReaderTake(reader, WindowSourceIconMaskSize(width, height), &mask) ||
+            !WindowSourceIconNew(width, height, &window->icon))
+                return FALSE;
+
+        CopyMemory(window->icon.color, color, WindowSourceIconColorSize(width, height));
+        CopyMemory(window->icon.mask, mask, WindowSourceIconMaskSize(width, height));
+
+        return TRUE;
+}
+
+static BOOL
+RecordingReaderGetWindow(RecordingReader *reader, RecordedWindow *window)
+{
+        ULONGLONG ex_style;
+        if (!RecordingReaderGetHWND(reader, &window->window) ||
+            !RecordingReaderGetHWND(reader, &window->owner) ||
+            !RecordingReaderGetU64(reader, &ex_style) ||
+            !RecordingReaderGetU32(reader, &window->flags) ||
+            !RecordingReaderGetU32(reader, &window->latency) ||
+            !RecordingReaderGetTitle(reader, window))
+                return FALSE;
+
+        window->ex_style = (LONG_PTR)ex_style;
+
+        if (window->flags & RECORDING_HAS_ICON)
+                return RecordingReaderGetIcon(reader, window);
+
+        return TRUE;
+}
+
+/* Reads the contents of the file at PATH, setting SIZE to its size. */
+static BYTE *
+ReadFileContents(LPCTSTR path, SIZE_T *size)
+{
+        HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+                return NULL;
+
+        BYTE *contents = NULL;
+        DWORD file_size = GetFileSize(file, NULL);
+        if (file_size != INVALID_FILE_SIZE)
+                contents = ALLOC_N(BYTE, max(file_size, 1));
+
+        DWORD n_read;
+        if (contents != NULL &&
+            (!ReadFile(file, contents, file_size, &n_read, NULL) || n_read != file_size)) {
+                FREE(contents);
+                contents = NULL;
+        }
+
+        CloseHandle(file);
+
+        *size = file_size;
+
+        return contents;
+}
+
+static RecordedWindow *
+RecordingLookup(Recording *recording, HWND window)
+{
+        return (RecordedWindow *)HashTableLookup(recording->index, HASH_KEY(window));
+}
+
+static BOOL
+RecordingEnumerate(VOID *closure, WNDENUMPROC f, LPARAM lParam)
+{
+        Recording *recording = (Recording *)closure;
+
+        for (UINT i = 0; i < recording->n_windows; i++)
+                if (!f(recording->windows[i].window, lParam))
+                        break;
+
+        return TRUE;
+}
+
+static HWND
+RecordingOwner(VOID *closure, HWND window)
+{
+        RecordedWindow *recorded = RecordingLookup((Recording *)closure, window);
+
+        return recorded != NULL ? recorded->owner : NULL;
+}
+
+static HWND
+RecordingShell(VOID *closure)
+{
+        return ((Recording *)closure)->shell;
+}
+
+static BOOL
+RecordingIsVisible(VOID *closure, HWND window)
+{
+        RecordedWindow *recorded = RecordingLookup((Recording *)closure, window);
+
+        return recorded != NULL && (recorded->flags & RECORDING_VISIBLE);
+}
+
+static LONG_PTR
+RecordingExStyle(VOID *closure, HWND window)
+{
+        RecordedWindow *recorded = RecordingLookup((Recording *)closure, window);
+
+        return recorded != NULL ? recorded->ex_style : 0;
+}
+
+static BOOL
+RecordingTitle(VOID *closure, HWND window, LPTSTR *title)
+{
+        RecordedWindow *recorded = RecordingLookup((Recording *)closure, window);
+        if (recorded == NULL || recorded->title == NULL)
+                return FALSE;
+
+        int size = ZERO_TERMINATE(lstrlen(recorded->title));
+        *title = ALLOC_N(TCHAR, size);
+        if (*title == NULL)
+                return FALSE;
+
+        CopyMemory(*title, recorded->title, size * sizeof(TCHAR));
+
+        return TRUE;
+}
+
+/* Replays the getting of WINDOW’s icon, taking as long as it did when
+ * it was recorded, and handing over a copy of its recorded pixels. */
+static BOOL
+RecordingSmallIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        RecordedWindow *recorded = RecordingLookup((Recording *)closure, window);
+
+        *was_hung = FALSE;
+
+        if (recorded == NULL)
+                return FALSE;
+
+        if (recorded->flags & RECORDING_HUNG) {
+                Sleep(HUNG_TIMEOUT);
+                *was_hung = TRUE;
+                return FALSE;
+        }
+
+        if (recorded->latency >= 1000)
+                Sleep(recorded->latency / 1000);
+
+        WindowSourceIcon const *recorded_icon = &recorded->icon;
+        if (!(recorded->flags & RECORDING_HAS_ICON) ||
+            !WindowSourceIconNew(recorded_icon->width, recorded_icon->height, icon))
+                return FALSE;
+
+        CopyMemory(icon->color, recorded_icon->color,
+                   WindowSourceIconColorSize(recorded_icon->width, recorded_icon->height));
+        CopyMemory(icon->mask, recorded_icon->mask,
+                   WindowSourceIconMaskSize(recorded_icon->width, recorded_icon->height));
+
+        return TRUE;
+}
+
+/* Only small icons are recorded, so there’s never a big one to pick
+ * instead. */
+static BOOL
+RecordingBigIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        UNREFERENCED_PARAMETER(closure);
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(icon);
+
+        *was_hung = FALSE;
+
+        return FALSE;
+}
+
+/* Recorded windows aren’t keyed, as their icons were never loaded from
+ * anywhere that may be looked up again. */
+static BOOL
+RecordingIconKey(VOID *closure, HWND window, LPTSTR *key)
+{
+        UNREFERENCED_PARAMETER(closure);
+        UNREFERENCED_PARAMETER(window);
+
+        *key = NULL;
+
+        return FALSE;
+}
+
+/* Recorded windows exist for as long as the recording is replayed. */
+static BOOL
+RecordingExists(VOID *closure, HWND window)
+{
+        return RecordingLookup((Recording *)closure, window) != NULL;
+}
+
+/* Recorded windows aren’t on this desktop, so there’s nothing to switch
+ * to, and their handles mustn’t be handed to Windows, as they may well
+ * be those of unrelated windows here. */
+static BOOL
+RecordingSwitchTo(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+        UNREFERENCED_PARAMETER(window);
+
+        return FALSE;
+}
+
+static WindowSourceFuncs const s_recording_funcs = {
+        RecordingEnumerate,
+        RecordingOwner,
+        RecordingShell,
+        RecordingIsVisible,
+        RecordingExStyle,
+        RecordingTitle,
+        RecordingSmallIcon,
+        RecordingBigIcon,
+        RecordingIconKey,
+        RecordingExists,
+        RecordingSwitchTo,
+};
+
+/* Reads the recording at PATH.  Returns NULL if it couldn’t be read or
+ * isn’t a valid recording. */
+Recording *
+RecordingRead(LPCTSTR path)
+{
+        SIZE_T size;
+        BYTE *contents = ReadFileContents(path, &size);
+        if (contents == NULL)
+                return NULL;
+
+        Recording *recording = ALLOC_STRUCT(Recording);
+        if (recording == NULL) {
+                FREE(contents);
+                return NULL;
+        }
+
+        recording->source.funcs = &s_recording_funcs;
+        recording->source.closure = recording;
+
+        RecordingReader reader = { contents, size };
+        DWORD magic, version, n_windows;
+        if (!RecordingReaderGetU32(&reader, &magic) || magic != RECORDING_MAGIC ||
+            !RecordingReaderGetU32(&reader, &version) || version != RECORDING_VERSION ||
+            !RecordingReaderGetHWND(&reader, &recording->shell) ||
+            !RecordingReaderGetU32(&reader, &n_windows) ||
+            n_windows > reader.left)
+                goto failure;
+
+        recording->windows = ALLOC_N(RecordedWindow, max(n_windows, 1));
+        recording->index = HashTableNew();
+        if (recording->windows == NULL || recording->index == NULL)
+                goto failure;
+        ZeroMemory(recording->windows, sizeof(RecordedWindow) * n_windows);
+
+        for ( ; recording->n_windows < n_windows; recording->n_windows++) {
+                RecordedWindow *window = &recording->windows[recording->n_windows];
+                if (!RecordingReaderGetWindow(&reader, window) ||
+                    !HashTableInsert(recording->index, HASH_KEY(window->window), window)) {
+                        recording->n_windows++;
+                        goto failure;
+                }
+        }
+
+        FREE(contents);
+
+        return recording;
+
+failure:
+        FREE(contents);
+        RecordingFree(recording);
+
+        return NULL;
+}
+
+/* Frees RECORDING, which mustn’t be used as a WindowSource anymore. */
+void
+RecordingFree(Recording *recording)
+{
+        for (UINT i = 0; i < recording->n_windows; i++) {
+                if (recording->windows[i].title != NULL)
+                        FREE(recording->windows[i].title);
+                WindowSourceIconFree(&recording->windows[i].icon);
+        }
+
+        if (recording->windows != NULL)
+                FREE(recording->windows);
+        if (recording->index != NULL)
+                HashTableFree(recording->index, NullFreeFunc);
+        FREE(recording);
+}
+
+/* Gets the WindowSource replaying RECORDING. */
+WindowSource *
+RecordingSource(Recording *recording)
+{
+        return &recording->source;
+}
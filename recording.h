@@ -0,0 +1,6 @@
+﻿typedef struct _Recording Recording;
+
+BOOL RecordingWrite(WindowSource *source, LPCTSTR path);
+Recording *RecordingRead(LPCTSTR path);
+void RecordingFree(Recording *recording);
+WindowSource *RecordingSource(Recording *recording);
@@ -0,0 +1,117 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stddef.h>
+
+#include "requestslot.h"
+
+/* Reads the generation of SLOT, as it may be bumped by another thread
+ * meanwhile. */
+static long
+RequestSlotLoadGeneration(RequestSlot const *slot)
+{
+#ifdef _MSC_VER
+        return slot->generation;
+#else
+        return __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Bumps the generation of SLOT, returning the new one.  Generations
+ * wrap around, which is fine, as they’re only ever compared for
+ * equality. */
+static long
+RequestSlotBumpGeneration(RequestSlot *slot)
+{
+#ifdef _MSC_VER
+        return InterlockedIncrement(&slot->generation);
+#else
+        return __atomic_add_fetch(&slot->generation, 1, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Sets up SLOT to be empty, with the worker idle. */
+void
+RequestSlotInit(RequestSlot *slot)
+{
+        slot->generation = 0;
+        slot->pending = NULL;
+        slot->pending_generation = 0;
+        slot->is_busy = 0;
+}
+
+/* Puts REQUEST in SLOT at a new generation, superseding the request
+ * pending and any the worker is working on.  Returns the request
+ * superseded before the worker took it, if any, for the caller to
+ * free. */
+void *
+RequestSlotPost(RequestSlot *slot, void *request)
+{
+        void *superseded = slot->pending;
+
+        slot->pending = request;
+        slot->pending_generation = RequestSlotBumpGeneration(slot);
+
+        return superseded;
+}
+
+/* Cancels the request pending in SLOT and any the worker is working on.
+ * Returns the request cancelled before the worker took it, if any, for
+ * the caller to free.  The worker may still be working on a request,
+ * until it notices; see RequestSlotIsBusy(). */
+void *
+RequestSlotCancel(RequestSlot *slot)
+{
+        void *cancelled = slot->pending;
+
+        slot->pending = NULL;
+        RequestSlotBumpGeneration(slot);
+
+        return cancelled;
+}
+
+/* Takes the request pending in SLOT for the worker, setting GENERATION
+ * to the one it was made at, and marks the worker as busy until it
+ * calls RequestSlotFinish().  Returns NULL if there’s none. */
+void *
+RequestSlotTake(RequestSlot *slot, long *generation)
+{
+        void *request = slot->pending;
+        if (request == NULL)
+                return NULL;
+
+        slot->pending = NULL;
+        slot->is_busy = 1;
+        *generation = slot->pending_generation;
+
+        return request;
+}
+
+/* Marks the worker of SLOT as done with the request it took at
+ * GENERATION.  Returns 1 if the request is still current, i.e., if its
+ * result should be handed back at all. */
+int
+RequestSlotFinish(RequestSlot *slot, long generation)
+{
+        slot->is_busy = 0;
+
+        return RequestSlotIsCurrent(slot, generation);
+}
+
+/* Determines whether the worker of SLOT is working on a request it
+ * took, which it may still be doing after it was cancelled. */
+int
+RequestSlotIsBusy(RequestSlot const *slot)
+{
+        return slot->is_busy;
+}
+
+/* Determines whether GENERATION is still that of the latest request in
+ * SLOT, i.e., whether it hasn’t been superseded or cancelled.  May be
+ * called from any thread without the caller’s lock, e.g., by the worker
+ * to see if it should give up, or when a result is handed back. */
+int
+RequestSlotIsCurrent(RequestSlot const *slot, long generation)
+{
+        return RequestSlotLoadGeneration(slot) == generation;
+}
@@ -0,0 +1,33 @@
+﻿/* A slot handing the latest of a series of requests over to a worker,
+ * each request superseding the ones before it.  Every request is tagged
+ * with a generation, which is bumped by each request and by each
+ * cancellation, so that the worker may tell when the request it’s
+ * working on has been superseded and give up on it, and so that results
+ * handed back for an older generation are ignored.  Requests are opaque
+ * pointers owned by the caller.
+ *
+ * All functions but RequestSlotIsCurrent() must be called with a lock
+ * of the caller’s held, and waking and waiting for the worker is left to
+ * the caller as well.  Like the atomic queue, it only depends on the C
+ * runtime and the compiler’s atomic operations. */
+typedef struct _RequestSlot RequestSlot;
+
+/* GENERATION is that of the latest request or cancellation, only ever
+ * changed with the caller’s lock held but read without it.  PENDING is
+ * the request waiting to be taken, made at PENDING_GENERATION.  IS_BUSY
+ * is set while the worker works on a request it has taken. */
+struct _RequestSlot
+{
+        volatile long generation;
+        void *pending;
+        long pending_generation;
+        int is_busy;
+};
+
+void RequestSlotInit(RequestSlot *slot);
+void *RequestSlotPost(RequestSlot *slot, void *request);
+void *RequestSlotCancel(RequestSlot *slot);
+void *RequestSlotTake(RequestSlot *slot, long *generation);
+int RequestSlotFinish(RequestSlot *slot, long generation);
+int RequestSlotIsBusy(RequestSlot const *slot);
+int RequestSlotIsCurrent(RequestSlot const *slot, long generation);
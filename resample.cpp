@@ -0,0 +1,308 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "resample.h"
+
+/* Pixels are resampled with their colors premultiplied by their alpha
+ * values, so that the colors of transparent pixels don’t bleed into
+ * their neighbors.  They come in and go out premultiplied, so filtering
+ * them is all there is to it.  Each pixel is held as four floats, blue,
+ * green, red, and alpha, and filtered first horizontally and then
+ * vertically.
+ * Downscaling by a whole factor uses a box filter, which averages each
+ * block of source pixels; any other scale uses a Lanczos filter with
+ * three lobes, widened by the scale when downscaling. */
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#  define RESAMPLE_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+#define LANCZOS_LOBES           3
+#define RESAMPLE_PI             3.14159265358979323846
+
+/* The filter for one axis.  Output pixel I is made up of the N_TAPS
+ * source pixels starting at FIRST[I], weighted by the N_TAPS weights
+ * starting at WEIGHTS[I * N_TAPS]. */
+typedef struct _ResampleAxis ResampleAxis;
+
+struct _ResampleAxis
+{
+        unsigned int source_size;
+        unsigned int size;
+        unsigned int n_taps;
+        unsigned int *first;
+        float *weights;
+};
+
+struct _Resampler
+{
+        ResampleAxis x;
+        ResampleAxis y;
+};
+
+static double
+Sinc(double x)
+{
+        if (x == 0.0)
+                return 1.0;
+
+        x *= RESAMPLE_PI;
+
+        return sin(x) / x;
+}
+
+static double
+Lanczos(double x)
+{
+        if (x <= -LANCZOS_LOBES || x >= LANCZOS_LOBES)
+                return 0.0;
+
+        return Sinc(x) * Sinc(x / LANCZOS_LOBES);
+}
+
+/* Determines how many source pixels, at most, each output pixel of AXIS
+ * is made up of. */
+static unsigned int
+ResampleAxisTaps(ResampleAxis const *axis, double scale)
+{
+        unsigned int n_taps;
+
+        if (axis->source_size % axis->size == 0)
+                n_taps = axis->source_size / axis->size;
+        else
+                n_taps = (unsigned int)ceil(2 * LANCZOS_LOBES * scale) + 1;
+
+        return n_taps < axis->source_size ? n_taps : axis->source_size;
+}
+
+/* Fills in the N_TAPS weights of output pixel I of AXIS, which is centered
+ * on CENTER in source pixels, and returns the first source pixel they
+ * apply to.  The weights add up to one. */
+static unsigned int
+ResampleAxisWeigh(ResampleAxis const *axis, double center, double scale, float *weights)
+{
+        double support = LANCZOS_LOBES * scale;
+        int low = (int)floor(center - support) + 1;
+        if (low < 0)
+                low = 0;
+        if ((unsigned int)low + axis->n_taps > axis->source_size)
+                low = (int)(axis->source_size - axis->n_taps);
+
+        double sum = 0.0;
+        for (unsigned int k = 0; k < axis->n_taps; k++) {
+                double weight = Lanczos((low + k - center) / scale);
+                weights[k] = (float)weight;
+                sum += weight;
+        }
+
+        for (unsigned int k = 0; k < axis->n_taps; k++)
+                weights[k] = (float)(weights[k] / sum);
+
+        return (unsigned int)low;
+}
+
+/* Sets up AXIS for resampling SOURCE_SIZE pixels to SIZE pixels.  Returns
+ * 0 if we run out of memory. */
+static int
+ResampleAxisInit(ResampleAxis *axis, unsigned int source_size, unsigned int size)
+{
+        axis->source_size = source_size;
+        axis->size = size;
+
+        double ratio = (double)source_size / size;
+        double scale = ratio > 1.0 ? ratio : 1.0;
+        axis->n_taps = ResampleAxisTaps(axis, scale);
+
+        axis->first = (unsigned int *)malloc(size * sizeof(*axis->first));
+        axis->weights = (float *)malloc(size * axis->n_taps * sizeof(*axis->weights));
+        if (axis->first == NULL || axis->weights == NULL)
+                return 0;
+
+        for (unsigned int i = 0; i < size; i++) {
+                float *weights = axis->weights + i * axis->n_taps;
+
+                if (source_size % size == 0) {
+                        axis->first[i] = i * axis->n_taps;
+                        for (unsigned int k = 0; k < axis->n_taps; k++)
+                                weights[k] = 1.0f / axis->n_taps;
+                } else {
+                        axis->first[i] = ResampleAxisWeigh(axis, (i + 0.5) * ratio - 0.5, scale, weights);
+                }
+        }
+
+        return 1;
+}
+
+static void
+ResampleAxisFinalize(ResampleAxis *axis)
+{
+        free(axis->first);
+        free(axis->weights);
+}
+
+/* Creates a Resampler for resampling pixels from SOURCE_WIDTH by
+ * SOURCE_HEIGHT to WIDTH by HEIGHT.  Returns NULL if any of them is zero
+ * or if we run out of memory. */
+Resampler *
+ResamplerNew(unsigned int source_width, unsigned int source_height, unsigned int width, unsigned int height)
+{
+        if (source_width == 0 || source_height == 0 || width == 0 || height == 0)
+                return NULL;
+
+        Resampler *resampler = (Resampler *)calloc(1, sizeof(*resampler));
+        if (resampler == NULL)
+                return NULL;
+
+        if (!ResampleAxisInit(&resampler->x, source_width, width) ||
+            !ResampleAxisInit(&resampler->y, source_height, height)) {
+                ResamplerFree(resampler);
+                return NULL;
+        }
+
+        return resampler;
+}
+
+void
+ResamplerFree(Resampler *resampler)
+{
+        if (resampler == NULL)
+                return;
+
+        ResampleAxisFinalize(&resampler->x);
+        ResampleAxisFinalize(&resampler->y);
+        free(resampler);
+}
+
+/* Determines whether RESAMPLER resamples from SOURCE_WIDTH by SOURCE_HEIGHT
+ * to WIDTH by HEIGHT. */
+int
+ResamplerMatches(Resampler const *resampler, unsigned int source_width, unsigned int source_height,
+                 unsigned int width, unsigned int height)
+{
+        return resampler->x.source_size == source_width && resampler->y.source_size == source_height &&
+               resampler->x.size == width && resampler->y.size == height;
+}
+
+#ifdef RESAMPLE_HAVE_SSE2
+/* Stores the premultiplied PIXEL into SAMPLE. */
+static inline void
+SampleLoad(float *sample, PixelsARGB pixel)
+{
+        __m128i const zero = _mm_setzero_si128();
+        __m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)pixel), zero), zero);
+
+        _mm_storeu_ps(sample, _mm_cvtepi32_ps(channels));
+}
+
+/* Filters the N_TAPS samples at SAMPLES, STEP floats apart, by WEIGHTS
+ * into SAMPLE. */
+static inline void
+SampleFilter(float *sample, float const *samples, unsigned int step, float const *weights, unsigned int n_taps)
+{
+        __m128 sum = _mm_setzero_ps();
+        for (unsigned int k = 0; k < n_taps; k++, samples += step)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(samples), _mm_set1_ps(weights[k])));
+
+        _mm_storeu_ps(sample, sum);
+}
+
+/* Gets the premultiplied pixel of SAMPLE.  Filters with negative lobes
+ * may overshoot, so the alpha value is clamped to [0, 255] and the colors
+ * to [0, alpha], which keeps the pixel a valid premultiplied one. */
+static inline PixelsARGB
+SampleStore(float const *sample)
+{
+        float alpha = sample[3] < 0.0f ? 0.0f : sample[3] > 255.0f ? 255.0f : sample[3];
+
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(sample), _mm_setzero_ps()), _mm_set1_ps(alpha));
+        __m128i channels = _mm_cvttps_epi32(_mm_add_ps(value, _mm_set1_ps(0.5f)));
+        channels = _mm_packs_epi32(channels, channels);
+
+        return (PixelsARGB)_mm_cvtsi128_si32(_mm_packus_epi16(channels, channels));
+}
+#else
+static inline void
+SampleLoad(float *sample, PixelsARGB pixel)
+{
+        for (unsigned int c = 0; c < 4; c++)
+                sample[c] = (float)((pixel >> (8 * c)) & 0xff);
+}
+
+static inline void
+SampleFilter(float *sample, float const *samples, unsigned int step, float const *weights, unsigned int n_taps)
+{
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (unsigned int k = 0; k < n_taps; k++, samples += step)
+                for (unsigned int c = 0; c < 4; c++)
+                        sum[c] += samples[c] * weights[k];
+
+        memcpy(sample, sum, sizeof(sum));
+}
+
+static inline PixelsARGB
+SampleStore(float const *sample)
+{
+        float alpha = sample[3] < 0.0f ? 0.0f : sample[3] > 255.0f ? 255.0f : sample[3];
+
+        PixelsARGB pixel = 0;
+        for (unsigned int c = 0; c < 4; c++) {
+                float value = sample[c] < 0.0f ? 0.0f : sample[c] > alpha ? alpha : sample[c];
+                pixel |= (PixelsARGB)(value + 0.5f) << (8 * c);
+        }
+
+        return pixel;
+}
+#endif
+
+/* Resamples the premultiplied pixels of SOURCE into DESTINATION, which
+ * are premultiplied as well, using RESAMPLER.  The rows of SOURCE and
+ * DESTINATION are SOURCE_STRIDE and DESTINATION_STRIDE bytes apart.  Returns 0 if we run out of memory. */
+int
+ResamplerRun(Resampler const *resampler, PixelsARGB *destination, int destination_stride,
+             PixelsARGB const *source, int source_stride)
+{
+        ResampleAxis const *x = &resampler->x;
+        ResampleAxis const *y = &resampler->y;
+
+        float *row = (float *)malloc(x->source_size * 4 * sizeof(float));
+        float *columns = (float *)malloc(y->source_size * x->size * 4 * sizeof(float));
+        if (row == NULL || columns == NULL) {
+                free(row);
+                free(columns);
+                return 0;
+        }
+
+        for (unsigned int j = 0; j < y->source_size; j++) {
+                PixelsARGB const *pixels = (PixelsARGB const *)((char const *)source + (long)j * source_stride);
+                for (unsigned int i = 0; i < x->source_size; i++)
+                        SampleLoad(row + 4 * i, pixels[i]);
+
+                float *filtered = columns + j * x->size * 4;
+                for (unsigned int i = 0; i < x->size; i++)
+                        SampleFilter(filtered + 4 * i, row + 4 * x->first[i], 4,
+                                     x->weights + i * x->n_taps, x->n_taps);
+        }
+
+        for (unsigned int j = 0; j < y->size; j++) {
+                PixelsARGB *pixels = (PixelsARGB *)((char *)destination + (long)j * destination_stride);
+                float const *first = columns + y->first[j] * x->size * 4;
+                float const *weights = y->weights + j * y->n_taps;
+
+                for (unsigned int i = 0; i < x->size; i++) {
+                        float sample[4];
+                        SampleFilter(sample, first + 4 * i, x->size * 4, weights, y->n_taps);
+                        pixels[i] = SampleStore(sample);
+                }
+        }
+
+        free(row);
+        free(columns);
+
+        return 1;
+}
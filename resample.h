@@ -0,0 +1,13 @@
+﻿/* A resampler of 32-bit premultiplied ARGB pixels from one size to
+ * another.  Its filter weights are worked out once when it’s created, so
+ * that it may be used over and over again, also from several threads at
+ * once.  Like the pixel kernels, it only depends on the C runtime. */
+typedef struct _Resampler Resampler;
+
+Resampler *ResamplerNew(unsigned int source_width, unsigned int source_height,
+                        unsigned int width, unsigned int height);
+void ResamplerFree(Resampler *resampler);
+int ResamplerMatches(Resampler const *resampler, unsigned int source_width, unsigned int source_height,
+                     unsigned int width, unsigned int height);
+int ResamplerRun(Resampler const *resampler, PixelsARGB *destination, int destination_stride,
+                 PixelsARGB const *source, int source_stride);
@@ -0,0 +1,277 @@
+﻿#ifdef _MSC_VER
+#  include "stdafx.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "shelfpack.h"
+
+/* A span of released room on a shelf, starting at X and WIDTH wide. */
+typedef struct _ShelfSpan ShelfSpan;
+
+struct _ShelfSpan
+{
+        unsigned int x;
+        unsigned int width;
+};
+
+/* A shelf starting at Y and HEIGHT tall.  Rectangles are appended at
+ * END, and SPANS holds the N_SPANS spans of released room before END,
+ * ordered by x-coordinate and never adjacent to each other. */
+typedef struct _Shelf Shelf;
+
+struct _Shelf
+{
+        unsigned int y;
+        unsigned int height;
+        unsigned int end;
+        ShelfSpan *spans;
+        unsigned int n_spans;
+        unsigned int n_allocated_spans;
+};
+
+/* WIDTH and HEIGHT are the size of the area being packed, TOP is where
+ * the next shelf goes, and USED is the area taken up by the rectangles
+ * currently packed. */
+struct _ShelfPacker
+{
+        unsigned int width;
+        unsigned int height;
+        unsigned int top;
+        Shelf *shelves;
+        unsigned int n_shelves;
+        unsigned int n_allocated_shelves;
+        unsigned long used;
+};
+
+/* Creates a ShelfPacker for an area WIDTH by HEIGHT.  Returns NULL if we
+ * run out of memory. */
+ShelfPacker *
+ShelfPackerNew(unsigned int width, unsigned int height)
+{
+        ShelfPacker *packer = (ShelfPacker *)calloc(1, sizeof(*packer));
+        if (packer == NULL)
+                return NULL;
+
+        packer->width = width;
+        packer->height = height;
+
+        return packer;
+}
+
+void
+ShelfPackerFree(ShelfPacker *packer)
+{
+        if (packer == NULL)
+                return;
+
+        for (unsigned int i = 0; i < packer->n_shelves; i++)
+                free(packer->shelves[i].spans);
+        free(packer->shelves);
+        free(packer);
+}
+
+/* Finds the span of SHELF with room for WIDTH, returning its index, or
+ * N_SPANS if there’s none. */
+static unsigned int
+ShelfFindSpan(Shelf const *shelf, unsigned int width)
+{
+        unsigned int i = 0;
+        while (i < shelf->n_spans && shelf->spans[i].width < width)
+                i++;
+
+        return i;
+}
+
+/* Determines whether SHELF has room for WIDTH in a packer WIDE pixels
+ * wide. */
+static int
+ShelfHasRoom(Shelf const *shelf, unsigned int width, unsigned int wide)
+{
+        return ShelfFindSpan(shelf, width) < shelf->n_spans || shelf->end + width <= wide;
+}
+
+/* Takes WIDTH of the room on SHELF, preferring released room over the
+ * room at its end.  SHELF must have room for it. */
+static unsigned int
+ShelfTake(Shelf *shelf, unsigned int width)
+{
+        unsigned int i = ShelfFindSpan(shelf, width);
+        if (i == shelf->n_spans) {
+                unsigned int x = shelf->end;
+                shelf->end += width;
+                return x;
+        }
+
+        ShelfSpan *span = &shelf->spans[i];
+        unsigned int x = span->x;
+        span->x += width;
+        span->width -= width;
+        if (span->width == 0) {
+                memmove(span, span + 1, (shelf->n_spans - i - 1) * sizeof(*span));
+                shelf->n_spans--;
+        }
+
+        return x;
+}
+
+/* Adds a shelf HEIGHT tall at the top of PACKER.  Returns NULL if there’s
+ * no room for it or if we run out of memory. */
+static Shelf *
+ShelfPackerAddShelf(ShelfPacker *packer, unsigned int height)
+{
+        if (packer->top + height > packer->height)
+                return NULL;
+
+        if (packer->n_shelves == packer->n_allocated_shelves) {
+                unsigned int n = packer->n_allocated_shelves == 0 ? 8 : packer->n_allocated_shelves * 2;
+                Shelf *shelves = (Shelf *)realloc(packer->shelves, n * sizeof(*shelves));
+                if (shelves == NULL)
+                        return NULL;
+                packer->shelves = shelves;
+                packer->n_allocated_shelves = n;
+        }
+
+        Shelf *shelf = &packer->shelves[packer->n_shelves++];
+        memset(shelf, 0, sizeof(*shelf));
+        shelf->y = packer->top;
+        shelf->height = height;
+        packer->top += height;
+
+        return shelf;
+}
+
+/* Packs a rectangle WIDTH by HEIGHT into PACKER, storing its place in
+ * SLOT.  The shelf wasting the least height on it is used, a new one
+ * being added only if no shelf has room.  Returns 0 if there’s no room
+ * for it left, in which case the packer may be made taller with
+ * ShelfPackerGrow(). */
+int
+ShelfPackerAlloc(ShelfPacker *packer, unsigned int width, unsigned int height, ShelfSlot *slot)
+{
+        if (width == 0 || height == 0 || width > packer->width)
+                return 0;
+
+        Shelf *best = NULL;
+        for (unsigned int i = 0; i < packer->n_shelves; i++) {
+                Shelf *shelf = &packer->shelves[i];
+                if (shelf->height >= height && (best == NULL || shelf->height < best->height) &&
+                    ShelfHasRoom(shelf, width, packer->width))
+                        best = shelf;
+        }
+
+        if (best == NULL)
+                best = ShelfPackerAddShelf(packer, height);
+        if (best == NULL)
+                return 0;
+
+        slot->x = ShelfTake(best, width);
+        slot->y = best->y;
+        slot->width = width;
+        slot->height = height;
+        packer->used += (unsigned long)width * height;
+
+        return 1;
+}
+
+/* Finds the shelf of PACKER starting at Y. */
+static Shelf *
+ShelfPackerFindShelf(ShelfPacker *packer, unsigned int y)
+{
+        for (unsigned int i = 0; i < packer->n_shelves; i++)
+                if (packer->shelves[i].y == y)
+                        return &packer->shelves[i];
+
+        return NULL;
+}
+
+/* Gives the room at X, WIDTH wide, back to SHELF, merging it with the
+ * spans next to it.  Returns 0 if we run out of memory, in which case the
+ * room is lost until the packer is freed. */
+static int
+ShelfGiveBack(Shelf *shelf, unsigned int x, unsigned int width)
+{
+        unsigned int i = 0;
+        while (i < shelf->n_spans && shelf->spans[i].x < x)
+                i++;
+
+        int joins_previous = i > 0 && shelf->spans[i - 1].x + shelf->spans[i - 1].width == x;
+        int joins_next = i < shelf->n_spans && x + width == shelf->spans[i].x;
+
+        if (joins_previous && joins_next) {
+                shelf->spans[i - 1].width += width + shelf->spans[i].width;
+                memmove(&shelf->spans[i], &shelf->spans[i + 1], (shelf->n_spans - i - 1) * sizeof(ShelfSpan));
+                shelf->n_spans--;
+        } else if (joins_previous) {
+                shelf->spans[i - 1].width += width;
+        } else if (joins_next) {
+                shelf->spans[i].x = x;
+                shelf->spans[i].width += width;
+        } else {
+                if (shelf->n_spans == shelf->n_allocated_spans) {
+                        unsigned int n = shelf->n_allocated_spans == 0 ? 4 : shelf->n_allocated_spans * 2;
+                        ShelfSpan *spans = (ShelfSpan *)realloc(shelf->spans, n * sizeof(*spans));
+                        if (spans == NULL)
+                                return 0;
+                        shelf->spans = spans;
+                        shelf->n_allocated_spans = n;
+                }
+
+                memmove(&shelf->spans[i + 1], &shelf->spans[i], (shelf->n_spans - i) * sizeof(ShelfSpan));
+                shelf->spans[i].x = x;
+                shelf->spans[i].width = width;
+                shelf->n_spans++;
+        }
+
+        /* Room released at the end of the shelf goes back to its end. */
+        ShelfSpan *last = &shelf->spans[shelf->n_spans - 1];
+        if (last->x + last->width == shelf->end) {
+                shelf->end = last->x;
+                shelf->n_spans--;
+        }
+
+        return 1;
+}
+
+/* Releases the room of the rectangle packed into SLOT of PACKER, so that
+ * it may be reused.  Empty shelves at the top are removed, so that their
+ * room may be used for shelves of other heights. */
+void
+ShelfPackerRelease(ShelfPacker *packer, ShelfSlot const *slot)
+{
+        Shelf *shelf = ShelfPackerFindShelf(packer, slot->y);
+        if (shelf == NULL || !ShelfGiveBack(shelf, slot->x, slot->width))
+                return;
+
+        packer->used -= (unsigned long)slot->width * slot->height;
+
+        while (packer->n_shelves > 0 && packer->shelves[packer->n_shelves - 1].end == 0) {
+                Shelf *top = &packer->shelves[--packer->n_shelves];
+                packer->top = top->y;
+                free(top->spans);
+        }
+}
+
+/* Makes the area packed by PACKER HEIGHT tall. */
+void
+ShelfPackerGrow(ShelfPacker *packer, unsigned int height)
+{
+        if (height > packer->height)
+                packer->height = height;
+}
+
+/* Gets the height of the area packed by PACKER. */
+unsigned int
+ShelfPackerHeight(ShelfPacker const *packer)
+{
+        return packer->height;
+}
+
+/* Gets the area USED by packed rectangles and the area RESERVED by
+ * shelves, the difference being lost to fragmentation. */
+void
+ShelfPackerUsage(ShelfPacker const *packer, unsigned long *used, unsigned long *reserved)
+{
+        *used = packer->used;
+        *reserved = (unsigned long)packer->width * packer->top;
+}
@@ -0,0 +1,25 @@
+﻿/* A packer of rectangles into an area of a fixed width that may be made
+ * taller.  Rectangles are placed side by side on shelves, each as tall
+ * as the first rectangle placed on it, and the room of released
+ * rectangles is reused by later ones.  Like the pixel kernels, it only
+ * depends on the C runtime. */
+typedef struct _ShelfPacker ShelfPacker;
+
+/* The place of a rectangle packed by a ShelfPacker. */
+typedef struct _ShelfSlot ShelfSlot;
+
+struct _ShelfSlot
+{
+        unsigned int x;
+        unsigned int y;
+        unsigned int width;
+        unsigned int height;
+};
+
+ShelfPacker *ShelfPackerNew(unsigned int width, unsigned int height);
+void ShelfPackerFree(ShelfPacker *packer);
+int ShelfPackerAlloc(ShelfPacker *packer, unsigned int width, unsigned int height, ShelfSlot *slot);
+void ShelfPackerRelease(ShelfPacker *packer, ShelfSlot const *slot);
+void ShelfPackerGrow(ShelfPacker *packer, unsigned int height);
+unsigned int ShelfPackerHeight(ShelfPacker const *packer);
+void ShelfPackerUsage(ShelfPacker const *packer, unsigned long *used, unsigned long *reserved);
@@ -0,0 +1,74 @@
+﻿#include <stdlib.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "iconstore.h"
+#include "test.h"
+
+/* Times putting together a file of icons and looking icons up in it, as
+ * the disk cache does when starting up and for every icon it delivers,
+ * for files of more and more icons.  With icons indexed by their keys,
+ * the time per icon should stay the same however many there are. */
+
+#define N_LOOKUPS       200000
+
+static int
+MakeKey(char *key, unsigned int i)
+{
+        return sprintf(key, "C:\\Program Files\\app%u.exe|Class%u|16x16", i, i % 7);
+}
+
+static void
+Bench(unsigned int n_icons)
+{
+        PixelsARGB pixels[16 * 16];
+        memset(pixels, 0xff, sizeof(pixels));
+        char key[64];
+
+        double start = TestNow();
+        IconStoreWriter *writer = IconStoreWriterNew();
+        CHECK(writer != NULL);
+        for (unsigned int i = 0; i < n_icons; i++)
+                CHECK(IconStoreWriterAdd(writer, key, MakeKey(key, i), 16, 16, pixels));
+        double add = (TestNow() - start) / n_icons;
+
+        start = TestNow();
+        for (unsigned int i = 0; i < N_LOOKUPS; i++)
+                CHECK(IconStoreWriterHas(writer, key, MakeKey(key, i % n_icons)));
+        double has = (TestNow() - start) / N_LOOKUPS;
+
+        void *data;
+        size_t size;
+        CHECK(IconStoreWriterFinish(writer, &data, &size));
+        IconStoreWriterFree(writer);
+
+        start = TestNow();
+        IconStore *store = IconStoreOpen(data, size);
+        CHECK(store != NULL);
+        double open = TestNow() - start;
+
+        start = TestNow();
+        for (unsigned int i = 0; i < N_LOOKUPS; i++) {
+                unsigned int width, height;
+                PixelsARGB const *found;
+                CHECK(IconStoreLookup(store, key, MakeKey(key, i % n_icons), &width, &height, &found));
+        }
+        double lookup = (TestNow() - start) / N_LOOKUPS;
+
+        IconStoreClose(store);
+        free(data);
+
+        printf("  %5u icons: add %5.2f us, has %5.2f us, open %7.1f us, lookup %5.2f us\n",
+               n_icons, add * 1e6, has * 1e6, open * 1e6, lookup * 1e6);
+}
+
+int
+main(void)
+{
+        Bench(10);
+        Bench(100);
+        Bench(1000);
+        Bench(10000);
+
+        return EXIT_SUCCESS;
+}
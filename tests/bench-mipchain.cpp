@@ -0,0 +1,93 @@
+﻿#include "pixels.h"
+#include "resample.h"
+#include "mipchain.h"
+#include "test.h"
+
+/* Times drawing icons at the sizes they’re drawn at for scale factors from
+ * 100% to 300%, resampling the level of a MipChain picked for each size,
+ * against resampling the icon as it came for each, and how long building
+ * the chain takes.  Resamplers are kept for each pair of sizes, as
+ * windowicon.cpp keeps them. */
+
+#define N_PIXELS        (1 << 22)
+
+static unsigned int const s_source_sizes[] = { 32, 48, 256 };
+static unsigned int const s_sizes[] = { 16, 20, 24, 32, 40, 48 };
+
+#define N_SIZES         (sizeof(s_sizes) / sizeof(s_sizes[0]))
+
+/* Resamples SOURCE, WIDTH by HEIGHT, to SIZE by SIZE N_ROUNDS times with
+ * *RESAMPLER, creating it if it’s NULL, and returns the seconds taken per
+ * round. */
+static double
+Draw(Resampler **resampler, PixelsARGB const *source, unsigned int width, unsigned int height,
+     PixelsARGB *destination, unsigned int size, unsigned int n_rounds)
+{
+        if (*resampler == NULL) {
+                *resampler = ResamplerNew(width, height, size, size);
+                CHECK(*resampler != NULL);
+        }
+
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++)
+                CHECK(ResamplerRun(*resampler, destination, size * sizeof(PixelsARGB),
+                                   source, width * sizeof(PixelsARGB)));
+
+        return (TestNow() - start) / n_rounds;
+}
+
+static void
+Bench(unsigned int source_size)
+{
+        PixelsARGB *source = new PixelsARGB[source_size * source_size];
+        PixelsARGB *destination = new PixelsARGB[48 * 48];
+        unsigned int n_rounds = N_PIXELS / (source_size * source_size);
+
+        unsigned int state = source_size;
+        for (unsigned int i = 0; i < source_size * source_size; i++)
+                source[i] = TestRandom(&state) ^ (TestRandom(&state) << 16);
+        PixelsPremultiply(source, source, source_size * source_size);
+
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++)
+                MipChainFree(MipChainNew(source_size, source_size, source, 16, 16));
+        double built = (TestNow() - start) / n_rounds;
+
+        MipChain *chain = MipChainNew(source_size, source_size, source, 16, 16);
+        CHECK(chain != NULL);
+        printf("  %3u: chain of %d levels, %lu bytes, built in %.2f us\n", source_size,
+               MipChainLength(chain), MipChainBytes(chain), built * 1e6);
+
+        for (unsigned int s = 0; s < N_SIZES; s++) {
+                unsigned int size = s_sizes[s];
+                Resampler *direct = NULL;
+                Resampler *from_level = NULL;
+
+                double whole = Draw(&direct, source, source_size, source_size,
+                                    destination, size, n_rounds);
+
+                unsigned int width, height;
+                int level = MipChainPick(chain, size, size);
+                PixelsARGB const *pixels = MipChainLevel(chain, level, &width, &height);
+                double picked = Draw(&from_level, pixels, width, height, destination, size, n_rounds);
+
+                printf("  %3u -> %2u: %7.2f us from the icon, %7.2f us from level %d (%ux%u)\n",
+                       source_size, size, whole * 1e6, picked * 1e6, level, width, height);
+
+                ResamplerFree(from_level);
+                ResamplerFree(direct);
+        }
+
+        MipChainFree(chain);
+        delete[] destination;
+        delete[] source;
+}
+
+int
+main(void)
+{
+        for (unsigned int s = 0; s < sizeof(s_source_sizes) / sizeof(s_source_sizes[0]); s++)
+                Bench(s_source_sizes[s]);
+
+        return EXIT_SUCCESS;
+}
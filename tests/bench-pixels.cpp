@@ -0,0 +1,305 @@
+﻿#include <string.h>
+
+#include "pixels.h"
+#include "test.h"
+
+/* Times turning the colors and the 1-bit mask of an icon into 32-bit
+ * ARGB pixels, checking for alpha values and applying the mask if there
+ * are none, with the pixel kernels at every level the processor supports
+ * against the per-pixel callbacks that were used before them, which are
+ * reimplemented here as BitmapIterate() and BitmapCopyWithMaskIterator()
+ * were.  Also times converting rows of each format without alpha values
+ * into ARGB with the converters against getting their pixels one at a
+ * time, as NonAlphaBitmapIterate() did.  GetPixel() is stood in for by a
+ * function decoding the pixel, so the per-pixel versions are timed at
+ * their best; on Windows, each call also went through GDI+. */
+
+#define N_PIXELS        (1 << 22)
+
+typedef enum {
+        IterationContinue,
+        IterationStop,
+} IterationState;
+
+typedef struct _Point Point;
+
+struct _Point
+{
+        unsigned int x;
+        unsigned int y;
+};
+
+typedef int (*BitmapIterator)(Point, PixelsARGB, void *, IterationState *);
+
+typedef struct _Icon Icon;
+
+struct _Icon
+{
+        unsigned int size;
+        PixelsARGB *color;
+        unsigned char *mask;
+        unsigned int mask_stride;
+        PixelsARGB *pixels;
+};
+
+/* The iterators are called through here, so that they’re called through
+ * a pointer, as they were from another translation unit. */
+static BitmapIterator volatile s_has_alpha_iterator;
+static BitmapIterator volatile s_copy_with_mask_iterator;
+
+static int
+BitmapIterate(Icon *icon, BitmapIterator iterator, void *closure)
+{
+        IterationState state = IterationContinue;
+
+        for (unsigned int y = 0; y < icon->size; y++) {
+                PixelsARGB *row = icon->color + y * icon->size;
+                for (unsigned int x = 0; x < icon->size; x++) {
+                        Point point = { x, y };
+                        int status = iterator(point, row[x], closure, &state);
+                        if (status != 0)
+                                return status;
+                        if (state == IterationStop)
+                                return 0;
+                }
+        }
+
+        return 0;
+}
+
+static int
+BitmapHasAlphaIterator(Point point, PixelsARGB pixel, void *closure, IterationState *state)
+{
+        (void)point;
+
+        PixelsARGB alpha = pixel & 0xff000000;
+        if (alpha == 0x00000000 || alpha == 0xff000000)
+                return 0;
+
+        *(int *)closure = 1;
+        *state = IterationStop;
+
+        return 0;
+}
+
+static int
+BitmapCopyWithMaskIterator(Point point, PixelsARGB pixel, void *closure, IterationState *state)
+{
+        (void)state;
+
+        Icon *icon = (Icon *)closure;
+        int visible = !((icon->mask[point.y * icon->mask_stride + point.x / 8] >> (7 - point.x % 8)) & 1);
+        icon->pixels[point.y * icon->size + point.x] = (pixel & 0x00ffffff) | (visible ? 0xff000000 : 0);
+
+        return 0;
+}
+
+static void
+ConvertWithCallbacks(Icon *icon)
+{
+        int has_alpha = 0;
+        CHECK(BitmapIterate(icon, s_has_alpha_iterator, &has_alpha) == 0);
+        CHECK(!has_alpha);
+        CHECK(BitmapIterate(icon, s_copy_with_mask_iterator, icon) == 0);
+}
+
+static void
+ConvertWithKernels(Icon *icon)
+{
+        unsigned int n = icon->size * icon->size;
+        CHECK(!PixelsHaveAlpha(icon->color, n));
+
+        unsigned char alpha[256];
+        for (unsigned int y = 0; y < icon->size; y++) {
+                PixelsExpandMask(alpha, icon->mask + y * icon->mask_stride, icon->size);
+                PixelsSetAlpha(icon->pixels + y * icon->size, icon->color + y * icon->size, alpha, icon->size);
+        }
+}
+
+static double
+Time(void (*convert)(Icon *), Icon *icon)
+{
+        unsigned int n_rounds = N_PIXELS / (icon->size * icon->size);
+
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++)
+                convert(icon);
+
+        return (TestNow() - start) / n_rounds;
+}
+
+static void
+Bench(unsigned int size)
+{
+        Icon icon;
+        icon.size = size;
+        icon.color = new PixelsARGB[size * size];
+        icon.mask_stride = (size + 15) / 16 * 2;
+        icon.mask = new unsigned char[icon.mask_stride * size];
+        icon.pixels = new PixelsARGB[size * size];
+
+        unsigned int state = size;
+        for (unsigned int i = 0; i < size * size; i++)
+                icon.color[i] = TestRandom(&state) & 0x00ffffff;
+        for (unsigned int i = 0; i < icon.mask_stride * size; i++)
+                icon.mask[i] = (unsigned char)TestRandom(&state);
+
+        double callbacks = Time(ConvertWithCallbacks, &icon);
+        PixelsARGB *expected = new PixelsARGB[size * size];
+        memcpy(expected, icon.pixels, size * size * sizeof(*expected));
+
+        printf("  %3ux%-3u icon: callbacks %8.2f us", size, size, callbacks * 1e6);
+        for (int level = PIXELS_SCALAR; level <= PixelsSupportedLevel(); level++) {
+                CHECK(PixelsUseLevel((PixelsLevel)level));
+                memset(icon.pixels, 0, size * size * sizeof(*icon.pixels));
+                double kernels = Time(ConvertWithKernels, &icon);
+                CHECK(memcmp(icon.pixels, expected, size * size * sizeof(*expected)) == 0);
+                printf(", level %d %6.2f us", level, kernels * 1e6);
+        }
+        printf("\n");
+
+        delete[] expected;
+        delete[] icon.pixels;
+        delete[] icon.mask;
+        delete[] icon.color;
+}
+
+/* Gets pixel X of ROW, as GetPixel() would for each format. */
+typedef PixelsARGB (*GetPixelFunc)(unsigned char const *row, PixelsARGB const *palette, unsigned int x);
+
+static PixelsARGB
+GetPixel4(unsigned char const *row, PixelsARGB const *palette, unsigned int x)
+{
+        return palette[(row[x / 2] >> (x % 2 == 0 ? 4 : 0)) & 0x0f];
+}
+
+static PixelsARGB
+GetPixel8(unsigned char const *row, PixelsARGB const *palette, unsigned int x)
+{
+        return palette[row[x]];
+}
+
+static PixelsARGB
+GetPixel565(unsigned char const *row, PixelsARGB const *palette, unsigned int x)
+{
+        (void)palette;
+
+        unsigned int value = row[2 * x] | row[2 * x + 1] << 8;
+        unsigned int r = (value >> 11) & 0x1f, g = (value >> 5) & 0x3f, b = value & 0x1f;
+
+        return 0xff000000 | ((r << 3) | (r >> 2)) << 16 | ((g << 2) | (g >> 4)) << 8 | ((b << 3) | (b >> 2));
+}
+
+static PixelsARGB
+GetPixel24(unsigned char const *row, PixelsARGB const *palette, unsigned int x)
+{
+        (void)palette;
+
+        return 0xff000000 | row[3 * x + 2] << 16 | row[3 * x + 1] << 8 | row[3 * x];
+}
+
+static GetPixelFunc volatile s_get_pixel;
+
+static double
+TimeGetPixel(GetPixelFunc get_pixel, unsigned char const *source, unsigned int stride,
+             PixelsARGB const *palette, PixelsARGB *pixels, unsigned int size)
+{
+        unsigned int n_rounds = N_PIXELS / (size * size);
+        s_get_pixel = get_pixel;
+
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++)
+                for (unsigned int y = 0; y < size; y++)
+                        for (unsigned int x = 0; x < size; x++)
+                                pixels[y * size + x] = s_get_pixel(source + y * stride, palette, x);
+
+        return (TestNow() - start) / n_rounds;
+}
+
+static double
+TimeConverter(unsigned int format, unsigned char const *source, unsigned int stride,
+              PixelsARGB const *palette, PixelsARGB *pixels, unsigned int size)
+{
+        unsigned int n_rounds = N_PIXELS / (size * size);
+
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++) {
+                for (unsigned int y = 0; y < size; y++) {
+                        unsigned char const *row = source + y * stride;
+                        switch (format) {
+                        case 565:
+                                PixelsFromRGB565(pixels + y * size, (unsigned short const *)row, size);
+                                break;
+                        case 24:
+                                PixelsFromRGB24(pixels + y * size, row, size);
+                                break;
+                        default:
+                                PixelsFromIndexed(pixels + y * size, row, format, palette, size);
+                                break;
+                        }
+                }
+        }
+
+        return (TestNow() - start) / n_rounds;
+}
+
+static void
+BenchConverters(unsigned int size)
+{
+        static struct {
+                unsigned int format;
+                char const *name;
+                unsigned int bits_per_pixel;
+                GetPixelFunc get_pixel;
+        } const formats[] = {
+                { 4, "4-bit", 4, GetPixel4 },
+                { 8, "8-bit", 8, GetPixel8 },
+                { 565, "565", 16, GetPixel565 },
+                { 24, "24-bit", 24, GetPixel24 },
+        };
+
+        unsigned int stride = (size * 24 + 31) / 32 * 4;
+        unsigned char *source = new unsigned char[stride * size];
+        PixelsARGB *expected = new PixelsARGB[size * size];
+        PixelsARGB *pixels = new PixelsARGB[size * size];
+        PixelsARGB palette[256];
+
+        unsigned int state = size;
+        for (unsigned int i = 0; i < stride * size; i++)
+                source[i] = (unsigned char)TestRandom(&state);
+        for (unsigned int i = 0; i < 256; i++)
+                palette[i] = 0xff000000 | TestRandom(&state);
+
+        CHECK(PixelsUseLevel(PixelsSupportedLevel()));
+        for (unsigned int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+                unsigned int format_stride = (size * formats[f].bits_per_pixel + 31) / 32 * 4;
+                double get_pixel = TimeGetPixel(formats[f].get_pixel, source, format_stride, palette,
+                                                expected, size);
+                double converter = TimeConverter(formats[f].format, source, format_stride, palette,
+                                                 pixels, size);
+                CHECK(memcmp(pixels, expected, size * size * sizeof(*pixels)) == 0);
+                printf("  %3ux%-3u %-6s icon: per pixel %8.2f us, converter %6.2f us\n",
+                       size, size, formats[f].name, get_pixel * 1e6, converter * 1e6);
+        }
+
+        delete[] pixels;
+        delete[] expected;
+        delete[] source;
+}
+
+int
+main(void)
+{
+        s_has_alpha_iterator = BitmapHasAlphaIterator;
+        s_copy_with_mask_iterator = BitmapCopyWithMaskIterator;
+
+        Bench(16);
+        Bench(32);
+        Bench(48);
+        Bench(256);
+
+        BenchConverters(32);
+        BenchConverters(256);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Times bringing a window list up to date for a desktop where only a
+ * few windows changed since the list was last built, by refreshing the
+ * list, against building it from scratch as was done for every popup
+ * before items were reused.  Both include measuring the list, as the
+ * popup does.  Titles and icons of made-up windows cost next to nothing,
+ * so the times only show the list’s own work; on a desktop, each of the
+ * icons counted may mean messaging another process. */
+
+#define N_ROUNDS        200
+
+/* Counted by the stand-in for windowicon.cpp. */
+extern UINT g_window_icon_news;
+
+static Font s_font(12.0f);
+
+/* Changes a few windows of FAKE, as between two popups: one is created,
+ * one destroyed, one retitled, and one raised. */
+static void
+Churn(FakeSource *fake, int round)
+{
+        HWND created = FakeSourceCreate(fake, NULL, 0, L"new window");
+        CHECK(created != NULL);
+
+        int n = FakeSourceLength(fake);
+        FakeSourceDestroy(fake, FakeSourceNth(fake, n - 1 - round % (n / 2)));
+
+        TCHAR title[32];
+        StringCchPrintf(title, _countof(title), L"retitled %d", round);
+        FakeSourceSetTitle(fake, FakeSourceNth(fake, round % (n - 1)), title);
+
+        FakeSourceRaise(fake, FakeSourceNth(fake, (round * 7) % (n - 1)));
+}
+
+static void
+Measure(WindowList *list)
+{
+        Graphics graphics;
+        SizeF size;
+        CHECK(WindowListSize(list, &graphics, &size) == Ok);
+}
+
+static void
+Bench(int n_windows)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        for (int i = 0; i < n_windows; i++) {
+                TCHAR title[32];
+                StringCchPrintf(title, _countof(title), L"window %d", i);
+                CHECK(FakeSourceCreate(fake, NULL, 0, title) != NULL);
+        }
+
+        FakeSourceCountersReset(fake);
+        g_window_icon_news = 0;
+        double start = TestNow();
+        for (int round = 0; round < N_ROUNDS; round++) {
+                Churn(fake, round);
+                WindowList *list = WindowListNewFromSource(FakeSourceSource(fake), &s_font);
+                CHECK(list != NULL);
+                Measure(list);
+                WindowListFree(list);
+        }
+        double rebuild = (TestNow() - start) / N_ROUNDS;
+        FakeSourceCounters rebuild_counters;
+        FakeSourceCountersGet(fake, &rebuild_counters);
+        UINT rebuild_icons = g_window_icon_news;
+
+        WindowList *list = WindowListNewFromSource(FakeSourceSource(fake), &s_font);
+        CHECK(list != NULL);
+        Measure(list);
+
+        FakeSourceCountersReset(fake);
+        g_window_icon_news = 0;
+        WindowListDiff total = { 0, 0, 0 };
+        start = TestNow();
+        for (int round = 0; round < N_ROUNDS; round++) {
+                Churn(fake, round);
+                WindowListDiff diff;
+                WindowListRefresh(list, FakeSourceSource(fake), &diff);
+                Measure(list);
+                total.added += diff.added;
+                total.removed += diff.removed;
+                total.changed += diff.changed;
+        }
+        double refresh = (TestNow() - start) / N_ROUNDS;
+        FakeSourceCounters refresh_counters;
+        FakeSourceCountersGet(fake, &refresh_counters);
+        UINT refresh_icons = g_window_icon_news;
+
+        CHECK(total.added == N_ROUNDS && total.removed == N_ROUNDS);
+        CHECK(WindowListLength(list) == n_windows);
+        WindowListFree(list);
+        FakeSourceFree(fake);
+
+        printf("  %4d windows: rebuild %7.1f us, refresh %7.1f us (%.1fx); per round, "
+               "titles fetched %u vs %u, icons %u vs %u; %d added, %d removed, %d changed\n",
+               n_windows, rebuild * 1e6, refresh * 1e6, rebuild / refresh,
+               rebuild_counters.titles / N_ROUNDS, refresh_counters.titles / N_ROUNDS,
+               rebuild_icons / N_ROUNDS, refresh_icons / N_ROUNDS,
+               total.added, total.removed, total.changed);
+}
+
+int
+main(void)
+{
+        Bench(50);
+        Bench(500);
+        Bench(2000);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "recording.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Times profiling the window list against a recorded desktop, as
+ * /replay does: reading the recording, building the list from it, and
+ * getting the pixels of every window’s icon, against building the list
+ * from the made-up desktop that was recorded.  Icons are replayed as
+ * copies of their recorded pixels, so getting them costs a copy of
+ * 1 KB per window rather than creating and destroying GDI objects. */
+
+#define N_ROUNDS        20
+#define RECORDING_PATH  L"obj/bench-replay.dat"
+
+static Font s_font(12.0f);
+
+static double
+BuildList(WindowSource *source)
+{
+        double start = TestNow();
+        for (int round = 0; round < N_ROUNDS; round++) {
+                WindowList *list = WindowListNewFromSource(source, &s_font);
+                CHECK(list != NULL);
+                WindowListFree(list);
+        }
+
+        return (TestNow() - start) / N_ROUNDS;
+}
+
+static double
+GetIcons(FakeSource *fake, WindowSource *source)
+{
+        double start = TestNow();
+        for (int round = 0; round < N_ROUNDS; round++) {
+                for (int i = 0; i < FakeSourceLength(fake); i++) {
+                        WindowSourceIcon icon;
+                        BOOL was_hung;
+                        CHECK(WindowSourceSmallIcon(source, FakeSourceNth(fake, i), &icon, &was_hung));
+                        WindowSourceIconFree(&icon);
+                }
+        }
+
+        return (TestNow() - start) / N_ROUNDS;
+}
+
+static void
+Bench(int n_windows)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        for (int i = 0; i < n_windows; i++) {
+                TCHAR title[32];
+                StringCchPrintf(title, _countof(title), L"window %d", i);
+                CHECK(FakeSourceCreate(fake, NULL, 0, title) != NULL);
+        }
+
+        double start = TestNow();
+        CHECK(RecordingWrite(FakeSourceSource(fake), RECORDING_PATH));
+        double write = TestNow() - start;
+
+        UINT calls = g_win32_window_calls;
+
+        start = TestNow();
+        for (int round = 0; round < N_ROUNDS; round++) {
+                Recording *recording = RecordingRead(RECORDING_PATH);
+                CHECK(recording != NULL);
+                RecordingFree(recording);
+        }
+        double read = (TestNow() - start) / N_ROUNDS;
+
+        Recording *recording = RecordingRead(RECORDING_PATH);
+        CHECK(recording != NULL);
+        double replayed_list = BuildList(RecordingSource(recording));
+        double replayed_icons = GetIcons(fake, RecordingSource(recording));
+        RecordingFree(recording);
+
+        CHECK(g_win32_window_calls == calls);
+
+        double list = BuildList(FakeSourceSource(fake));
+        double icons = GetIcons(fake, FakeSourceSource(fake));
+
+        FakeSourceFree(fake);
+        CHECK(DeleteFile(RECORDING_PATH));
+
+        printf("  %4d windows: write %7.0f us, read %7.0f us; list %7.0f us replayed vs %7.0f us; "
+               "icons %7.0f us replayed vs %7.0f us\n",
+               n_windows, write * 1e6, read * 1e6, replayed_list * 1e6, list * 1e6,
+               replayed_icons * 1e6, icons * 1e6);
+}
+
+int
+main(void)
+{
+        Bench(50);
+        Bench(500);
+        Bench(2000);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+﻿#include "pixels.h"
+#include "resample.h"
+#include "test.h"
+
+/* Times resampling icons between the sizes they come in and the sizes
+ * they’re drawn at, with a Resampler kept for each pair of sizes, as
+ * windowicon.cpp keeps them, against working out the filter weights for
+ * each icon.  GDI+, which icons were scaled with before, can’t be run here;
+ * on Windows, scaling through it also meant creating a bitmap and a
+ * Graphics for every icon. */
+
+#define N_PIXELS        (1 << 22)
+
+static unsigned int const s_sizes[][2] = {
+        { 32, 16 }, { 48, 16 }, { 24, 16 }, { 20, 16 }, { 16, 24 }, { 48, 32 }, { 256, 32 }, { 256, 48 },
+};
+
+static void
+Bench(unsigned int source_size, unsigned int size)
+{
+        PixelsARGB *source = new PixelsARGB[source_size * source_size];
+        PixelsARGB *destination = new PixelsARGB[size * size];
+        unsigned int n_rounds = N_PIXELS / (source_size * source_size);
+
+        unsigned int state = source_size * size;
+        for (unsigned int i = 0; i < source_size * source_size; i++)
+                source[i] = TestRandom(&state) ^ (TestRandom(&state) << 16);
+        PixelsPremultiply(source, source, source_size * source_size);
+
+        Resampler *resampler = ResamplerNew(source_size, source_size, size, size);
+        CHECK(resampler != NULL);
+        double start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++)
+                CHECK(ResamplerRun(resampler, destination, size * sizeof(PixelsARGB),
+                                   source, source_size * sizeof(PixelsARGB)));
+        double kept = (TestNow() - start) / n_rounds;
+        ResamplerFree(resampler);
+
+        start = TestNow();
+        for (unsigned int round = 0; round < n_rounds; round++) {
+                resampler = ResamplerNew(source_size, source_size, size, size);
+                CHECK(resampler != NULL);
+                CHECK(ResamplerRun(resampler, destination, size * sizeof(PixelsARGB),
+                                   source, source_size * sizeof(PixelsARGB)));
+                ResamplerFree(resampler);
+        }
+        double created = (TestNow() - start) / n_rounds;
+
+        printf("  %3u -> %2u: %7.2f us per icon kept, %7.2f us created for each icon\n",
+               source_size, size, kept * 1e6, created * 1e6);
+
+        delete[] destination;
+        delete[] source;
+}
+
+int
+main(void)
+{
+        for (unsigned int s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); s++)
+                Bench(s_sizes[s][0], s_sizes[s][1]);
+
+        return EXIT_SUCCESS;
+}
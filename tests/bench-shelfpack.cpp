@@ -0,0 +1,55 @@
+﻿#include "shelfpack.h"
+#include "test.h"
+
+/* Times packing and releasing icons at random with a few hundred of them
+ * packed at a time, as windows come and go, for icons all of one size,
+ * as on a desktop at one DPI, and for icons of mixed sizes, and reports
+ * how much of the room reserved by shelves the icons use. */
+
+#define N_EDITS         2000000
+
+static void
+Bench(char const *name, unsigned int const *sizes, unsigned int n_sizes, unsigned int max_live)
+{
+        ShelfSlot *live = new ShelfSlot[max_live];
+        unsigned int n_live = 0;
+
+        ShelfPacker *packer = ShelfPackerNew(256, 256);
+        CHECK(packer != NULL);
+
+        unsigned int state = n_sizes;
+        double start = TestNow();
+        for (int edit = 0; edit < N_EDITS; edit++) {
+                if (n_live == 0 || (n_live < max_live && TestRandom(&state) % 2 == 0)) {
+                        unsigned int size = sizes[TestRandom(&state) % n_sizes];
+                        while (!ShelfPackerAlloc(packer, size, size, &live[n_live]))
+                                ShelfPackerGrow(packer, ShelfPackerHeight(packer) * 2);
+                        n_live++;
+                } else {
+                        unsigned int i = TestRandom(&state) % n_live;
+                        ShelfPackerRelease(packer, &live[i]);
+                        live[i] = live[--n_live];
+                }
+        }
+        double elapsed = TestNow() - start;
+
+        unsigned long used, reserved;
+        ShelfPackerUsage(packer, &used, &reserved);
+        printf("  %-5s icons: %5.1f ns per edit, %3.0f%% of reserved room used, %u pixels tall\n",
+               name, elapsed / N_EDITS * 1e9, 100.0 * used / reserved, ShelfPackerHeight(packer));
+
+        ShelfPackerFree(packer);
+        delete[] live;
+}
+
+int
+main(void)
+{
+        static unsigned int const uniform[] = { 16 };
+        static unsigned int const mixed[] = { 16, 16, 16, 16, 20, 24, 32, 48 };
+
+        Bench("16x16", uniform, 1, 200);
+        Bench("mixed", mixed, sizeof(mixed) / sizeof(mixed[0]), 200);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,353 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "fakesource.h"
+
+/* The handle of the Nth window created by a FakeSource.  Handles are
+ * never NULL and never reused. */
+#define FAKE_HWND(n)            ((HWND)(UINT_PTR)(0x10000 + 4 * (n)))
+#define FAKE_INDEX(window)      (((int)(UINT_PTR)(window) - 0x10000) / 4)
+
+/* The sizes of the small and big icons of windows. */
+#define FAKE_SMALL_ICON_DELTA   16
+#define FAKE_BIG_ICON_DELTA     32
+
+/* WINDOWS holds the N_WINDOWS windows created so far, by the order they
+ * were created in, and has room for N_ALLOCATED.  ORDER holds the
+ * indexes of the N_ORDER windows that haven’t been destroyed, top-most
+ * first.  ICONS_AT_ONCE counts the icons being gotten right now. */
+struct _FakeSource
+{
+        WindowSource source;
+        FakeWindow *windows;
+        int n_windows;
+        int n_allocated;
+        int *order;
+        int n_order;
+        HWND shell;
+        FakeSourceCounters counters;
+        UINT icons_at_once;
+};
+
+static BOOL
+FakeEnumerate(VOID *closure, WNDENUMPROC f, LPARAM lParam)
+{
+        FakeSource *fake = (FakeSource *)closure;
+
+        for (int i = 0; i < fake->n_order; i++)
+                if (!f(FAKE_HWND(fake->order[i]), lParam))
+                        break;
+
+        return TRUE;
+}
+
+static HWND
+FakeOwner(VOID *closure, HWND window)
+{
+        FakeWindow *fake_window = FakeSourceWindow((FakeSource *)closure, window);
+
+        return fake_window != NULL ? fake_window->owner : NULL;
+}
+
+static HWND
+FakeShell(VOID *closure)
+{
+        return ((FakeSource *)closure)->shell;
+}
+
+static BOOL
+FakeIsVisible(VOID *closure, HWND window)
+{
+        FakeWindow *fake_window = FakeSourceWindow((FakeSource *)closure, window);
+
+        return fake_window != NULL && fake_window->is_visible;
+}
+
+static LONG_PTR
+FakeExStyle(VOID *closure, HWND window)
+{
+        FakeWindow *fake_window = FakeSourceWindow((FakeSource *)closure, window);
+
+        return fake_window != NULL ? fake_window->ex_style : 0;
+}
+
+static BOOL
+FakeTitle(VOID *closure, HWND window, LPTSTR *title)
+{
+        FakeSource *fake = (FakeSource *)closure;
+        FakeWindow *fake_window = FakeSourceWindow(fake, window);
+
+        fake->counters.titles++;
+
+        *title = NULL;
+        if (fake_window == NULL || fake_window->title[0] == L'\0')
+                return FALSE;
+
+        *title = ALLOC_N(TCHAR, ZERO_TERMINATE(lstrlen(fake_window->title)));
+        if (*title == NULL)
+                return FALSE;
+        lstrcpy(*title, fake_window->title);
+
+        return TRUE;
+}
+
+static int FakeSourceFindOrder(FakeSource *fake, HWND window);
+
+/* Gets WINDOW’s icon of DELTA by DELTA, which is opaque and colored by
+ * FakeSourceIconColor().  Icons may be gotten from any thread, so the
+ * counters they touch are updated atomically. */
+static BOOL
+FakeIcon(FakeSource *fake, HWND window, UINT delta, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        FakeWindow *fake_window = FakeSourceWindow(fake, window);
+
+        __atomic_add_fetch(&fake->counters.icons, 1, __ATOMIC_RELAXED);
+        UINT at_once = __atomic_add_fetch(&fake->icons_at_once, 1, __ATOMIC_RELAXED);
+        UINT max_at_once = __atomic_load_n(&fake->counters.max_icons_at_once, __ATOMIC_RELAXED);
+        while (at_once > max_at_once &&
+               !__atomic_compare_exchange_n(&fake->counters.max_icons_at_once, &max_at_once, at_once,
+                                            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                ;
+
+        if (fake_window != NULL && fake_window->icon_latency > 0)
+                Sleep(fake_window->icon_latency);
+
+        __atomic_sub_fetch(&fake->icons_at_once, 1, __ATOMIC_RELAXED);
+
+        *was_hung = fake_window != NULL && fake_window->is_hung;
+        if (fake_window == NULL || *was_hung || !WindowSourceIconNew(delta, delta, icon))
+                return FALSE;
+
+        DWORD color = FakeSourceIconColor(window);
+        for (UINT i = 0; i < delta * delta; i++)
+                CopyMemory(icon->color + i * sizeof(color), &color, sizeof(color));
+        ZeroMemory(icon->mask, WindowSourceIconMaskSize(delta, delta));
+
+        return TRUE;
+}
+
+static BOOL
+FakeSmallIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        return FakeIcon((FakeSource *)closure, window, FAKE_SMALL_ICON_DELTA, icon, was_hung);
+}
+
+static BOOL
+FakeBigIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        return FakeIcon((FakeSource *)closure, window, FAKE_BIG_ICON_DELTA, icon, was_hung);
+}
+
+static BOOL
+FakeIconKey(VOID *closure, HWND window, LPTSTR *key)
+{
+        UNREFERENCED_PARAMETER(closure);
+        UNREFERENCED_PARAMETER(window);
+
+        *key = NULL;
+
+        return FALSE;
+}
+
+static BOOL
+FakeExists(VOID *closure, HWND window)
+{
+        return FakeSourceFindOrder((FakeSource *)closure, window) >= 0;
+}
+
+/* Switching to a window raises it, as activating it would. */
+static BOOL
+FakeSwitchTo(VOID *closure, HWND window)
+{
+        FakeSource *fake = (FakeSource *)closure;
+        if (FakeSourceFindOrder(fake, window) < 0)
+                return FALSE;
+
+        fake->counters.switches++;
+        FakeSourceRaise(fake, window);
+
+        return TRUE;
+}
+
+static WindowSourceFuncs const s_fake_funcs = {
+        FakeEnumerate,
+        FakeOwner,
+        FakeShell,
+        FakeIsVisible,
+        FakeExStyle,
+        FakeTitle,
+        FakeSmallIcon,
+        FakeBigIcon,
+        FakeIconKey,
+        FakeExists,
+        FakeSwitchTo,
+};
+
+/* Creates a new FakeSource without any windows. */
+FakeSource *
+FakeSourceNew(void)
+{
+        FakeSource *fake = ALLOC_STRUCT(FakeSource);
+        if (fake == NULL)
+                return NULL;
+
+        fake->source.funcs = &s_fake_funcs;
+        fake->source.closure = fake;
+
+        return fake;
+}
+
+void
+FakeSourceFree(FakeSource *fake)
+{
+        if (fake->windows != NULL)
+                FREE(fake->windows);
+        if (fake->order != NULL)
+                FREE(fake->order);
+        FREE(fake);
+}
+
+/* Gets the WindowSource of FAKE. */
+WindowSource *
+FakeSourceSource(FakeSource *fake)
+{
+        return &fake->source;
+}
+
+/* Creates a visible window on top of FAKE, owned by OWNER, of style
+ * EX_STYLE, and titled TITLE.  Returns NULL if there’s no memory for
+ * it. */
+HWND
+FakeSourceCreate(FakeSource *fake, HWND owner, LONG_PTR ex_style, LPCTSTR title)
+{
+        if (fake->n_windows == fake->n_allocated) {
+                int n_allocated = max(16, fake->n_allocated * 2);
+                FakeWindow *windows = REALLOC_N(FakeWindow, fake->windows, n_allocated);
+                if (windows == NULL)
+                        return NULL;
+                fake->windows = windows;
+
+                int *order = REALLOC_N(int, fake->order, n_allocated);
+                if (order == NULL)
+                        return NULL;
+                fake->order = order;
+
+                fake->n_allocated = n_allocated;
+        }
+
+        int index = fake->n_windows++;
+        FakeWindow *window = &fake->windows[index];
+        ZeroMemory(window, sizeof(*window));
+        window->owner = owner;
+        window->is_visible = TRUE;
+        window->ex_style = ex_style;
+        StringCchCopy(window->title, _countof(window->title), title);
+
+        MoveMemory(fake->order + 1, fake->order, fake->n_order * sizeof(int));
+        fake->order[0] = index;
+        fake->n_order++;
+
+        return FAKE_HWND(index);
+}
+
+/* Finds where WINDOW is in the z-order of FAKE, or -1 if it has been
+ * destroyed. */
+static int
+FakeSourceFindOrder(FakeSource *fake, HWND window)
+{
+        int index = FAKE_INDEX(window);
+        for (int i = 0; i < fake->n_order; i++)
+                if (fake->order[i] == index)
+                        return i;
+
+        return -1;
+}
+
+/* Destroys WINDOW of FAKE.  Windows it owned are left as they are. */
+void
+FakeSourceDestroy(FakeSource *fake, HWND window)
+{
+        int i = FakeSourceFindOrder(fake, window);
+        if (i < 0)
+                return;
+
+        fake->n_order--;
+        MoveMemory(fake->order + i, fake->order + i + 1, (fake->n_order - i) * sizeof(int));
+}
+
+/* Moves WINDOW of FAKE to the top of the z-order. */
+void
+FakeSourceRaise(FakeSource *fake, HWND window)
+{
+        int i = FakeSourceFindOrder(fake, window);
+        if (i < 0)
+                return;
+
+        MoveMemory(fake->order + 1, fake->order, i * sizeof(int));
+        fake->order[0] = FAKE_INDEX(window);
+}
+
+/* Gets WINDOW of FAKE, or NULL if there’s no such window.  Destroyed
+ * windows are still found, so that they may be asked about, like a
+ * handle that Windows hasn’t reused yet. */
+FakeWindow *
+FakeSourceWindow(FakeSource *fake, HWND window)
+{
+        int index = FAKE_INDEX(window);
+        if (window != FAKE_HWND(index) || index < 0 || index >= fake->n_windows)
+                return NULL;
+
+        return &fake->windows[index];
+}
+
+/* Sets the shell’s desktop window of FAKE to SHELL. */
+void
+FakeSourceSetShell(FakeSource *fake, HWND shell)
+{
+        fake->shell = shell;
+}
+
+void
+FakeSourceSetTitle(FakeSource *fake, HWND window, LPCTSTR title)
+{
+        FakeWindow *fake_window = FakeSourceWindow(fake, window);
+        if (fake_window != NULL)
+                StringCchCopy(fake_window->title, _countof(fake_window->title), title);
+}
+
+/* Gets the number of windows of FAKE that haven’t been destroyed. */
+int
+FakeSourceLength(FakeSource const *fake)
+{
+        return fake->n_order;
+}
+
+/* Gets the color of every pixel of WINDOW’s icons, as a 32-bit BGRA
+ * value, so that icons may be told apart. */
+DWORD
+FakeSourceIconColor(HWND window)
+{
+        return 0xff000000 | (DWORD)FAKE_INDEX(window);
+}
+
+/* Gets the Nth window of FAKE in z-order, top-most first. */
+HWND
+FakeSourceNth(FakeSource const *fake, int n)
+{
+        return FAKE_HWND(fake->order[n]);
+}
+
+void
+FakeSourceCountersGet(FakeSource *fake, FakeSourceCounters *counters)
+{
+        counters->titles = fake->counters.titles;
+        counters->switches = fake->counters.switches;
+        counters->icons = __atomic_load_n(&fake->counters.icons, __ATOMIC_RELAXED);
+        counters->max_icons_at_once = __atomic_load_n(&fake->counters.max_icons_at_once, __ATOMIC_RELAXED);
+}
+
+void
+FakeSourceCountersReset(FakeSource *fake)
+{
+        ZeroMemory(&fake->counters, sizeof(fake->counters));
+}
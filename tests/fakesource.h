@@ -0,0 +1,52 @@
+﻿/* A WindowSource of made-up windows, for building window lists without
+ * a desktop.  Windows are created on top of the z-order and may be
+ * raised, changed, and destroyed in between building lists. */
+typedef struct _FakeSource FakeSource;
+typedef struct _FakeWindow FakeWindow;
+
+/* A window of a FakeSource.
+ *
+ * OWNER, IS_VISIBLE, EX_STYLE, and TITLE are what the WindowSource
+ * reports for it.
+ * ICON_LATENCY is the number of milliseconds getting its icon takes,
+ * after which it fails as having timed out if IS_HUNG is TRUE. */
+struct _FakeWindow
+{
+        HWND owner;
+        BOOL is_visible;
+        LONG_PTR ex_style;
+        TCHAR title[64];
+        DWORD icon_latency;
+        BOOL is_hung;
+};
+
+/* Counters of the calls made to a FakeSource.
+ *
+ * TITLES and ICONS count the titles and icons asked for, and SWITCHES
+ * the windows switched to.
+ * MAX_ICONS_AT_ONCE is the largest number of icons that were being
+ * gotten at the same time. */
+typedef struct _FakeSourceCounters FakeSourceCounters;
+
+struct _FakeSourceCounters
+{
+        UINT titles;
+        UINT icons;
+        UINT switches;
+        UINT max_icons_at_once;
+};
+
+FakeSource *FakeSourceNew(void);
+void FakeSourceFree(FakeSource *fake);
+WindowSource *FakeSourceSource(FakeSource *fake);
+HWND FakeSourceCreate(FakeSource *fake, HWND owner, LONG_PTR ex_style, LPCTSTR title);
+void FakeSourceDestroy(FakeSource *fake, HWND window);
+void FakeSourceRaise(FakeSource *fake, HWND window);
+FakeWindow *FakeSourceWindow(FakeSource *fake, HWND window);
+void FakeSourceSetShell(FakeSource *fake, HWND shell);
+void FakeSourceSetTitle(FakeSource *fake, HWND window, LPCTSTR title);
+int FakeSourceLength(FakeSource const *fake);
+HWND FakeSourceNth(FakeSource const *fake, int n);
+DWORD FakeSourceIconColor(HWND window);
+void FakeSourceCountersGet(FakeSource *fake, FakeSourceCounters *counters);
+void FakeSourceCountersReset(FakeSource *fake);
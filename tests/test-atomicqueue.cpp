@@ -0,0 +1,121 @@
+﻿#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "atomicqueue.h"
+#include "test.h"
+
+/* Tests AtomicQueue, first one call at a time and then by having several
+ * threads push items onto it as fast as they can while a consumer takes
+ * them off only when told to, as the icon loader tells the window
+ * procedure with a message whenever a push finds the queue empty.  Each
+ * item must be taken exactly once, in the order its thread pushed it,
+ * and every message must find items to take.  Threads yield now and
+ * then, so that they interleave even on a single processor. */
+
+#define N_PRODUCERS     4
+#define N_ITEMS         200000
+
+typedef struct _Item Item;
+
+struct _Item
+{
+        AtomicQueueNode node;
+        int producer;
+        int sequence;
+};
+
+static AtomicQueue s_queue;
+static Item s_items[N_PRODUCERS][N_ITEMS];
+
+/* The number of messages posted by producers, as a push found the queue
+ * empty. */
+static long s_n_posted;
+
+static void
+TestOrder(void)
+{
+        AtomicQueue queue;
+        AtomicQueueInit(&queue);
+        CHECK(AtomicQueueTake(&queue) == NULL);
+
+        Item items[3];
+        CHECK(AtomicQueuePush(&queue, &items[0].node));
+        CHECK(!AtomicQueuePush(&queue, &items[1].node));
+        CHECK(!AtomicQueuePush(&queue, &items[2].node));
+
+        AtomicQueueNode *taken = AtomicQueueTake(&queue);
+        CHECK(taken == &items[0].node);
+        CHECK(taken->next == &items[1].node);
+        CHECK(taken->next->next == &items[2].node);
+        CHECK(taken->next->next->next == NULL);
+        CHECK(AtomicQueueTake(&queue) == NULL);
+
+        CHECK(AtomicQueuePush(&queue, &items[1].node));
+        CHECK(AtomicQueueTake(&queue) == &items[1].node);
+        CHECK(items[1].node.next == NULL);
+}
+
+static void *
+ProducerThread(void *closure)
+{
+        int producer = (int)(long)closure;
+        unsigned int state = producer + 1;
+
+        for (int i = 0; i < N_ITEMS; i++) {
+                Item *item = &s_items[producer][i];
+                item->producer = producer;
+                item->sequence = i;
+                if (AtomicQueuePush(&s_queue, &item->node))
+                        __atomic_add_fetch(&s_n_posted, 1, __ATOMIC_RELEASE);
+                if (TestRandom(&state) % 64 == 0)
+                        sched_yield();
+        }
+
+        return NULL;
+}
+
+static void
+TestStress(void)
+{
+        AtomicQueueInit(&s_queue);
+
+        pthread_t producers[N_PRODUCERS];
+        for (long i = 0; i < N_PRODUCERS; i++)
+                CHECK(pthread_create(&producers[i], NULL, ProducerThread, (void *)i) == 0);
+
+        int next[N_PRODUCERS] = { 0 };
+        long n_taken = 0, n_handled = 0;
+        while (n_taken < (long)N_PRODUCERS * N_ITEMS) {
+                if (__atomic_load_n(&s_n_posted, __ATOMIC_ACQUIRE) == n_handled) {
+                        sched_yield();
+                        continue;
+                }
+                n_handled++;
+
+                AtomicQueueNode *node = AtomicQueueTake(&s_queue);
+                CHECK(node != NULL);
+                for ( ; node != NULL; node = node->next) {
+                        Item *item = (Item *)node;
+                        CHECK(item->sequence == next[item->producer]);
+                        next[item->producer]++;
+                        n_taken++;
+                }
+        }
+
+        for (int i = 0; i < N_PRODUCERS; i++)
+                CHECK(pthread_join(producers[i], NULL) == 0);
+
+        CHECK(AtomicQueueTake(&s_queue) == NULL);
+        CHECK(s_n_posted == n_handled);
+        printf("  %ld items taken in %ld batches\n", n_taken, n_handled);
+}
+
+int
+main(void)
+{
+        TestOrder();
+        TestStress();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+﻿#include <string.h>
+
+#include "coalescer.h"
+#include "test.h"
+
+/* Tests Coalescer with storms of posts of a few keys and of many, as
+ * icons that animate and desktops full of windows send them, against a
+ * model of the keys waiting, with a clock that wraps around during each
+ * storm: keys have to be taken once per post while they’re waiting, in
+ * the order they were posted, only once they’re due. */
+
+#define N_STORMS        100
+#define N_STEPS         20000
+#define MAX_KEYS        3000
+
+/* The keys waiting in the model, in the order they were posted, in a
+ * ring of MAX_KEYS starting at FIRST, with when each becomes due, and
+ * whether each key is waiting. */
+typedef struct _Model Model;
+
+struct _Model
+{
+        unsigned int keys[MAX_KEYS];
+        unsigned long dues[MAX_KEYS];
+        unsigned int first;
+        unsigned int n;
+        char waiting[MAX_KEYS];
+};
+
+/* Makes the key of window K look like a window handle. */
+static unsigned long long
+Key(unsigned int k)
+{
+        return 0x10000 + ((unsigned long long)k << 4);
+}
+
+static void
+TestStorm(unsigned int *state, unsigned int n_keys)
+{
+        static Model model;
+        unsigned long delay = 1 + TestRandom(state) % 200;
+        unsigned long now = 0 - (unsigned long)(TestRandom(state) % 30000);
+
+        memset(&model, 0, sizeof(model));
+        Coalescer *coalescer = CoalescerNew(delay);
+        CHECK(coalescer != NULL);
+
+        for (int step = 0; step < N_STEPS; step++) {
+                unsigned int action = TestRandom(state) % 10;
+                if (action < 7) {
+                        unsigned int k = TestRandom(state) % n_keys;
+                        CHECK(CoalescerPost(coalescer, Key(k), now));
+                        if (!model.waiting[k]) {
+                                unsigned int i = (model.first + model.n++) % MAX_KEYS;
+                                model.keys[i] = k;
+                                model.dues[i] = now + delay;
+                                model.waiting[k] = 1;
+                        }
+                } else if (action < 9) {
+                        now += TestRandom(state) % 20;
+                } else {
+                        unsigned long long key;
+                        while (CoalescerTake(coalescer, now, &key)) {
+                                CHECK(model.n > 0);
+                                CHECK(key == Key(model.keys[model.first]));
+                                CHECK((long)(model.dues[model.first] - now) <= 0);
+                                model.waiting[model.keys[model.first]] = 0;
+                                model.first = (model.first + 1) % MAX_KEYS;
+                                model.n--;
+                        }
+                        if (model.n > 0) {
+                                CHECK((long)(model.dues[model.first] - now) > 0);
+                                CHECK(CoalescerNextDue(coalescer, now) == model.dues[model.first] - now);
+                        } else {
+                                CHECK(CoalescerNextDue(coalescer, now) == 0);
+                        }
+                }
+                CHECK(CoalescerLength(coalescer) == model.n);
+        }
+
+        CoalescerFree(coalescer);
+}
+
+static void
+TestStorms(void)
+{
+        unsigned int state = 1;
+
+        for (int storm = 0; storm < N_STORMS; storm++)
+                TestStorm(&state, 1 + TestRandom(&state) % (storm % 2 == 0 ? 5 : MAX_KEYS));
+}
+
+/* A window changing its icon every millisecond is handled once for each
+ * period. */
+static void
+TestFlood(void)
+{
+        Coalescer *coalescer = CoalescerNew(100);
+        CHECK(coalescer != NULL);
+
+        int n_handled = 0;
+        for (unsigned long now = 0; now < 10000; now++) {
+                unsigned long long key;
+                CHECK(CoalescerPost(coalescer, Key(42), now));
+                while (CoalescerTake(coalescer, now, &key)) {
+                        CHECK(key == Key(42));
+                        n_handled++;
+                }
+        }
+        CHECK(n_handled == 99);
+
+        CoalescerFree(coalescer);
+}
+
+/* Many windows changing their icons at once are handled once each, in
+ * the order they first changed, once they’re due. */
+static void
+TestManyKeys(void)
+{
+        Coalescer *coalescer = CoalescerNew(10);
+        CHECK(coalescer != NULL);
+
+        for (unsigned int k = 0; k < 100000; k++)
+                CHECK(CoalescerPost(coalescer, Key(k), 0));
+        for (unsigned int k = 0; k < 100000; k++)
+                CHECK(CoalescerPost(coalescer, Key(k), 5));
+        CHECK(CoalescerLength(coalescer) == 100000);
+
+        unsigned long long key;
+        CHECK(!CoalescerTake(coalescer, 9, &key));
+        CHECK(CoalescerNextDue(coalescer, 9) == 1);
+
+        unsigned int n = 0;
+        while (CoalescerTake(coalescer, 10, &key)) {
+                CHECK(key == Key(n));
+                n++;
+        }
+        CHECK(n == 100000);
+        CHECK(CoalescerLength(coalescer) == 0);
+
+        CoalescerFree(coalescer);
+}
+
+int
+main(void)
+{
+        TestStorms();
+        TestFlood();
+        TestManyKeys();
+
+        return EXIT_SUCCESS;
+}
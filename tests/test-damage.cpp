@@ -0,0 +1,148 @@
+﻿#include <string.h>
+
+#include "damage.h"
+#include "test.h"
+
+/* Tests Damage with rows and a text field being damaged as a keystroke
+ * damages them, and with random rectangles, some empty and some off the
+ * surface, against a map of the pixels of the surface damaged: every
+ * pixel added has to be covered, in at most as many rectangles as asked
+ * for, and the bounds and clipping have to be those of what was added. */
+
+#define N_ROUNDS        20000
+#define WIDTH           120
+#define HEIGHT          90
+
+static int
+IsCovered(Damage const *damage, int x, int y)
+{
+        DamageRect const *rects = DamageRects(damage);
+        for (unsigned int i = 0; i < DamageLength(damage); i++)
+                if (x >= rects[i].x && x < rects[i].x + rects[i].width &&
+                    y >= rects[i].y && y < rects[i].y + rects[i].height)
+                        return 1;
+
+        return 0;
+}
+
+static void
+TestRows(void)
+{
+        Damage *damage = DamageNew(4);
+        CHECK(damage != NULL);
+        CHECK(DamageIsEmpty(damage));
+
+        DamageRect bounds;
+        CHECK(!DamageBounds(damage, &bounds));
+
+        /* Rows next to each other merge into one. */
+        for (int row = 0; row < 10; row++)
+                DamageAdd(damage, 0, row * 20, 100, 20);
+        CHECK(DamageLength(damage) == 1);
+        CHECK(DamageBounds(damage, &bounds));
+        CHECK(bounds.x == 0 && bounds.y == 0 && bounds.width == 100 && bounds.height == 200);
+
+        /* What’s covered already and empty rectangles change nothing. */
+        DamageAdd(damage, 10, 10, 5, 5);
+        DamageAdd(damage, 0, 0, 0, 5);
+        DamageAdd(damage, 0, 0, 5, -1);
+        CHECK(DamageLength(damage) == 1);
+
+        /* A text field apart from the rows is kept apart. */
+        DamageAdd(damage, 200, 10, 50, 12);
+        CHECK(DamageLength(damage) == 2);
+
+        DamageClip(damage, 0, 50, 100, 10);
+        CHECK(DamageLength(damage) == 1);
+        bounds = DamageRects(damage)[0];
+        CHECK(bounds.x == 0 && bounds.y == 50 && bounds.width == 100 && bounds.height == 10);
+
+        DamageClip(damage, 200, 0, 5, 5);
+        CHECK(DamageIsEmpty(damage));
+
+        DamageAdd(damage, 1, 2, 3, 4);
+        DamageClear(damage);
+        CHECK(DamageIsEmpty(damage));
+        CHECK(DamageLength(damage) == 0);
+
+        DamageFree(damage);
+}
+
+static void
+TestRandomRects(void)
+{
+        static unsigned char damaged[HEIGHT][WIDTH];
+        unsigned int state = 7;
+
+        for (int round = 0; round < N_ROUNDS; round++) {
+                unsigned int max_rects = 1 + TestRandom(&state) % 8;
+                Damage *damage = DamageNew(max_rects);
+                CHECK(damage != NULL);
+                memset(damaged, 0, sizeof(damaged));
+
+                int left = 0, top = 0, right = 0, bottom = 0;
+                int is_empty = 1;
+                int n = 1 + TestRandom(&state) % 20;
+                for (int i = 0; i < n; i++) {
+                        int x = (int)(TestRandom(&state) % WIDTH) - 10;
+                        int y = (int)(TestRandom(&state) % HEIGHT) - 10;
+                        int width = (int)(TestRandom(&state) % 40) - 5;
+                        int height = (int)(TestRandom(&state) % 30) - 5;
+                        DamageAdd(damage, x, y, width, height);
+                        CHECK(DamageLength(damage) <= max_rects);
+                        if (width <= 0 || height <= 0)
+                                continue;
+
+                        for (int py = y; py < y + height; py++)
+                                for (int px = x; px < x + width; px++)
+                                        if (px >= 0 && py >= 0 && px < WIDTH && py < HEIGHT)
+                                                damaged[py][px] = 1;
+
+                        if (is_empty || x < left)
+                                left = x;
+                        if (is_empty || y < top)
+                                top = y;
+                        if (is_empty || x + width > right)
+                                right = x + width;
+                        if (is_empty || y + height > bottom)
+                                bottom = y + height;
+                        is_empty = 0;
+                }
+
+                DamageRect bounds;
+                CHECK(DamageBounds(damage, &bounds) == !is_empty);
+                CHECK(DamageIsEmpty(damage) == is_empty);
+                if (!is_empty) {
+                        CHECK(bounds.x == left && bounds.y == top);
+                        CHECK(bounds.x + bounds.width == right && bounds.y + bounds.height == bottom);
+                        if (max_rects == 1) {
+                                DamageRect const *only = DamageRects(damage);
+                                CHECK(only->x == bounds.x && only->y == bounds.y);
+                                CHECK(only->width == bounds.width && only->height == bounds.height);
+                        }
+                }
+
+                DamageClip(damage, 0, 0, WIDTH, HEIGHT);
+                DamageRect const *rects = DamageRects(damage);
+                for (unsigned int i = 0; i < DamageLength(damage); i++) {
+                        CHECK(rects[i].width > 0 && rects[i].height > 0);
+                        CHECK(rects[i].x >= 0 && rects[i].y >= 0);
+                        CHECK(rects[i].x + rects[i].width <= WIDTH && rects[i].y + rects[i].height <= HEIGHT);
+                }
+                for (int py = 0; py < HEIGHT; py++)
+                        for (int px = 0; px < WIDTH; px++)
+                                if (damaged[py][px])
+                                        CHECK(IsCovered(damage, px, py));
+
+                DamageFree(damage);
+        }
+}
+
+int
+main(void)
+{
+        TestRows();
+        TestRandomRects();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+﻿#include <stdlib.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "iconstore.h"
+#include "test.h"
+
+/* Tests IconStore and IconStoreWriter: that icons put together by a
+ * writer are found again under their keys, both by the writer and by a
+ * store reading the file, including when there are thousands of them,
+ * and that a store never reads outside of a corrupted file, which it
+ * either rejects or reads entries from that only point into it. */
+
+#define N_ICONS         5000
+#define N_CORRUPTIONS   20000
+
+static unsigned int volatile s_sum;
+
+static int
+MakeKey(char *key, unsigned int i)
+{
+        return sprintf(key, "C:\\Program Files\\app%u.exe|Class%u|16x16", i, i % 7);
+}
+
+static void
+MakePixels(PixelsARGB *pixels, unsigned int n, unsigned int seed)
+{
+        for (unsigned int i = 0; i < n; i++)
+                pixels[i] = seed * 2654435761U + i;
+}
+
+static void
+TestRoundTrip(void)
+{
+        IconStoreWriter *writer = IconStoreWriterNew();
+        CHECK(writer != NULL);
+
+        char key[64];
+        PixelsARGB pixels[32 * 32];
+        for (unsigned int i = 0; i < N_ICONS; i++) {
+                unsigned int size = i % 3 == 0 ? 32 : 16;
+                MakePixels(pixels, size * size, i);
+                CHECK(IconStoreWriterAdd(writer, key, MakeKey(key, i), size, size, pixels));
+        }
+        CHECK(IconStoreWriterLength(writer) == N_ICONS);
+
+        /* Adding under a key that’s there replaces the icon. */
+        MakePixels(pixels, 8 * 8, N_ICONS);
+        CHECK(IconStoreWriterAdd(writer, key, MakeKey(key, 3), 8, 8, pixels));
+        CHECK(IconStoreWriterLength(writer) == N_ICONS);
+        CHECK(IconStoreWriterAdd(writer, "", 0, 1, 1, pixels));
+        CHECK(IconStoreWriterLength(writer) == N_ICONS + 1);
+
+        CHECK(!IconStoreWriterAdd(writer, "large", 5, ICON_STORE_MAX_DELTA + 1, 1, pixels));
+        CHECK(!IconStoreWriterAdd(writer, "empty", 5, 0, 16, pixels));
+
+        for (unsigned int i = 0; i < N_ICONS; i++)
+                CHECK(IconStoreWriterHas(writer, key, MakeKey(key, i)));
+        CHECK(IconStoreWriterHas(writer, "", 0));
+        CHECK(!IconStoreWriterHas(writer, key, MakeKey(key, N_ICONS)));
+        CHECK(!IconStoreWriterHas(writer, key, MakeKey(key, 1) - 1));
+
+        void *data;
+        size_t size;
+        CHECK(IconStoreWriterFinish(writer, &data, &size));
+        IconStoreWriterFree(writer);
+
+        IconStore *store = IconStoreOpen(data, size);
+        CHECK(store != NULL);
+        CHECK(IconStoreLength(store) == N_ICONS + 1);
+
+        PixelsARGB expected[32 * 32];
+        for (unsigned int i = 0; i < N_ICONS; i++) {
+                unsigned int width, height;
+                PixelsARGB const *found;
+                CHECK(IconStoreLookup(store, key, MakeKey(key, i), &width, &height, &found));
+
+                unsigned int size = i == 3 ? 8 : i % 3 == 0 ? 32 : 16;
+                CHECK(width == size && height == size);
+                MakePixels(expected, size * size, i == 3 ? N_ICONS : i);
+                CHECK(memcmp(found, expected, size * size * sizeof(*found)) == 0);
+        }
+
+        unsigned int width, height;
+        PixelsARGB const *found;
+        CHECK(IconStoreLookup(store, "", 0, &width, &height, &found));
+        CHECK(width == 1 && height == 1);
+        CHECK(!IconStoreLookup(store, key, MakeKey(key, N_ICONS), &width, &height, &found));
+
+        void const *entry_key;
+        size_t entry_key_size;
+        CHECK(IconStoreEntry(store, 0, &entry_key, &entry_key_size, &width, &height, &found));
+        CHECK(entry_key_size == (size_t)MakeKey(key, 0) && memcmp(entry_key, key, entry_key_size) == 0);
+
+        IconStoreClose(store);
+        free(data);
+}
+
+/* Sums what a store lets us read of its file and looks up every key in
+ * it, so that reading outside of the file would be caught by the tools
+ * the test is run with, if not by a crash.  Keys found may be under an
+ * earlier, corrupted entry, so whether they’re found isn’t checked. */
+static unsigned int
+ReadAll(IconStore *store)
+{
+        unsigned int sum = 0;
+        for (unsigned int i = 0; i < IconStoreLength(store); i++) {
+                void const *key;
+                size_t key_size;
+                unsigned int width, height;
+                PixelsARGB const *pixels;
+                if (!IconStoreEntry(store, i, &key, &key_size, &width, &height, &pixels))
+                        continue;
+                for (size_t j = 0; j < key_size; j++)
+                        sum += ((unsigned char const *)key)[j];
+                for (unsigned int j = 0; j < width * height; j++)
+                        sum += pixels[j];
+                IconStoreLookup(store, key, key_size, &width, &height, &pixels);
+        }
+
+        return sum;
+}
+
+/* Flips random bits of a file, and truncates it now and then.  As the
+ * checksum of the entry table would reject almost every corrupted table,
+ * it’s fixed up every so often, so that corrupted entries get read. */
+static void
+TestCorruption(void)
+{
+        IconStoreWriter *writer = IconStoreWriterNew();
+        CHECK(writer != NULL);
+        char key[64];
+        PixelsARGB pixels[16 * 16];
+        for (unsigned int i = 0; i < 20; i++) {
+                MakePixels(pixels, 16 * 16, i);
+                CHECK(IconStoreWriterAdd(writer, key, MakeKey(key, i), 16, 16, pixels));
+        }
+        void *data;
+        size_t size;
+        CHECK(IconStoreWriterFinish(writer, &data, &size));
+        IconStoreWriterFree(writer);
+
+        unsigned int *buffer = (unsigned int *)malloc(size);
+        unsigned char *bytes = (unsigned char *)buffer;
+        CHECK(buffer != NULL);
+        unsigned int state = 11, n_opened = 0;
+        for (int round = 0; round < N_CORRUPTIONS; round++) {
+                memcpy(buffer, data, size);
+                size_t length = size;
+                for (unsigned int n = 1 + TestRandom(&state) % 8; n > 0; n--)
+                        bytes[TestRandom(&state) % size] ^= 1 << (TestRandom(&state) % 8);
+                if (TestRandom(&state) % 4 == 0)
+                        length = TestRandom(&state) % (size + 1);
+
+                unsigned int n_entries = bytes[8] | bytes[9] << 8 | bytes[10] << 16 | (unsigned int)bytes[11] << 24;
+                if (TestRandom(&state) % 8 == 0 && length >= 24 && n_entries <= (length - 24) / 24) {
+                        unsigned int hash = 2166136261U;
+                        for (size_t i = 24; i < 24 + (size_t)n_entries * 24; i++)
+                                hash = (hash ^ bytes[i]) * 16777619U;
+                        for (unsigned int i = 0; i < 4; i++)
+                                bytes[12 + i] = (unsigned char)(hash >> (8 * i));
+                }
+
+                IconStore *store = IconStoreOpen(buffer, length);
+                if (store != NULL) {
+                        s_sum += ReadAll(store);
+                        IconStoreClose(store);
+                        n_opened++;
+                }
+        }
+        printf("  %u of %u corrupted files opened\n", n_opened, N_CORRUPTIONS);
+
+        free(buffer);
+        free(data);
+}
+
+int
+main(void)
+{
+        TestRoundTrip();
+        TestCorruption();
+
+        return EXIT_SUCCESS;
+}
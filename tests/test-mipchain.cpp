@@ -0,0 +1,205 @@
+﻿#include <stdlib.h>
+
+#include "pixels.h"
+#include "mipchain.h"
+#include "test.h"
+
+/* Tests picking the size of an icon to scale from, and MipChain: that
+ * each level is the one before it halved, rounding each block of four
+ * channels’ average, for chains of random sizes and limits, and that the
+ * level picked for each size is the smallest whole multiple of it, or
+ * otherwise the smallest level at least as large. */
+
+#define N_CHAINS        2000
+
+static PixelsARGB
+RandomPremultiplied(unsigned int *state)
+{
+        unsigned int alpha = TestRandom(state) % 256;
+        if (TestRandom(state) % 4 == 0)
+                alpha = 0xff;
+        else if (TestRandom(state) % 8 == 0)
+                alpha = 0;
+
+        PixelsARGB pixel = alpha << 24;
+        for (unsigned int shift = 0; shift < 24; shift += 8)
+                pixel |= (TestRandom(state) % (alpha + 1)) << shift;
+
+        return pixel;
+}
+
+static void
+TestPickSource(void)
+{
+        unsigned int const widths[] = { 16, 32, 48, 24 };
+        unsigned int const heights[] = { 16, 32, 48, 24 };
+
+        CHECK(MipPickSource(widths, heights, 4, 16, 16) == 0);
+        CHECK(MipPickSource(widths, heights, 4, 32, 32) == 1);
+        CHECK(MipPickSource(widths, heights, 4, 20, 20) == 3);
+        CHECK(MipPickSource(widths, heights, 4, 40, 40) == 2);
+        CHECK(MipPickSource(widths, heights, 4, 64, 64) == 2);
+        CHECK(MipPickSource(widths, heights, 0, 16, 16) == -1);
+
+        /* A size only has to be as large in both dimensions to be picked
+         * over a larger one; if none is, the largest is. */
+        unsigned int const wide_widths[] = { 16, 32, 20 };
+        unsigned int const wide_heights[] = { 16, 16, 24 };
+        CHECK(MipPickSource(wide_widths, wide_heights, 3, 20, 16) == 2);
+        CHECK(MipPickSource(wide_widths, wide_heights, 2, 20, 16) == 1);
+        CHECK(MipPickSource(wide_widths, wide_heights, 2, 20, 20) == 1);
+}
+
+/* Gets channel SHIFT of pixel X, Y of a level WIDTH by HEIGHT, repeating
+ * the last row and column past its edges. */
+static unsigned int
+Channel(PixelsARGB const *pixels, unsigned int width, unsigned int height,
+        unsigned int x, unsigned int y, unsigned int shift)
+{
+        if (x >= width)
+                x = width - 1;
+        if (y >= height)
+                y = height - 1;
+
+        return (pixels[y * width + x] >> shift) & 0xff;
+}
+
+static void
+CheckLevels(MipChain const *chain, PixelsARGB const *pixels, unsigned int width, unsigned int height,
+            unsigned int min_width, unsigned int min_height)
+{
+        unsigned int level_width, level_height;
+        PixelsARGB const *level = MipChainLevel(chain, 0, &level_width, &level_height);
+        CHECK(level_width == width && level_height == height);
+        CHECK(level != pixels);
+        for (unsigned int i = 0; i < width * height; i++)
+                CHECK(level[i] == pixels[i]);
+
+        unsigned long bytes = width * height * sizeof(PixelsARGB);
+        for (int l = 1; l < MipChainLength(chain); l++) {
+                unsigned int larger_width, larger_height;
+                PixelsARGB const *larger = MipChainLevel(chain, l - 1, &larger_width, &larger_height);
+                level = MipChainLevel(chain, l, &level_width, &level_height);
+                CHECK(level_width == larger_width / 2 && level_height == larger_height / 2);
+                CHECK(level_width >= min_width && level_height >= min_height);
+                bytes += level_width * level_height * sizeof(PixelsARGB);
+
+                for (unsigned int y = 0; y < level_height; y++) {
+                        for (unsigned int x = 0; x < level_width; x++) {
+                                PixelsARGB pixel = level[y * level_width + x];
+                                for (unsigned int shift = 0; shift < 32; shift += 8) {
+                                        unsigned int sum = 0;
+                                        for (unsigned int dy = 0; dy < 2; dy++)
+                                                for (unsigned int dx = 0; dx < 2; dx++)
+                                                        sum += Channel(larger, larger_width, larger_height,
+                                                                       2 * x + dx, 2 * y + dy, shift);
+                                        CHECK(((pixel >> shift) & 0xff) == (sum + 2) / 4);
+                                        if (shift < 24)
+                                                CHECK(((pixel >> shift) & 0xff) <= pixel >> 24);
+                                }
+                        }
+                }
+        }
+
+        /* Halving the last level would have made it too small. */
+        MipChainLevel(chain, MipChainLength(chain) - 1, &level_width, &level_height);
+        CHECK(level_width / 2 == 0 || level_height / 2 == 0 ||
+              level_width / 2 < min_width || level_height / 2 < min_height);
+        CHECK(MipChainBytes(chain) == bytes);
+}
+
+/* Checks that the level picked for WIDTH by HEIGHT is the smallest whole
+ * multiple of it, or otherwise the smallest at least as large, or the
+ * first. */
+static void
+CheckPick(MipChain const *chain, unsigned int width, unsigned int height)
+{
+        int covering = 0;
+        for (int l = 1; l < MipChainLength(chain); l++) {
+                unsigned int level_width, level_height;
+                MipChainLevel(chain, l, &level_width, &level_height);
+                if (level_width >= width && level_height >= height)
+                        covering = l;
+        }
+
+        int expected = covering;
+        for (int l = covering; l >= 0; l--) {
+                unsigned int level_width, level_height;
+                MipChainLevel(chain, l, &level_width, &level_height);
+                if (level_width % width == 0 && level_height % height == 0) {
+                        expected = l;
+                        break;
+                }
+        }
+
+        CHECK(MipChainPick(chain, width, height) == expected);
+}
+
+static void
+TestRandomChains(void)
+{
+        unsigned int state = 1;
+
+        for (int round = 0; round < N_CHAINS; round++) {
+                unsigned int width = 1 + TestRandom(&state) % 70;
+                unsigned int height = 1 + TestRandom(&state) % 70;
+                unsigned int min_width = TestRandom(&state) % 20;
+                unsigned int min_height = TestRandom(&state) % 20;
+
+                PixelsARGB *pixels = (PixelsARGB *)malloc(width * height * sizeof(*pixels));
+                CHECK(pixels != NULL);
+                for (unsigned int i = 0; i < width * height; i++)
+                        pixels[i] = RandomPremultiplied(&state);
+
+                MipChain *chain = MipChainNew(width, height, pixels, min_width, min_height);
+                CHECK(chain != NULL);
+                CheckLevels(chain, pixels, width, height, min_width, min_height);
+                for (int i = 0; i < 8; i++)
+                        CheckPick(chain, 1 + TestRandom(&state) % 80, 1 + TestRandom(&state) % 80);
+
+                MipChainFree(chain);
+                free(pixels);
+        }
+}
+
+/* Checks the levels picked for the sizes icons are drawn at, at scale
+ * factors from 100% to 300%, for the sizes applications offer. */
+static void
+TestPick(void)
+{
+        static PixelsARGB pixels[256 * 256];
+
+        MipChain *chain = MipChainNew(48, 48, pixels, 16, 16);
+        CHECK(chain != NULL);
+        CHECK(MipChainLength(chain) == 2);
+        CHECK(MipChainPick(chain, 16, 16) == 0);
+        CHECK(MipChainPick(chain, 20, 20) == 1);
+        CHECK(MipChainPick(chain, 24, 24) == 1);
+        MipChainFree(chain);
+
+        chain = MipChainNew(32, 32, pixels, 16, 16);
+        CHECK(chain != NULL);
+        CHECK(MipChainPick(chain, 16, 16) == 1);
+        CHECK(MipChainPick(chain, 24, 24) == 0);
+        MipChainFree(chain);
+
+        chain = MipChainNew(256, 256, pixels, 16, 16);
+        CHECK(chain != NULL);
+        CHECK(MipChainLength(chain) == 5);
+        CHECK(MipChainPick(chain, 16, 16) == 4);
+        CHECK(MipChainPick(chain, 20, 20) == 3);
+        CHECK(MipChainPick(chain, 32, 32) == 3);
+        CHECK(MipChainPick(chain, 48, 48) == 2);
+        CHECK(MipChainPick(chain, 300, 300) == 0);
+        MipChainFree(chain);
+}
+
+int
+main(void)
+{
+        TestPickSource();
+        TestRandomChains();
+        TestPick();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+﻿#include <math.h>
+#include <string.h>
+
+#include "pixels.h"
+#include "test.h"
+
+/* Tests the pixel kernels at every level the processor supports against
+ * straightforward per-pixel versions of what they do, over rows of every
+ * length up to a few hundred pixels starting at every alignment, so that
+ * both the vectorized loops and the scalar tails they finish with are
+ * run.  Premultiplying is checked exhaustively. */
+
+#define MAX_ROW         300
+#define MAX_OFFSET      8
+#define N_ROWS          2000
+
+static PixelsARGB
+RandomPixel(unsigned int *state)
+{
+        return TestRandom(state) ^ (TestRandom(state) << 16);
+}
+
+/* Sets ROW to N random pixels that are either transparent or opaque,
+ * except for one pixel out of three rows, which is translucent. */
+static void
+RandomSolidRow(PixelsARGB *row, unsigned int n, unsigned int *state)
+{
+        for (unsigned int i = 0; i < n; i++)
+                row[i] = (RandomPixel(state) & 0x00ffffff) | (TestRandom(state) % 2 ? 0xff000000 : 0);
+        if (n > 0 && TestRandom(state) % 3 == 0)
+                row[TestRandom(state) % n] = 0x80123456;
+}
+
+static int
+HasAlpha(PixelsARGB const *pixels, unsigned int n)
+{
+        for (unsigned int i = 0; i < n; i++)
+                if (pixels[i] >> 24 != 0x00 && pixels[i] >> 24 != 0xff)
+                        return 1;
+
+        return 0;
+}
+
+static void
+TestRows(PixelsLevel level)
+{
+        static PixelsARGB source[MAX_ROW + MAX_OFFSET];
+        static PixelsARGB destination[MAX_ROW + MAX_OFFSET];
+        static unsigned char alpha[MAX_ROW + MAX_OFFSET];
+
+        unsigned int state = 1;
+        for (int round = 0; round < N_ROWS; round++) {
+                unsigned int n = TestRandom(&state) % MAX_ROW;
+                unsigned int offset = TestRandom(&state) % MAX_OFFSET;
+                PixelsARGB *row = source + offset;
+
+                RandomSolidRow(row, n, &state);
+                CHECK(PixelsHaveAlpha(row, n) == HasAlpha(row, n));
+
+                for (unsigned int i = 0; i < n; i++)
+                        row[i] = RandomPixel(&state);
+                CHECK(PixelsHaveAlpha(row, n) == HasAlpha(row, n));
+
+                memset(destination, 0, sizeof(destination));
+                PixelsCopy(destination + offset, row, n);
+                CHECK(memcmp(destination + offset, row, n * sizeof(*row)) == 0);
+                CHECK(destination[offset + n] == 0);
+
+                for (unsigned int i = 0; i < n; i++)
+                        alpha[offset + i] = (unsigned char)TestRandom(&state);
+                PixelsSetAlpha(destination, row, alpha + offset, n);
+                for (unsigned int i = 0; i < n; i++)
+                        CHECK(destination[i] == ((row[i] & 0x00ffffff) | ((PixelsARGB)alpha[offset + i] << 24)));
+                PixelsSetAlpha(row, row, alpha + offset, n);
+                CHECK(memcmp(destination, row, n * sizeof(*row)) == 0);
+        }
+
+        printf("  level %d: rows\n", level);
+}
+
+/* Checks every pair of alpha value and channel value, that premultiplying
+ * rounds C * A / 255 to the nearest value, that unpremultiplying rounds
+ * C * 255 / A to the nearest value, and that doing both gives back the
+ * premultiplied pixel.  Also checks that both work in place and that they
+ * agree with the scalar kernels on pixels premultiplying never produces. */
+static void
+TestPremultiply(PixelsLevel level)
+{
+        static PixelsARGB source[256 * 256];
+        static PixelsARGB premultiplied[256 * 256];
+        static PixelsARGB unpremultiplied[256 * 256];
+        static PixelsARGB scalar[256 * 256];
+        static PixelsARGB other[256 * 256];
+        unsigned int const n = 256 * 256;
+
+        for (unsigned int a = 0; a < 256; a++)
+                for (unsigned int c = 0; c < 256; c++)
+                        source[a * 256 + c] = a << 24 | c << 16 | ((c * 7) & 0xff) << 8 | ((c * 13) & 0xff);
+
+        PixelsPremultiply(premultiplied, source, n);
+        PixelsUnpremultiply(unpremultiplied, premultiplied, n);
+        for (unsigned int i = 0; i < n; i++) {
+                unsigned int a = source[i] >> 24;
+                CHECK(premultiplied[i] >> 24 == a);
+                CHECK(unpremultiplied[i] >> 24 == a);
+                for (unsigned int shift = 0; shift < 24; shift += 8) {
+                        unsigned int c = (source[i] >> shift) & 0xff;
+                        unsigned int p = (premultiplied[i] >> shift) & 0xff;
+                        unsigned int u = (unpremultiplied[i] >> shift) & 0xff;
+                        CHECK(p == (unsigned int)floor(c * a / 255.0 + 0.5));
+                        CHECK(a == 0 ? u == 0 : fabs(u - p * 255.0 / a) <= 0.5);
+                }
+        }
+
+        PixelsPremultiply(other, unpremultiplied, n);
+        CHECK(memcmp(other, premultiplied, sizeof(other)) == 0);
+
+        memcpy(other, source, sizeof(other));
+        PixelsPremultiply(other, other, n);
+        CHECK(memcmp(other, premultiplied, sizeof(other)) == 0);
+        PixelsUnpremultiply(other, other, n);
+        CHECK(memcmp(other, unpremultiplied, sizeof(other)) == 0);
+
+        PixelsUnpremultiply(other, source, n);
+        CHECK(PixelsUseLevel(PIXELS_SCALAR));
+        PixelsUnpremultiply(scalar, source, n);
+        CHECK(memcmp(other, scalar, sizeof(other)) == 0);
+        CHECK(PixelsUseLevel(level));
+
+        printf("  level %d: premultiplying\n", level);
+}
+
+/* Expands the BITS bottom bits of VALUE to 8 bits by repeating them from
+ * the top, so that all zeros and all ones stay so. */
+static unsigned int
+Expand(unsigned int value, unsigned int bits)
+{
+        unsigned int expanded = 0;
+        value &= (1 << bits) - 1;
+        for (int shift = 8 - bits; shift > -(int)bits; shift -= bits)
+                expanded |= shift >= 0 ? value << shift : value >> -shift;
+
+        return expanded;
+}
+
+/* Gets pixel I of a row of FORMAT, which is the number of bits per pixel
+ * of an indexed format, 555 or 565 for 16-bit formats, or 24, one pixel
+ * at a time, as GetPixel() would. */
+static PixelsARGB
+ReferencePixel(unsigned int format, unsigned char const *row, PixelsARGB const *palette, unsigned int i)
+{
+        unsigned int value;
+
+        switch (format) {
+        case 1:
+                return palette[(row[i / 8] >> (7 - i % 8)) & 0x01];
+        case 4:
+                return palette[(row[i / 2] >> (i % 2 == 0 ? 4 : 0)) & 0x0f];
+        case 8:
+                return palette[row[i]];
+        case 555:
+                value = row[2 * i] | row[2 * i + 1] << 8;
+                return 0xff000000 | Expand(value >> 10, 5) << 16 | Expand(value >> 5, 5) << 8 | Expand(value, 5);
+        case 565:
+                value = row[2 * i] | row[2 * i + 1] << 8;
+                return 0xff000000 | Expand(value >> 11, 5) << 16 | Expand(value >> 5, 6) << 8 | Expand(value, 5);
+        default:
+                return 0xff000000 | row[3 * i + 2] << 16 | row[3 * i + 1] << 8 | row[3 * i];
+        }
+}
+
+/* Checks each converter against ReferencePixel() on random rows of every
+ * length and alignment, checking that it writes nothing past the last
+ * pixel. */
+static void
+TestConverters(PixelsLevel level)
+{
+        static unsigned int const formats[] = { 1, 4, 8, 555, 565, 24 };
+        static unsigned char source[3 * (MAX_ROW + MAX_OFFSET)];
+        static PixelsARGB destination[MAX_ROW + 1];
+        PixelsARGB palette[256];
+
+        CHECK(Expand(0x1f, 5) == 0xff && Expand(0x3f, 6) == 0xff && Expand(0x10, 5) == 0x84);
+
+        unsigned int state = 3;
+        for (unsigned int i = 0; i < 256; i++)
+                palette[i] = RandomPixel(&state);
+
+        for (int round = 0; round < N_ROWS; round++) {
+                unsigned int n = TestRandom(&state) % MAX_ROW;
+                unsigned int offset = TestRandom(&state) % MAX_OFFSET;
+                unsigned char *row = source + 3 * offset;
+                for (unsigned int i = 0; i < 3 * n; i++)
+                        row[i] = (unsigned char)TestRandom(&state);
+
+                for (unsigned int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+                        destination[n] = 0x42424242;
+
+                        /* NOTE: 16-bit rows are 16-bit aligned in
+                         * bitmaps, so we only misalign them by pixels. */
+                        switch (formats[f]) {
+                        case 555:
+                                row = source + 2 * offset;
+                                PixelsFromRGB555(destination, (unsigned short const *)row, n);
+                                break;
+                        case 565:
+                                row = source + 2 * offset;
+                                PixelsFromRGB565(destination, (unsigned short const *)row, n);
+                                break;
+                        case 24:
+                                row = source + 3 * offset;
+                                PixelsFromRGB24(destination, row, n);
+                                break;
+                        default:
+                                row = source + offset;
+                                PixelsFromIndexed(destination, row, formats[f], palette, n);
+                                break;
+                        }
+
+                        for (unsigned int i = 0; i < n; i++)
+                                CHECK(destination[i] == ReferencePixel(formats[f], row, palette, i));
+                        CHECK(destination[n] == 0x42424242);
+                }
+        }
+
+        printf("  level %d: converters\n", level);
+}
+
+/* Checks PixelsExpandMask() against a bit-by-bit reference on every byte
+ * and on random masks of every length, and that it writes nothing past
+ * the last pixel. */
+static void
+TestExpandMask(void)
+{
+        unsigned char mask[MAX_ROW / 8 + 1];
+        unsigned char alpha[MAX_ROW + 1];
+
+        unsigned int state = 2;
+        for (int round = 0; round < N_ROWS; round++) {
+                unsigned int n = TestRandom(&state) % MAX_ROW;
+                for (unsigned int i = 0; i < sizeof(mask); i++)
+                        mask[i] = (unsigned char)TestRandom(&state);
+
+                memset(alpha, 0x42, sizeof(alpha));
+                PixelsExpandMask(alpha, mask, n);
+                for (unsigned int i = 0; i < n; i++)
+                        CHECK(alpha[i] == ((mask[i / 8] >> (7 - i % 8)) & 1 ? 0x00 : 0xff));
+                CHECK(alpha[n] == 0x42);
+        }
+
+        for (unsigned int byte = 0; byte < 256; byte++) {
+                unsigned char b = (unsigned char)byte;
+                PixelsExpandMask(alpha, &b, 8);
+                for (unsigned int i = 0; i < 8; i++)
+                        CHECK(alpha[i] == ((byte >> (7 - i)) & 1 ? 0x00 : 0xff));
+        }
+}
+
+int
+main(void)
+{
+        for (int level = PIXELS_SCALAR; level <= PixelsSupportedLevel(); level++) {
+                CHECK(PixelsUseLevel((PixelsLevel)level));
+                TestRows((PixelsLevel)level);
+                TestPremultiply((PixelsLevel)level);
+                TestConverters((PixelsLevel)level);
+        }
+        CHECK(PixelsSupportedLevel() == PIXELS_AVX2 || !PixelsUseLevel(PIXELS_AVX2));
+
+        TestExpandMask();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "recording.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Tests recording a made-up desktop and replaying it: the replayed
+ * windows, titles, and icons are those that were recorded, a window list
+ * built from the replay is the same as one built from the desktop, and
+ * nothing replayed is ever handed to Windows, as the handles of recorded
+ * windows may well be those of unrelated windows on this desktop. */
+
+#define RECORDING_PATH  L"obj/test-recording.dat"
+
+static Font s_font(12.0f);
+
+/* Creates a desktop of N_WINDOWS windows, a few of which are owned,
+ * hidden, tool windows, or untitled. */
+static FakeSource *
+NewDesktop(int n_windows)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+
+        HWND shell = FakeSourceCreate(fake, NULL, 0, L"Program Manager");
+        CHECK(shell != NULL);
+        FakeSourceSetShell(fake, shell);
+
+        for (int i = 0; i < n_windows; i++) {
+                TCHAR title[32];
+                StringCchPrintf(title, _countof(title), L"window %d", i);
+                HWND owner = (i % 5 == 4) ? FakeSourceNth(fake, 1 + i % 3) : NULL;
+                HWND window = FakeSourceCreate(fake, owner, (i % 7 == 6) ? WS_EX_TOOLWINDOW : 0,
+                                               (i % 11 == 10) ? L"" : title);
+                CHECK(window != NULL);
+                FakeSourceWindow(fake, window)->is_visible = i % 13 != 12;
+        }
+
+        return fake;
+}
+
+/* Checks that WINDOW’s icon in SOURCE is an opaque one of DELTA by DELTA
+ * in COLOR. */
+static void
+CheckIcon(WindowSource *source, HWND window, UINT delta, DWORD color)
+{
+        WindowSourceIcon icon;
+        BOOL was_hung;
+        CHECK(WindowSourceSmallIcon(source, window, &icon, &was_hung));
+        CHECK(!was_hung);
+        CHECK(icon.width == delta && icon.height == delta);
+        for (UINT i = 0; i < delta * delta; i++)
+                CHECK(memcmp(icon.color + i * sizeof(color), &color, sizeof(color)) == 0);
+        for (SIZE_T i = 0; i < WindowSourceIconMaskSize(delta, delta); i++)
+                CHECK(icon.mask[i] == 0);
+        WindowSourceIconFree(&icon);
+}
+
+static void
+CheckTitle(WindowSource *source, WindowSource *replay, HWND window)
+{
+        LPTSTR title, replayed_title;
+        BOOL has_title = WindowSourceTitle(source, window, &title);
+        CHECK(WindowSourceTitle(replay, window, &replayed_title) == has_title);
+        if (!has_title)
+                return;
+
+        CHECK(lstrcmp(title, replayed_title) == 0);
+        FREE(title);
+        FREE(replayed_title);
+}
+
+/* Everything asked of a replayed window is what was recorded, without a
+ * single call to Windows. */
+static void
+TestReplay(void)
+{
+        FakeSource *fake = NewDesktop(60);
+        WindowSource *source = FakeSourceSource(fake);
+        HWND hung = FakeSourceNth(fake, 3);
+        FakeSourceWindow(fake, hung)->is_hung = TRUE;
+        CHECK(RecordingWrite(source, RECORDING_PATH));
+
+        UINT calls = g_win32_window_calls;
+
+        Recording *recording = RecordingRead(RECORDING_PATH);
+        CHECK(recording != NULL);
+        WindowSource *replay = RecordingSource(recording);
+
+        CHECK(WindowSourceShell(replay) == WindowSourceShell(source));
+        for (int i = 0; i < FakeSourceLength(fake); i++) {
+                HWND window = FakeSourceNth(fake, i);
+                CHECK(WindowSourceExists(replay, window));
+                CHECK(WindowSourceOwner(replay, window) == WindowSourceOwner(source, window));
+                CHECK(WindowSourceIsVisible(replay, window) == WindowSourceIsVisible(source, window));
+                CHECK(WindowSourceExStyle(replay, window) == WindowSourceExStyle(source, window));
+                CheckTitle(source, replay, window);
+                if (window != hung)
+                        CheckIcon(replay, window, 16, FakeSourceIconColor(window));
+        }
+
+        /* Only small icons are recorded. */
+        WindowSourceIcon icon;
+        BOOL was_hung;
+        CHECK(!WindowSourceBigIcon(replay, FakeSourceNth(fake, 0), &icon, &was_hung));
+        CHECK(!was_hung);
+
+        CHECK(!WindowSourceSmallIcon(replay, hung, &icon, &was_hung));
+        CHECK(was_hung);
+
+        /* Windows created since weren’t recorded. */
+        HWND created = FakeSourceCreate(fake, NULL, 0, L"created");
+        CHECK(!WindowSourceExists(replay, created));
+        CHECK(!WindowSourceSmallIcon(replay, created, &icon, &was_hung));
+        CHECK(!WindowSourceSwitchTo(replay, created));
+
+        CHECK(g_win32_window_calls == calls);
+
+        RecordingFree(recording);
+        FakeSourceFree(fake);
+        CHECK(DeleteFile(RECORDING_PATH));
+}
+
+/* A window list built from a replay lists the same windows, with the
+ * same owners, as one built from the desktop that was recorded, and
+ * switching to its items doesn’t switch to anything on this desktop. */
+static void
+TestReplayedList(void)
+{
+        FakeSource *fake = NewDesktop(200);
+        WindowSource *source = FakeSourceSource(fake);
+        CHECK(RecordingWrite(source, RECORDING_PATH));
+
+        UINT calls = g_win32_window_calls;
+
+        Recording *recording = RecordingRead(RECORDING_PATH);
+        CHECK(recording != NULL);
+
+        WindowList *list = WindowListNewFromSource(source, &s_font);
+        WindowList *replayed_list = WindowListNewFromSource(RecordingSource(recording), &s_font);
+        CHECK(list != NULL && replayed_list != NULL);
+
+        int n_items = WindowListLength(list);
+        CHECK(n_items > 100);
+        CHECK(WindowListLength(replayed_list) == n_items);
+        for (int i = 1; i <= n_items; i++) {
+                WindowListItem *item = WindowListNthShown(list, i);
+                WindowListItem *replayed_item = WindowListNthShown(replayed_list, i);
+                CHECK(WindowListItemWindow(replayed_item) == WindowListItemWindow(item));
+                CHECK(WindowListItemOwner(replayed_item) == WindowListItemOwner(item));
+                CHECK(!WindowListItemSwitchTo(replayed_item));
+        }
+
+        CHECK(g_win32_window_calls == calls);
+
+        /* Switching to an item of the desktop’s list raises its window,
+         * still without asking Windows. */
+        WindowListItem *last = WindowListNthShown(list, n_items);
+        CHECK(WindowListItemSwitchTo(last));
+        CHECK(FakeSourceNth(fake, 0) == WindowListItemWindow(last));
+
+        FakeSourceCounters counters;
+        FakeSourceCountersGet(fake, &counters);
+        CHECK(counters.switches == 1);
+        CHECK(g_win32_window_calls == calls);
+
+        WindowListFree(replayed_list);
+        WindowListFree(list);
+        RecordingFree(recording);
+        FakeSourceFree(fake);
+        CHECK(DeleteFile(RECORDING_PATH));
+}
+
+/* Recordings that were cut short, or aren’t recordings at all, aren’t
+ * read. */
+static void
+TestInvalid(void)
+{
+        FakeSource *fake = NewDesktop(10);
+        CHECK(RecordingWrite(FakeSourceSource(fake), RECORDING_PATH));
+        FakeSourceFree(fake);
+
+        HANDLE file = CreateFile(RECORDING_PATH, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+        CHECK(file != INVALID_HANDLE_VALUE);
+        DWORD size = GetFileSize(file, NULL);
+        BYTE *contents = ALLOC_N(BYTE, size);
+        CHECK(contents != NULL);
+        DWORD n_read;
+        CHECK(ReadFile(file, contents, size, &n_read, NULL) && n_read == size);
+        CloseHandle(file);
+
+        DWORD const sizes[] = { 0, 4, 20, size / 2, size - 1 };
+        for (int i = 0; i < (int)_countof(sizes); i++) {
+                file = CreateFile(RECORDING_PATH, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, NULL);
+                CHECK(file != INVALID_HANDLE_VALUE);
+                DWORD n_written;
+                CHECK(WriteFile(file, contents, sizes[i], &n_written, NULL) && n_written == sizes[i]);
+                CloseHandle(file);
+
+                CHECK(RecordingRead(RECORDING_PATH) == NULL);
+        }
+
+        FREE(contents);
+        CHECK(DeleteFile(RECORDING_PATH));
+        CHECK(RecordingRead(RECORDING_PATH) == NULL);
+}
+
+int
+main(void)
+{
+        TestReplay();
+        TestReplayedList();
+        TestInvalid();
+
+        return EXIT_SUCCESS;
+}
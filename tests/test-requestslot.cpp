@@ -0,0 +1,336 @@
+﻿#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "requestslot.h"
+#include "test.h"
+
+/* Tests RequestSlot, first going through its states one call at a time
+ * and then stressing it with a worker thread that works on a shared
+ * list the way a Filter’s worker does, while requests are posted and
+ * cancelled, and the list is changed after each cancellation, as fast
+ * as they can be.  Both threads yield now and then, so that they
+ * interleave even on a single processor. */
+
+static void
+TestStates(void)
+{
+        RequestSlot slot;
+        RequestSlotInit(&slot);
+
+        int a, b;
+        long generation;
+        CHECK(RequestSlotTake(&slot, &generation) == NULL);
+        CHECK(!RequestSlotIsBusy(&slot));
+
+        CHECK(RequestSlotPost(&slot, &a) == NULL);
+        CHECK(RequestSlotPost(&slot, &b) == &a);
+        CHECK(RequestSlotTake(&slot, &generation) == &b);
+        CHECK(RequestSlotIsCurrent(&slot, generation));
+        CHECK(RequestSlotIsBusy(&slot));
+        CHECK(RequestSlotTake(&slot, &generation) == NULL);
+        CHECK(RequestSlotFinish(&slot, generation));
+        CHECK(!RequestSlotIsBusy(&slot));
+
+        CHECK(RequestSlotPost(&slot, &a) == NULL);
+        CHECK(RequestSlotTake(&slot, &generation) == &a);
+        CHECK(RequestSlotPost(&slot, &b) == NULL);
+        CHECK(!RequestSlotIsCurrent(&slot, generation));
+        CHECK(!RequestSlotFinish(&slot, generation));
+        CHECK(RequestSlotTake(&slot, &generation) == &b);
+        CHECK(RequestSlotCancel(&slot) == NULL);
+        CHECK(RequestSlotIsBusy(&slot));
+        CHECK(!RequestSlotFinish(&slot, generation));
+
+        CHECK(RequestSlotPost(&slot, &a) == NULL);
+        CHECK(RequestSlotCancel(&slot) == &a);
+        CHECK(RequestSlotTake(&slot, &generation) == NULL);
+
+        slot.generation = 0x7fffffffL;
+        CHECK(RequestSlotPost(&slot, &a) == NULL);
+        CHECK(RequestSlotTake(&slot, &generation) == &a);
+        CHECK(RequestSlotIsCurrent(&slot, generation));
+        CHECK(RequestSlotFinish(&slot, generation));
+}
+
+/* The number of items of the list the worker works on. */
+#define LIST_LENGTH     1024
+
+/* The number of things done to the worker by the stress test. */
+#define N_OPERATIONS    200000
+
+/* A request to sum LIST, made when all its items were VERSION. */
+typedef struct _Request Request;
+
+struct _Request
+{
+        int version;
+};
+
+/* A result of a request made at GENERATION when the list was at
+ * VERSION, SUM being the sum of the list’s items. */
+typedef struct _Result Result;
+
+struct _Result
+{
+        long generation;
+        int version;
+        long sum;
+        Result *next;
+};
+
+/* The worker and what it shares with the thread posting requests.
+ *
+ * LOCK protects SLOT, apart from checking its generation, QUIT, and
+ * RESULTS.
+ * WAKE is signalled when a request is posted, and IDLE when the worker
+ * is done with one.
+ * LIST is only changed when the worker isn’t busy.
+ * RESULTS are those handed back, newest first.
+ * N_REQUESTS counts the requests made but not freed, N_TORN the runs
+ * that saw the list change under them, N_ABANDONED the runs that gave
+ * up, and N_DROPPED the results that were superseded by the time the
+ * worker finished. */
+typedef struct _Worker Worker;
+
+struct _Worker
+{
+        pthread_mutex_t lock;
+        pthread_cond_t wake;
+        pthread_cond_t idle;
+        RequestSlot slot;
+        int quit;
+        volatile int list[LIST_LENGTH];
+        Result *results;
+        int n_requests;
+        int n_torn;
+        int n_abandoned;
+        int n_dropped;
+};
+
+static void
+RequestFree(Worker *worker, Request *request)
+{
+        if (request == NULL)
+                return;
+
+        free(request);
+        __atomic_sub_fetch(&worker->n_requests, 1, __ATOMIC_RELAXED);
+}
+
+/* Sums the list of WORKER for REQUEST, made at GENERATION, giving up if
+ * it’s superseded, and yielding before item YIELD_AT, if there’s such an
+ * item.  Returns NULL if it was superseded. */
+static Result *
+WorkerRun(Worker *worker, Request *request, long generation, int yield_at)
+{
+        long sum = 0;
+        int first = worker->list[0];
+
+        for (int i = 0; i < LIST_LENGTH; i++) {
+                if (!RequestSlotIsCurrent(&worker->slot, generation)) {
+                        __atomic_add_fetch(&worker->n_abandoned, 1, __ATOMIC_RELAXED);
+                        return NULL;
+                }
+
+                if (i == yield_at)
+                        sched_yield();
+
+                int item = worker->list[i];
+                if (item != first)
+                        __atomic_add_fetch(&worker->n_torn, 1, __ATOMIC_RELAXED);
+                sum += item;
+        }
+
+        Result *result = (Result *)calloc(1, sizeof(Result));
+        CHECK(result != NULL);
+        result->generation = generation;
+        result->version = request->version;
+        result->sum = sum;
+
+        return result;
+}
+
+static void *
+WorkerThread(void *closure)
+{
+        Worker *worker = (Worker *)closure;
+        unsigned int state = 2;
+
+        pthread_mutex_lock(&worker->lock);
+        for (;;) {
+                long generation;
+                Request *request = (Request *)RequestSlotTake(&worker->slot, &generation);
+                if (worker->quit) {
+                        if (request != NULL) {
+                                RequestSlotFinish(&worker->slot, generation);
+                                RequestFree(worker, request);
+                        }
+                        break;
+                }
+                if (request == NULL) {
+                        pthread_cond_wait(&worker->wake, &worker->lock);
+                        continue;
+                }
+                pthread_mutex_unlock(&worker->lock);
+
+                int yield_at = (int)(TestRandom(&state) % (2 * LIST_LENGTH));
+                Result *result = WorkerRun(worker, request, generation, yield_at);
+                RequestFree(worker, request);
+
+                pthread_mutex_lock(&worker->lock);
+                if (RequestSlotFinish(&worker->slot, generation) && result != NULL) {
+                        result->next = worker->results;
+                        worker->results = result;
+                } else if (result != NULL) {
+                        worker->n_dropped++;
+                        free(result);
+                }
+                pthread_cond_broadcast(&worker->idle);
+        }
+        pthread_mutex_unlock(&worker->lock);
+
+        return NULL;
+}
+
+static void
+WorkerPost(Worker *worker, int version)
+{
+        Request *request = (Request *)malloc(sizeof(Request));
+        CHECK(request != NULL);
+        request->version = version;
+        __atomic_add_fetch(&worker->n_requests, 1, __ATOMIC_RELAXED);
+
+        pthread_mutex_lock(&worker->lock);
+        Request *superseded = (Request *)RequestSlotPost(&worker->slot, request);
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+
+        RequestFree(worker, superseded);
+}
+
+/* Cancels what WORKER is doing and waits until it has let go of its
+ * list, as FilterCancel() does. */
+static void
+WorkerCancel(Worker *worker)
+{
+        pthread_mutex_lock(&worker->lock);
+        Request *cancelled = (Request *)RequestSlotCancel(&worker->slot);
+        while (RequestSlotIsBusy(&worker->slot))
+                pthread_cond_wait(&worker->idle, &worker->lock);
+        pthread_mutex_unlock(&worker->lock);
+
+        RequestFree(worker, cancelled);
+}
+
+/* Takes the results handed back by WORKER, checking that those that are
+ * still current are for VERSION of the list.  Returns the number of
+ * those. */
+static int
+WorkerTakeResults(Worker *worker, int version)
+{
+        pthread_mutex_lock(&worker->lock);
+        Result *results = worker->results;
+        worker->results = NULL;
+        pthread_mutex_unlock(&worker->lock);
+
+        int n_current = 0;
+        while (results != NULL) {
+                Result *next = results->next;
+                if (RequestSlotIsCurrent(&worker->slot, results->generation)) {
+                        CHECK(results->version == version);
+                        CHECK(results->sum == (long)version * LIST_LENGTH);
+                        n_current++;
+                }
+                free(results);
+                results = next;
+        }
+
+        return n_current;
+}
+
+static void
+WorkerSetList(Worker *worker, int version)
+{
+        for (int i = 0; i < LIST_LENGTH; i++)
+                worker->list[i] = version;
+}
+
+static void
+TestStress(void)
+{
+        Worker worker;
+        memset(&worker, 0, sizeof(worker));
+        pthread_mutex_init(&worker.lock, NULL);
+        pthread_cond_init(&worker.wake, NULL);
+        pthread_cond_init(&worker.idle, NULL);
+        RequestSlotInit(&worker.slot);
+
+        int version = 1;
+        WorkerSetList(&worker, version);
+
+        pthread_t thread;
+        CHECK(pthread_create(&thread, NULL, WorkerThread, &worker) == 0);
+
+        unsigned int state = 1;
+        int n_current = 0;
+        for (int i = 0; i < N_OPERATIONS; i++) {
+                switch (TestRandom(&state) % 4) {
+                case 0:
+                case 1:
+                        WorkerPost(&worker, version);
+                        break;
+                case 2:
+                        WorkerCancel(&worker);
+                        WorkerSetList(&worker, ++version);
+                        break;
+                case 3:
+                        n_current += WorkerTakeResults(&worker, version);
+                        break;
+                }
+                if (TestRandom(&state) % 8 == 0)
+                        sched_yield();
+        }
+
+        /* The last request is always answered. */
+        WorkerPost(&worker, version);
+        int n_last = 0;
+        while (n_last == 0) {
+                pthread_mutex_lock(&worker.lock);
+                while (worker.results == NULL)
+                        pthread_cond_wait(&worker.idle, &worker.lock);
+                pthread_mutex_unlock(&worker.lock);
+                n_last = WorkerTakeResults(&worker, version);
+        }
+        CHECK(n_last == 1);
+        n_current++;
+
+        pthread_mutex_lock(&worker.lock);
+        worker.quit = 1;
+        pthread_cond_signal(&worker.wake);
+        pthread_mutex_unlock(&worker.lock);
+        CHECK(pthread_join(thread, NULL) == 0);
+        WorkerTakeResults(&worker, version);
+        RequestFree(&worker, (Request *)RequestSlotCancel(&worker.slot));
+
+        CHECK(worker.n_torn == 0);
+        CHECK(worker.n_requests == 0);
+        CHECK(!RequestSlotIsBusy(&worker.slot));
+
+        printf("  %d operations: %d list versions, %d results current, "
+               "%d dropped, %d runs abandoned\n",
+               N_OPERATIONS, version, n_current, worker.n_dropped, worker.n_abandoned);
+
+        pthread_cond_destroy(&worker.idle);
+        pthread_cond_destroy(&worker.wake);
+        pthread_mutex_destroy(&worker.lock);
+}
+
+int
+main(void)
+{
+        TestStates();
+        TestStress();
+
+        return EXIT_SUCCESS;
+}
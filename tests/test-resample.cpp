@@ -0,0 +1,148 @@
+﻿#include <string.h>
+
+#include "pixels.h"
+#include "resample.h"
+#include "test.h"
+
+/* Tests the Resampler: that whole-factor downscales average blocks of
+ * pixels exactly, that resampling to the same size copies the pixels,
+ * that solid colors stay solid and that what comes out is always validly
+ * premultiplied, whatever the sizes, and that strides are honored. */
+
+#define MAX_SIZE        64
+
+/* The sizes that icons are resampled between, and a few odd ones. */
+static unsigned int const s_sizes[][4] = {
+        { 32, 32, 16, 16 }, { 48, 48, 16, 16 }, { 256, 256, 32, 32 }, { 24, 24, 16, 16 },
+        { 20, 20, 16, 16 }, { 16, 16, 20, 20 }, { 16, 16, 32, 32 }, { 32, 32, 24, 24 },
+        { 7, 5, 3, 9 }, { 1, 1, 16, 16 }, { 16, 16, 1, 1 }, { 3, 64, 64, 3 },
+};
+
+static PixelsARGB s_source[256 * 256];
+static PixelsARGB s_destination[MAX_SIZE * (MAX_SIZE + 1)];
+
+static void
+RandomPremultiplied(PixelsARGB *pixels, unsigned int n, unsigned int *state)
+{
+        for (unsigned int i = 0; i < n; i++)
+                pixels[i] = TestRandom(state) ^ (TestRandom(state) << 16);
+        PixelsPremultiply(pixels, pixels, n);
+}
+
+static void
+TestNew(void)
+{
+        CHECK(ResamplerNew(0, 16, 16, 16) == NULL);
+        CHECK(ResamplerNew(16, 16, 16, 0) == NULL);
+
+        Resampler *resampler = ResamplerNew(32, 24, 16, 12);
+        CHECK(resampler != NULL);
+        CHECK(ResamplerMatches(resampler, 32, 24, 16, 12));
+        CHECK(!ResamplerMatches(resampler, 24, 32, 16, 12));
+        CHECK(!ResamplerMatches(resampler, 32, 24, 12, 16));
+        ResamplerFree(resampler);
+        ResamplerFree(NULL);
+}
+
+static void
+TestBox(void)
+{
+        unsigned int state = 1;
+
+        for (unsigned int factor = 1; factor <= 4; factor++) {
+                unsigned int size = 16, source_size = size * factor;
+                Resampler *resampler = ResamplerNew(source_size, source_size, size, size);
+                CHECK(resampler != NULL);
+
+                RandomPremultiplied(s_source, source_size * source_size, &state);
+                CHECK(ResamplerRun(resampler, s_destination, size * sizeof(PixelsARGB),
+                                   s_source, source_size * sizeof(PixelsARGB)));
+
+                for (unsigned int y = 0; y < size; y++) {
+                        for (unsigned int x = 0; x < size; x++) {
+                                PixelsARGB pixel = s_destination[y * size + x];
+                                for (unsigned int shift = 0; shift < 32; shift += 8) {
+                                        unsigned int sum = 0;
+                                        for (unsigned int j = 0; j < factor; j++)
+                                                for (unsigned int i = 0; i < factor; i++)
+                                                        sum += (s_source[(y * factor + j) * source_size +
+                                                                         x * factor + i] >> shift) & 0xff;
+                                        unsigned int n = factor * factor;
+                                        CHECK(((pixel >> shift) & 0xff) == (sum + n / 2) / n);
+                                }
+                        }
+                }
+
+                ResamplerFree(resampler);
+        }
+}
+
+static void
+TestSizes(void)
+{
+        unsigned int state = 2;
+
+        for (unsigned int s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); s++) {
+                unsigned int source_width = s_sizes[s][0], source_height = s_sizes[s][1];
+                unsigned int width = s_sizes[s][2], height = s_sizes[s][3];
+                Resampler *resampler = ResamplerNew(source_width, source_height, width, height);
+                CHECK(resampler != NULL);
+
+                for (unsigned int i = 0; i < source_width * source_height; i++)
+                        s_source[i] = 0xff336699;
+                CHECK(ResamplerRun(resampler, s_destination, width * sizeof(PixelsARGB),
+                                   s_source, source_width * sizeof(PixelsARGB)));
+                for (unsigned int i = 0; i < width * height; i++)
+                        CHECK(s_destination[i] == 0xff336699);
+
+                /* NOTE: Each destination row is followed by a pixel that
+                 * must be left alone. */
+                RandomPremultiplied(s_source, source_width * source_height, &state);
+                memset(s_destination, 0x42, sizeof(s_destination));
+                CHECK(ResamplerRun(resampler, s_destination, (width + 1) * sizeof(PixelsARGB),
+                                   s_source, source_width * sizeof(PixelsARGB)));
+                for (unsigned int y = 0; y < height; y++) {
+                        for (unsigned int x = 0; x < width; x++) {
+                                PixelsARGB pixel = s_destination[y * (width + 1) + x];
+                                unsigned int alpha = pixel >> 24;
+                                CHECK(((pixel >> 16) & 0xff) <= alpha);
+                                CHECK(((pixel >> 8) & 0xff) <= alpha);
+                                CHECK((pixel & 0xff) <= alpha);
+                        }
+                        CHECK(s_destination[y * (width + 1) + width] == 0x42424242);
+                }
+
+                ResamplerFree(resampler);
+        }
+}
+
+/* Checks that a transparent pixel doesn’t change the color of its opaque
+ * neighbors, which it would if the colors weren’t premultiplied. */
+static void
+TestTransparent(void)
+{
+        PixelsARGB const source[4] = { 0xffff0000, 0xffff0000, 0x00000000, 0xffff0000 };
+        PixelsARGB pixel;
+
+        Resampler *resampler = ResamplerNew(2, 2, 1, 1);
+        CHECK(resampler != NULL);
+        CHECK(ResamplerRun(resampler, &pixel, sizeof(pixel), source, 2 * sizeof(PixelsARGB)));
+        CHECK(pixel == 0xbfbf0000);
+
+        PixelsARGB unpremultiplied;
+        PixelsUnpremultiply(&unpremultiplied, &pixel, 1);
+        CHECK((unpremultiplied & 0x00ffffff) == 0x00ff0000);
+
+        ResamplerFree(resampler);
+}
+
+int
+main(void)
+{
+        TestNew();
+        TestBox();
+        TestSizes();
+        TestTransparent();
+
+        return EXIT_SUCCESS;
+}
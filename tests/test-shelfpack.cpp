@@ -0,0 +1,158 @@
+﻿#include "shelfpack.h"
+#include "test.h"
+
+/* Tests the ShelfPacker, first placing a few rectangles by hand and then
+ * packing and releasing icon-sized rectangles at random, as windows come
+ * and go, checking that packed rectangles never overlap or leave the
+ * area, that released room is reused, and that fragmentation stays
+ * bounded. */
+
+#define MAX_LIVE        300
+#define N_EDITS         200000
+
+static int
+Overlap(ShelfSlot const *a, ShelfSlot const *b)
+{
+        return a->x < b->x + b->width && b->x < a->x + a->width &&
+               a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static void
+CheckUsage(ShelfPacker const *packer, unsigned long expected_used, unsigned long expected_reserved)
+{
+        unsigned long used, reserved;
+        ShelfPackerUsage(packer, &used, &reserved);
+        CHECK(used == expected_used);
+        CHECK(reserved == expected_reserved);
+}
+
+static void
+TestShelves(void)
+{
+        ShelfPacker *packer = ShelfPackerNew(64, 32);
+        CHECK(packer != NULL);
+
+        ShelfSlot slots[6];
+        for (unsigned int i = 0; i < 4; i++) {
+                CHECK(ShelfPackerAlloc(packer, 16, 16, &slots[i]));
+                CHECK(slots[i].x == 16 * i && slots[i].y == 0);
+                CHECK(slots[i].width == 16 && slots[i].height == 16);
+        }
+        CheckUsage(packer, 4 * 16 * 16, 64 * 16);
+
+        /* A shorter rectangle goes on a new shelf, as the one there is
+         * full, and then there’s no room for a taller one. */
+        CHECK(ShelfPackerAlloc(packer, 16, 8, &slots[4]));
+        CHECK(slots[4].x == 0 && slots[4].y == 16);
+        CHECK(!ShelfPackerAlloc(packer, 16, 16, &slots[5]));
+        ShelfPackerGrow(packer, 64);
+        CHECK(ShelfPackerHeight(packer) == 64);
+        CHECK(ShelfPackerAlloc(packer, 16, 16, &slots[5]));
+        CHECK(slots[5].x == 0 && slots[5].y == 24);
+        CheckUsage(packer, 5 * 16 * 16 + 16 * 8, 64 * 40);
+
+        /* Released room is reused, by a rectangle as wide or narrower. */
+        ShelfPackerRelease(packer, &slots[1]);
+        CHECK(ShelfPackerAlloc(packer, 8, 16, &slots[1]));
+        CHECK(slots[1].x == 16 && slots[1].y == 0);
+        ShelfPackerRelease(packer, &slots[1]);
+        ShelfPackerRelease(packer, &slots[2]);
+        CHECK(ShelfPackerAlloc(packer, 32, 16, &slots[1]));
+        CHECK(slots[1].x == 16 && slots[1].y == 0);
+
+        CHECK(!ShelfPackerAlloc(packer, 65, 1, &slots[2]));
+        CHECK(!ShelfPackerAlloc(packer, 0, 16, &slots[2]));
+
+        /* Releasing everything removes the shelves. */
+        ShelfPackerRelease(packer, &slots[0]);
+        ShelfPackerRelease(packer, &slots[1]);
+        ShelfPackerRelease(packer, &slots[3]);
+        ShelfPackerRelease(packer, &slots[4]);
+        ShelfPackerRelease(packer, &slots[5]);
+        CheckUsage(packer, 0, 0);
+        CHECK(ShelfPackerAlloc(packer, 64, 64, &slots[0]));
+
+        ShelfPackerFree(packer);
+        ShelfPackerFree(NULL);
+}
+
+/* Packs icons of the sizes applications use, mostly small ones, and
+ * releases them at random, growing the packer whenever it’s full, as the
+ * icon atlas does.  Every so often most icons are released at once, as
+ * when many windows are closed. */
+static void
+TestRandomEdits(void)
+{
+        static unsigned int const sizes[] = { 16, 16, 16, 16, 20, 24, 32 };
+        static ShelfSlot live[MAX_LIVE];
+        unsigned int n_live = 0;
+        unsigned long used = 0;
+        unsigned int n_grows = 0;
+        double lowest_fill = 1.0;
+
+        ShelfPacker *packer = ShelfPackerNew(256, 64);
+        CHECK(packer != NULL);
+
+        unsigned int state = 7;
+        for (int edit = 0; edit < N_EDITS; edit++) {
+                if (n_live == 0 || (n_live < MAX_LIVE && TestRandom(&state) % 100 < 55)) {
+                        unsigned int size = sizes[TestRandom(&state) % (sizeof(sizes) / sizeof(sizes[0]))];
+                        ShelfSlot *slot = &live[n_live];
+                        while (!ShelfPackerAlloc(packer, size, size, slot)) {
+                                ShelfPackerGrow(packer, ShelfPackerHeight(packer) * 2);
+                                CHECK(++n_grows <= 4);
+                        }
+                        CHECK(slot->x + slot->width <= 256);
+                        CHECK(slot->y + slot->height <= ShelfPackerHeight(packer));
+                        for (unsigned int i = 0; i < n_live; i++)
+                                CHECK(!Overlap(&live[i], slot));
+                        n_live++;
+                        used += size * size;
+                } else {
+                        unsigned int i = TestRandom(&state) % n_live;
+                        ShelfPackerRelease(packer, &live[i]);
+                        used -= live[i].width * live[i].height;
+                        live[i] = live[--n_live];
+                }
+
+                /* NOTE: Shelves are never moved, so fragmentation is
+                 * only bounded while the packer is full enough; it’s
+                 * checked before most of the icons are released. */
+                if (edit % 20000 == 19999) {
+                        unsigned long packed, reserved;
+                        ShelfPackerUsage(packer, &packed, &reserved);
+                        double fill = (double)packed / reserved;
+                        CHECK(fill >= 0.5);
+                        if (fill < lowest_fill)
+                                lowest_fill = fill;
+                        while (n_live > 50) {
+                                n_live--;
+                                ShelfPackerRelease(packer, &live[n_live]);
+                                used -= live[n_live].width * live[n_live].height;
+                        }
+                }
+
+                unsigned long packed, reserved;
+                ShelfPackerUsage(packer, &packed, &reserved);
+                CHECK(packed == used);
+                CHECK(reserved >= used);
+        }
+
+        printf("  at least %.0f%% of reserved room used with up to %u icons, %u pixels tall\n",
+               100.0 * lowest_fill, MAX_LIVE, ShelfPackerHeight(packer));
+
+        while (n_live > 0)
+                ShelfPackerRelease(packer, &live[--n_live]);
+        CheckUsage(packer, 0, 0);
+
+        ShelfPackerFree(packer);
+}
+
+int
+main(void)
+{
+        TestShelves();
+        TestRandomEdits();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,308 @@
+﻿#include "stdafx.h"
+
+#include "buffer.h"
+#include "textmetrics.h"
+#include "textfield.h"
+
+#include "test.h"
+
+/* Tests that a TextField’s width, kept as prefix sums of the advances of
+ * its characters, follows the changes made to its buffer, by measuring
+ * with fake metrics in which every character has its own advance and
+ * strings measured as a whole are a quarter wider than the sum of their
+ * characters’ advances.  The quarter sets apart the widths that were
+ * measured as a whole from those that were summed. */
+
+#define WHOLE_EXTRA     0.25f
+
+/* A character needing shaping, see TextMetricsIsComplex(). */
+#define COMBINING_ACUTE 0x0301
+
+static Font s_font(12.0f);
+static UINT s_n_measured;
+
+static REAL
+FakeAdvance(TCHAR c)
+{
+        return (REAL)(c % 7 + 1);
+}
+
+/* The TextMetricsMeasureFunc of the tests. */
+static Status
+FakeMeasure(LPCTSTR string, int length, REAL *width, VOID *closure)
+{
+        Canvas *canvas = (Canvas *)closure;
+        CHECK(canvas->font == &s_font);
+
+        s_n_measured++;
+
+        *width = 0.0f;
+        for (int i = 0; i < length; i++)
+                *width += FakeAdvance(string[i]);
+        if (length > 1)
+                *width += WHOLE_EXTRA;
+
+        return Ok;
+}
+
+/* Gets the width that FIELD should have given the contents of its
+ * buffer. */
+static REAL
+ExpectedWidth(TextField *field)
+{
+        Buffer *buffer = TextFieldBuffer(field);
+        LPCTSTR contents = BufferContents(buffer);
+        UINT length = BufferLength(buffer);
+
+        REAL width = 0.0f;
+        BOOL is_complex = FALSE;
+        for (UINT i = 0; i < length; i++) {
+                width += FakeAdvance(contents[i]);
+                is_complex = is_complex || TextMetricsIsComplex(contents[i]);
+        }
+        if (is_complex && length > 1)
+                width += WHOLE_EXTRA;
+
+        return width;
+}
+
+static REAL
+Width(TextField *field)
+{
+        Graphics graphics;
+        SizeF size;
+        CHECK(TextFieldSize(field, &graphics, &size) == Ok);
+
+        return size.Width;
+}
+
+static void
+PushString(Buffer *buffer, LPCTSTR string)
+{
+        for (LPCTSTR p = string; *p != L'\0'; p++)
+                CHECK(BufferPushChar(buffer, *p, 1));
+}
+
+/* Checks pushing, popping, and clearing one change at a time, and that
+ * each character is only measured once. */
+static void
+TestEdits(void)
+{
+        TextField *field = TextFieldNewWithMeasure(&s_font, FakeMeasure);
+        CHECK(field != NULL);
+        Buffer *buffer = TextFieldBuffer(field);
+
+        CHECK(Width(field) == 0.0f);
+
+        s_n_measured = 0;
+        PushString(buffer, L"abc");
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(s_n_measured == 3);
+
+        s_n_measured = 0;
+        PushString(buffer, L"ab");
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(s_n_measured == 0);
+
+        CHECK(BufferPopChar(buffer, 2));
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(BufferPopChar(buffer, 1));
+        CHECK(Width(field) == FakeAdvance(L'a') + FakeAdvance(L'b'));
+
+        /* The same length, but a different last character. */
+        CHECK(BufferPushChar(buffer, L'x', 1));
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(BufferPopChar(buffer, 1));
+        CHECK(BufferPushChar(buffer, L'y', 1));
+        CHECK(Width(field) == ExpectedWidth(field));
+
+        CHECK(BufferPushChar(buffer, L'z', 4));
+        CHECK(Width(field) == ExpectedWidth(field));
+
+        BufferClear(buffer);
+        CHECK(Width(field) == 0.0f);
+        PushString(buffer, L"zy");
+        CHECK(Width(field) == FakeAdvance(L'z') + FakeAdvance(L'y'));
+
+        /* A new font has new advances. */
+        s_n_measured = 0;
+        TextFieldSetFont(field, &s_font);
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(s_n_measured == 2);
+
+        TextFieldFree(field);
+}
+
+/* Checks that changes coalesced while batching are accounted for from
+ * the lowest offset any of them touched, not just where the last one
+ * started. */
+static void
+TestBatching(void)
+{
+        TextField *field = TextFieldNewWithMeasure(&s_font, FakeMeasure);
+        CHECK(field != NULL);
+        Buffer *buffer = TextFieldBuffer(field);
+
+        PushString(buffer, L"abcdef");
+        CHECK(Width(field) == ExpectedWidth(field));
+
+        BufferSetBatching(buffer, TRUE);
+        CHECK(BufferPopChar(buffer, 4));
+        PushString(buffer, L"uvw");
+        CHECK(BufferPopChar(buffer, 1));
+        PushString(buffer, L"xyz");
+        BufferFlush(buffer);
+        CHECK(Width(field) == ExpectedWidth(field));
+
+        CHECK(BufferPopChar(buffer, 2));
+        PushString(buffer, L"q");
+        BufferSetBatching(buffer, FALSE);
+        CHECK(Width(field) == ExpectedWidth(field));
+
+        TextFieldFree(field);
+}
+
+/* What a Buffer’s BUFFER_ON_CHANGE events reported. */
+typedef struct _Changes Changes;
+
+struct _Changes
+{
+        UINT n;
+        int delta;
+        UINT start;
+};
+
+static void
+RecordChange(Buffer *buffer, BufferEvent event, VOID *closure)
+{
+        Changes *changes = (Changes *)closure;
+        if (event & BUFFER_ON_CHANGE) {
+                changes->n++;
+                changes->delta = BufferChangeDelta(buffer);
+                changes->start = BufferChangeStart(buffer);
+        }
+}
+
+/* Checks that changes coalesced while batching are sent as one event
+ * carrying their net change in length, that changes cancelling each
+ * other out are seen to leave the contents as they were, and that the
+ * events are counted. */
+static void
+TestChangeEvents(void)
+{
+        TextField *field = TextFieldNewWithMeasure(&s_font, FakeMeasure);
+        CHECK(field != NULL);
+        Buffer *buffer = TextFieldBuffer(field);
+
+        Changes changes = { 0, 0, 0 };
+        CHECK(BufferRegisterListener(buffer, BUFFER_ON_CHANGE, RecordChange, &changes));
+
+        PushString(buffer, L"abc");
+        CHECK(changes.n == 3 && changes.delta == 1 && changes.start == 2);
+
+        BufferSetBatching(buffer, TRUE);
+        PushString(buffer, L"defg");
+        CHECK(BufferPopChar(buffer, 2));
+        CHECK(changes.n == 3);
+        BufferFlush(buffer);
+        CHECK(changes.n == 4 && changes.delta == 2 && changes.start == 3);
+
+        BufferFlush(buffer);
+        CHECK(changes.n == 4);
+
+        PushString(buffer, L"x");
+        CHECK(BufferPopChar(buffer, 1));
+        BufferFlush(buffer);
+        CHECK(changes.n == 5 && changes.delta == 0 && changes.start == BufferLength(buffer));
+
+        CHECK(BufferPopChar(buffer, 1));
+        PushString(buffer, L"y");
+        BufferFlush(buffer);
+        CHECK(changes.n == 6 && changes.delta == 0 && changes.start < BufferLength(buffer));
+
+        BufferEventCounters counters;
+        BufferEventCountersGet(buffer, &counters);
+        CHECK(counters.delivered == 6);
+        CHECK(counters.coalesced == 4 + 1 + 1);
+
+        BufferUnregisterListener(buffer, BUFFER_ON_CHANGE, RecordChange);
+        TextFieldFree(field);
+}
+
+/* Checks that characters needing shaping make the whole buffer be
+ * measured, and that summing resumes once they’re gone. */
+static void
+TestComplex(void)
+{
+        TextField *field = TextFieldNewWithMeasure(&s_font, FakeMeasure);
+        CHECK(field != NULL);
+        Buffer *buffer = TextFieldBuffer(field);
+
+        PushString(buffer, L"ae");
+        CHECK(BufferPushChar(buffer, COMBINING_ACUTE, 1));
+        PushString(buffer, L"b");
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(Width(field) != FakeAdvance(L'a') + FakeAdvance(L'e') +
+                              FakeAdvance(COMBINING_ACUTE) + FakeAdvance(L'b'));
+
+        CHECK(BufferPopChar(buffer, 1));
+        CHECK(Width(field) == ExpectedWidth(field));
+        CHECK(BufferPopChar(buffer, 1));
+        CHECK(Width(field) == FakeAdvance(L'a') + FakeAdvance(L'e'));
+
+        TextFieldFree(field);
+}
+
+/* Checks random sequences of changes, batched or not, against widths
+ * worked out from scratch. */
+static void
+TestRandomEdits(void)
+{
+        static TCHAR const characters[] = {
+                L'a', L'b', L'c', L'd', L'e', L'f', L'g', L' ', COMBINING_ACUTE,
+        };
+
+        TextField *field = TextFieldNewWithMeasure(&s_font, FakeMeasure);
+        CHECK(field != NULL);
+        Buffer *buffer = TextFieldBuffer(field);
+
+        unsigned int state = 1;
+        for (int i = 0; i < 100000; i++) {
+                BOOL batching = TestRandom(&state) % 4 == 0;
+                BufferSetBatching(buffer, batching);
+
+                int n_changes = batching ? TestRandom(&state) % 5 + 1 : 1;
+                for (int j = 0; j < n_changes; j++) {
+                        UINT length = BufferLength(buffer);
+                        UINT operation = TestRandom(&state) % 16;
+                        if (operation < 9 || length == 0) {
+                                TCHAR c = characters[TestRandom(&state) % _countof(characters)];
+                                CHECK(BufferPushChar(buffer, c, TestRandom(&state) % 2 + 1));
+                        } else if (operation < 15) {
+                                CHECK(BufferPopChar(buffer, TestRandom(&state) % min(length, 3) + 1));
+                        } else {
+                                BufferClear(buffer);
+                        }
+                }
+
+                BufferFlush(buffer);
+                CHECK(Width(field) == ExpectedWidth(field));
+
+                if (BufferLength(buffer) > 40)
+                        BufferClear(buffer);
+        }
+
+        TextFieldFree(field);
+}
+
+int
+main(void)
+{
+        TestEdits();
+        TestBatching();
+        TestChangeEvents();
+        TestComplex();
+        TestRandomEdits();
+
+        return EXIT_SUCCESS;
+}
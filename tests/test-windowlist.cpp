@@ -0,0 +1,465 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Tests which windows of made-up desktops end up in the window list,
+ * and with which owners, first on desktops that each exercise one of
+ * the rules, then on random desktops against a straightforward
+ * reimplementation of the rules that scans for windows with the same
+ * owner, as the window list did before it indexed them by owner. */
+
+#define APP     WS_EX_APPWINDOW
+#define TOOL    WS_EX_TOOLWINDOW
+#define PARENT  WS_EX_CONTROLPARENT
+
+static Font s_font(12.0f);
+
+/* An item of a window list, as expected or as found. */
+typedef struct _Item Item;
+
+struct _Item
+{
+        HWND window;
+        HWND owner;
+};
+
+/* Gets the N_ITEMS ITEMS of LIST, in order, into ITEMS, which has room
+ * for N_ALLOCATED of them. */
+static int
+GetItems(WindowList *list, Item *items, int n_allocated)
+{
+        int n_items = WindowListLength(list);
+        CHECK(n_items <= n_allocated);
+        for (int i = 0; i < n_items; i++) {
+                WindowListItem *item = WindowListNthShown(list, i + 1);
+                CHECK(item != NULL);
+                items[i].window = WindowListItemWindow(item);
+                items[i].owner = WindowListItemOwner(item);
+        }
+
+        return n_items;
+}
+
+/* Gets the N_ITEMS ITEMS of a window list built from FAKE, which has
+ * room for N_ALLOCATED of them. */
+static int
+ListItems(FakeSource *fake, Item *items, int n_allocated)
+{
+        WindowList *list = WindowListNewFromSource(FakeSourceSource(fake), &s_font);
+        CHECK(list != NULL);
+
+        int n_items = GetItems(list, items, n_allocated);
+
+        WindowListFree(list);
+
+        return n_items;
+}
+
+static void
+CheckItems(FakeSource *fake, Item const *expected, int n_expected)
+{
+        Item items[16];
+        CHECK(ListItems(fake, items, _countof(items)) == n_expected);
+        for (int i = 0; i < n_expected; i++) {
+                CHECK(items[i].window == expected[i].window);
+                CHECK(items[i].owner == expected[i].owner);
+        }
+}
+
+/* Unowned windows are listed in z-order, unless they’re hidden or tool
+ * windows. */
+static void
+TestUnowned(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+
+        HWND c = FakeSourceCreate(fake, NULL, 0, L"c");
+        HWND tool = FakeSourceCreate(fake, NULL, TOOL, L"tool");
+        HWND hidden = FakeSourceCreate(fake, NULL, 0, L"hidden");
+        FakeSourceWindow(fake, hidden)->is_visible = FALSE;
+        HWND b = FakeSourceCreate(fake, NULL, PARENT, L"b");
+        HWND a = FakeSourceCreate(fake, NULL, 0, L"a");
+        UNREFERENCED_PARAMETER(tool);
+
+        Item const expected[] = { { a, a }, { b, b }, { c, c } };
+        CheckItems(fake, expected, _countof(expected));
+
+        /* Application windows are listed even if they’re tool windows. */
+        HWND app_tool = FakeSourceCreate(fake, NULL, TOOL | APP, L"app tool");
+        Item const with_app_tool[] = { { app_tool, app_tool }, { a, a }, { b, b }, { c, c } };
+        CheckItems(fake, with_app_tool, _countof(with_app_tool));
+
+        FakeSourceFree(fake);
+}
+
+/* Owned windows are listed as their top-most owner, in the place of the
+ * top-most of them, unless they’re application windows.  Windows owned
+ * by the shell are as good as unowned. */
+static void
+TestOwned(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+
+        HWND shell = FakeSourceCreate(fake, NULL, 0, L"shell");
+        FakeSourceWindow(fake, shell)->is_visible = FALSE;
+        FakeSourceSetShell(fake, shell);
+
+        HWND main = FakeSourceCreate(fake, NULL, 0, L"main");
+        HWND dialog = FakeSourceCreate(fake, main, 0, L"dialog");
+        HWND subdialog = FakeSourceCreate(fake, dialog, 0, L"subdialog");
+        HWND app = FakeSourceCreate(fake, main, APP, L"app");
+        HWND desktop_owned = FakeSourceCreate(fake, shell, 0, L"owned by the shell");
+        UNREFERENCED_PARAMETER(subdialog);
+
+        Item const expected[] = {
+                { desktop_owned, desktop_owned },
+                { app, app },
+                { main, main },
+        };
+        CheckItems(fake, expected, _countof(expected));
+
+        FakeSourceRaise(fake, dialog);
+        Item const raised[] = {
+                { main, main },
+                { desktop_owned, desktop_owned },
+                { app, app },
+        };
+        CheckItems(fake, raised, _countof(raised));
+
+        /* Without the owner being visible, the top-most window it owns is
+         * listed in its place. */
+        FakeSourceWindow(fake, main)->is_visible = FALSE;
+        Item const hidden[] = {
+                { dialog, main },
+                { desktop_owned, desktop_owned },
+                { app, app },
+        };
+        CheckItems(fake, hidden, _countof(hidden));
+
+        FakeSourceFree(fake);
+}
+
+/* Tool windows owned by a window that isn’t a tool window, e.g., the
+ * palettes of Adobe Illustrator, which come before their owner in
+ * z-order, are listed as their owner, by their owner. */
+static void
+TestToolWindows(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+
+        HWND main = FakeSourceCreate(fake, NULL, 0, L"main");
+        HWND palette1 = FakeSourceCreate(fake, main, TOOL, L"palette 1");
+        HWND palette2 = FakeSourceCreate(fake, main, TOOL, L"palette 2");
+        UNREFERENCED_PARAMETER(palette1);
+        UNREFERENCED_PARAMETER(palette2);
+
+        Item const expected[] = { { main, main } };
+        CheckItems(fake, expected, _countof(expected));
+
+        /* Without the owner being visible, there’s nothing to list. */
+        FakeSourceWindow(fake, main)->is_visible = FALSE;
+        CheckItems(fake, NULL, 0);
+
+        /* Parts of a tool window are left out, unless they’re application
+         * windows or control parents that aren’t tool windows. */
+        HWND toolbox = FakeSourceCreate(fake, NULL, TOOL, L"toolbox");
+        HWND part = FakeSourceCreate(fake, toolbox, 0, L"part");
+        HWND tool_part = FakeSourceCreate(fake, toolbox, TOOL | PARENT, L"tool part");
+        HWND app_part = FakeSourceCreate(fake, toolbox, APP, L"app part");
+        HWND parent_part = FakeSourceCreate(fake, toolbox, PARENT, L"parent part");
+        UNREFERENCED_PARAMETER(part);
+        UNREFERENCED_PARAMETER(tool_part);
+
+        Item const parts[] = {
+                { parent_part, toolbox },
+                { app_part, app_part },
+        };
+        CheckItems(fake, parts, _countof(parts));
+
+        FakeSourceFree(fake);
+}
+
+/* The semi-added items of the reference, see WindowListSemiAddedItem. */
+typedef struct _SemiItem SemiItem;
+
+struct _SemiItem
+{
+        HWND window;
+        HWND owner;
+        BOOL keep;
+};
+
+static LONG_PTR
+ExStyle(FakeSource *fake, HWND window)
+{
+        return FakeSourceWindow(fake, window)->ex_style;
+}
+
+static HWND
+ReferenceTopmostOwner(FakeSource *fake, HWND window, HWND shell)
+{
+        HWND owner = window;
+        for (HWND next = FakeSourceWindow(fake, owner)->owner;
+             next != NULL && next != shell;
+             next = FakeSourceWindow(fake, owner)->owner)
+                owner = next;
+
+        return owner;
+}
+
+static BOOL
+ReferenceIsToolWindowPart(FakeSource *fake, HWND window, HWND owner)
+{
+        return (ExStyle(fake, owner) & TOOL) && !(ExStyle(fake, window) & APP) &&
+               ((ExStyle(fake, window) & TOOL) || !(ExStyle(fake, window) & PARENT));
+}
+
+/* Works out the ITEMS of a window list built from FAKE, whose shell’s
+ * window is SHELL, scanning the items collected so far, newest first,
+ * for one with the same owner. */
+static int
+ReferenceItems(FakeSource *fake, HWND shell, Item *items)
+{
+        int n_windows = FakeSourceLength(fake);
+        SemiItem *semi_items = (SemiItem *)malloc(sizeof(SemiItem) * max(n_windows, 1));
+        CHECK(semi_items != NULL);
+        int n_semi_items = 0;
+
+        for (int i = 0; i < n_windows; i++) {
+                HWND window = FakeSourceNth(fake, i);
+                if (!FakeSourceWindow(fake, window)->is_visible)
+                        continue;
+
+                HWND owner = ReferenceTopmostOwner(fake, window, shell);
+                HWND saved_owner = owner;
+
+                if (window != owner && (ExStyle(fake, window) & APP)) {
+                        owner = window;
+                } else {
+                        SemiItem *same = NULL;
+                        for (int j = n_semi_items - 1; j >= 0 && same == NULL; j--)
+                                if (semi_items[j].owner == owner)
+                                        same = &semi_items[j];
+
+                        if (same != NULL) {
+                                if (!(ExStyle(fake, window) & TOOL)) {
+                                        if (same->owner == window && !ReferenceIsToolWindowPart(fake, window, owner)) {
+                                                same->window = window;
+                                                same->owner = owner;
+                                        }
+                                        if (!(ExStyle(fake, same->window) & TOOL))
+                                                same->keep = TRUE;
+                                }
+                                continue;
+                        }
+                }
+
+                if (ReferenceIsToolWindowPart(fake, window, saved_owner))
+                        continue;
+
+                SemiItem *semi_item = &semi_items[n_semi_items++];
+                semi_item->window = window;
+                semi_item->owner = owner;
+                semi_item->keep = (ExStyle(fake, saved_owner) & TOOL) || !(ExStyle(fake, window) & TOOL);
+        }
+
+        int n_items = 0;
+        for (int i = 0; i < n_semi_items; i++) {
+                if (!semi_items[i].keep)
+                        continue;
+                items[n_items].window = semi_items[i].window;
+                items[n_items].owner = semi_items[i].owner;
+                n_items++;
+        }
+
+        free(semi_items);
+
+        return n_items;
+}
+
+/* Builds random desktops of N_WINDOWS windows, with owner chains of
+ * every length and every combination of the styles that matter. */
+static void
+TestRandomDesktops(int n_desktops, int n_windows)
+{
+        static LONG_PTR const styles[] = {
+                0, 0, 0, APP, TOOL, TOOL, PARENT, TOOL | PARENT, APP | TOOL, APP | PARENT,
+        };
+
+        Item *items = (Item *)malloc(sizeof(Item) * n_windows);
+        Item *expected = (Item *)malloc(sizeof(Item) * n_windows);
+        CHECK(items != NULL && expected != NULL);
+
+        unsigned int state = 1;
+        for (int i = 0; i < n_desktops; i++) {
+                FakeSource *fake = FakeSourceNew();
+                CHECK(fake != NULL);
+
+                HWND shell = FakeSourceCreate(fake, NULL, 0, L"shell");
+                FakeSourceWindow(fake, shell)->is_visible = FALSE;
+                FakeSourceSetShell(fake, shell);
+
+                HWND *windows = (HWND *)malloc(sizeof(HWND) * n_windows);
+                CHECK(windows != NULL);
+                for (int j = 0; j < n_windows; j++) {
+                        HWND owner = NULL;
+                        UINT kind = TestRandom(&state) % 10;
+                        if (kind < 4 && j > 0)
+                                owner = windows[TestRandom(&state) % j];
+                        else if (kind == 4)
+                                owner = shell;
+
+                        windows[j] = FakeSourceCreate(fake, owner, styles[TestRandom(&state) % _countof(styles)], L"w");
+                        CHECK(windows[j] != NULL);
+                        FakeSourceWindow(fake, windows[j])->is_visible = TestRandom(&state) % 8 != 0;
+
+                        if (TestRandom(&state) % 4 == 0)
+                                FakeSourceRaise(fake, windows[TestRandom(&state) % (j + 1)]);
+                }
+
+                int n_items = ListItems(fake, items, n_windows);
+                int n_expected = ReferenceItems(fake, shell, expected);
+                CHECK(n_items == n_expected);
+                for (int j = 0; j < n_items; j++) {
+                        CHECK(items[j].window == expected[j].window);
+                        CHECK(items[j].owner == expected[j].owner);
+                }
+
+                free(windows);
+                FakeSourceFree(fake);
+        }
+
+        free(expected);
+        free(items);
+}
+
+static BOOL
+HasItemOwnedBy(Item const *items, int n_items, HWND owner)
+{
+        for (int i = 0; i < n_items; i++)
+                if (items[i].owner == owner)
+                        return TRUE;
+
+        return FALSE;
+}
+
+/* Creates, destroys, replaces, activates, and changes the owners of
+ * random windows of a random desktop, updating a window list as the
+ * events of the desktop would, or refreshing it, and checks that what
+ * the list finds by owner is what a scan of its items finds, as the list
+ * scanned them before it indexed them by owner.  Refreshing moves items
+ * from one owner to another while the items of windows that are gone
+ * are still around, so that several items may have the same owner for a
+ * while. */
+static void
+TestRandomEdits(int n_edits)
+{
+        static LONG_PTR const styles[] = { 0, 0, 0, APP, TOOL, PARENT };
+
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        HWND shell = FakeSourceCreate(fake, NULL, 0, L"shell");
+        FakeSourceWindow(fake, shell)->is_visible = FALSE;
+        FakeSourceSetShell(fake, shell);
+        WindowSource *source = FakeSourceSource(fake);
+
+        unsigned int state = 1;
+        for (int i = 0; i < 60; i++) {
+                int n = FakeSourceLength(fake);
+                HWND owner = TestRandom(&state) % 3 == 0 ? FakeSourceNth(fake, TestRandom(&state) % n) : NULL;
+                CHECK(FakeSourceCreate(fake, owner, styles[TestRandom(&state) % _countof(styles)], L"w") != NULL);
+        }
+
+        WindowList *list = WindowListNewFromSource(source, &s_font);
+        CHECK(list != NULL);
+
+        Item items[512];
+        for (int edit = 0; edit < n_edits; edit++) {
+                int n_items = GetItems(list, items, _countof(items));
+                int n = FakeSourceLength(fake);
+                HWND window = FakeSourceNth(fake, TestRandom(&state) % n);
+                UINT kind = TestRandom(&state) % 5;
+
+                if (kind == 0 && n < 120) {
+                        HWND owner = TestRandom(&state) % 3 == 0 ? window : NULL;
+                        HWND created = FakeSourceCreate(fake, owner, styles[TestRandom(&state) % _countof(styles)], L"w");
+                        CHECK(created != NULL);
+                        WindowListInsertWindow(list, source, created);
+                } else if (kind == 1 && window != shell && n > 20) {
+                        BOOL has_item = HasItemOwnedBy(items, n_items, window);
+                        for (int i = 0; i < n_items; i++)
+                                has_item = has_item || items[i].window == window;
+
+                        FakeSourceDestroy(fake, window);
+                        CHECK(WindowListRemoveWindow(list, window) == has_item);
+                        CHECK(!HasItemOwnedBy(items, GetItems(list, items, _countof(items)), window));
+                } else if (kind == 4) {
+                        /* Windows are only ever owned by older ones, which
+                         * have lower handles, so that there are no cycles. */
+                        for (int i = 0; i < 4; i++) {
+                                HWND changed = FakeSourceNth(fake, TestRandom(&state) % n);
+                                HWND owner = FakeSourceNth(fake, TestRandom(&state) % n);
+                                if (changed != shell && (UINT_PTR)owner < (UINT_PTR)changed)
+                                        FakeSourceWindow(fake, changed)->owner = TestRandom(&state) % 2 ? owner : NULL;
+                        }
+                        for (int i = 0; i < 2 && n_items > 0; i++) {
+                                HWND destroyed = items[TestRandom(&state) % n_items].window;
+                                if (destroyed != shell && FakeSourceLength(fake) > 20)
+                                        FakeSourceDestroy(fake, destroyed);
+                        }
+
+                        WindowListDiff diff;
+                        WindowListRefresh(list, source, &diff);
+                } else if (kind == 2 && n_items > 0) {
+                        HWND replaced = items[TestRandom(&state) % n_items].window;
+                        HWND created = FakeSourceCreate(fake, NULL, 0, L"w");
+                        CHECK(created != NULL);
+                        FakeSourceDestroy(fake, replaced);
+                        WindowListReplaceWindow(list, source, replaced, created);
+                } else {
+                        HWND topmost = ReferenceTopmostOwner(fake, window, shell);
+                        BOOL has_item = FALSE;
+                        for (int i = 0; i < n_items; i++)
+                                has_item = has_item || items[i].window == window || items[i].owner == topmost;
+
+                        FakeSourceRaise(fake, window);
+                        WindowListActivateWindow(list, source, window);
+                        if (has_item) {
+                                WindowListItem *first = WindowListNthShown(list, 1);
+                                CHECK(WindowListItemWindow(first) == window || WindowListItemOwner(first) == topmost);
+                        }
+                }
+
+                n_items = GetItems(list, items, _countof(items));
+                for (int i = 0; i < FakeSourceLength(fake); i++) {
+                        HWND owner = FakeSourceNth(fake, i);
+                        BOOL is_owner = HasItemOwnedBy(items, n_items, owner);
+                        CHECK(WindowListShowsOwner(list, owner) == is_owner);
+                        CHECK(WindowListUpdateIcon(list, owner) == is_owner);
+                }
+        }
+
+        WindowListFree(list);
+        FakeSourceFree(fake);
+}
+
+int
+main(void)
+{
+        TestUnowned();
+        TestOwned();
+        TestToolWindows();
+        TestRandomDesktops(2000, 40);
+        TestRandomDesktops(20, 2000);
+        TestRandomEdits(5000);
+
+        return EXIT_SUCCESS;
+}
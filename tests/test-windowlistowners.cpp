@@ -0,0 +1,85 @@
+﻿/* Includes windowlist.cpp, as copied into $(OBJ)/src, which the Makefile
+ * searches first for this test, to get at its nodes. */
+#include "windowlist.cpp"
+
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Tests the chains of nodes of a WindowList with the same owner, which
+ * the public functions only ever make two long, and only for a while, by
+ * giving the items of a list one owner and removing them from the front,
+ * the middle, and all at once, checking the owner index and the links of
+ * the chain each time. */
+
+static Font s_font(12.0f);
+
+/* Checks that the chain of nodes of LIST owned by OWNER is the N NODES,
+ * from the first to the last. */
+static void
+CheckChain(WindowList *list, HWND owner, WindowListNode *const *nodes, int n)
+{
+        CHECK(WindowListFindOwnerNode(list, owner) == (n > 0 ? nodes[0] : NULL));
+        for (int i = 0; i < n; i++) {
+                CHECK(WindowListItemOwner(nodes[i]->item) == owner);
+                CHECK(nodes[i]->previous_same_owner == (i > 0 ? nodes[i - 1] : NULL));
+                CHECK(nodes[i]->next_same_owner == (i + 1 < n ? nodes[i + 1] : NULL));
+        }
+        CHECK(WindowListShowsOwner(list, owner) == (n > 0));
+}
+
+static void
+TestChain(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        WindowSource *source = FakeSourceSource(fake);
+
+        HWND owner = FakeSourceCreate(fake, NULL, 0, L"owner");
+        FakeSourceWindow(fake, owner)->is_visible = FALSE;
+        HWND windows[4];
+        for (int i = 0; i < 4; i++)
+                windows[i] = FakeSourceCreate(fake, NULL, 0, L"w");
+
+        WindowList *list = WindowListNewFromSource(source, &s_font);
+        CHECK(list != NULL);
+        CHECK(WindowListLength(list) == 4);
+
+        /* Each node is linked to the front of the chain. */
+        WindowListNode *nodes[4];
+        for (int i = 0; i < 4; i++) {
+                WindowListNode *node = WindowListFindNode(list, windows[i]);
+                CHECK(node != NULL);
+                CheckChain(list, windows[i], &node, 1);
+
+                WindowListItem *item = WindowListItemNew(source, windows[i], owner);
+                CHECK(item != NULL);
+                CHECK(WindowListNodeSetItem(list, node, item));
+                CheckChain(list, windows[i], NULL, 0);
+                nodes[3 - i] = node;
+                CheckChain(list, owner, nodes + 3 - i, i + 1);
+        }
+
+        WindowListRemoveNode(list, nodes[0]);
+        CheckChain(list, owner, nodes + 1, 3);
+
+        WindowListRemoveNode(list, nodes[2]);
+        nodes[2] = nodes[3];
+        CheckChain(list, owner, nodes + 1, 2);
+
+        CHECK(WindowListRemoveWindow(list, owner));
+        CheckChain(list, owner, NULL, 0);
+        CHECK(WindowListLength(list) == 0);
+        CHECK(!WindowListRemoveWindow(list, owner));
+
+        WindowListFree(list);
+        FakeSourceFree(fake);
+}
+
+int
+main(void)
+{
+        TestChain();
+
+        return EXIT_SUCCESS;
+}
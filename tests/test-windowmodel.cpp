@@ -0,0 +1,247 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "windowmodel.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Tests that a WindowModel follows a made-up desktop from the events it
+ * sends, by replaying events for changes made to the desktop and
+ * checking the model’s window list after each one. */
+
+#define APP     WS_EX_APPWINDOW
+#define TOOL    WS_EX_TOOLWINDOW
+
+static Font s_font(12.0f);
+
+static BOOL
+Send(WindowModel *model, WindowEventType type, HWND window, HWND new_window = NULL)
+{
+        WindowEvent event = { type, window, new_window };
+
+        return WindowModelHandleEvent(model, &event);
+}
+
+/* Checks that the list of MODEL holds the N_EXPECTED windows EXPECTED,
+ * in order, each with the owner in OWNERS, if not NULL. */
+static void
+CheckList(WindowModel *model, HWND const *expected, int n_expected, HWND const *owners = NULL)
+{
+        WindowList *list = WindowModelList(model);
+        CHECK(WindowListLength(list) == n_expected);
+        for (int i = 0; i < n_expected; i++) {
+                WindowListItem *item = WindowListNthShown(list, i + 1);
+                CHECK(WindowListItemWindow(item) == expected[i]);
+                if (owners != NULL)
+                        CHECK(WindowListItemOwner(item) == owners[i]);
+        }
+}
+
+/* Checks creating, activating, retitling, and destroying windows. */
+static void
+TestEvents(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        HWND a = FakeSourceCreate(fake, NULL, 0, L"a");
+        WindowModel *model = WindowModelNew(FakeSourceSource(fake), &s_font);
+        CHECK(model != NULL);
+
+        HWND b = FakeSourceCreate(fake, NULL, 0, L"b");
+        CHECK(Send(model, WINDOW_EVENT_CREATED, b));
+        CHECK(!Send(model, WINDOW_EVENT_CREATED, b));
+        HWND const created[] = { b, a };
+        CheckList(model, created, _countof(created));
+
+        /* Dialogs are listed as their owner, which is activated in their
+         * place. */
+        HWND dialog = FakeSourceCreate(fake, a, 0, L"dialog");
+        CHECK(!Send(model, WINDOW_EVENT_CREATED, dialog));
+        CHECK(Send(model, WINDOW_EVENT_ACTIVATED, dialog));
+        HWND const activated[] = { a, b };
+        CheckList(model, activated, _countof(activated));
+        CHECK(!Send(model, WINDOW_EVENT_ACTIVATED, a));
+
+        /* Windows missed when created are inserted once activated. */
+        HWND c = FakeSourceCreate(fake, NULL, 0, L"c");
+        CHECK(Send(model, WINDOW_EVENT_ACTIVATED, c));
+        HWND const inserted[] = { c, a, b };
+        CheckList(model, inserted, _countof(inserted));
+
+        CHECK(!WindowListItemMatches(WindowListNthShown(WindowModelList(model), 3), L"renamed"));
+        FakeSourceSetTitle(fake, b, L"renamed");
+        CHECK(Send(model, WINDOW_EVENT_TITLE_CHANGED, b));
+        CHECK(WindowListItemMatches(WindowListNthShown(WindowModelList(model), 3), L"renamed"));
+        CHECK(!Send(model, WINDOW_EVENT_TITLE_CHANGED, dialog));
+
+        CHECK(Send(model, WINDOW_EVENT_ICON_CHANGED, a));
+        CHECK(!Send(model, WINDOW_EVENT_ICON_CHANGED, dialog));
+
+        /* Destroying an owner takes the items it owns along. */
+        FakeSourceDestroy(fake, dialog);
+        CHECK(!Send(model, WINDOW_EVENT_DESTROYED, dialog));
+        FakeSourceDestroy(fake, a);
+        CHECK(Send(model, WINDOW_EVENT_DESTROYED, a));
+        HWND const destroyed[] = { c, b };
+        CheckList(model, destroyed, _countof(destroyed));
+
+        WindowModelFree(model);
+        FakeSourceFree(fake);
+}
+
+/* Checks that a window replacing another is only given its place if it
+ * would have been inserted on its own, and as which owner. */
+static void
+TestReplace(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        HWND d = FakeSourceCreate(fake, NULL, 0, L"d");
+        HWND c = FakeSourceCreate(fake, NULL, 0, L"c");
+        HWND b = FakeSourceCreate(fake, NULL, 0, L"b");
+        HWND a = FakeSourceCreate(fake, NULL, 0, L"a");
+        WindowModel *model = WindowModelNew(FakeSourceSource(fake), &s_font);
+        CHECK(model != NULL);
+
+        HWND a2 = FakeSourceCreate(fake, NULL, 0, L"a2");
+        CHECK(Send(model, WINDOW_EVENT_REPLACED, a, a2));
+        HWND const replaced[] = { a2, b, c, d };
+        CheckList(model, replaced, _countof(replaced), replaced);
+
+        /* Neither tool windows nor hidden windows are listed. */
+        HWND tool = FakeSourceCreate(fake, NULL, TOOL, L"tool");
+        CHECK(Send(model, WINDOW_EVENT_REPLACED, b, tool));
+        HWND hidden = FakeSourceCreate(fake, NULL, 0, L"hidden");
+        FakeSourceWindow(fake, hidden)->is_visible = FALSE;
+        CHECK(Send(model, WINDOW_EVENT_REPLACED, c, hidden));
+        HWND const removed[] = { a2, d };
+        CheckList(model, removed, _countof(removed));
+
+        /* A window owned by a listed window is listed as that window… */
+        HWND owned = FakeSourceCreate(fake, a2, 0, L"owned");
+        CHECK(Send(model, WINDOW_EVENT_REPLACED, d, owned));
+        HWND const owned_removed[] = { a2 };
+        CheckList(model, owned_removed, _countof(owned_removed));
+
+        /* …unless it replaces that window, or is an application window. */
+        HWND app = FakeSourceCreate(fake, a2, APP, L"app");
+        CHECK(Send(model, WINDOW_EVENT_CREATED, app));
+        HWND const with_app[] = { app, a2 };
+        CheckList(model, with_app, _countof(with_app), with_app);
+
+        HWND successor = FakeSourceCreate(fake, a2, 0, L"successor");
+        CHECK(Send(model, WINDOW_EVENT_REPLACED, a2, successor));
+        HWND const successors[] = { app, successor };
+        HWND const successor_owners[] = { app, a2 };
+        CheckList(model, successors, _countof(successors), successor_owners);
+
+        WindowModelFree(model);
+        FakeSourceFree(fake);
+}
+
+/* Finds WINDOW in the N_WINDOWS WINDOWS, or returns -1. */
+static int
+Find(HWND const *windows, int n_windows, HWND window)
+{
+        for (int i = 0; i < n_windows; i++)
+                if (windows[i] == window)
+                        return i;
+
+        return -1;
+}
+
+/* Replays random events for a desktop of unowned windows, whose list
+ * should hold them all in the order they were last activated in.  Now
+ * and then an event is missed, in which case the model is reconciled
+ * with the desktop, which should find exactly what was missed. */
+static void
+TestRandomReplay(int n_events)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+        WindowModel *model = WindowModelNew(FakeSourceSource(fake), &s_font);
+        CHECK(model != NULL);
+
+        HWND expected[64];
+        int n_expected = 0;
+
+        unsigned int state = 1;
+        for (int i = 0; i < n_events; i++) {
+                UINT operation = TestRandom(&state) % 8;
+                BOOL is_missed = TestRandom(&state) % 16 == 0;
+                WindowListDiff expected_diff = { 0, 0, 0 };
+
+                if (operation < 2 || n_expected == 0) {
+                        if (n_expected == _countof(expected))
+                                continue;
+                        HWND window = FakeSourceCreate(fake, NULL, 0, L"window");
+                        CHECK(window != NULL);
+                        MoveMemory(expected + 1, expected, n_expected * sizeof(HWND));
+                        expected[0] = window;
+                        n_expected++;
+                        expected_diff.added = 1;
+                        if (!is_missed)
+                                CHECK(Send(model, WINDOW_EVENT_CREATED, window));
+                } else {
+                        int n = TestRandom(&state) % n_expected;
+                        HWND window = expected[n];
+                        if (operation < 4) {
+                                FakeSourceDestroy(fake, window);
+                                n_expected--;
+                                MoveMemory(expected + n, expected + n + 1, (n_expected - n) * sizeof(HWND));
+                                expected_diff.removed = 1;
+                                if (!is_missed)
+                                        CHECK(Send(model, WINDOW_EVENT_DESTROYED, window));
+                        } else if (operation < 6) {
+                                /* Activations aren’t recovered by reconciling. */
+                                is_missed = FALSE;
+                                FakeSourceRaise(fake, window);
+                                MoveMemory(expected + 1, expected, n * sizeof(HWND));
+                                expected[0] = window;
+                                CHECK(Send(model, WINDOW_EVENT_ACTIVATED, window) == (n > 0));
+                        } else if (operation < 7) {
+                                TCHAR title[16];
+                                StringCchPrintf(title, _countof(title), L"title %d", i);
+                                FakeSourceSetTitle(fake, window, title);
+                                expected_diff.changed = 1;
+                                if (!is_missed)
+                                        CHECK(Send(model, WINDOW_EVENT_TITLE_CHANGED, window));
+                        } else {
+                                /* Replacements are only sent for windows
+                                 * that stay where they are. */
+                                is_missed = FALSE;
+                                HWND new_window = FakeSourceCreate(fake, NULL, 0, L"replacement");
+                                CHECK(new_window != NULL);
+                                FakeSourceDestroy(fake, window);
+                                expected[n] = new_window;
+                                CHECK(Send(model, WINDOW_EVENT_REPLACED, window, new_window));
+                        }
+                }
+
+                if (is_missed) {
+                        WindowListDiff diff;
+                        WindowModelReconcile(model, &diff);
+                        CHECK(diff.added == expected_diff.added);
+                        CHECK(diff.removed == expected_diff.removed);
+                        CHECK(diff.changed == expected_diff.changed);
+                }
+
+                CheckList(model, expected, n_expected);
+        }
+
+        WindowModelFree(model);
+        FakeSourceFree(fake);
+}
+
+int
+main(void)
+{
+        TestEvents();
+        TestReplace();
+        TestRandomReplay(20000);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "workerpool.h"
+#include "fakesource.h"
+
+#include "test.h"
+
+/* Tests a WorkerPool getting the icons of a made-up desktop where some
+ * windows are slow to answer and some are hung, as windowicon.cpp does:
+ * no more icons are gotten at once than there are threads, slow windows
+ * don’t hold up the others past a deadline, and jobs are run in the
+ * order they were submitted, or dropped, but never both. */
+
+#define N_THREADS       4
+#define N_WINDOWS       32
+
+/* The number of milliseconds slow windows take, and how long to wait
+ * for the others. */
+#define SLOW_LATENCY    400
+#define DEADLINE        150
+
+/* A job getting the ICON of WINDOW of SOURCE, setting HAS_ICON if it
+ * got one.  IS_DONE is set once it has run, and IS_FREED if it was
+ * dropped. */
+typedef struct _IconJob IconJob;
+
+struct _IconJob
+{
+        WindowSource *source;
+        HWND window;
+        WindowSourceIcon icon;
+        BOOL has_icon;
+        BOOL was_hung;
+        int is_done;
+        int is_freed;
+        int *order;
+        int *n_ran;
+        int index;
+        HANDLE done;
+};
+
+static void
+IconJobRun(VOID *closure)
+{
+        IconJob *job = (IconJob *)closure;
+
+        int n = __atomic_fetch_add(job->n_ran, 1, __ATOMIC_SEQ_CST);
+        job->order[n] = job->index;
+
+        job->has_icon = WindowSourceSmallIcon(job->source, job->window, &job->icon, &job->was_hung);
+        __atomic_store_n(&job->is_done, TRUE, __ATOMIC_RELEASE);
+        SetEvent(job->done);
+}
+
+static void
+IconJobFree(VOID *closure)
+{
+        IconJob *job = (IconJob *)closure;
+
+        job->is_freed++;
+}
+
+/* Submits a job for each of the N_JOBS JOBS to POOL. */
+static void
+SubmitAll(WorkerPool *pool, IconJob *jobs, int n_jobs)
+{
+        for (int i = 0; i < n_jobs; i++)
+                CHECK(WorkerPoolSubmit(pool, IconJobRun, IconJobFree, &jobs[i]));
+}
+
+/* Waits at most MILLISECONDS for all N_JOBS JOBS to be done, returning
+ * how many were. */
+static int
+WaitForJobs(IconJob *jobs, int n_jobs, HANDLE done, DWORD milliseconds)
+{
+        DWORD deadline = GetTickCount() + milliseconds;
+        for (;;) {
+                int n_done = 0;
+                for (int i = 0; i < n_jobs; i++)
+                        n_done += __atomic_load_n(&jobs[i].is_done, __ATOMIC_ACQUIRE);
+
+                DWORD now = GetTickCount();
+                if (n_done == n_jobs || (int)(deadline - now) <= 0)
+                        return n_done;
+
+                WaitForSingleObject(done, deadline - now);
+        }
+}
+
+/* Sets up JOBS for the windows of FAKE, every fourth of which is slow
+ * and every eighth of which, of those, is also hung. */
+static void
+SetUpJobs(FakeSource *fake, IconJob *jobs, int *order, int *n_ran, HANDLE done)
+{
+        ZeroMemory(jobs, sizeof(IconJob) * N_WINDOWS);
+        *n_ran = 0;
+        for (int i = 0; i < N_WINDOWS; i++) {
+                jobs[i].source = FakeSourceSource(fake);
+                jobs[i].window = FakeSourceNth(fake, i);
+                jobs[i].order = order;
+                jobs[i].n_ran = n_ran;
+                jobs[i].index = i;
+                jobs[i].done = done;
+        }
+}
+
+static FakeSource *
+SlowDesktop(void)
+{
+        FakeSource *fake = FakeSourceNew();
+        CHECK(fake != NULL);
+
+        for (int i = 0; i < N_WINDOWS; i++) {
+                HWND window = FakeSourceCreate(fake, NULL, 0, L"window");
+                CHECK(window != NULL);
+        }
+        for (int i = 0; i < N_WINDOWS; i++) {
+                FakeWindow *window = FakeSourceWindow(fake, FakeSourceNth(fake, i));
+                window->icon_latency = i % 4 == 3 ? SLOW_LATENCY : 1;
+                window->is_hung = i % 8 == 7;
+        }
+
+        return fake;
+}
+
+/* Checks that fast windows make the deadline even though slow ones take
+ * up threads, that the slow ones are done later, and that no more icons
+ * are gotten at once than there are threads. */
+static void
+TestDeadline(void)
+{
+        FakeSource *fake = SlowDesktop();
+        IconJob jobs[N_WINDOWS];
+        int order[N_WINDOWS];
+        int n_ran;
+        HANDLE done = CreateEvent(NULL, FALSE, FALSE, NULL);
+        CHECK(done != NULL);
+        SetUpJobs(fake, jobs, order, &n_ran, done);
+
+        WorkerPool *pool = WorkerPoolNew(N_THREADS);
+        CHECK(pool != NULL);
+
+        double start = TestNow();
+        SubmitAll(pool, jobs, N_WINDOWS);
+
+        /* Every fourth window is slow, so the three fast windows ahead of
+         * each of the first slow ones make the deadline, while the rest
+         * wait for a thread. */
+        int n_done = WaitForJobs(jobs, N_WINDOWS, done, DEADLINE);
+        CHECK(n_done >= 3 * N_THREADS && n_done < N_WINDOWS);
+        for (int i = 0; i < N_WINDOWS; i++)
+                if (jobs[i].is_done)
+                        CHECK(FakeSourceWindow(fake, jobs[i].window)->icon_latency < SLOW_LATENCY);
+
+        CHECK(WaitForJobs(jobs, N_WINDOWS, done, 10 * SLOW_LATENCY) == N_WINDOWS);
+        double elapsed = TestNow() - start;
+
+        /* The slow windows are waited upon N_THREADS at a time. */
+        int n_slow = N_WINDOWS / 4;
+        CHECK(elapsed < (double)n_slow * SLOW_LATENCY / 1000 / 2);
+
+        for (int i = 0; i < N_WINDOWS; i++) {
+                BOOL is_hung = FakeSourceWindow(fake, jobs[i].window)->is_hung;
+                CHECK(jobs[i].was_hung == is_hung);
+                CHECK(jobs[i].has_icon == !is_hung);
+                CHECK(jobs[i].is_freed == 0);
+                if (jobs[i].has_icon)
+                        WindowSourceIconFree(&jobs[i].icon);
+        }
+
+        FakeSourceCounters counters;
+        FakeSourceCountersGet(fake, &counters);
+        CHECK(counters.icons == N_WINDOWS);
+        CHECK(counters.max_icons_at_once <= N_THREADS);
+        CHECK(counters.max_icons_at_once > 1);
+
+        WorkerPoolFree(pool);
+        CloseHandle(done);
+        FakeSourceFree(fake);
+
+        printf("  %d of %d icons made the %d ms deadline, all done after %.0f ms\n",
+               n_done, N_WINDOWS, DEADLINE, elapsed * 1000);
+}
+
+/* Checks that a pool of one thread runs jobs in the order they were
+ * submitted, and that freeing a pool drops the jobs that haven’t been
+ * started, while waiting for the one running. */
+static void
+TestOrderAndDrop(void)
+{
+        FakeSource *fake = SlowDesktop();
+        IconJob jobs[N_WINDOWS];
+        int order[N_WINDOWS];
+        int n_ran;
+        HANDLE done = CreateEvent(NULL, FALSE, FALSE, NULL);
+        CHECK(done != NULL);
+        SetUpJobs(fake, jobs, order, &n_ran, done);
+
+        WorkerPool *pool = WorkerPoolNew(1);
+        CHECK(pool != NULL);
+        SubmitAll(pool, jobs, N_WINDOWS);
+
+        /* Let a few jobs through, up to and including the first slow one,
+         * and stop once it has started, while it’s still running. */
+        CHECK(WaitForJobs(jobs, 3, done, 10 * SLOW_LATENCY) == 3);
+        while (__atomic_load_n(&n_ran, __ATOMIC_SEQ_CST) < 4)
+                Sleep(1);
+        WorkerPoolFree(pool);
+
+        int n = __atomic_load_n(&n_ran, __ATOMIC_SEQ_CST);
+        CHECK(n >= 4);
+        for (int i = 0; i < n; i++)
+                CHECK(order[i] == i);
+
+        for (int i = 0; i < N_WINDOWS; i++) {
+                CHECK(jobs[i].is_done == (i < n));
+                CHECK(jobs[i].is_freed == (i < n ? 0 : 1));
+                if (jobs[i].has_icon)
+                        WindowSourceIconFree(&jobs[i].icon);
+        }
+
+        CloseHandle(done);
+        FakeSourceFree(fake);
+}
+
+int
+main(void)
+{
+        TestDeadline();
+        TestOrderAndDrop();
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+﻿/* What the tests and benchmarks share: checking that things hold and
+ * timing things.  A failed check reports where it failed and exits, so
+ * that make stops. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(condition) do {                                           \
+        if (!(condition)) {                                             \
+                fprintf(stderr, "%s:%d: check failed: %s\n",            \
+                        __FILE__, __LINE__, #condition);                \
+                exit(EXIT_FAILURE);                                     \
+        }                                                               \
+} while (0)
+
+/* Gets the time in seconds since some point in the past. */
+static inline double
+TestNow(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* A simple, reproducible source of pseudo-random numbers. */
+static inline unsigned int
+TestRandom(unsigned int *state)
+{
+        *state = *state * 1103515245 + 12345;
+
+        return *state >> 8;
+}
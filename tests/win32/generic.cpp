@@ -0,0 +1,46 @@
+﻿#include "stdafx.h"
+
+/* Stands in for the parts of generic.cpp that the tests link with. */
+
+void
+NullFreeFunc(void *data)
+{
+        UNREFERENCED_PARAMETER(data);
+}
+
+BOOL
+PointerEqualityFunc(void *p1, void *p2)
+{
+        return p1 == p2;
+}
+
+BOOL
+LastErrorWasTimeout(VOID)
+{
+        DWORD error = GetLastError();
+        return (error == 0 || error == ERROR_TIMEOUT);
+}
+
+BOOL
+MySwitchToThisWindow(HWND window)
+{
+        return ShowWindow(window, SW_SHOW);
+}
+
+BOOL
+GetWindowTitle(HWND window, LPTSTR *title)
+{
+        UNREFERENCED_PARAMETER(window);
+        __atomic_add_fetch(&g_win32_window_calls, 1, __ATOMIC_RELAXED);
+        *title = NULL;
+
+        return FALSE;
+}
+
+int
+GetSystemMetricsDefault(int index, int default_dimension)
+{
+        UNREFERENCED_PARAMETER(index);
+
+        return default_dimension;
+}
@@ -0,0 +1,4 @@
+﻿/* A stand-in for process.h, see stdafx.h. */
+uintptr_t _beginthreadex(void *security, unsigned stack_size,
+                         unsigned (__stdcall *f)(void *), void *argument,
+                         unsigned flags, unsigned *thread_id);
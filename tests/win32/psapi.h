@@ -0,0 +1,2 @@
+﻿/* A stand-in for psapi.h, see stdafx.h. */
+DWORD GetModuleFileNameEx(HANDLE process, HINSTANCE module, LPTSTR name, DWORD size);
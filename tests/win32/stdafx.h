@@ -0,0 +1,583 @@
+﻿/* A stand-in for stdafx.h that lets the parts of window-prefix that use
+ * Win32 and GDI+ be built and tested without Windows.  It only declares
+ * what those parts use, and win32.cpp only implements it as far as the
+ * tests need: memory, strings, and files work as on Windows;
+ * synchronization objects and threads are built on pthreads; there are
+ * no windows, so the functions that take an HWND fail and are counted
+ * by g_win32_window_calls; and GDI+ measures every character as half as
+ * wide as the font is high and draws nothing. */
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNICODE
+#define _UNICODE
+
+#define CALLBACK
+#define WINAPI
+#define __stdcall
+
+#define VOID void
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef unsigned int UINT;
+typedef int INT;
+typedef int LONG;
+typedef unsigned int ULONG;
+
+/* LONGs are 32 bits on Windows, and so are their limits. */
+#undef LONG_MAX
+#define LONG_MAX 2147483647
+#undef LONG_MIN
+#define LONG_MIN (-LONG_MAX - 1)
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef intptr_t LONG_PTR;
+typedef intptr_t INT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef DWORD_PTR *PDWORD_PTR;
+typedef size_t SIZE_T;
+typedef float REAL;
+typedef LONG_PTR LPARAM;
+typedef UINT_PTR WPARAM;
+typedef LONG_PTR LRESULT;
+
+/* Tests are built with -fshort-wchar, so that a TCHAR is a UTF-16 code
+ * unit, as on Windows. */
+typedef wchar_t WCHAR;
+typedef WCHAR TCHAR;
+typedef WCHAR *LPWSTR;
+typedef WCHAR *LPTSTR;
+typedef WCHAR const *LPCWSTR;
+typedef WCHAR const *LPCTSTR;
+typedef char const *LPCSTR;
+typedef void *LPVOID;
+typedef void *HANDLE;
+
+#define DECLARE_HANDLE(name) typedef struct name##__ *name
+DECLARE_HANDLE(HWND);
+DECLARE_HANDLE(HICON);
+DECLARE_HANDLE(HBITMAP);
+DECLARE_HANDLE(HDC);
+DECLARE_HANDLE(HINSTANCE);
+typedef void *HGDIOBJ;
+
+typedef union _LARGE_INTEGER {
+        LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct tagRECT {
+        LONG left;
+        LONG top;
+        LONG right;
+        LONG bottom;
+} RECT, *LPRECT;
+
+typedef struct tagSIZE {
+        LONG cx;
+        LONG cy;
+} SIZE;
+
+typedef struct _BLENDFUNCTION {
+        BYTE BlendOp;
+        BYTE BlendFlags;
+        BYTE SourceConstantAlpha;
+        BYTE AlphaFormat;
+} BLENDFUNCTION;
+
+typedef BOOL (CALLBACK *WNDENUMPROC)(HWND, LPARAM);
+
+#define TRUE 1
+#define FALSE 0
+
+#ifndef min
+#  define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#  define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+#define TEXT(s) L##s
+#define _T(s) L##s
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+#define MoveMemory(d, s, n) memmove((d), (s), (n))
+#define SUCCEEDED(hr) ((hr) >= 0)
+#define FAILED(hr) ((hr) < 0)
+typedef LONG HRESULT;
+#define S_OK 0
+
+#define MAXDWORD 0xffffffff
+#define MAX_PATH 260
+#define INFINITE 0xffffffff
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xffffffff
+#define ERROR_TIMEOUT 1460
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define INVALID_FILE_SIZE 0xffffffff
+
+#define WM_USER 0x0400
+#define WM_GETICON 0x007f
+#define ICON_SMALL 0
+#define ICON_BIG 1
+#define ICON_SMALL2 2
+#define SMTO_ABORTIFHUNG 0x0002
+#define GCLP_HICON (-14)
+#define GCLP_HICONSM (-34)
+#define GWL_STYLE (-16)
+#define GWL_EXSTYLE (-20)
+#define GW_OWNER 4
+#define SW_HIDE 0
+#define SW_SHOW 5
+#define SM_CXICON 11
+#define SM_CYICON 12
+#define SM_CXSMICON 49
+#define SM_CYSMICON 50
+#define SM_CYCAPTION 4
+#define WS_EX_TOOLWINDOW 0x00000080
+#define WS_EX_CONTROLPARENT 0x00010000
+#define WS_EX_APPWINDOW 0x00040000
+#define VK_BACK 0x08
+#define VK_KANA 0x15
+#define PROCESS_QUERY_INFORMATION 0x0400
+#define PROCESS_VM_READ 0x0010
+#define LOCALE_USER_DEFAULT 0x0400
+#define NORM_IGNORECASE 0x00000001
+#define CSTR_LESS_THAN 1
+#define CSTR_EQUAL 2
+#define CSTR_GREATER_THAN 3
+
+/* Memory */
+
+#define HEAP_ZERO_MEMORY 0x00000008
+
+static inline HANDLE GetProcessHeap(void) { return NULL; }
+
+static inline LPVOID
+HeapAlloc(HANDLE heap, DWORD flags, SIZE_T size)
+{
+        UNREFERENCED_PARAMETER(heap);
+        return (flags & HEAP_ZERO_MEMORY) ? calloc(1, size) : malloc(size);
+}
+
+static inline LPVOID
+HeapReAlloc(HANDLE heap, DWORD flags, LPVOID pointer, SIZE_T size)
+{
+        UNREFERENCED_PARAMETER(heap);
+        UNREFERENCED_PARAMETER(flags);
+        return realloc(pointer, size);
+}
+
+static inline BOOL
+HeapFree(HANDLE heap, DWORD flags, LPVOID pointer)
+{
+        UNREFERENCED_PARAMETER(heap);
+        UNREFERENCED_PARAMETER(flags);
+        free(pointer);
+        return TRUE;
+}
+
+/* Strings */
+
+int lstrlen(LPCTSTR string);
+int lstrcmp(LPCTSTR string1, LPCTSTR string2);
+int lstrcmpi(LPCTSTR string1, LPCTSTR string2);
+LPTSTR lstrcpy(LPTSTR destination, LPCTSTR source);
+LPTSTR CharNext(LPCTSTR string);
+BOOL IsCharUpper(TCHAR c);
+int CompareString(DWORD locale, DWORD flags, LPCTSTR string1, int length1, LPCTSTR string2, int length2);
+HRESULT StringCchCopy(LPTSTR destination, size_t size, LPCTSTR source);
+HRESULT StringCchPrintf(LPTSTR destination, size_t size, LPCTSTR format, ...);
+
+/* Synchronization and threads */
+
+typedef struct _CRITICAL_SECTION CRITICAL_SECTION;
+
+struct _CRITICAL_SECTION
+{
+        void *mutex;
+};
+
+void InitializeCriticalSection(CRITICAL_SECTION *section);
+void DeleteCriticalSection(CRITICAL_SECTION *section);
+void EnterCriticalSection(CRITICAL_SECTION *section);
+void LeaveCriticalSection(CRITICAL_SECTION *section);
+HANDLE CreateEvent(void *attributes, BOOL manual_reset, BOOL initial_state, LPCTSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+HANDLE CreateSemaphore(void *attributes, LONG initial_count, LONG maximum_count, LPCTSTR name);
+BOOL ReleaseSemaphore(HANDLE semaphore, LONG count, LONG *previous_count);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+DWORD WaitForMultipleObjects(DWORD n, HANDLE const *handles, BOOL wait_all, DWORD milliseconds);
+BOOL CloseHandle(HANDLE handle);
+void Sleep(DWORD milliseconds);
+DWORD GetTickCount(void);
+BOOL QueryPerformanceCounter(LARGE_INTEGER *count);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency);
+DWORD GetLastError(void);
+void SetLastError(DWORD error);
+
+static inline LONG
+InterlockedIncrement(LONG volatile *value)
+{
+        return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedDecrement(LONG volatile *value)
+{
+        return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedExchange(LONG volatile *target, LONG value)
+{
+        return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedCompareExchange(LONG volatile *target, LONG value, LONG comparand)
+{
+        __atomic_compare_exchange_n(target, &comparand, value, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        return comparand;
+}
+
+/* Files */
+
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+
+HANDLE CreateFile(LPCTSTR name, DWORD access, DWORD share, void *security, DWORD disposition, DWORD flags, HANDLE templ);
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD size, DWORD *n_read, void *overlapped);
+BOOL WriteFile(HANDLE file, void const *buffer, DWORD size, DWORD *n_written, void *overlapped);
+DWORD GetFileSize(HANDLE file, DWORD *high);
+BOOL DeleteFile(LPCTSTR name);
+
+/* Windows, of which there are none.  Each call is counted, so that tests
+ * can check that nothing asks Windows about windows that it doesn’t
+ * know. */
+
+extern UINT g_win32_window_calls;
+
+BOOL IsWindow(HWND window);
+BOOL IsWindowVisible(HWND window);
+BOOL ShowWindow(HWND window, int command);
+HWND GetWindow(HWND window, UINT command);
+HWND GetShellWindow(void);
+LONG_PTR GetWindowLongPtr(HWND window, int index);
+ULONG_PTR GetClassLongPtr(HWND window, int index);
+int GetClassName(HWND window, LPTSTR name, int size);
+DWORD GetWindowThreadProcessId(HWND window, DWORD *process_id);
+LRESULT SendMessageTimeout(HWND window, UINT message, WPARAM wparam, LPARAM lparam, UINT flags, UINT timeout, PDWORD_PTR result);
+BOOL EnumDesktopWindows(HANDLE desktop, WNDENUMPROC f, LPARAM lparam);
+HANDLE OpenProcess(DWORD access, BOOL inherit, DWORD process_id);
+BOOL DestroyIcon(HICON icon);
+
+/* GDI, which has no icons to get the bitmaps of, so GetIconInfo() fails
+ * and is counted along with the functions that take an HWND. */
+
+#define BI_RGB 0
+#define DIB_RGB_COLORS 0
+
+typedef struct _ICONINFO {
+        BOOL fIcon;
+        DWORD xHotspot;
+        DWORD yHotspot;
+        HBITMAP hbmMask;
+        HBITMAP hbmColor;
+} ICONINFO;
+
+typedef struct tagBITMAP {
+        LONG bmType;
+        LONG bmWidth;
+        LONG bmHeight;
+        LONG bmWidthBytes;
+        WORD bmPlanes;
+        WORD bmBitsPixel;
+        LPVOID bmBits;
+} BITMAP;
+
+typedef struct tagBITMAPINFOHEADER {
+        DWORD biSize;
+        LONG biWidth;
+        LONG biHeight;
+        WORD biPlanes;
+        WORD biBitCount;
+        DWORD biCompression;
+        DWORD biSizeImage;
+        LONG biXPelsPerMeter;
+        LONG biYPelsPerMeter;
+        DWORD biClrUsed;
+        DWORD biClrImportant;
+} BITMAPINFOHEADER;
+
+typedef struct tagRGBQUAD {
+        BYTE rgbBlue;
+        BYTE rgbGreen;
+        BYTE rgbRed;
+        BYTE rgbReserved;
+} RGBQUAD;
+
+typedef struct tagBITMAPINFO {
+        BITMAPINFOHEADER bmiHeader;
+        RGBQUAD bmiColors[1];
+} BITMAPINFO;
+
+BOOL GetIconInfo(HICON icon, ICONINFO *info);
+int GetObject(HGDIOBJ object, int size, LPVOID data);
+BOOL DeleteObject(HGDIOBJ object);
+HDC GetDC(HWND window);
+int ReleaseDC(HWND window, HDC dc);
+int GetDIBits(HDC dc, HBITMAP bitmap, UINT start, UINT lines, LPVOID bits, BITMAPINFO *info, UINT usage);
+LONG GetBitmapBits(HBITMAP bitmap, LONG size, LPVOID bits);
+
+/* GDI+ */
+
+namespace Gdiplus {
+
+enum Status {
+        Ok,
+        GenericError,
+        InvalidParameter,
+        OutOfMemory,
+        ObjectBusy,
+        InsufficientBuffer,
+        NotImplemented,
+        Win32Error,
+        WrongState,
+        Aborted,
+        FileNotFound,
+        ValueOverflow,
+        AccessDenied,
+        UnknownImageFormat,
+        FontFamilyNotFound,
+        FontStyleNotFound,
+        NotTrueTypeFont,
+        UnsupportedGdiplusVersion,
+        GdiplusNotInitialized,
+        PropertyNotFound,
+        PropertyNotSupported,
+};
+
+enum StringFormatFlags {
+        StringFormatFlagsNoWrap = 0x00001000,
+        StringFormatFlagsMeasureTrailingSpaces = 0x00000800,
+};
+
+enum StringAlignment {
+        StringAlignmentNear,
+        StringAlignmentCenter,
+        StringAlignmentFar,
+};
+
+enum StringTrimming {
+        StringTrimmingNone,
+        StringTrimmingCharacter,
+        StringTrimmingWord,
+        StringTrimmingEllipsisCharacter,
+};
+
+enum TextRenderingHint {
+        TextRenderingHintAntiAliasGridFit = 3,
+};
+
+typedef DWORD ARGB;
+
+class PointF
+{
+public:
+        PointF() : X(0.0f), Y(0.0f) {}
+        PointF(REAL x, REAL y) : X(x), Y(y) {}
+        REAL X;
+        REAL Y;
+};
+
+class SizeF
+{
+public:
+        SizeF() : Width(0.0f), Height(0.0f) {}
+        SizeF(REAL width, REAL height) : Width(width), Height(height) {}
+        REAL Width;
+        REAL Height;
+};
+
+class RectF
+{
+public:
+        RectF() : X(0.0f), Y(0.0f), Width(0.0f), Height(0.0f) {}
+        RectF(REAL x, REAL y, REAL width, REAL height) : X(x), Y(y), Width(width), Height(height) {}
+        REAL GetLeft() const { return X; }
+        REAL GetTop() const { return Y; }
+        REAL GetRight() const { return X + Width; }
+        REAL GetBottom() const { return Y + Height; }
+        BOOL Equals(RectF const &rect) const
+        {
+                return X == rect.X && Y == rect.Y && Width == rect.Width && Height == rect.Height;
+        }
+        REAL X;
+        REAL Y;
+        REAL Width;
+        REAL Height;
+};
+
+class Rect
+{
+public:
+        Rect() : X(0), Y(0), Width(0), Height(0) {}
+        Rect(INT x, INT y, INT width, INT height) : X(x), Y(y), Width(width), Height(height) {}
+        INT X;
+        INT Y;
+        INT Width;
+        INT Height;
+};
+
+class Color
+{
+public:
+        enum { White = 0xffffffff, Black = 0xff000000 };
+        Color() : argb(Black) {}
+        Color(ARGB value) : argb(value) {}
+        Color(BYTE a, BYTE r, BYTE g, BYTE b) : argb(((ARGB)a << 24) | ((ARGB)r << 16) | ((ARGB)g << 8) | b) {}
+        ARGB GetValue() const { return argb; }
+private:
+        ARGB argb;
+};
+
+class CharacterRange
+{
+public:
+        CharacterRange() : First(0), Length(0) {}
+        CharacterRange(INT first, INT length) : First(first), Length(length) {}
+        INT First;
+        INT Length;
+};
+
+class StringFormat
+{
+public:
+        StringFormat(INT flags = 0) : flags(flags), n_ranges(0) {}
+        Status SetFormatFlags(INT new_flags) { flags = new_flags; return Ok; }
+        Status SetTrimming(StringTrimming trimming) { UNREFERENCED_PARAMETER(trimming); return Ok; }
+        Status SetAlignment(StringAlignment alignment) { UNREFERENCED_PARAMETER(alignment); return Ok; }
+        Status SetMeasurableCharacterRanges(INT n, CharacterRange const *new_ranges)
+        {
+                if (n > (INT)_countof(ranges))
+                        return ValueOverflow;
+                for (INT i = 0; i < n; i++)
+                        ranges[i] = new_ranges[i];
+                n_ranges = n;
+                return Ok;
+        }
+        Status GetLastStatus() const { return Ok; }
+        INT flags;
+        INT n_ranges;
+        CharacterRange ranges[32];
+};
+
+class Brush
+{
+public:
+        Status GetLastStatus() const { return Ok; }
+};
+
+class SolidBrush : public Brush
+{
+public:
+        SolidBrush(Color const &color) : color(color) {}
+        Color color;
+};
+
+class Pen
+{
+public:
+        Pen(Color const &color, REAL width = 1.0f) : color(color), width(width) {}
+        Status GetLastStatus() const { return Ok; }
+        Color color;
+        REAL width;
+};
+
+class Graphics;
+
+class Font
+{
+public:
+        Font(REAL size = 12.0f) : size(size) {}
+        REAL GetSize() const { return size; }
+        REAL GetHeight(Graphics const *graphics) const { UNREFERENCED_PARAMETER(graphics); return size * 1.25f; }
+        Status GetLastStatus() const { return Ok; }
+        REAL size;
+};
+
+class Region
+{
+public:
+        Region() {}
+        Status GetBounds(RectF *rect, Graphics const *graphics) const
+        {
+                UNREFERENCED_PARAMETER(graphics);
+                *rect = bounds;
+                return Ok;
+        }
+        RectF bounds;
+};
+
+/* Draws nothing, but counts what it draws in N_STRINGS and N_LINES.
+ * CLIP is the area that IsVisible() considers visible. */
+class Graphics
+{
+public:
+        Graphics() : clip(-1e9f, -1e9f, 2e9f, 2e9f), n_strings(0), n_lines(0) {}
+        Status MeasureString(WCHAR const *string, INT length, Font const *font,
+                             PointF const &origin, StringFormat const *format, RectF *bounds) const;
+        Status MeasureString(WCHAR const *string, INT length, Font const *font,
+                             PointF const &origin, RectF *bounds) const;
+        Status MeasureString(WCHAR const *string, INT length, Font const *font,
+                             RectF const &area, StringFormat const *format, RectF *bounds) const;
+        Status MeasureCharacterRanges(WCHAR const *string, INT length, Font const *font,
+                                      RectF const &area, StringFormat const *format,
+                                      INT n, Region *regions) const;
+        Status DrawString(WCHAR const *string, INT length, Font const *font,
+                          RectF const &area, StringFormat const *format, Brush const *brush);
+        Status DrawString(WCHAR const *string, INT length, Font const *font,
+                          PointF const &origin, Brush const *brush);
+        Status DrawLine(Pen const *pen, PointF const &from, PointF const &to);
+        BOOL IsVisible(RectF const &rect) const;
+        Status SetTextRenderingHint(TextRenderingHint hint) { UNREFERENCED_PARAMETER(hint); return Ok; }
+        RectF clip;
+        UINT n_strings;
+        UINT n_lines;
+};
+
+}
+
+using namespace Gdiplus;
+
+typedef struct _Canvas Canvas;
+
+struct _Canvas
+{
+        Graphics *graphics;
+        Font const *font;
+};
+
+#include "error.h"
+#include "windowicon.h"
+#include "generic.h"
+#include "translation.h"
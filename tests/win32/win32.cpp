@@ -0,0 +1,888 @@
+﻿#include "stdafx.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Implements the Win32 and GDI+ stand-ins declared in stdafx.h. */
+
+/* Strings */
+
+int
+lstrlen(LPCTSTR string)
+{
+        int length = 0;
+        while (string[length] != L'\0')
+                length++;
+
+        return length;
+}
+
+int
+lstrcmp(LPCTSTR string1, LPCTSTR string2)
+{
+        while (*string1 != L'\0' && *string1 == *string2) {
+                string1++;
+                string2++;
+        }
+
+        return (int)*string1 - (int)*string2;
+}
+
+static TCHAR
+CharToLower(TCHAR c)
+{
+        return (c >= L'A' && c <= L'Z') ? c - L'A' + L'a' : c;
+}
+
+int
+lstrcmpi(LPCTSTR string1, LPCTSTR string2)
+{
+        while (*string1 != L'\0' && CharToLower(*string1) == CharToLower(*string2)) {
+                string1++;
+                string2++;
+        }
+
+        return (int)CharToLower(*string1) - (int)CharToLower(*string2);
+}
+
+LPTSTR
+lstrcpy(LPTSTR destination, LPCTSTR source)
+{
+        memcpy(destination, source, (lstrlen(source) + 1) * sizeof(TCHAR));
+
+        return destination;
+}
+
+LPTSTR
+CharNext(LPCTSTR string)
+{
+        return (LPTSTR)(*string == L'\0' ? string : string + 1);
+}
+
+BOOL
+IsCharUpper(TCHAR c)
+{
+        return c >= L'A' && c <= L'Z';
+}
+
+int
+CompareString(DWORD locale, DWORD flags, LPCTSTR string1, int length1, LPCTSTR string2, int length2)
+{
+        UNREFERENCED_PARAMETER(locale);
+
+        if (length1 < 0)
+                length1 = lstrlen(string1);
+        if (length2 < 0)
+                length2 = lstrlen(string2);
+
+        for (int i = 0; i < length1 && i < length2; i++) {
+                TCHAR c1 = string1[i], c2 = string2[i];
+                if (flags & NORM_IGNORECASE) {
+                        c1 = CharToLower(c1);
+                        c2 = CharToLower(c2);
+                }
+                if (c1 != c2)
+                        return c1 < c2 ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+        }
+
+        if (length1 != length2)
+                return length1 < length2 ? CSTR_LESS_THAN : CSTR_GREATER_THAN;
+
+        return CSTR_EQUAL;
+}
+
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007a)
+
+HRESULT
+StringCchCopy(LPTSTR destination, size_t size, LPCTSTR source)
+{
+        size_t i;
+        for (i = 0; i + 1 < size && source[i] != L'\0'; i++)
+                destination[i] = source[i];
+        if (size > 0)
+                destination[i] = L'\0';
+
+        return source[i] == L'\0' ? S_OK : STRSAFE_E_INSUFFICIENT_BUFFER;
+}
+
+/* Only understands %s, %d, %u, %x, and %%. */
+HRESULT
+StringCchPrintf(LPTSTR destination, size_t size, LPCTSTR format, ...)
+{
+        va_list arguments;
+        va_start(arguments, format);
+
+        size_t n = 0;
+        BOOL is_truncated = FALSE;
+#define PUT(c) do { if (n + 1 < size) destination[n++] = (c); else is_truncated = TRUE; } while (0)
+        for (LPCTSTR p = format; *p != L'\0'; p++) {
+                if (*p != L'%' || p[1] == L'\0') {
+                        PUT(*p);
+                        continue;
+                }
+
+                char number[32];
+                switch (*++p) {
+                case L's':
+                        for (LPCTSTR s = va_arg(arguments, LPCTSTR); *s != L'\0'; s++)
+                                PUT(*s);
+                        continue;
+                case L'd':
+                        snprintf(number, sizeof(number), "%d", va_arg(arguments, int));
+                        break;
+                case L'u':
+                        snprintf(number, sizeof(number), "%u", va_arg(arguments, unsigned int));
+                        break;
+                case L'x':
+                        snprintf(number, sizeof(number), "%x", va_arg(arguments, unsigned int));
+                        break;
+                default:
+                        PUT(*p);
+                        continue;
+                }
+                for (char *s = number; *s != '\0'; s++)
+                        PUT((TCHAR)*s);
+        }
+#undef PUT
+        if (size > 0)
+                destination[n] = L'\0';
+
+        va_end(arguments);
+
+        return is_truncated ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+/* Synchronization and threads
+ *
+ * Events, semaphores, and threads are all waited upon with one lock
+ * and condition, which is simple and plenty fast enough for tests. */
+
+typedef enum {
+        HANDLE_EVENT,
+        HANDLE_SEMAPHORE,
+        HANDLE_THREAD,
+        HANDLE_FILE,
+} HandleKind;
+
+typedef struct _Handle Handle;
+
+/* COUNT is 1 for a set event or an exited thread and is the count of a
+ * semaphore.  REFERENCES counts the closes a thread handle awaits, as
+ * the thread itself holds one. */
+struct _Handle
+{
+        HandleKind kind;
+        BOOL manual_reset;
+        LONG count;
+        LONG maximum_count;
+        int references;
+        FILE *file;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_changed = PTHREAD_COND_INITIALIZER;
+static __thread DWORD s_last_error;
+
+DWORD
+GetLastError(void)
+{
+        return s_last_error;
+}
+
+void
+SetLastError(DWORD error)
+{
+        s_last_error = error;
+}
+
+static Handle *
+HandleNew(HandleKind kind)
+{
+        Handle *handle = (Handle *)calloc(1, sizeof(Handle));
+        if (handle == NULL)
+                return NULL;
+
+        handle->kind = kind;
+        handle->references = 1;
+
+        return handle;
+}
+
+static void
+HandleRelease(Handle *handle)
+{
+        pthread_mutex_lock(&s_lock);
+        BOOL is_last = --handle->references == 0;
+        pthread_mutex_unlock(&s_lock);
+
+        if (is_last)
+                free(handle);
+}
+
+void
+InitializeCriticalSection(CRITICAL_SECTION *section)
+{
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+
+        pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+        if (mutex == NULL)
+                abort();
+        pthread_mutex_init(mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+
+        section->mutex = mutex;
+}
+
+void
+DeleteCriticalSection(CRITICAL_SECTION *section)
+{
+        pthread_mutex_destroy((pthread_mutex_t *)section->mutex);
+        free(section->mutex);
+}
+
+void
+EnterCriticalSection(CRITICAL_SECTION *section)
+{
+        pthread_mutex_lock((pthread_mutex_t *)section->mutex);
+}
+
+void
+LeaveCriticalSection(CRITICAL_SECTION *section)
+{
+        pthread_mutex_unlock((pthread_mutex_t *)section->mutex);
+}
+
+HANDLE
+CreateEvent(void *attributes, BOOL manual_reset, BOOL initial_state, LPCTSTR name)
+{
+        UNREFERENCED_PARAMETER(attributes);
+        UNREFERENCED_PARAMETER(name);
+
+        Handle *event = HandleNew(HANDLE_EVENT);
+        if (event == NULL)
+                return NULL;
+
+        event->manual_reset = manual_reset;
+        event->count = initial_state ? 1 : 0;
+
+        return event;
+}
+
+static BOOL
+HandleSetCount(HANDLE handle, LONG count)
+{
+        pthread_mutex_lock(&s_lock);
+        ((Handle *)handle)->count = count;
+        pthread_cond_broadcast(&s_changed);
+        pthread_mutex_unlock(&s_lock);
+
+        return TRUE;
+}
+
+BOOL
+SetEvent(HANDLE event)
+{
+        return HandleSetCount(event, 1);
+}
+
+BOOL
+ResetEvent(HANDLE event)
+{
+        return HandleSetCount(event, 0);
+}
+
+HANDLE
+CreateSemaphore(void *attributes, LONG initial_count, LONG maximum_count, LPCTSTR name)
+{
+        UNREFERENCED_PARAMETER(attributes);
+        UNREFERENCED_PARAMETER(name);
+
+        Handle *semaphore = HandleNew(HANDLE_SEMAPHORE);
+        if (semaphore == NULL)
+                return NULL;
+
+        semaphore->count = initial_count;
+        semaphore->maximum_count = maximum_count;
+
+        return semaphore;
+}
+
+BOOL
+ReleaseSemaphore(HANDLE handle, LONG count, LONG *previous_count)
+{
+        Handle *semaphore = (Handle *)handle;
+        BOOL success = FALSE;
+
+        pthread_mutex_lock(&s_lock);
+        if (previous_count != NULL)
+                *previous_count = semaphore->count;
+        if (semaphore->count + count <= semaphore->maximum_count) {
+                semaphore->count += count;
+                success = TRUE;
+                pthread_cond_broadcast(&s_changed);
+        }
+        pthread_mutex_unlock(&s_lock);
+
+        return success;
+}
+
+/* Takes what a satisfied wait on HANDLE takes; called with the lock
+ * held. */
+static void
+HandleAcquire(Handle *handle)
+{
+        if (handle->kind == HANDLE_SEMAPHORE ||
+            (handle->kind == HANDLE_EVENT && !handle->manual_reset))
+                handle->count--;
+}
+
+static BOOL
+WaitUntil(struct timespec const *deadline)
+{
+        if (deadline == NULL)
+                return pthread_cond_wait(&s_changed, &s_lock) == 0;
+
+        return pthread_cond_timedwait(&s_changed, &s_lock, deadline) != ETIMEDOUT;
+}
+
+DWORD
+WaitForMultipleObjects(DWORD n, HANDLE const *handles, BOOL wait_all, DWORD milliseconds)
+{
+        struct timespec deadline;
+        if (milliseconds != INFINITE) {
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += milliseconds / 1000;
+                deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                        deadline.tv_sec++;
+                        deadline.tv_nsec -= 1000000000L;
+                }
+        }
+
+        pthread_mutex_lock(&s_lock);
+        DWORD result = WAIT_TIMEOUT;
+        do {
+                DWORD n_signaled = 0, first_signaled = n;
+                for (DWORD i = 0; i < n; i++) {
+                        if (((Handle *)handles[i])->count > 0) {
+                                n_signaled++;
+                                first_signaled = min(first_signaled, i);
+                        }
+                }
+
+                if (wait_all && n_signaled == n) {
+                        for (DWORD i = 0; i < n; i++)
+                                HandleAcquire((Handle *)handles[i]);
+                        result = WAIT_OBJECT_0;
+                        break;
+                } else if (!wait_all && n_signaled > 0) {
+                        HandleAcquire((Handle *)handles[first_signaled]);
+                        result = WAIT_OBJECT_0 + first_signaled;
+                        break;
+                }
+        } while (milliseconds != 0 &&
+                 WaitUntil(milliseconds == INFINITE ? NULL : &deadline));
+        pthread_mutex_unlock(&s_lock);
+
+        return result;
+}
+
+DWORD
+WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+        return WaitForMultipleObjects(1, &handle, TRUE, milliseconds);
+}
+
+typedef struct _ThreadStart ThreadStart;
+
+struct _ThreadStart
+{
+        unsigned (__stdcall *f)(void *);
+        void *argument;
+        Handle *thread;
+};
+
+static void *
+ThreadProc(void *closure)
+{
+        ThreadStart start = *(ThreadStart *)closure;
+        free(closure);
+
+        start.f(start.argument);
+
+        HandleSetCount(start.thread, 1);
+        HandleRelease(start.thread);
+
+        return NULL;
+}
+
+uintptr_t
+_beginthreadex(void *security, unsigned stack_size,
+               unsigned (__stdcall *f)(void *), void *argument,
+               unsigned flags, unsigned *thread_id)
+{
+        UNREFERENCED_PARAMETER(security);
+        UNREFERENCED_PARAMETER(stack_size);
+        UNREFERENCED_PARAMETER(flags);
+
+        Handle *thread = HandleNew(HANDLE_THREAD);
+        ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+        if (thread == NULL || start == NULL) {
+                free(thread);
+                free(start);
+                return 0;
+        }
+
+        thread->references = 2;
+        start->f = f;
+        start->argument = argument;
+        start->thread = thread;
+
+        pthread_t id;
+        if (pthread_create(&id, NULL, ThreadProc, start) != 0) {
+                free(thread);
+                free(start);
+                return 0;
+        }
+        pthread_detach(id);
+
+        if (thread_id != NULL)
+                *thread_id = 0;
+
+        return (uintptr_t)thread;
+}
+
+BOOL
+CloseHandle(HANDLE handle)
+{
+        Handle *h = (Handle *)handle;
+        if (h->kind == HANDLE_FILE)
+                fclose(h->file);
+        HandleRelease(h);
+
+        return TRUE;
+}
+
+void
+Sleep(DWORD milliseconds)
+{
+        usleep(milliseconds * 1000);
+}
+
+DWORD
+GetTickCount(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (DWORD)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+BOOL
+QueryPerformanceCounter(LARGE_INTEGER *count)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        count->QuadPart = (LONGLONG)now.tv_sec * 1000000000LL + now.tv_nsec;
+
+        return TRUE;
+}
+
+BOOL
+QueryPerformanceFrequency(LARGE_INTEGER *frequency)
+{
+        frequency->QuadPart = 1000000000LL;
+
+        return TRUE;
+}
+
+/* Files, with only ASCII names. */
+
+HANDLE
+CreateFile(LPCTSTR name, DWORD access, DWORD share, void *security, DWORD disposition, DWORD flags, HANDLE templ)
+{
+        UNREFERENCED_PARAMETER(share);
+        UNREFERENCED_PARAMETER(security);
+        UNREFERENCED_PARAMETER(flags);
+        UNREFERENCED_PARAMETER(templ);
+
+        char path[MAX_PATH];
+        int i;
+        for (i = 0; i < MAX_PATH - 1 && name[i] != L'\0'; i++)
+                path[i] = (char)name[i];
+        path[i] = '\0';
+
+        Handle *file = HandleNew(HANDLE_FILE);
+        if (file == NULL)
+                return INVALID_HANDLE_VALUE;
+
+        if (disposition == CREATE_ALWAYS)
+                file->file = fopen(path, (access & GENERIC_READ) ? "w+b" : "wb");
+        else
+                file->file = fopen(path, (access & GENERIC_WRITE) ? "r+b" : "rb");
+        if (file->file == NULL) {
+                free(file);
+                return INVALID_HANDLE_VALUE;
+        }
+
+        return file;
+}
+
+BOOL
+ReadFile(HANDLE file, LPVOID buffer, DWORD size, DWORD *n_read, void *overlapped)
+{
+        UNREFERENCED_PARAMETER(overlapped);
+
+        FILE *f = ((Handle *)file)->file;
+        *n_read = (DWORD)fread(buffer, 1, size, f);
+
+        return !ferror(f);
+}
+
+BOOL
+WriteFile(HANDLE file, void const *buffer, DWORD size, DWORD *n_written, void *overlapped)
+{
+        UNREFERENCED_PARAMETER(overlapped);
+
+        FILE *f = ((Handle *)file)->file;
+        *n_written = (DWORD)fwrite(buffer, 1, size, f);
+
+        return *n_written == size;
+}
+
+DWORD
+GetFileSize(HANDLE file, DWORD *high)
+{
+        FILE *f = ((Handle *)file)->file;
+        long position = ftell(f);
+        if (fseek(f, 0, SEEK_END) != 0)
+                return INVALID_FILE_SIZE;
+        long size = ftell(f);
+        fseek(f, position, SEEK_SET);
+
+        if (high != NULL)
+                *high = 0;
+
+        return (DWORD)size;
+}
+
+BOOL
+DeleteFile(LPCTSTR name)
+{
+        char path[MAX_PATH];
+        int i;
+        for (i = 0; i < MAX_PATH - 1 && name[i] != L'\0'; i++)
+                path[i] = (char)name[i];
+        path[i] = '\0';
+
+        return remove(path) == 0;
+}
+
+/* Windows */
+
+UINT g_win32_window_calls;
+
+#define WINDOW_CALL() __atomic_add_fetch(&g_win32_window_calls, 1, __ATOMIC_RELAXED)
+
+BOOL
+IsWindow(HWND window)
+{
+        UNREFERENCED_PARAMETER(window);
+        WINDOW_CALL();
+        return FALSE;
+}
+
+BOOL
+IsWindowVisible(HWND window)
+{
+        UNREFERENCED_PARAMETER(window);
+        WINDOW_CALL();
+        return FALSE;
+}
+
+BOOL
+ShowWindow(HWND window, int command)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(command);
+        WINDOW_CALL();
+        return FALSE;
+}
+
+HWND
+GetWindow(HWND window, UINT command)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(command);
+        WINDOW_CALL();
+        return NULL;
+}
+
+HWND
+GetShellWindow(void)
+{
+        WINDOW_CALL();
+        return NULL;
+}
+
+LONG_PTR
+GetWindowLongPtr(HWND window, int index)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(index);
+        WINDOW_CALL();
+        return 0;
+}
+
+ULONG_PTR
+GetClassLongPtr(HWND window, int index)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(index);
+        WINDOW_CALL();
+        return 0;
+}
+
+int
+GetClassName(HWND window, LPTSTR name, int size)
+{
+        UNREFERENCED_PARAMETER(window);
+        WINDOW_CALL();
+        if (size > 0)
+                name[0] = L'\0';
+        return 0;
+}
+
+DWORD
+GetWindowThreadProcessId(HWND window, DWORD *process_id)
+{
+        UNREFERENCED_PARAMETER(window);
+        WINDOW_CALL();
+        if (process_id != NULL)
+                *process_id = 0;
+        return 0;
+}
+
+LRESULT
+SendMessageTimeout(HWND window, UINT message, WPARAM wparam, LPARAM lparam, UINT flags, UINT timeout, PDWORD_PTR result)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(message);
+        UNREFERENCED_PARAMETER(wparam);
+        UNREFERENCED_PARAMETER(lparam);
+        UNREFERENCED_PARAMETER(flags);
+        UNREFERENCED_PARAMETER(timeout);
+        WINDOW_CALL();
+        if (result != NULL)
+                *result = 0;
+        return 0;
+}
+
+BOOL
+EnumDesktopWindows(HANDLE desktop, WNDENUMPROC f, LPARAM lparam)
+{
+        UNREFERENCED_PARAMETER(desktop);
+        UNREFERENCED_PARAMETER(f);
+        UNREFERENCED_PARAMETER(lparam);
+        WINDOW_CALL();
+        return TRUE;
+}
+
+HANDLE
+OpenProcess(DWORD access, BOOL inherit, DWORD process_id)
+{
+        UNREFERENCED_PARAMETER(access);
+        UNREFERENCED_PARAMETER(inherit);
+        UNREFERENCED_PARAMETER(process_id);
+        WINDOW_CALL();
+        return NULL;
+}
+
+DWORD
+GetModuleFileNameEx(HANDLE process, HINSTANCE module, LPTSTR name, DWORD size)
+{
+        UNREFERENCED_PARAMETER(process);
+        UNREFERENCED_PARAMETER(module);
+        if (size > 0)
+                name[0] = L'\0';
+        return 0;
+}
+
+BOOL
+DestroyIcon(HICON icon)
+{
+        UNREFERENCED_PARAMETER(icon);
+        return TRUE;
+}
+
+/* GDI */
+
+BOOL
+GetIconInfo(HICON icon, ICONINFO *info)
+{
+        UNREFERENCED_PARAMETER(icon);
+        WINDOW_CALL();
+        ZeroMemory(info, sizeof(*info));
+        return FALSE;
+}
+
+int
+GetObject(HGDIOBJ object, int size, LPVOID data)
+{
+        UNREFERENCED_PARAMETER(object);
+        UNREFERENCED_PARAMETER(size);
+        UNREFERENCED_PARAMETER(data);
+        return 0;
+}
+
+BOOL
+DeleteObject(HGDIOBJ object)
+{
+        return object != NULL;
+}
+
+HDC
+GetDC(HWND window)
+{
+        UNREFERENCED_PARAMETER(window);
+        return NULL;
+}
+
+int
+ReleaseDC(HWND window, HDC dc)
+{
+        UNREFERENCED_PARAMETER(window);
+        UNREFERENCED_PARAMETER(dc);
+        return 0;
+}
+
+int
+GetDIBits(HDC dc, HBITMAP bitmap, UINT start, UINT lines, LPVOID bits, BITMAPINFO *info, UINT usage)
+{
+        UNREFERENCED_PARAMETER(dc);
+        UNREFERENCED_PARAMETER(bitmap);
+        UNREFERENCED_PARAMETER(start);
+        UNREFERENCED_PARAMETER(lines);
+        UNREFERENCED_PARAMETER(bits);
+        UNREFERENCED_PARAMETER(info);
+        UNREFERENCED_PARAMETER(usage);
+        return 0;
+}
+
+LONG
+GetBitmapBits(HBITMAP bitmap, LONG size, LPVOID bits)
+{
+        UNREFERENCED_PARAMETER(bitmap);
+        UNREFERENCED_PARAMETER(size);
+        UNREFERENCED_PARAMETER(bits);
+        return 0;
+}
+
+/* GDI+ */
+
+namespace Gdiplus {
+
+static REAL
+MeasureWidth(WCHAR const *string, INT length, Font const *font)
+{
+        if (length < 0)
+                length = lstrlen(string);
+
+        return length * font->GetSize() / 2.0f;
+}
+
+Status
+Graphics::MeasureString(WCHAR const *string, INT length, Font const *font,
+                        PointF const &origin, StringFormat const *format, RectF *bounds) const
+{
+        UNREFERENCED_PARAMETER(format);
+
+        *bounds = RectF(origin.X, origin.Y, MeasureWidth(string, length, font), font->GetHeight(this));
+
+        return Ok;
+}
+
+Status
+Graphics::MeasureString(WCHAR const *string, INT length, Font const *font,
+                        PointF const &origin, RectF *bounds) const
+{
+        return MeasureString(string, length, font, origin, NULL, bounds);
+}
+
+Status
+Graphics::MeasureString(WCHAR const *string, INT length, Font const *font,
+                        RectF const &area, StringFormat const *format, RectF *bounds) const
+{
+        return MeasureString(string, length, font, PointF(area.X, area.Y), format, bounds);
+}
+
+Status
+Graphics::MeasureCharacterRanges(WCHAR const *string, INT length, Font const *font,
+                                 RectF const &area, StringFormat const *format,
+                                 INT n, Region *regions) const
+{
+        UNREFERENCED_PARAMETER(length);
+
+        if (n > format->n_ranges)
+                return InvalidParameter;
+
+        for (INT i = 0; i < n; i++) {
+                CharacterRange const &range = format->ranges[i];
+                regions[i].bounds = RectF(area.X + MeasureWidth(string, range.First, font),
+                                          area.Y,
+                                          MeasureWidth(string + range.First, range.Length, font),
+                                          font->GetHeight(this));
+        }
+
+        return Ok;
+}
+
+Status
+Graphics::DrawString(WCHAR const *string, INT length, Font const *font,
+                     RectF const &area, StringFormat const *format, Brush const *brush)
+{
+        UNREFERENCED_PARAMETER(string);
+        UNREFERENCED_PARAMETER(length);
+        UNREFERENCED_PARAMETER(font);
+        UNREFERENCED_PARAMETER(area);
+        UNREFERENCED_PARAMETER(format);
+        UNREFERENCED_PARAMETER(brush);
+
+        n_strings++;
+
+        return Ok;
+}
+
+Status
+Graphics::DrawString(WCHAR const *string, INT length, Font const *font,
+                     PointF const &origin, Brush const *brush)
+{
+        return DrawString(string, length, font, RectF(origin.X, origin.Y, 0.0f, 0.0f), NULL, brush);
+}
+
+Status
+Graphics::DrawLine(Pen const *pen, PointF const &from, PointF const &to)
+{
+        UNREFERENCED_PARAMETER(pen);
+        UNREFERENCED_PARAMETER(from);
+        UNREFERENCED_PARAMETER(to);
+
+        n_lines++;
+
+        return Ok;
+}
+
+BOOL
+Graphics::IsVisible(RectF const &rect) const
+{
+        return rect.X < clip.GetRight() && rect.GetRight() > clip.X &&
+               rect.Y < clip.GetBottom() && rect.GetBottom() > clip.Y;
+}
+
+}
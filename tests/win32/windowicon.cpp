@@ -0,0 +1,44 @@
+﻿#include "stdafx.h"
+
+/* Stands in for windowicon.cpp, whose icons are GDI+ bitmaps.  Items of
+ * window lists get no icon, which is drawn as nothing, but the icons
+ * asked for are counted in g_window_icon_news. */
+
+UINT g_window_icon_news;
+
+Status
+WindowIconNew(WindowSource *source, HWND window, WindowIcon **icon)
+{
+        UNREFERENCED_PARAMETER(source);
+        UNREFERENCED_PARAMETER(window);
+
+        g_window_icon_news++;
+        *icon = NULL;
+
+        return Ok;
+}
+
+void
+WindowIconFree(WindowIcon *icon)
+{
+        UNREFERENCED_PARAMETER(icon);
+}
+
+Status
+WindowIconDraw(Graphics *graphics, WindowIcon const *icon, INT x, INT y)
+{
+        UNREFERENCED_PARAMETER(graphics);
+        UNREFERENCED_PARAMETER(icon);
+        UNREFERENCED_PARAMETER(x);
+        UNREFERENCED_PARAMETER(y);
+
+        return Ok;
+}
+
+void
+WindowIconGetDimensions(WindowIcon const *icon, INT *width, INT *height)
+{
+        UNREFERENCED_PARAMETER(icon);
+
+        *width = *height = DEFAULT_ICON_DELTA;
+}
@@ -1,6 +1,7 @@
 ﻿#include "stdafx.h"
 
 #include "buffer.h"
+#include "textmetrics.h"
 #include "textfield.h"
 
 /* The TextField is responsible for maintaining and displaying the
@@ -16,34 +17,72 @@
 /* The amount of padding to the left of the cursor. */
 #define TEXTFIELD_CURSOR_LEFT_PADDING   2.0f
 
+/* Value of FIRST_COMPLEX when there are no complex characters. */
+#define TEXTFIELD_NO_COMPLEX            UINT_MAX
+
 /* The TextField consists of a BUFFER being drawn in FONT and has a
- * cached size of SIZE. */
+ * cached size of SIZE.
+ *
+ * METRICS caches the advances of characters drawn in FONT.
+ * ADVANCES holds the prefix sums of the advances of the characters in
+ * BUFFER, ADVANCES[i] being the width of the first i characters.
+ * N_ALLOCATED is the number of REALs allocated in ADVANCES.
+ * N_MEASURED is the number of characters of BUFFER accounted for in
+ * ADVANCES.
+ * FIRST_COMPLEX is the index of the first character of BUFFER for which
+ * TextMetricsIsComplex() holds, in which case the whole buffer has to be
+ * measured to find its width.
+ * IS_DAMAGED is TRUE if the field has changed since it was last drawn,
+ * and DRAWN_WIDTH is the width of the text the cursor was drawn after. */
 struct _TextField
 {
         Buffer *buffer;
         Font const *font;
         SizeF size;
+        TextMetrics *metrics;
+        REAL *advances;
+        UINT n_allocated;
+        UINT n_measured;
+        UINT first_complex;
+        BOOL is_damaged;
+        REAL drawn_width;
 };
 
 static void
 TextFieldInvalidateSize(TextField *field)
 {
         field->size.Width = field->size.Height = INVALID_CXY;
+        field->n_measured = 0;
+        field->is_damaged = TRUE;
 }
 
 /* We need to know when the Buffer changes, so that we can update the
- * TextField’s size. */
+ * TextField’s size.  Only the advances of the characters that changed
+ * need to be recalculated. */
 static void 
 TextFieldBufferEventHandler(Buffer *buffer, BufferEvent event, VOID *closure)
 {
         TextField *field = (TextField *)closure;
 
-        if (event & BUFFER_ON_CHANGE)
-                TextFieldInvalidateSize(field);
+        if (event & BUFFER_ON_CHANGE) {
+                field->size.Width = INVALID_CXY;
+                field->n_measured = min(field->n_measured, BufferChangeStart(buffer));
+                field->is_damaged = TRUE;
+        }
 }
 
+static Status MeasureString(LPCTSTR string, int length, REAL *width, VOID *closure);
+
 TextField *
 TextFieldNew(Font const *font)
+{
+        return TextFieldNewWithMeasure(font, MeasureString);
+}
+
+/* Creates a TextField drawn in FONT whose text is measured by MEASURE,
+ * being passed the Canvas it’s measured on. */
+TextField *
+TextFieldNewWithMeasure(Font const *font, TextMetricsMeasureFunc measure)
 {
         TextField *field = ALLOC_STRUCT(TextField);
         if (field == NULL)
@@ -53,10 +92,15 @@ TextFieldNew(Font const *font)
         if (field->buffer == NULL)
                 goto cleanup;
 
+        field->metrics = TextMetricsNew(measure);
+        if (field->metrics == NULL)
+                goto cleanup;
+
         if (!BufferRegisterListener(field->buffer, BUFFER_ON_CHANGE, TextFieldBufferEventHandler, field))
                 goto cleanup;
 
         field->font = font;
+        field->first_complex = TEXTFIELD_NO_COMPLEX;
 
         TextFieldInvalidateSize(field);
 
@@ -73,6 +117,10 @@ TextFieldFree(TextField *field)
 {
         if (field->buffer != NULL)
                 BufferFree(field->buffer);
+        if (field->metrics != NULL)
+                TextMetricsFree(field->metrics);
+        if (field->advances != NULL)
+                FREE(field->advances);
         FREE(field);
 }
 
@@ -80,6 +128,7 @@ void
 TextFieldSetFont(TextField *field, Font const *font)
 {
         field->font = font;
+        TextMetricsClear(field->metrics);
         TextFieldInvalidateSize(field);
 }
 
@@ -103,41 +152,115 @@ UpdateHeight(TextField *field, Graphics const *graphics)
         return Ok;
 }
 
+/* Measures the WIDTH of the first LENGTH characters of STRING on the
+ * Canvas CLOSURE.  This is the TextMetricsMeasureFunc of a TextField. */
 static Status 
-UpdateWidth(TextField *field, Graphics const *graphics)
+MeasureString(LPCTSTR string, int length, REAL *width, VOID *closure)
 {
-        if (BufferLength(field->buffer) == 0) {
-                field->size.Width = 0.0f;
-                return Ok;
-        }
+        Canvas *canvas = (Canvas *)closure;
 
         StringFormat format;
         RETURN_GDI_FAILURE(format.SetFormatFlags(StringFormatFlagsNoWrap | StringFormatFlagsMeasureTrailingSpaces));
         RETURN_GDI_FAILURE(format.SetTrimming(StringTrimmingEllipsisCharacter));
-        CharacterRange ranges[] = { CharacterRange(0, BufferLength(field->buffer)) };
+        CharacterRange ranges[] = { CharacterRange(0, length) };
         RETURN_GDI_FAILURE(format.SetMeasurableCharacterRanges(1, ranges));
 
         RectF area(0.0f, 0.0f, 10000.0f, 10000.0f);
         Region regions[1];
-        RETURN_GDI_FAILURE(graphics->MeasureCharacterRanges(BufferContents(field->buffer),
-                                                            BufferLength(field->buffer),
-                                                            field->font, area,
-                                                            &format, 1, regions));
-        RETURN_GDI_FAILURE(regions[0].GetBounds(&area, graphics));
+        RETURN_GDI_FAILURE(canvas->graphics->MeasureCharacterRanges(string, length,
+                                                                    canvas->font, area,
+                                                                    &format, 1, regions));
+        RETURN_GDI_FAILURE(regions[0].GetBounds(&area, canvas->graphics));
+
+        *width = area.Width;
 
-        field->size.Width = area.Width;
+        return Ok;
+}
+
+/* Asserts that FIELD’s ADVANCES can hold N prefix sums. */
+static BOOL
+AssertAdvancesBigEnough(TextField *field, UINT n)
+{
+        if (n <= field->n_allocated)
+                return TRUE;
+
+        UINT new_size = max(n, field->n_allocated * 2);
+        REAL *new_advances = REALLOC_N(REAL, field->advances, new_size);
+        if (new_advances == NULL)
+                return FALSE;
+
+        field->advances = new_advances;
+        field->advances[0] = 0.0f;
+        field->n_allocated = new_size;
+
+        return TRUE;
+}
+
+/* Extends FIELD’s ADVANCES to cover all of its buffer, looking up the
+ * advances of characters that haven’t been accounted for yet. */
+static Status
+UpdateAdvances(TextField *field, Canvas *canvas)
+{
+        UINT length = BufferLength(field->buffer);
+        if (!AssertAdvancesBigEnough(field, length + 1))
+                return OutOfMemory;
+
+        field->n_measured = min(field->n_measured, length);
+        if (field->first_complex >= field->n_measured)
+                field->first_complex = TEXTFIELD_NO_COMPLEX;
+
+        LPCTSTR contents = BufferContents(field->buffer);
+        for (UINT i = field->n_measured; i < length; i++) {
+                REAL advance = 0.0f;
+                if (!TextMetricsIsComplex(contents[i]))
+                        RETURN_GDI_FAILURE(TextMetricsAdvance(field->metrics, contents[i], canvas, &advance));
+                else if (field->first_complex == TEXTFIELD_NO_COMPLEX)
+                        field->first_complex = i;
+
+                field->advances[i + 1] = field->advances[i] + advance;
+                field->n_measured = i + 1;
+        }
 
         return Ok;
 }
 
+/* Updates the width of FIELD.  The width is the sum of the advances of
+ * the characters in the buffer, unless there are characters that need
+ * shaping, in which case we measure the whole buffer.  The sum ignores
+ * kerning and ligatures, which can only put the cursor a pixel or so off
+ * the end of the text, as the text itself is drawn into all of the area
+ * given to TextFieldDraw(). */
 static Status 
-TextFieldValidateSize(TextField *field, Graphics const *graphics)
+UpdateWidth(TextField *field, Graphics const *graphics)
 {
-        if (field->size.Width != INVALID_CXY && field->size.Height != INVALID_CXY)
+        UINT length = BufferLength(field->buffer);
+        if (length == 0) {
+                field->size.Width = 0.0f;
                 return Ok;
+        }
+
+        Canvas canvas = { (Graphics *)graphics, field->font };
+        RETURN_GDI_FAILURE(UpdateAdvances(field, &canvas));
 
-        RETURN_GDI_FAILURE(UpdateHeight(field, graphics));
-        return UpdateWidth(field, graphics);
+        if (field->first_complex < length)
+                return TextMetricsMeasure(field->metrics, BufferContents(field->buffer),
+                                          length, &canvas, &field->size.Width);
+
+        field->size.Width = field->advances[length];
+
+        return Ok;
+}
+
+static Status 
+TextFieldValidateSize(TextField *field, Graphics const *graphics)
+{
+        if (field->size.Height == INVALID_CXY)
+                RETURN_GDI_FAILURE(UpdateHeight(field, graphics));
+
+        if (field->size.Width == INVALID_CXY)
+                RETURN_GDI_FAILURE(UpdateWidth(field, graphics));
+
+        return Ok;
 }
 
 Status 
@@ -188,7 +311,31 @@ TextFieldDraw(TextField *field, Graphics *graphics, RectF const *area)
         TextFieldValidateSize(field, graphics);
 
         RETURN_GDI_FAILURE(DrawBuffer(field, graphics, area));
-        return DrawCursor(field, graphics, area);
+        RETURN_GDI_FAILURE(DrawCursor(field, graphics, area));
+
+        field->is_damaged = FALSE;
+        field->drawn_width = field->size.Width;
+
+        return Ok;
+}
+
+/* Calls F with CLOSURE and the area of FIELD, drawn on GRAPHICS inside
+ * AREA, if it has changed since it was last drawn.  The area reaches as
+ * far as the cursor, both where it was drawn and where it’ll be drawn,
+ * as it may be drawn beyond AREA. */
+Status
+TextFieldDamage(TextField *field, Graphics const *graphics, RectF const *area, DamageFunc f, VOID *closure)
+{
+        if (!field->is_damaged)
+                return Ok;
+
+        RETURN_GDI_FAILURE(TextFieldValidateSize(field, graphics));
+
+        REAL cursor_right = max(field->drawn_width, field->size.Width) + TEXTFIELD_CURSOR_LEFT_PADDING + 1.0f;
+        RectF damage(area->X, area->Y, max(area->Width, cursor_right), max(area->Height, field->size.Height));
+        f(&damage, closure);
+
+        return Ok;
 }
 
 #define VK_CONTROL_U            VK_KANA
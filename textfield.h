@@ -1,9 +1,11 @@
 ﻿typedef struct _TextField TextField;
 
 TextField *TextFieldNew(Font const *font);
+TextField *TextFieldNewWithMeasure(Font const *font, TextMetricsMeasureFunc measure);
 void TextFieldFree(TextField *field);
 void TextFieldSetFont(TextField *field, Font const *font);
 Status TextFieldSize(TextField *field, Graphics const *graphics, SizeF *size);
 Buffer *TextFieldBuffer(TextField const *field);
 Status TextFieldDraw(TextField *field, Graphics *graphics, RectF const *area);
+Status TextFieldDamage(TextField *field, Graphics const *graphics, RectF const *area, DamageFunc f, VOID *closure);
 BOOL TextFieldOnChar(TextField *field, TCHAR c, int n, BOOL control);
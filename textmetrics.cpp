@@ -0,0 +1,145 @@
+﻿#include "stdafx.h"
+
+#include "textmetrics.h"
+
+/* TextMetrics caches the advance of each character drawn in a given
+ * font, so that the width of a simple string can be found by summing
+ * the advances of its characters instead of measuring the whole string.
+ * The actual measuring is done by a TextMetricsMeasureFunc, which is
+ * only called the first time a character is seen.  Characters that need
+ * shaping don’t have meaningful advances on their own, see
+ * TextMetricsIsComplex().
+ *
+ * The sum leaves out kerning and ligatures between simple characters,
+ * so it may be off from what measuring the whole string gives by about
+ * a pixel for each kerned pair.  That’s close enough for placing a
+ * cursor, but not for laying out text that has to line up. */
+
+/* The number of characters in a page of cached advances. */
+#define TEXTMETRICS_PAGE_SIZE   256
+
+/* The number of pages needed to cover all TCHARs. */
+#define TEXTMETRICS_N_PAGES     (0x10000 / TEXTMETRICS_PAGE_SIZE)
+
+/* Cached advances of characters, measured by MEASURE.
+ *
+ * PAGES are allocated on demand, each holding the advances of
+ * TEXTMETRICS_PAGE_SIZE consecutive characters, INVALID_CXY meaning
+ * that the advance hasn’t been measured yet. */
+struct _TextMetrics
+{
+        TextMetricsMeasureFunc measure;
+        REAL *pages[TEXTMETRICS_N_PAGES];
+};
+
+/* Creates a new, empty, TextMetrics that measures using MEASURE. */
+TextMetrics *
+TextMetricsNew(TextMetricsMeasureFunc measure)
+{
+        TextMetrics *metrics = ALLOC_STRUCT(TextMetrics);
+        if (metrics == NULL)
+                return NULL;
+
+        metrics->measure = measure;
+
+        return metrics;
+}
+
+/* Forgets all cached advances of METRICS, e.g., when its font changes. */
+void
+TextMetricsClear(TextMetrics *metrics)
+{
+        for (int i = 0; i < TEXTMETRICS_N_PAGES; i++) {
+                if (metrics->pages[i] != NULL)
+                        FREE(metrics->pages[i]);
+                metrics->pages[i] = NULL;
+        }
+}
+
+void
+TextMetricsFree(TextMetrics *metrics)
+{
+        TextMetricsClear(metrics);
+        FREE(metrics);
+}
+
+/* Gets the page of METRICS containing C, allocating it if needed. */
+static REAL *
+TextMetricsPage(TextMetrics *metrics, TCHAR c)
+{
+        REAL **page = &metrics->pages[(WORD)c / TEXTMETRICS_PAGE_SIZE];
+        if (*page != NULL)
+                return *page;
+
+        *page = ALLOC_N(REAL, TEXTMETRICS_PAGE_SIZE);
+        if (*page == NULL)
+                return NULL;
+
+        for (int i = 0; i < TEXTMETRICS_PAGE_SIZE; i++)
+                (*page)[i] = INVALID_CXY;
+
+        return *page;
+}
+
+/* Gets the ADVANCE of C, measuring it with CLOSURE if it isn’t cached. */
+Status
+TextMetricsAdvance(TextMetrics *metrics, TCHAR c, VOID *closure, REAL *advance)
+{
+        REAL *page = TextMetricsPage(metrics, c);
+        if (page == NULL)
+                return OutOfMemory;
+
+        REAL *cached = &page[(WORD)c % TEXTMETRICS_PAGE_SIZE];
+        if (*cached == INVALID_CXY)
+                RETURN_GDI_FAILURE(metrics->measure(&c, 1, cached, closure));
+
+        *advance = *cached;
+
+        return Ok;
+}
+
+/* Measures the WIDTH of the first LENGTH characters of STRING as a
+ * whole with CLOSURE, for strings whose width isn’t the sum of the
+ * advances of their characters. */
+Status
+TextMetricsMeasure(TextMetrics *metrics, LPCTSTR string, int length, VOID *closure, REAL *width)
+{
+        return metrics->measure(string, length, width, closure);
+}
+
+/* Determines whether C belongs to a script where the width of a string
+ * isn’t the sum of the advances of its characters, i.e., where
+ * characters combine, join, or are reordered.  Surrogates are included,
+ * as half a pair can’t be measured on its own. */
+BOOL
+TextMetricsIsComplex(TCHAR c)
+{
+        static struct {
+                WCHAR first;
+                WCHAR last;
+        } const ranges[] = {
+                { 0x0300, 0x036f },     /* Combining diacritical marks */
+                { 0x0483, 0x0489 },     /* Cyrillic combining marks */
+                { 0x0590, 0x08ff },     /* Hebrew, Arabic, Syriac, Thaana, … */
+                { 0x0900, 0x0dff },     /* Indic scripts */
+                { 0x0e00, 0x0fff },     /* Thai, Lao, Tibetan */
+                { 0x1000, 0x109f },     /* Myanmar */
+                { 0x1100, 0x11ff },     /* Hangul Jamo */
+                { 0x1780, 0x18af },     /* Khmer, Mongolian */
+                { 0x1dc0, 0x1dff },     /* Combining diacritical marks supplement */
+                { 0x200b, 0x200f },     /* Zero-width and directional marks */
+                { 0x202a, 0x202e },     /* Directional embeddings */
+                { 0x20d0, 0x20ff },     /* Combining marks for symbols */
+                { 0xd800, 0xdfff },     /* Surrogates */
+                { 0xfb1d, 0xfdff },     /* Hebrew and Arabic presentation forms */
+                { 0xfe00, 0xfe0f },     /* Variation selectors */
+                { 0xfe20, 0xfe2f },     /* Combining half marks */
+                { 0xfe70, 0xfeff },     /* Arabic presentation forms-B */
+        };
+
+        for (int i = 0; i < _countof(ranges); i++)
+                if (c >= ranges[i].first && c <= ranges[i].last)
+                        return TRUE;
+
+        return FALSE;
+}
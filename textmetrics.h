@@ -0,0 +1,12 @@
+﻿typedef struct _TextMetrics TextMetrics;
+
+/* A function measuring the WIDTH of the first LENGTH characters of
+ * STRING, being passed the closure given to TextMetricsAdvance(). */
+typedef Status (*TextMetricsMeasureFunc)(LPCTSTR string, int length, REAL *width, VOID *closure);
+
+TextMetrics *TextMetricsNew(TextMetricsMeasureFunc measure);
+void TextMetricsFree(TextMetrics *metrics);
+void TextMetricsClear(TextMetrics *metrics);
+Status TextMetricsAdvance(TextMetrics *metrics, TCHAR c, VOID *closure, REAL *advance);
+Status TextMetricsMeasure(TextMetrics *metrics, LPCTSTR string, int length, VOID *closure, REAL *width);
+BOOL TextMetricsIsComplex(TCHAR c);
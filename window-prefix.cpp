@@ -5,10 +5,18 @@
 #include <shlobj.h>
 #include "window-prefix.h"
 #include "list.h"
+#include "windowsource.h"
 #include "windowlistitem.h"
 #include "windowlist.h"
+#include "windowmodel.h"
 #include "buffer.h"
+#include "textmetrics.h"
 #include "textfield.h"
+#include "filter.h"
+#include "recording.h"
+#include "prewarm.h"
+#include "coalescer.h"
+#include "damage.h"
 #include "systray.h"
 #include "hook/hook.h"
 
@@ -19,6 +27,31 @@
 #define IDK_BASE                1000
 #define IDK_SHOW_WINDOWLIST     (IDK_BASE + 1)
 
+#define IDT_PREWARM             1
+#define IDT_ICON_CHANGES        2
+
+/* The number of milliseconds between checks for whether to warm up the
+ * window list, and the least number of milliseconds between warm-ups. */
+#define PREWARM_TICK            (5 * 1000)
+#define PREWARM_INTERVAL        (30 * 1000)
+
+/* The number of cached icons visited by the sweep for windows that no
+ * longer exist on each tick while the window list is hidden. */
+#define ICON_SWEEP_BATCH        8
+
+/* The number of milliseconds changes of a window’s icon are gathered for
+ * before it’s loaded anew, so that windows animating their icons don’t
+ * have them loaded for every frame. */
+#define ICON_CHANGE_DELAY       100
+
+/* The number of rectangles the damage of the window is kept as. */
+#define DAMAGE_MAX_RECTS        8
+
+/* Command-line options for recording the desktop to a file and for
+ * showing the windows of such a recording instead of the desktop’s. */
+#define RECORD_OPTION           L"/record "
+#define REPLAY_OPTION           L"/replay "
+
 #define BACKGROUND_ALPHA        0xbf
 
 #define RIGHT_ANGLE (90.0f)
@@ -31,7 +64,12 @@
 static HINSTANCE s_instance;
 static LPCWSTR g_window_name;
 
+static WindowModel *g_model;
 static WindowList *g_list;
+static Filter *g_filter;
+static Prewarm *g_prewarm;
+static Coalescer *g_icon_changes;
+static Damage *g_damage;
 static TextField *g_buffer;
 static REAL g_buffer_height;
 
@@ -113,6 +151,8 @@ LastErrorAsStatus(VOID)
 static Status 
 CreateMemoryDC(Rect const *canvas_area, MemoryDC *memory_dc)
 {
+        memory_dc->bitmap = NULL;
+        memory_dc->saved_bitmap = NULL;
         memory_dc->dc = CreateCompatibleDC(HDC_OF_SCREEN);
         if (memory_dc->dc == NULL)
                 return LastErrorAsStatus();
@@ -169,7 +209,9 @@ DrawBackground(Graphics *canvas, Rect *area)
 
         RETURN_GDI_FAILURE(background.CloseAllFigures());
 
-        /* TODO: This is slow when using high quality rendition. */
+        /* NOTE: This is slow when using high quality rendition, which is
+         * why it’s only done once for each size of the window; see
+         * BackBufferBackground(). */
         return canvas->FillPath(&background_brush, &background);
 }
 
@@ -185,45 +227,255 @@ DrawTitle(Graphics *canvas, Font *font, RectF *area)
         return canvas->DrawString(TITLE_STRING, -1, font, *area, &format, &white_brush);
 }
 
-#define FREE_AND_RETURN_GDI_FAILURE(call, memory_dc) MACRO_BLOCK_START  \
-        Status __return_on_gdiplus_failure_status = call;               \
-if (__return_on_gdiplus_failure_status != Ok) {                         \
-        MemoryDCFree(&(memory_dc));                                     \
-        return __return_on_gdiplus_failure_status;                      \
-}                                                                       \
-MACRO_BLOCK_END
+typedef struct _BackBuffer BackBuffer;
+
+/* The surface the window is drawn on before it’s handed to
+ * UpdateLayeredWindow(), kept between draws and only allocated anew as
+ * the window changes size.  WIDTH and HEIGHT are the size of MEMORY_DC’s
+ * bitmap, and CANVAS draws on it, having been set up by GraphicsSetup()
+ * as the bitmap was allocated.  BACKGROUND is the background of the
+ * window at that size, drawn once and copied onto each frame, or NULL
+ * until it’s been drawn.  IS_COMPLETE is TRUE while it holds a whole
+ * frame of the current layout, in which case only the damage is drawn
+ * anew. */
+struct _BackBuffer
+{
+        MemoryDC memory_dc;
+        INT width;
+        INT height;
+        Graphics *canvas;
+        Bitmap *background;
+        BOOL is_complete;
+};
+
+static BackBuffer g_back_buffer;
 
-static Status 
-Draw(HWND window)
+typedef struct _DrawCounters DrawCounters;
+
+/* Counters of Draw().
+ *
+ * FRAMES counts the frames drawn, PARTIAL_FRAMES those for which only
+ * the damage was drawn anew, ALLOCATIONS the back buffers allocated
+ * for them, and BACKGROUNDS the backgrounds drawn for those.
+ * TIME is the total, and MAX_TIME the largest, number of microseconds
+ * spent drawing a frame, including handing it to the layered window. */
+struct _DrawCounters
 {
-        Rect canvas_area;
-        RETURN_GDI_FAILURE(GetClientPlusRect(window, &canvas_area));
+        UINT frames;
+        UINT partial_frames;
+        UINT allocations;
+        UINT backgrounds;
+        ULONGLONG time;
+        DWORD max_time;
+};
 
-        MemoryDC memory_dc;
-        RETURN_GDI_FAILURE(CreateMemoryDC(&canvas_area, &memory_dc));
+static DrawCounters g_draw_counters;
 
-        Graphics canvas(memory_dc.dc);
-        FREE_AND_RETURN_GDI_FAILURE(canvas.GetLastStatus(), memory_dc);
+static void
+BackBufferFree(BackBuffer *buffer)
+{
+        if (buffer->canvas != NULL)
+                delete buffer->canvas;
+        if (buffer->background != NULL)
+                delete buffer->background;
 
-        FREE_AND_RETURN_GDI_FAILURE(GraphicsSetup(&canvas), memory_dc);
+        MemoryDCFree(&buffer->memory_dc);
 
-        FREE_AND_RETURN_GDI_FAILURE(DrawBackground(&canvas, &canvas_area), memory_dc);
+        ZeroMemory(buffer, sizeof(*buffer));
+}
 
-        FREE_AND_RETURN_GDI_FAILURE(DrawTitle(&canvas, g_caption_font, &g_title_area), memory_dc);
+/* Sets CANVAS to the Graphics of BUFFER, allocating its bitmap anew
+ * first if it isn’t the size of CANVAS_AREA. */
+static Status
+BackBufferGet(BackBuffer *buffer, Rect const *canvas_area, Graphics **canvas)
+{
+        if (buffer->canvas != NULL &&
+            buffer->width == canvas_area->Width &&
+            buffer->height == canvas_area->Height) {
+                *canvas = buffer->canvas;
+                return Ok;
+        }
+
+        BackBufferFree(buffer);
 
-        FREE_AND_RETURN_GDI_FAILURE(TextFieldDraw(g_buffer, &canvas, &g_buffer_area), memory_dc);
+        RETURN_GDI_FAILURE(CreateMemoryDC(canvas_area, &buffer->memory_dc));
+
+        buffer->canvas = new Graphics(buffer->memory_dc.dc);
+        Status status = (buffer->canvas != NULL) ? buffer->canvas->GetLastStatus() : OutOfMemory;
+        if (status == Ok)
+                status = GraphicsSetup(buffer->canvas);
+        if (status != Ok) {
+                BackBufferFree(buffer);
+                return status;
+        }
+
+        buffer->width = canvas_area->Width;
+        buffer->height = canvas_area->Height;
+        g_draw_counters.allocations++;
+
+        *canvas = buffer->canvas;
+
+        return Ok;
+}
+
+/* Sets BACKGROUND to the background of the window for BUFFER, which is
+ * CANVAS_AREA, drawing it first if it hasn’t been drawn since BUFFER was
+ * allocated. */
+static Status
+BackBufferBackground(BackBuffer *buffer, Rect *canvas_area, Bitmap **background)
+{
+        if (buffer->background != NULL) {
+                *background = buffer->background;
+                return Ok;
+        }
+
+        Bitmap *bitmap = new Bitmap(canvas_area->Width, canvas_area->Height, PixelFormat32bppPARGB);
+        Status status = (bitmap != NULL) ? bitmap->GetLastStatus() : OutOfMemory;
+        if (status == Ok) {
+                Graphics graphics(bitmap);
+                status = graphics.GetLastStatus();
+                if (status == Ok)
+                        status = GraphicsSetup(&graphics);
+                if (status == Ok)
+                        status = DrawBackground(&graphics, canvas_area);
+        }
+        if (status != Ok) {
+                if (bitmap != NULL)
+                        delete bitmap;
+                return status;
+        }
+
+        buffer->background = bitmap;
+        g_draw_counters.backgrounds++;
+
+        *background = bitmap;
+
+        return Ok;
+}
+
+/* Adds AREA, rounded out to whole pixels and a pixel more for
+ * anti-aliasing, to the Damage CLOSURE.  This is the DamageFunc of the
+ * window. */
+static void
+AddDamage(RectF const *area, VOID *closure)
+{
+        INT left = (INT)area->X - 1;
+        INT top = (INT)area->Y - 1;
+        INT right = (INT)(area->X + area->Width) + 2;
+        INT bottom = (INT)(area->Y + area->Height) + 2;
+
+        DamageAdd((Damage *)closure, left, top, right - left, bottom - top);
+}
+
+/* Sets G_DAMAGE to what has changed inside CANVAS_AREA since the last
+ * frame: the text field and the rows of the window list that changed.
+ * The background and the title only change along with the layout, in
+ * which case the whole frame is drawn anew. */
+static Status
+CollectDamage(Graphics *canvas, Rect const *canvas_area)
+{
+        DamageClear(g_damage);
+
+        RETURN_GDI_FAILURE(TextFieldDamage(g_buffer, canvas, &g_buffer_area, AddDamage, g_damage));
+
+        RETURN_GDI_FAILURE(WindowListDamage(g_list, canvas, &g_window_list_area, AddDamage, g_damage));
+
+        DamageClip(g_damage, canvas_area->X, canvas_area->Y, canvas_area->Width, canvas_area->Height);
+
+        return Ok;
+}
+
+/* Limits the drawing on CANVAS to DAMAGE. */
+static Status
+ClipToDamage(Graphics *canvas, Damage const *damage)
+{
+        Region clip;
+        RETURN_GDI_FAILURE(clip.MakeEmpty());
+
+        DamageRect const *rects = DamageRects(damage);
+        for (UINT i = 0; i < DamageLength(damage); i++)
+                RETURN_GDI_FAILURE(clip.Union(Rect(rects[i].x, rects[i].y, rects[i].width, rects[i].height)));
+
+        return canvas->SetClip(&clip);
+}
+
+/* Copies BACKGROUND onto CANVAS_AREA of CANVAS, replacing what was
+ * there, as far as the clipping region of CANVAS reaches. */
+static Status
+CopyBackground(Graphics *canvas, Bitmap *background, Rect *canvas_area)
+{
+        RETURN_GDI_FAILURE(canvas->SetCompositingMode(CompositingModeSourceCopy));
 
-        FREE_AND_RETURN_GDI_FAILURE(WindowListDraw(g_list, &canvas, &g_window_list_area), memory_dc);
+        Status status = canvas->DrawImage(background, *canvas_area,
+                                          0, 0, canvas_area->Width, canvas_area->Height,
+                                          UnitPixel);
+
+        RETURN_GDI_FAILURE(canvas->SetCompositingMode(CompositingModeSourceOver));
+
+        return status;
+}
+
+/* Draws the layers of the window on CANVAS, as far as its clipping
+ * region reaches.  The background is copied from the one drawn for the
+ * back buffer’s size, rather than being drawn anew. */
+static Status
+DrawLayers(Graphics *canvas, Rect *canvas_area)
+{
+        Bitmap *background;
+        RETURN_GDI_FAILURE(BackBufferBackground(&g_back_buffer, canvas_area, &background));
+
+        RETURN_GDI_FAILURE(CopyBackground(canvas, background, canvas_area));
+
+        RETURN_GDI_FAILURE(DrawTitle(canvas, g_caption_font, &g_title_area));
+
+        RETURN_GDI_FAILURE(TextFieldDraw(g_buffer, canvas, &g_buffer_area));
+
+        RETURN_GDI_FAILURE(WindowListDraw(g_list, canvas, &g_window_list_area));
 
 #ifdef _DEBUG
-        canvas.DrawRectangle(&Pen(Color::Red, 1), g_title_area);
-        canvas.DrawRectangle(&Pen(Color::Blue, 1), g_buffer_area);
-        canvas.DrawRectangle(&Pen(Color::Green, 1), g_window_list_area);
+        canvas->DrawRectangle(&Pen(Color::Red, 1), g_title_area);
+        canvas->DrawRectangle(&Pen(Color::Blue, 1), g_buffer_area);
+        canvas->DrawRectangle(&Pen(Color::Green, 1), g_window_list_area);
 #endif
 
-        POINT origin;
-        origin.x = 0;
-        origin.y = 0;
+        return Ok;
+}
+
+/* Draws what changed since the last frame on the back buffer, or all of
+ * it if it doesn’t hold a complete frame, and hands it to the layered
+ * window, only updating what changed where possible. */
+static Status 
+DrawFrame(HWND window)
+{
+        Rect canvas_area;
+        RETURN_GDI_FAILURE(GetClientPlusRect(window, &canvas_area));
+
+        Graphics *canvas;
+        RETURN_GDI_FAILURE(BackBufferGet(&g_back_buffer, &canvas_area, &canvas));
+
+        BOOL is_partial = g_back_buffer.is_complete && g_damage != NULL &&
+                CollectDamage(canvas, &canvas_area) == Ok;
+        if (is_partial && DamageIsEmpty(g_damage))
+                return Ok;
+
+        /* NOTE: If drawing fails, the whole frame is drawn anew next
+         * time. */
+        g_back_buffer.is_complete = FALSE;
+
+        Status status = is_partial ? ClipToDamage(canvas, g_damage) : Ok;
+        if (status == Ok)
+                status = DrawLayers(canvas, &canvas_area);
+        canvas->ResetClip();
+        RETURN_GDI_FAILURE(status);
+
+        g_back_buffer.is_complete = TRUE;
+
+        RECT dirty;
+        DamageRect bounds;
+        if (is_partial && DamageBounds(g_damage, &bounds)) {
+                SetRect(&dirty, bounds.x, bounds.y, bounds.x + bounds.width, bounds.y + bounds.height);
+                g_draw_counters.partial_frames++;
+        }
 
         SIZE size;
         size.cx = canvas_area.Width;
@@ -235,15 +487,34 @@ Draw(HWND window)
         bf.SourceConstantAlpha = 0xff;
         bf.AlphaFormat = AC_SRC_ALPHA;
 
-        HDC canvas_dc = canvas.GetHDC();
-        UpdateLayeredWindow(window, NULL, NULL, &size, canvas_dc, &origin, 0, &bf, ULW_ALPHA);
-        canvas.ReleaseHDC(canvas_dc);
-
-        MemoryDCFree(&memory_dc);
+        HDC canvas_dc = canvas->GetHDC();
+        MyUpdateLayeredWindow(window, &size, canvas_dc, &bf, is_partial ? &dirty : NULL);
+        canvas->ReleaseHDC(canvas_dc);
 
         return Ok;
 }
 
+/* Draws the window on the back buffer and hands it to the layered
+ * window, timing it. */
+static Status
+Draw(HWND window)
+{
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        Status status = DrawFrame(window);
+
+        QueryPerformanceCounter(&end);
+
+        DWORD time = (DWORD)((end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart);
+        g_draw_counters.frames++;
+        g_draw_counters.time += time;
+        g_draw_counters.max_time = max(g_draw_counters.max_time, time);
+
+        return status;
+}
+
 static Status
 CalculateSubAreas(Graphics *canvas, PointF *origin, Rect *constraint_area)
 {
@@ -286,6 +557,9 @@ CalculateSubAreas(Graphics *canvas, PointF *origin, Rect *constraint_area)
 static void 
 AdjustWindowSize(HWND window)
 {
+        /* NOTE: Anything may move as the layout changes. */
+        g_back_buffer.is_complete = FALSE;
+
         Graphics canvas(window);
         GraphicsSetup(&canvas);
 
@@ -331,6 +605,27 @@ SwitchToAndHide(WindowListItem *item, HWND window)
         HideWindow(window);
 }
 
+/* Brings the window list in line with everything typed so far before
+ * it’s acted upon: any changes to the buffer that are still being
+ * batched are sent on, and any filtering underway in the background is
+ * cancelled and done here and now instead, as its result may not have
+ * arrived yet.  Returns FALSE if flushing the buffer already switched to
+ * a window, hiding WINDOW. */
+static BOOL
+SettleWindowList(HWND window)
+{
+        BufferFlush(TextFieldBuffer(g_buffer));
+        if (!IsWindowVisible(window))
+                return FALSE;
+
+        if (g_filter != NULL) {
+                FilterCancel(g_filter);
+                WindowListFilter(g_list, BufferContents(TextFieldBuffer(g_buffer)));
+        }
+
+        return TRUE;
+}
+
 static BOOL 
 CharDigitValue(TCHAR c, int *value)
 {
@@ -355,7 +650,8 @@ HandleDigits(HWND window, TCHAR digit)
         if (n == 0)
                 n = 10;
 
-        SwitchToAndHide(WindowListNthShown(g_list, n), window);
+        if (SettleWindowList(window))
+                SwitchToAndHide(WindowListNthShown(g_list, n), window);
         return 0;
 }
 
@@ -390,7 +686,8 @@ OnChar(HWND window, TCHAR c, int cRepeat)
                 HideWindow(window);
                 return 0;
         } else if (c == VK_RETURN) { // TODO: this needs to be modified once we can move between items.
-                SwitchToAndHide(WindowListNthShown(g_list, 1), window);
+                if (SettleWindowList(window))
+                        SwitchToAndHide(WindowListNthShown(g_list, 1), window);
                 return 0;
         }
 
@@ -422,32 +719,94 @@ OnKillFocus(HWND window, HWND window_focus)
         return 0;
 }
 
+/* Updates the display after the window list has been filtered. */
+static void
+WindowListFiltered(HWND window)
+{
+        if (WindowListLengthShown(g_list) == 1) {
+                SwitchToAndHide(WindowListNthShown(g_list, 1), window);
+                return;
+        }
+        RedrawWindow(window, NULL, NULL, RDW_INTERNALPAINT);
+}
+
+/* Filters the window list whenever the buffer changes.  The matching is
+ * done by g_filter in the background if possible, the result arriving
+ * through WM_FILTERDONE. */
 static void 
 MyBufferEventHandler(Buffer *buffer, BufferEvent event, VOID *closure)
 {
         if (event & BUFFER_ON_CHANGE) {
+                /* NOTE: Edits that cancelled each other out, such as a
+                 * character typed and erased within one turn, leave the
+                 * contents as they were. */
+                if (BufferChangeDelta(buffer) == 0 && BufferChangeStart(buffer) >= BufferLength(buffer))
+                        return;
+
                 HWND main_window = (HWND)closure;
-                WindowListFilter(g_list, BufferContents(buffer));
-                if (WindowListLengthShown(g_list) == 1) {
-                        SwitchToAndHide(WindowListNthShown(g_list, 1), main_window);
+                if (g_filter != NULL && FilterSubmit(g_filter, g_list, BufferContents(buffer)))
                         return;
-                }
-                RedrawWindow(main_window, NULL, NULL, RDW_INTERNALPAINT);
+                WindowListFilter(g_list, BufferContents(buffer));
+                WindowListFiltered(main_window);
         }
 }
 
+static LRESULT
+OnFilterDone(HWND window, FilterResult *result)
+{
+        /* NOTE: A change still being batched supersedes RESULT. */
+        BufferFlush(TextFieldBuffer(g_buffer));
+        if (FilterResultApply(g_filter, result))
+                WindowListFiltered(window);
+        FilterResultFree(result);
+
+        return 0;
+}
+
+/* Patches the icon loaded for OWNER into its rows, setting *CLOSURE if
+ * any of them are shown. */
+static void
+IconLoaded(HWND owner, VOID *closure)
+{
+        WindowEvent event = { WINDOW_EVENT_ICON_CHANGED, owner, NULL };
+        if (WindowModelHandleEvent(g_model, &event) && WindowListShowsOwner(g_list, owner))
+                *(BOOL *)closure = TRUE;
+}
+
+/* Swaps in the icons that have been loaded in the background for the
+ * default icons shown in their place, never waiting for any.  The
+ * window is only redrawn if one of its rows got a new icon. */
+static void
+DeliverIcons(HWND window)
+{
+        BOOL changed = FALSE;
+        WindowIconLoaderDeliver(IconLoaded, &changed);
+
+        if (changed && IsWindowVisible(window))
+                RedrawWindow(window, NULL, NULL, RDW_INTERNALPAINT);
+}
+
 static void 
 DisplayWindowListIfNotAlreadyDisplayed(HWND window)
 {
-        if (g_list != NULL)
-                WindowListFree(g_list);
-        g_list = WindowListNew(g_caption_font);
+        if (g_filter != NULL)
+                FilterCancel(g_filter);
 
         if (GetForegroundWindow() == window && g_list != NULL && WindowListLength(g_list) > 1) {
-                SwitchToAndHide(WindowListNthShown(g_list, 2), window);
+                if (SettleWindowList(window))
+                        SwitchToAndHide(WindowListNthShown(g_list, 2), window);
                 return;
         }
 
+        /* NOTE: The list has been kept warm, so only repair what changed
+         * since. */
+        WindowListDiff repaired;
+        WindowModelReconcile(g_model, &repaired);
+        if (g_prewarm != NULL)
+                PrewarmDisplayed(g_prewarm, &repaired);
+        /* NOTE: New windows get the default icon until theirs arrives. */
+        DeliverIcons(window);
+
         BufferReset(TextFieldBuffer(g_buffer));
         WindowListFilter(g_list, BufferContents(TextFieldBuffer(g_buffer)));
         AdjustWindowSize(window);
@@ -472,7 +831,7 @@ DisplayWindowListIfNotAlreadyDisplayed(HWND window)
                         UpdateLayeredWindow(window, NULL, NULL, NULL, NULL, NULL, NULL, &blend, ULW_ALPHA);
                         Sleep(12);
                 }
-                if (WindowListLength(g_list) > 0)
+                if (WindowListLength(g_list) > 0 && SettleWindowList(window))
                         SwitchToAndHide(WindowListNthShown(g_list, 0), window);
                 else
                         HideWindow(window);
@@ -570,16 +929,183 @@ OnFontChange(HWND window)
         g_caption_font = new_caption_font;
         TextFieldSetFont(g_buffer, g_caption_font);
         WindowListSetFont(g_list, g_caption_font);
+        g_back_buffer.is_complete = FALSE;
+
+        return 0;
+}
+
+/* Scales the icons anew if the size of small icons has changed, e.g.,
+ * along with the DPI, measuring the window list again. */
+static LRESULT
+OnSettingChange(HWND window, LPCTSTR section)
+{
+        UNREFERENCED_PARAMETER(section);
+
+        if (g_list == NULL || !WindowIconMetricsChanged())
+                return 0;
+
+        WindowListInvalidateSizes(g_list);
+        if (IsWindowVisible(window)) {
+                AdjustWindowSize(window);
+                Draw(window);
+        }
+
+        return 0;
+}
+
+/* Updates the window model according to EVENT, updating the display if
+ * the window list is being displayed. */
+static void
+HandleWindowEvent(HWND window, WindowEvent const *event)
+{
+        if (g_filter != NULL)
+                FilterCancel(g_filter);
+
+        BOOL changed = WindowModelHandleEvent(g_model, event);
+
+        if (!IsWindowVisible(window))
+                return;
+
+        WindowListFilter(g_list, BufferContents(TextFieldBuffer(g_buffer)));
+        if (changed)
+                AdjustWindowSize(window);
+        Draw(window);
+}
+
+static LRESULT 
+OnWPHookWindowActivated(HWND window, HWND activated_window, BOOL fullscreen)
+{
+        UNREFERENCED_PARAMETER(fullscreen);
+
+        if (activated_window == NULL || activated_window == window)
+                return 0;
 
+        WindowEvent event = { WINDOW_EVENT_ACTIVATED, activated_window, NULL };
+        HandleWindowEvent(window, &event);
+        return 0;
+}
+
+static LRESULT 
+OnWPHookWindowCreated(HWND window, HWND created_window)
+{
+        WindowEvent event = { WINDOW_EVENT_CREATED, created_window, NULL };
+        HandleWindowEvent(window, &event);
+        return 0;
+}
+
+static LRESULT 
+OnWPHookWindowDestroyed(HWND window, HWND destroyed_window)
+{
+        WindowIconWindowDestroyed(destroyed_window, (DWORD)GetMessageTime());
+
+        WindowEvent event = { WINDOW_EVENT_DESTROYED, destroyed_window, NULL };
+        HandleWindowEvent(window, &event);
+        return 0;
+}
+
+static LRESULT 
+OnWPHookWindowReplaced(HWND window, HWND replaced_window, HWND new_window)
+{
+        WindowEvent event = { WINDOW_EVENT_REPLACED, replaced_window, new_window };
+        HandleWindowEvent(window, &event);
+        return 0;
+}
+
+static LRESULT 
+OnWPHookWindowTitleChanged(HWND window, HWND changed_window)
+{
+        WindowEvent event = { WINDOW_EVENT_TITLE_CHANGED, changed_window, NULL };
+        HandleWindowEvent(window, &event);
         return 0;
 }
 
 static LRESULT 
 OnWPHookWindowIconChanged(HWND window, HWND changed_window)
 {
-        UNREFERENCED_PARAMETER(window);
+        /* NOTE: The icon is loaded in the background once the changes
+         * have settled, and delivered on WM_WINDOWICON_LOADED. */
+        if (g_icon_changes != NULL) {
+                BOOL was_idle = CoalescerLength(g_icon_changes) == 0;
+                if (CoalescerPost(g_icon_changes, (ULONGLONG)(ULONG_PTR)changed_window, GetTickCount())) {
+                        if (was_idle)
+                                SetTimer(window, IDT_ICON_CHANGES, ICON_CHANGE_DELAY, NULL);
+                        return 0;
+                }
+        }
+
+        WindowIconIconChanged(WindowModelSource(g_model), changed_window);
+
+        WindowEvent event = { WINDOW_EVENT_ICON_CHANGED, changed_window, NULL };
+        HandleWindowEvent(window, &event);
+        return 0;
+}
+
+static LRESULT
+OnWindowIconLoaded(HWND window)
+{
+        DeliverIcons(window);
+
+        return 0;
+}
+
+/* Warms up the window list while it’s hidden, bringing it in line with
+ * the desktop and measuring its items, so that displaying it only has to
+ * repair what changed in the meantime. */
+static void
+WarmUp(HWND window)
+{
+        if (g_filter != NULL)
+                FilterCancel(g_filter);
+
+        WindowListDiff diff;
+        WindowModelReconcile(g_model, &diff);
+
+        WindowListFilter(g_list, L"");
+        AdjustWindowSize(window);
+
+        if (g_prewarm != NULL)
+                PrewarmWarmed(g_prewarm);
+}
+
+/* Loads the icons of the windows whose icon changes have settled anew
+ * in the background, waiting for the rest. */
+static void
+ReloadChangedIcons(HWND window)
+{
+        DWORD now = GetTickCount();
+
+        ULONGLONG key;
+        while (CoalescerTake(g_icon_changes, now, &key)) {
+                HWND changed_window = (HWND)(ULONG_PTR)key;
+                if (WindowSourceExists(WindowModelSource(g_model), changed_window) &&
+                    !WindowIconLoaderReload(WindowModelSource(g_model), changed_window))
+                        CoalescerPost(g_icon_changes, key, now);
+        }
+
+        if (CoalescerLength(g_icon_changes) > 0)
+                SetTimer(window, IDT_ICON_CHANGES, (UINT)max(CoalescerNextDue(g_icon_changes, now), 1), NULL);
+        else
+                KillTimer(window, IDT_ICON_CHANGES);
+}
+
+static LRESULT
+OnTimer(HWND window, UINT id)
+{
+        if (id == IDT_ICON_CHANGES) {
+                ReloadChangedIcons(window);
+                return 0;
+        }
+
+        if (id != IDT_PREWARM || IsWindowVisible(window))
+                return 0;
+
+        WindowIconSweep(WindowModelSource(g_model), ICON_SWEEP_BATCH);
+
+        if (g_prewarm != NULL && !PrewarmIsDue(g_prewarm))
+                return 0;
+
+        WarmUp(window);
 
-        WindowIconIconChanged(changed_window);
         return 0;
 }
 
@@ -604,7 +1130,16 @@ WndProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam)
                 HANDLE_MSG(window, WM_HOTKEY, OnHotKey);
                 HANDLE_MSG(window, WM_DESTROY, OnDestroy);
                 HANDLE_MSG(window, WM_FONTCHANGE, OnFontChange);
+                HANDLE_MSG(window, WM_WININICHANGE, OnSettingChange);
+                HANDLE_MSG(window, WM_WPHOOK_WINDOW_ACTIVATED, OnWPHookWindowActivated);
+                HANDLE_MSG(window, WM_WPHOOK_WINDOW_CREATED, OnWPHookWindowCreated);
+                HANDLE_MSG(window, WM_WPHOOK_WINDOW_DESTROYED, OnWPHookWindowDestroyed);
+                HANDLE_MSG(window, WM_WPHOOK_WINDOW_REPLACED, OnWPHookWindowReplaced);
+                HANDLE_MSG(window, WM_WPHOOK_WINDOW_TITLE_CHANGED, OnWPHookWindowTitleChanged);
                 HANDLE_MSG(window, WM_WPHOOK_WINDOW_ICON_CHANGED, OnWPHookWindowIconChanged);
+                HANDLE_MSG(window, WM_TIMER, OnTimer);
+                HANDLE_MSG(window, WM_FILTERDONE, OnFilterDone);
+                HANDLE_MSG(window, WM_WINDOWICON_LOADED, OnWindowIconLoaded);
                 HANDLE_MSG(window, WM_PAINT, OnPaint);
         default: return DefWindowProc(window, message, wParam, lParam);
         }
@@ -939,6 +1474,10 @@ InstallSystrayIcon(HWND window, HINSTANCE instance, Error **error)
         return TRUE;
 }
 
+/* Runs the message loop.  Changes made to the TextField’s Buffer are
+ * batched while there are messages waiting to be processed, so that
+ * a held-down key or a paste only causes one filtering and redraw of
+ * the window list once the queue runs dry. */
 int 
 MainLoop(VOID)
 {
@@ -946,11 +1485,79 @@ MainLoop(VOID)
         while (GetMessage(&message, NULL, 0, 0)) {
                 TranslateMessage(&message);
                 DispatchMessage(&message);
+
+                MSG pending;
+                if (g_buffer != NULL && !PeekMessage(&pending, NULL, 0, 0, PM_NOREMOVE))
+                        BufferFlush(TextFieldBuffer(g_buffer));
         }
 
         return (int)message.wParam;
 }
 
+#ifdef _DEBUG
+static void
+ReportDrawCounters(VOID)
+{
+        TCHAR message[256];
+        StringCchPrintf(message, _countof(message),
+                        L"Draw: %u frames (%u partial) on %u back buffers with %u backgrounds, "
+                        L"%I64u us in total, %lu us at most\r\n",
+                        g_draw_counters.frames, g_draw_counters.partial_frames, g_draw_counters.allocations,
+                        g_draw_counters.backgrounds,
+                        g_draw_counters.time, g_draw_counters.max_time);
+        OutputDebugString(message);
+}
+
+static void
+ReportPrewarmCounters(Prewarm const *prewarm)
+{
+        PrewarmCounters counters;
+        PrewarmCountersGet(prewarm, &counters);
+
+        TCHAR message[256];
+        StringCchPrintf(message, _countof(message),
+                        L"Prewarm: warmed %u times, skipped %u on battery and %u busy; "
+                        L"displayed %u times, %u warm, repairing %u items; "
+                        L"staleness %I64u ms in total, %lu ms at most\r\n",
+                        counters.warmed, counters.skipped_on_battery, counters.skipped_busy,
+                        counters.displayed, counters.displayed_warm, counters.repaired,
+                        counters.staleness, counters.max_staleness);
+        OutputDebugString(message);
+}
+
+static void
+ReportBufferCounters(Buffer const *buffer)
+{
+        BufferEventCounters counters;
+        BufferEventCountersGet(buffer, &counters);
+
+        TCHAR message[256];
+        StringCchPrintf(message, _countof(message),
+                        L"Buffer: %u changes delivered, %u more coalesced into them\r\n",
+                        counters.delivered, counters.coalesced);
+        OutputDebugString(message);
+}
+
+static void
+ReportIconCacheCounters(VOID)
+{
+        WindowIconCounters counters;
+        WindowIconCountersGet(&counters);
+
+        TCHAR message[512];
+        StringCchPrintf(message, _countof(message),
+                        L"Icon cache: %u hits, %u misses (%u from disk), %u deduplicated, %u evicted; "
+                        L"%u windows sharing %u icons of %Iu bytes; "
+                        L"%u dropped as destroyed and %u swept, %I64u ms late in total, %lu ms at most; "
+                        L"%u windows checked by the sweep in %I64u us in total, %lu us at most\r\n",
+                        counters.hits, counters.misses, counters.disk_hits, counters.dedups, counters.evictions,
+                        counters.n_windows, counters.n_icons, counters.bytes,
+                        counters.destroyed, counters.swept, counters.eviction_latency, counters.max_eviction_latency,
+                        counters.sweep_checks, counters.sweep_time, counters.max_sweep_time);
+        OutputDebugString(message);
+}
+#endif
+
 int APIENTRY 
 _tWinMain(HINSTANCE instance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCmdShow)
 {
@@ -964,7 +1571,12 @@ _tWinMain(HINSTANCE instance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCm
 
         g_window_name = _(IDS_WINDOW_NAME, L"Window*");
 
+        if (IsPrefixIgnoringCase(lpCmdLine, RECORD_OPTION))
+                return RecordingWrite(WindowSourceDesktop(), lpCmdLine + lstrlen(RECORD_OPTION)) ?
+                        EXIT_SUCCESS : EXIT_FAILURE;
+
         int exit_value = EXIT_FAILURE;
+        Recording *recording = NULL;
         ULONG_PTR gdiplus_token = NULL;
         Error *error = NULL;
         if (!GdiInitialize(&gdiplus_token, &error))
@@ -995,9 +1607,43 @@ _tWinMain(HINSTANCE instance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCm
                 goto cleanup;
 
         BufferRegisterListener(TextFieldBuffer(g_buffer), BUFFER_ON_CHANGE, MyBufferEventHandler, main_window);
+        BufferSetBatching(TextFieldBuffer(g_buffer), TRUE);
+
+        /* NOTE: We filter on the UI thread if this fails. */
+        g_filter = FilterNew(main_window);
+
+        /* NOTE: The whole window is drawn every time if this fails. */
+        g_damage = DamageNew(DAMAGE_MAX_RECTS);
+
+        /* NOTE: Icons are loaded as they’re needed, and loaded anew as
+         * soon as they change, if this fails. */
+        if (WindowIconLoaderStart(main_window))
+                g_icon_changes = CoalescerNew(ICON_CHANGE_DELAY);
+
+        if (IsPrefixIgnoringCase(lpCmdLine, REPLAY_OPTION)) {
+                recording = RecordingRead(lpCmdLine + lstrlen(REPLAY_OPTION));
+                if (recording == NULL) {
+                        error = ErrorNew(L"Unable to read the recording “%s”.",
+                                         lpCmdLine + lstrlen(REPLAY_OPTION));
+                        goto cleanup;
+                }
+        }
+
+        g_model = WindowModelNew(recording != NULL ? RecordingSource(recording) : WindowSourceDesktop(),
+                                 g_caption_font);
+        if (g_model == NULL)
+                goto cleanup;
+        g_list = WindowModelList(g_model);
 
+        /* NOTE: If this fails we warm up on every tick. */
+        g_prewarm = PrewarmNew(PREWARM_INTERVAL);
+
+        /* NOTE: If this fails we rely on the hook and repairs on display. */
+        SetTimer(main_window, IDT_PREWARM, PREWARM_TICK, NULL);
+
+        /* NOTE: Events of the live desktop don’t apply to a recording. */
         /* TODO: Load hook.dll dynamically and fail gracefully? */
-        if (!WPHookRegister(main_window))
+        if (recording == NULL && !WPHookRegister(main_window))
                 goto cleanup;
 
         exit_value = MainLoop();
@@ -1005,14 +1651,44 @@ _tWinMain(HINSTANCE instance, HINSTANCE hPrevInstance, LPTSTR lpCmdLine, int nCm
 cleanup:
         WPHookUnregister();
 
-        if (g_list != NULL)
-                WindowListFree(g_list);
+        if (g_filter != NULL)
+                FilterFree(g_filter);
 
-        if (g_buffer != NULL)
+        if (g_prewarm != NULL) {
+#ifdef _DEBUG
+                ReportPrewarmCounters(g_prewarm);
+#endif
+                PrewarmFree(g_prewarm);
+        }
+
+        if (g_icon_changes != NULL)
+                CoalescerFree(g_icon_changes);
+
+        if (g_model != NULL)
+                WindowModelFree(g_model);
+
+        if (g_buffer != NULL) {
+#ifdef _DEBUG
+                ReportBufferCounters(TextFieldBuffer(g_buffer));
+#endif
                 TextFieldFree(g_buffer);
+        }
 
+#ifdef _DEBUG
+        ReportIconCacheCounters();
+#endif
         WindowIconFinalize();
 
+#ifdef _DEBUG
+        ReportDrawCounters();
+#endif
+        BackBufferFree(&g_back_buffer);
+        if (g_damage != NULL)
+                DamageFree(g_damage);
+
+        if (recording != NULL)
+                RecordingFree(recording);
+
         if (g_caption_font != NULL)
                 delete g_caption_font;
 
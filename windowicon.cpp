@@ -1,265 +1,536 @@
 ﻿#include <stdafx.h>
 
 #include "bitmap.h"
+#include "pixels.h"
+#include "resample.h"
+#include "mipchain.h"
+#include "iconatlas.h"
+#include "diskcache.h"
+#include "windowsource.h"
 #include "windowicon.h"
-#include "list.h"
+#include "hashtable.h"
+#include "workerpool.h"
+#include "atomicqueue.h"
+
+/* The number of icons that fit side by side on the atlas, and the
+ * number of rows of them it has room for to begin with. */
+#define ATLAS_ICONS_PER_ROW         16
+#define ATLAS_INITIAL_ROWS          4
+
+/* The number of bytes of icons, and of the chains they’re scaled from,
+ * the cache tries to stay within. */
+#define CACHE_BUDGET                (1024 * 1024)
+
+/* The atlas holding all window icons. */
+static IconAtlas *s_atlas;
+
+/* The size icons are displayed in, that of small icons, as of the last
+ * call to WindowIconInitialize() or WindowIconMetricsChanged().  Loader
+ * threads read it too, so icons loaded as it changes are scaled anew
+ * when they’re delivered. */
+static UINT s_icon_width;
+static UINT s_icon_height;
+
+/* An icon on the atlas, shared by all windows whose icons have the same
+ * pixels.
+ *
+ * HASH is the hash of its pixels, under which it’s kept in S_ICONS.
+ * SLOT is the Rect it occupies on the atlas.
+ * MIPS is the chain it was scaled from, kept so that it may be scaled
+ * to another size without being decoded anew.
+ * N_REFS is the number of references to it, held by cache entries,
+ * window-list items, and S_DEFAULT_ICON.
+ * NEXT and PREVIOUS link all icons, starting at S_FIRST_ICON, as two
+ * icons may end up with the same hash when they’re scaled anew. */
+struct _WindowIcon
+{
+        HashKey hash;
+        Rect slot;
+        MipChain *mips;
+        int n_refs;
+        WindowIcon *next;
+        WindowIcon *previous;
+};
 
-/* The default icon to use when no other icon can be provided. */
-static Bitmap *s_default_icon;
+/* The icons on the atlas, keyed by the hashes of their pixels. */
+static HashTable *s_icons;
+static WindowIcon *s_first_icon;
 
-static List *s_cache;
-static int s_cache_size;
-static int s_cache_next_compression_size = 20;
+/* The default icon to use when no other icon can be provided. */
+static WindowIcon *s_default_icon;
 
 typedef struct _CacheEntry CacheEntry;
 
+/* The cached ICON of WINDOW.  GENERATION is the pass of the sweep in
+ * which WINDOW was last known to exist, and SEEN the tick count it was
+ * last known to exist at.  NEWER and OLDER link the entries from the
+ * most recently used to the least recently used. */
 struct _CacheEntry
 {
         HWND window;
+        WindowIcon *icon;
+        UINT generation;
+        DWORD seen;
+        CacheEntry *newer;
+        CacheEntry *older;
+};
+
+/* The cache of the icons of windows.  S_CACHE maps windows to their
+ * CacheEntries, S_NEWEST being the most recently used of them and
+ * S_OLDEST the least recently used. */
+static HashTable *s_cache;
+static CacheEntry *s_newest;
+static CacheEntry *s_oldest;
+
+/* The sweep of the cache for windows that no longer exist, which checks
+ * a few entries at a time from the least recently used to the most
+ * recently used; see WindowIconSweep().  S_SWEEP_NEXT is the entry to
+ * check next, and S_SWEEP_GENERATION the number of the current pass.
+ * Entries already known to exist during the current pass are skipped,
+ * but still count toward the entries a call may visit. */
+static CacheEntry *s_sweep_next;
+static UINT s_sweep_generation;
+
+static WindowIconCounters s_counters;
+
+/* The icons kept on disk from earlier runs, or NULL if they couldn’t be
+ * opened.  It’s opened before the loader starts and closed after it
+ * stops.  The loader threads only look icons up in it with
+ * DiskCacheGet(), which reads nothing but the store mapped from disk,
+ * and that doesn’t change while it’s open.  DiskCacheRemember() writes
+ * to it, so it’s only called on the thread that called
+ * WindowIconInitialize(); calling it on a loader thread needs a lock. */
+static DiskCache *s_disk_cache;
+
+/* The number of Resamplers kept around for scaling icons.  Applications
+ * only ship icons in a handful of sizes, so a few are plenty. */
+#define RESAMPLER_CACHE_SIZE        8
+
+/* Resamplers from the icon sizes seen so far to the size icons are
+ * displayed in.  S_RESAMPLER_LOCK protects them, as icons are scaled on
+ * the loader’s threads. */
+static Resampler *s_resamplers[RESAMPLER_CACHE_SIZE];
+static int s_n_resamplers;
+static CRITICAL_SECTION s_resampler_lock;
+
+/* The number of threads used for loading icons in the background.
+ * Icons are retrieved by sending messages to their windows, so a few
+ * hung windows mustn’t hold up the rest. */
+#define LOADER_THREADS              4
+
+/* Background loading of icons, set up by WindowIconLoaderStart().
+ *
+ * S_LOADER runs the loads.  Finished IconLoads are pushed onto S_LOADED
+ * by the loader threads without taking a lock, and S_LOADER_WINDOW is
+ * sent WM_WINDOWICON_LOADED when S_LOADED becomes non-empty.  S_PENDING
+ * maps windows that are being loaded to their IconLoads, so that each
+ * window is only loaded once at a time, and so that loads of windows
+ * destroyed in the meantime are told apart; it’s only used from the
+ * thread that called WindowIconLoaderStart(). */
+static WorkerPool *s_loader;
+static HWND s_loader_window;
+static HashTable *s_pending;
+static AtomicQueue s_loaded;
+
+typedef struct _IconLoad IconLoad;
+
+/* The loading of the icon of WINDOW in SOURCE.  ICON is NULL until
+ * loaded, and stays NULL if WINDOW has no icon of its own.  MIPS is the
+ * chain ICON was scaled from, HASH is the hash of ICON’s pixels, and KEY
+ * is what ICON is kept under on disk, or NULL, all worked out on the
+ * loader thread.  KEY is worked out first, setting HAS_KEY, and if
+ * WANTS_DISK_ICON, the icon kept on disk under it is handed over as
+ * DISK_ICON before ICON is loaded, so that it may be shown meanwhile.
+ * NODE links it into S_LOADED once either is ready. */
+struct _IconLoad
+{
+        AtomicQueueNode node;
+        WindowSource *source;
+        HWND window;
+        BOOL wants_disk_icon;
+        BOOL has_key;
+        Bitmap *disk_icon;
         Bitmap *icon;
+        MipChain *mips;
+        HashKey hash;
+        LPTSTR key;
 };
 
-static CacheEntry *
-CacheEntryNew(HWND window, Bitmap *icon)
+/* Gets the number of bytes taken up by ICON on the atlas and by the
+ * chain it’s scaled from. */
+static SIZE_T
+WindowIconBytes(WindowIcon const *icon)
 {
-        CacheEntry *entry = ALLOC_STRUCT(CacheEntry);
+        return (SIZE_T)icon->slot.Width * icon->slot.Height * sizeof(ARGB) + MipChainBytes(icon->mips);
+}
 
-        entry->window = window;
-        entry->icon = icon;
+/* Adds a reference to ICON. */
+static WindowIcon *
+WindowIconRef(WindowIcon *icon)
+{
+        icon->n_refs++;
 
-        return entry;
+        return icon;
 }
 
-static void 
-CacheEntryFree(CacheEntry *entry)
+/* Drops a reference to ICON, as set by WindowIconNew().  The icon is
+ * removed from the atlas once there are no references to it left. */
+void
+WindowIconFree(WindowIcon *icon)
 {
-        delete entry->icon;
-        FREE(entry);
+        if (icon == NULL || --icon->n_refs > 0)
+                return;
+
+        if (HashTableLookup(s_icons, icon->hash) == icon)
+                HashTableRemove(s_icons, icon->hash);
+        if (icon->next != NULL)
+                icon->next->previous = icon->previous;
+        if (icon->previous != NULL)
+                icon->previous->next = icon->next;
+        else
+                s_first_icon = icon->next;
+        IconAtlasRemove(s_atlas, &icon->slot);
+        s_counters.n_icons--;
+        s_counters.bytes -= WindowIconBytes(icon);
+        MipChainFree(icon->mips);
+        FREE(icon);
 }
 
-static BOOL 
-CacheEntryWindowEqual(CacheEntry *entry, HWND window)
+/* Sets ICON to a new reference to the icon with the pixels of BITMAP,
+ * whose hash is HASH, scaled from MIPS.  BITMAP is only added to the
+ * atlas if no icon with the same pixels is there already.  BITMAP and
+ * MIPS are freed. */
+static Status
+WindowIconIntern(Bitmap *bitmap, HashKey hash, MipChain *mips, WindowIcon **icon)
 {
-        return entry->window == window;
+        WindowIcon *shared = (WindowIcon *)HashTableLookup(s_icons, hash);
+        if (shared != NULL) {
+                delete bitmap;
+                MipChainFree(mips);
+                s_counters.dedups++;
+                *icon = WindowIconRef(shared);
+                return Ok;
+        }
+
+        WindowIcon *added = ALLOC_STRUCT(WindowIcon);
+        if (added == NULL) {
+                delete bitmap;
+                MipChainFree(mips);
+                return OutOfMemory;
+        }
+
+        Status status = IconAtlasAdd(s_atlas, bitmap, &added->slot);
+        delete bitmap;
+        if (status == Ok && !HashTableInsert(s_icons, hash, added)) {
+                IconAtlasRemove(s_atlas, &added->slot);
+                status = OutOfMemory;
+        }
+        if (status != Ok) {
+                MipChainFree(mips);
+                FREE(added);
+                return status;
+        }
+
+        added->hash = hash;
+        added->mips = mips;
+        added->next = s_first_icon;
+        if (s_first_icon != NULL)
+                s_first_icon->previous = added;
+        s_first_icon = added;
+        s_counters.n_icons++;
+        s_counters.bytes += WindowIconBytes(added);
+        *icon = WindowIconRef(added);
+
+        return Ok;
 }
 
-static CacheEntry *
-CacheLookup(HWND window)
+/* Works out the hash of BITMAP’s pixels and a chain of BITMAP alone,
+ * for icons that there’s nothing larger to scale from, and hands them to
+ * WindowIconIntern(). */
+static Status
+WindowIconFromBitmap(Bitmap *bitmap, WindowIcon **icon)
 {
-        return (CacheEntry *)ListFindItem(s_cache, (EqualityFunc)CacheEntryWindowEqual, window);
+        HashKey hash;
+        UINT width, height;
+        ARGB *pixels;
+        Status status = BitmapHash(bitmap, &hash);
+        if (status == Ok)
+                status = BitmapGetPremultipliedPixels(bitmap, &width, &height, &pixels);
+        if (status != Ok) {
+                delete bitmap;
+                return status;
+        }
+
+        MipChain *mips = MipChainNew(width, height, pixels, width, height);
+        FREE(pixels);
+        if (mips == NULL) {
+                delete bitmap;
+                return OutOfMemory;
+        }
+
+        return WindowIconIntern(bitmap, hash, mips, icon);
 }
 
-static BOOL 
-CacheEntryInvalid(CacheEntry *entry)
+static void
+CacheUnlink(CacheEntry *entry)
 {
-        return !IsWindow(entry->window);
+        if (s_sweep_next == entry)
+                s_sweep_next = entry->newer;
+
+        if (entry->newer != NULL)
+                entry->newer->older = entry->older;
+        else
+                s_newest = entry->older;
+
+        if (entry->older != NULL)
+                entry->older->newer = entry->newer;
+        else
+                s_oldest = entry->newer;
 }
 
-static void 
-CacheCompress(void)
+static void
+CacheLinkNewest(CacheEntry *entry)
 {
-        if (s_cache_size < s_cache_next_compression_size)
-                return;
+        entry->newer = NULL;
+        entry->older = s_newest;
 
-        s_cache = ListRemoveIf(s_cache, (PredicateFunc)CacheEntryInvalid, (FreeFunc)CacheEntryFree);
-        s_cache_size = ListLength(s_cache);
-        s_cache_next_compression_size = max(s_cache_size * 2, 20);
+        if (s_newest != NULL)
+                s_newest->newer = entry;
+        else
+                s_oldest = entry;
+        s_newest = entry;
 }
 
-static void 
-CacheAdd(HWND window, Bitmap *icon)
+static CacheEntry *
+CacheLookup(HWND window)
 {
-        CacheEntry *entry = CacheEntryNew(window, icon);
-        if (entry == NULL)
-                return;
+        return (CacheEntry *)HashTableLookup(s_cache, HASH_KEY(window));
+}
 
-        if (!ListCons(&s_cache, entry))
-                CacheEntryFree(entry);
-        else
-                s_cache_size++;
+/* Removes ENTRY from the cache, dropping its reference to its icon. */
+static void
+CacheRemove(CacheEntry *entry)
+{
+        CacheUnlink(entry);
+        HashTableRemove(s_cache, HASH_KEY(entry->window));
+        WindowIconFree(entry->icon);
+        FREE(entry);
+        s_counters.n_windows--;
 }
 
-static BOOL 
-CacheUpdate(HWND window, Bitmap *icon)
+/* Removes ENTRY, whose window no longer exists, from the cache,
+ * counting the LATENCY, in milliseconds, between the window going away
+ * and its entry being removed. */
+static void
+CacheEvictDead(CacheEntry *entry, DWORD latency)
 {
-        CacheEntry *entry = CacheLookup(window);
-        if (entry == NULL)
-                return FALSE;
+        CacheRemove(entry);
 
-        delete entry->icon;
-        entry->icon = icon;
+        s_counters.eviction_latency += latency;
+        s_counters.max_eviction_latency = max(s_counters.max_eviction_latency, latency);
+}
 
-        return TRUE;
+/* Evicts the least recently used entries, but never the most recently
+ * used one, until the icons on the atlas fit within CACHE_BUDGET.  Only
+ * entries holding the last reference to their icon are evicted, as
+ * evicting the others wouldn’t free anything. */
+static void
+CacheTrim(void)
+{
+        CacheEntry *newer;
+        for (CacheEntry *entry = s_oldest; entry != s_newest && s_counters.bytes > CACHE_BUDGET; entry = newer) {
+                newer = entry->newer;
+                if (entry->icon->n_refs == 1) {
+                        CacheRemove(entry);
+                        s_counters.evictions++;
+                }
+        }
 }
 
+/* Caches ICON as the icon of WINDOW, taking a reference of its own. */
 static VOID 
-CachePut(HWND window, Bitmap *icon)
+CachePut(HWND window, WindowIcon *icon)
 {
-        if (CacheUpdate(window, icon))
-                return;
+        WindowIconRef(icon);
+
+        CacheEntry *entry = CacheLookup(window);
+        if (entry != NULL) {
+                WindowIconFree(entry->icon);
+                entry->icon = icon;
+                CacheUnlink(entry);
+        } else {
+                entry = ALLOC_STRUCT(CacheEntry);
+                if (entry == NULL || !HashTableInsert(s_cache, HASH_KEY(window), entry)) {
+                        if (entry != NULL)
+                                FREE(entry);
+                        WindowIconFree(icon);
+                        return;
+                }
+                entry->window = window;
+                entry->icon = icon;
+                s_counters.n_windows++;
+        }
+        entry->generation = s_sweep_generation;
+        entry->seen = GetTickCount();
+        CacheLinkNewest(entry);
 
-        CacheAdd(window, icon);
-        CacheCompress();
+        CacheTrim();
 }
 
+/* Sets ICON to a new reference to the cached icon of WINDOW.  Returns
+ * FALSE if it isn’t cached. */
 static BOOL 
-CacheGet(HWND window, Bitmap **icon)
+CacheGet(HWND window, WindowIcon **icon)
 {
         CacheEntry *entry = CacheLookup(window);
-        if (entry == NULL)
+        if (entry == NULL) {
+                s_counters.misses++;
                 return FALSE;
+        }
 
-        *icon = entry->icon;
+        s_counters.hits++;
+        CacheUnlink(entry);
+        CacheLinkNewest(entry);
+        *icon = WindowIconRef(entry->icon);
 
         return TRUE;
 }
 
-/* Gets the HICON for ICON_ID ({ICON_BIG, ICON_SMALL, ICON_SMALL2}) associated
- * with WINDOW.  Returns FALSE if unable to retrieve this icon and sets
- * WAS_HUNG to true if the reason it fail was because the message timed out. */
-static BOOL 
-GetWindowHIconByMessage(HWND window, WPARAM icon_id, HICON *icon, BOOL *was_hung)
+/* Gets a Resampler from SOURCE_WIDTH by SOURCE_HEIGHT to WIDTH by HEIGHT,
+ * reusing the filter weights worked out for earlier icons of the same
+ * size.  IS_CACHED is set to FALSE if the cache was full, in which case the
+ * caller has to free the Resampler when done with it. */
+static Resampler *
+ResamplerGet(UINT source_width, UINT source_height, UINT width, UINT height, BOOL *is_cached)
 {
-        *icon = NULL;
-        *was_hung = FALSE;
-
-        if (SendMessageTimeout(window, WM_GETICON, icon_id, 0, SMTO_ABORTIFHUNG, HUNG_TIMEOUT, (PDWORD_PTR)icon))
-                return *icon != NULL;
+        Resampler *resampler = NULL;
+        *is_cached = TRUE;
 
-        *was_hung = LastErrorWasTimeout();
+        EnterCriticalSection(&s_resampler_lock);
 
-        return FALSE;
-}
+        for (int i = 0; i < s_n_resamplers && resampler == NULL; i++)
+                if (ResamplerMatches(s_resamplers[i], source_width, source_height, width, height))
+                        resampler = s_resamplers[i];
 
-/* Gets the HICON for ICON_ID ({ICON_BIG, ICON_SMALL, ICON_SMALL2}) associated
- * with WINDOW, also trying to get it by calling GetClassLongPtr(WINDOW, CLASS_LONG_ICON).
- * Returns FALSE if unable to retrieve both of these icons. */
-static BOOL 
-GetWindowHIcon(HWND window, WPARAM icon_id, int class_long_icon, HICON *icon)
-{
-        BOOL was_hung;
-
-        if (GetWindowHIconByMessage(window, icon_id, icon, &was_hung))
-                return TRUE;
+        if (resampler == NULL) {
+                resampler = ResamplerNew(source_width, source_height, width, height);
+                if (resampler != NULL && s_n_resamplers < RESAMPLER_CACHE_SIZE)
+                        s_resamplers[s_n_resamplers++] = resampler;
+                else
+                        *is_cached = FALSE;
+        }
 
-        if (was_hung)
-                return FALSE;
+        LeaveCriticalSection(&s_resampler_lock);
 
-        *icon = (HICON)(UINT_PTR)GetClassLongPtr(window, class_long_icon);
-        return *icon != NULL;
+        return resampler;
 }
 
-/* Iterator setting the alpha channel’s value by checking the bitmap mask’s pixels.
- * If the mask’s pixel is black, set the alpha channel to opaque and to transparent
- * otherwise. */
-static Status 
-BitmapCopyWithMaskIterator(Point point, ARGB pixel, VOID *closure, IterationState *state)
+/* Scales MIPS to WIDTH by HEIGHT into a new premultiplied BITMAP,
+ * resampling the level of MIPS closest to that size.  Doesn’t touch the
+ * cache, so it may be called from any thread. */
+static Status
+BitmapFromMipChain(MipChain const *mips, UINT width, UINT height, Bitmap **bitmap)
 {
-        UNREFERENCED_PARAMETER(state);
+        UINT source_width, source_height;
+        ARGB const *source = MipChainLevel(mips, MipChainPick(mips, width, height), &source_width, &source_height);
+        if (source_width == width && source_height == height)
+                return BitmapFromPremultipliedPixels(width, height, source, bitmap);
+
+        BOOL is_cached;
+        Resampler *resampler = ResamplerGet(source_width, source_height, width, height, &is_cached);
+        if (resampler == NULL)
+                return OutOfMemory;
 
-        BitmapIterateForCopyClosure *copy_closure = (BitmapIterateForCopyClosure *)closure;
-        Bitmap *mask = (Bitmap *)copy_closure->inner_closure;
+        Status status = OutOfMemory;
+        ARGB *pixels = ALLOC_N(ARGB, width * height);
+        if (pixels != NULL) {
+                if (ResamplerRun(resampler, pixels, (int)(width * sizeof(ARGB)), source, (int)(source_width * sizeof(ARGB))))
+                        status = BitmapFromPremultipliedPixels(width, height, pixels, bitmap);
+                FREE(pixels);
+        }
 
-        Color mask_pixel;
-        RETURN_GDI_FAILURE(mask->GetPixel(point.X, point.Y, &mask_pixel));
-        BOOL visible = mask_pixel.GetValue() == Color::Black;
-        ARGB fixed_pixel = ARGBSetAlpha(pixel, visible ? ALPHA_OPAQUE : ALPHA_TRANSPARENT);
-        BitmapDataRow(&copy_closure->copy_data, point.Y)[point.X] = fixed_pixel;
+        if (!is_cached)
+                ResamplerFree(resampler);
 
-        return Ok;
+        return status;
 }
 
-/* Creates a Bitmap from a Bitmap SOURCE created from a HBITMAP of an icon.
- * If SOURCE has less than 32 bits of information per pixel, use the
- * non-alpha-bitmap copy-routine.  Otherwise, if SOURCE has pixels with the
- * alpha channel set, do a simple per-pixel copy of it.  Otherwise, create
- * the copy by copying pixels and setting the alpha channel based on HB_MASK,
- * which should be a 1-bit-per-pixel HBITMAP where pixels that should be
- * transparent are set to 1 and pixels that should be opaque are sot to 0. */
+/* Decodes ICON into a chain of premultiplied copies, halved for as long
+ * as they’re no smaller than the size icons are displayed in.  Unless its
+ * colors have an alpha channel of their own, its alpha values are taken
+ * from its mask. */
 static Status
-BitmapFromIconBitmap(Bitmap *source, HBITMAP hb_mask, Bitmap **icon)
+MipChainFromSourceIcon(WindowSourceIcon const *icon, MipChain **mips)
 {
-        if (GetPixelFormatSize(source->GetPixelFormat()) < 32)
-                return NonAlphaBitmapCopy(source, icon);
-
-        BOOL has_alpha;
-        RETURN_GDI_FAILURE(BitmapHasAlpha(source, &has_alpha));
-        if (has_alpha)
-                return BitmapCopy(source, icon);
+        UINT n = icon->width * icon->height;
+        ARGB *pixels = ALLOC_N(ARGB, n);
+        BYTE *alpha = ALLOC_N(BYTE, icon->width);
+        Status status = OutOfMemory;
+        if (pixels != NULL && alpha != NULL) {
+                CopyMemory(pixels, icon->color, WindowSourceIconColorSize(icon->width, icon->height));
+
+                if (!PixelsHaveAlpha(pixels, n)) {
+                        SIZE_T mask_stride = WindowSourceIconMaskSize(icon->width, 1);
+                        for (UINT y = 0; y < icon->height; y++) {
+                                ARGB *row = pixels + y * icon->width;
+                                PixelsExpandMask(alpha, icon->mask + y * mask_stride, icon->width);
+                                PixelsSetAlpha(row, row, alpha, icon->width);
+                        }
+                }
+                PixelsPremultiply(pixels, pixels, n);
+
+                *mips = MipChainNew(icon->width, icon->height, pixels, s_icon_width, s_icon_height);
+                if (*mips != NULL)
+                        status = Ok;
+        }
 
-        Bitmap mask(hb_mask, NULL);
-        RETURN_GDI_FAILURE(mask.GetLastStatus());
+        if (alpha != NULL)
+                FREE(alpha);
+        if (pixels != NULL)
+                FREE(pixels);
 
-        return BitmapIterateForCopy(source, BitmapIterate, BitmapCopyWithMaskIterator, &mask, icon);
+        return status;
 }
 
-/* Scales BITMAP to the relevant system metrics for displaying small icons
- * (SM_CXSMICON, SMCYSMICON). BITMAP may be freed, a new bitmap being returned
- * instead. */
-static Status 
-BitmapScaleToSystemMetrics(Bitmap **bitmap)
+/* The most sizes a window offers its icon in: small and big. */
+#define ICON_SOURCES            2
+
+/* Sets MIPS to a chain of WINDOW’s icon in SOURCE, decoded from whichever
+ * of the sizes WINDOW offers it in scales best to the size icons are
+ * displayed in; see MipPickSource().  The big icon is only asked for if
+ * the small one isn’t that size already.  Returns FALSE if WINDOW is
+ * hung, has no icon of its own, or it couldn’t be decoded.  Doesn’t
+ * touch the cache, so it may be called from any thread. */
+static BOOL
+GetWindowMipChain(WindowSource *source, HWND window, MipChain **mips)
 {
-        UINT width, height;
-        RETURN_GDI_FAILURE(BitmapGetDimensions(*bitmap, &width, &height));
-
-        UINT desired_width = (UINT)GetSystemMetricsDefault(SM_CXSMICON, DEFAULT_ICON_DELTA);
-        UINT desired_height = (UINT)GetSystemMetricsDefault(SM_CYSMICON, DEFAULT_ICON_DELTA);
-
-        if (width == desired_width && height == desired_height)
-                return Ok;
+        WindowSourceIcon icons[ICON_SOURCES];
+        UINT widths[ICON_SOURCES];
+        UINT heights[ICON_SOURCES];
+        int n_sources = 0;
 
-        Bitmap *scaled_bitmap = new Bitmap(desired_width, desired_height, (*bitmap)->GetPixelFormat());
-        if (scaled_bitmap == NULL) {
-                delete *bitmap;
-
-                return OutOfMemory;
-        }
-
-        Status status = scaled_bitmap->GetLastStatus();
-        if (status != Ok) {
-                delete scaled_bitmap;
-                delete *bitmap;
-
-                return status;
-        }
-
-        Graphics canvas(scaled_bitmap);
-        status = canvas.GetLastStatus();
-        if (status == Ok)
-                status = canvas.SetInterpolationMode(InterpolationModeHighQualityBilinear);
-        if (status == Ok)
-                status = canvas.DrawImage(*bitmap, 0, 0, desired_width, desired_height);
+        BOOL was_hung;
+        if (WindowSourceSmallIcon(source, window, &icons[n_sources], &was_hung))
+                n_sources++;
+        if (was_hung)
+                return FALSE;
 
-        if (status != Ok) {
-                delete scaled_bitmap;
-                delete *bitmap;
+        if ((n_sources == 0 || icons[0].width != s_icon_width || icons[0].height != s_icon_height) &&
+            WindowSourceBigIcon(source, window, &icons[n_sources], &was_hung))
+                n_sources++;
 
-                return status;
+        for (int i = 0; i < n_sources; i++) {
+                widths[i] = icons[i].width;
+                heights[i] = icons[i].height;
         }
 
-        delete *bitmap;
-        *bitmap = scaled_bitmap;
-
-        return Ok;
-}
-
-/* Creates a Bitmap from ICON.  See BitmapFromIconBitmap() for more details. */
-static Status 
-BitmapFromHIcon(HICON icon, Bitmap **icon_bitmap)
-{
-        ICONINFO info;
-        if (!GetIconInfo(icon, &info))
-                return Win32Error;
-
-        Bitmap bitmap(info.hbmColor, NULL);
-        RETURN_GDI_FAILURE(bitmap.GetLastStatus());
+        int best = MipPickSource(widths, heights, n_sources, s_icon_width, s_icon_height);
+        Status status = (best < 0) ? GenericError : MipChainFromSourceIcon(&icons[best], mips);
 
-        Status status = BitmapFromIconBitmap(&bitmap, info.hbmMask, icon_bitmap);
+        for (int i = 0; i < n_sources; i++)
+                WindowSourceIconFree(&icons[i]);
 
-        DeleteObject(info.hbmColor);
-        DeleteObject(info.hbmMask);
-
-        return status;
+        return status == Ok;
 }
 
 /* Loads the default icon used for windows. */
@@ -272,39 +543,47 @@ LoadDefaultWindowIcon(HICON *icon)
 
 /* Creates a transparent icon of iconic dimensions. */
 static Status 
-CreateTransparentIcon(Bitmap **icon)
+CreateTransparentIcon(WindowIcon **icon)
 {
-        *icon = new Bitmap(GetSystemMetricsDefault(SM_CXSMICON, DEFAULT_ICON_DELTA),
-                           GetSystemMetricsDefault(SM_CYSMICON, DEFAULT_ICON_DELTA));
-        if (*icon == NULL)
+        Bitmap *bitmap = new Bitmap(s_icon_width, s_icon_height, PixelFormat32bppPARGB);
+        if (bitmap == NULL)
                 return OutOfMemory;
 
-        Status status = (*icon)->GetLastStatus();
+        Status status = bitmap->GetLastStatus();
         if (status != Ok) {
-                delete *icon;
+                delete bitmap;
                 return status;
         }
 
-        return Ok;
+        return WindowIconFromBitmap(bitmap, icon);
 }
 
 /* A function setting an input parameter to an icon. */
-typedef Status (*IconSetterFunc)(Bitmap **);
+typedef Status (*IconSetterFunc)(WindowIcon **);
 
-/* Set-ups a window icon from a HICON, using SET.  Frees the HICON, and
- * scales the resulting window icon to system metrics. */
+/* Set-ups a window icon scaled from MIPS, using SET if that fails, and
+ * caches it as the icon of WINDOW, unless it’s NULL.  The icon is kept
+ * on disk under KEY, unless it’s NULL.  MIPS is freed. */
 static Status 
-SetupWindowIconFromHIcon(HWND window, HICON hicon, IconSetterFunc set, Bitmap **icon)
+SetupWindowIconFromMips(HWND window, MipChain *mips, LPCTSTR key, IconSetterFunc set, WindowIcon **icon)
 {
-        Status status = BitmapFromHIcon(hicon, icon);
+        Bitmap *bitmap;
+        HashKey hash;
+        if (BitmapFromMipChain(mips, s_icon_width, s_icon_height, &bitmap) != Ok) {
+                MipChainFree(mips);
+                return set(icon);
+        }
 
-        DeleteObject(hicon);
+        if (key != NULL)
+                DiskCacheRemember(s_disk_cache, key, bitmap);
 
-        if (status != Ok)
+        if (BitmapHash(bitmap, &hash) != Ok) {
+                delete bitmap;
+                MipChainFree(mips);
                 return set(icon);
+        }
 
-        status = BitmapScaleToSystemMetrics(icon);
-        if (status != Ok)
+        if (WindowIconIntern(bitmap, hash, mips, icon) != Ok)
                 return set(icon);
 
         if (window != NULL)
@@ -313,11 +592,11 @@ SetupWindowIconFromHIcon(HWND window, HICON hicon, IconSetterFunc set, Bitmap **
         return Ok;
 }
 
-/* Sets ICON to the default window-icon. */
+/* Sets ICON to a new reference to the default window-icon. */
 static Status 
-SetToDefaultIcon(Bitmap **icon)
+SetToDefaultIcon(WindowIcon **icon)
 {
-        *icon = s_default_icon;
+        *icon = WindowIconRef(s_default_icon);
 
         return Ok;
 }
@@ -327,19 +606,55 @@ static Status
 SetupDefaultIcon(VOID)
 {
         HICON application_icon;
-        if (!LoadDefaultWindowIcon(&application_icon))
+        WindowSourceIcon icon;
+        if (!LoadDefaultWindowIcon(&application_icon) || !WindowSourceIconFromHIcon(application_icon, &icon))
                 return CreateTransparentIcon(&s_default_icon);
 
-        return SetupWindowIconFromHIcon(NULL, application_icon, CreateTransparentIcon, &s_default_icon);
+        MipChain *mips;
+        Status status = MipChainFromSourceIcon(&icon, &mips);
+        WindowSourceIconFree(&icon);
+        if (status != Ok)
+                return CreateTransparentIcon(&s_default_icon);
+
+        return SetupWindowIconFromMips(NULL, mips, NULL, CreateTransparentIcon, &s_default_icon);
+}
+
+/* Gets the WIDTH and HEIGHT icons are displayed in, that of small icons
+ * (SM_CXSMICON, SM_CYSMICON). */
+static void
+IconSizeFromMetrics(UINT *width, UINT *height)
+{
+        *width = (UINT)GetSystemMetricsDefault(SM_CXSMICON, DEFAULT_ICON_DELTA);
+        *height = (UINT)GetSystemMetricsDefault(SM_CYSMICON, DEFAULT_ICON_DELTA);
+}
+
+/* Creates the atlas, with room for a few rows of icons of iconic
+ * dimensions to begin with, and the tables of the cache. */
+static Status
+SetupCache(VOID)
+{
+        IconSizeFromMetrics(&s_icon_width, &s_icon_height);
+
+        s_atlas = IconAtlasNew(s_icon_width * ATLAS_ICONS_PER_ROW, s_icon_height * ATLAS_INITIAL_ROWS);
+        s_icons = HashTableNew();
+        s_cache = HashTableNew();
+
+        return (s_atlas != NULL && s_icons != NULL && s_cache != NULL) ? Ok : OutOfMemory;
 }
 
-/* Sets up the window-icon management code.  Currently, this only creates
- * a transparent window-icon to return whenever a window icon can’t be
- * otherwise created. */
+/* Sets up the window-icon management code.  This creates the atlas that
+ * icons are kept on and a window-icon to return whenever a window icon
+ * can’t be otherwise created, and opens the icons kept on disk. */
 BOOL 
 WindowIconInitialize(Error **error)
 {
-        Status status = SetupDefaultIcon();
+        InitializeCriticalSection(&s_resampler_lock);
+
+        s_disk_cache = DiskCacheOpen();
+
+        Status status = SetupCache();
+        if (status == Ok)
+                status = SetupDefaultIcon();
         if (status == Ok)
                 return TRUE;
 
@@ -350,45 +665,543 @@ WindowIconInitialize(Error **error)
         return FALSE;
 }
 
+static void 
+IconLoadFree(IconLoad *load)
+{
+        if (load->disk_icon != NULL)
+                delete load->disk_icon;
+        if (load->icon != NULL)
+                delete load->icon;
+        if (load->mips != NULL)
+                MipChainFree(load->mips);
+        if (load->key != NULL)
+                FREE(load->key);
+        FREE(load);
+}
+
 void 
 WindowIconFinalize(VOID)
 {
-        if (s_default_icon != NULL)
-                delete s_default_icon;
+        WindowIconLoaderStop();
+
+        DiskCacheClose(s_disk_cache);
+        s_disk_cache = NULL;
+
+        while (s_oldest != NULL)
+                CacheRemove(s_oldest);
+
+        WindowIconFree(s_default_icon);
+        s_default_icon = NULL;
+
+        if (s_cache != NULL)
+                HashTableFree(s_cache, NullFreeFunc);
+        s_cache = NULL;
+        if (s_icons != NULL)
+                HashTableFree(s_icons, NullFreeFunc);
+        s_icons = NULL;
+        if (s_atlas != NULL)
+                IconAtlasFree(s_atlas);
+        s_atlas = NULL;
+
+        for (int i = 0; i < s_n_resamplers; i++)
+                ResamplerFree(s_resamplers[i]);
+        s_n_resamplers = 0;
+        DeleteCriticalSection(&s_resampler_lock);
+}
+
+/* Gets the key WINDOW’s icon in SOURCE is kept under on disk, which
+ * should be freed with FREE().  Returns NULL if icons aren’t kept on disk
+ * or there’s no telling where WINDOW’s comes from. */
+static LPTSTR
+WindowIconKey(WindowSource *source, HWND window)
+{
+        LPTSTR key;
+        if (s_disk_cache == NULL || !WindowSourceIconKey(source, window, &key))
+                return NULL;
+
+        return key;
+}
 
-        ListFree(s_cache, (FreeFunc)CacheEntryFree);
+/* Sets ICON to a new reference to the icon kept on disk under KEY, and
+ * caches it as the icon of WINDOW.  Returns FALSE if KEY is NULL or
+ * there’s no such icon. */
+static BOOL
+WindowIconFromDisk(HWND window, LPCTSTR key, WindowIcon **icon)
+{
+        Bitmap *bitmap;
+        if (key == NULL ||
+            !DiskCacheGet(s_disk_cache, key, s_icon_width, s_icon_height, &bitmap) ||
+            WindowIconFromBitmap(bitmap, icon) != Ok)
+                return FALSE;
+
+        s_counters.disk_hits++;
+        CachePut(window, *icon);
+
+        return TRUE;
 }
 
 static Status 
-WindowIconNewCached(HWND window, Bitmap **icon)
+WindowIconNewCached(WindowSource *source, HWND window, LPCTSTR key, WindowIcon **icon)
 {
         if (s_default_icon == NULL)
                 return WrongState;
 
-        HICON small_icon;
-        BOOL was_hung;
+        MipChain *mips;
+        if (!GetWindowMipChain(source, window, &mips))
+                return SetToDefaultIcon(icon);
+
+        return SetupWindowIconFromMips(window, mips, key, SetToDefaultIcon, icon);
+}
+
+/* Hands LOAD over to WindowIconLoaderDeliver(). */
+static void
+IconLoadFinish(IconLoad *load)
+{
+        if (AtomicQueuePush(&s_loaded, &load->node))
+                PostMessage(s_loader_window, WM_WINDOWICON_LOADED, 0, 0);
+}
 
-        if (!GetWindowHIconByMessage(window, ICON_SMALL, &small_icon, &was_hung))
-                if (was_hung || !GetWindowHIcon(window, ICON_SMALL2, GCLP_HICONSM, &small_icon))
-                        return SetToDefaultIcon(icon);
+/* Loads the icon of LOAD’s window on a loader thread and hands it over
+ * to WindowIconLoaderDeliver().  Working out the key means opening the
+ * window’s process, so it’s done here rather than when the load is
+ * requested.  If the icon kept on disk under it is handed over, the load
+ * is run again to load the window’s own icon. */
+static void 
+IconLoadRun(VOID *closure)
+{
+        IconLoad *load = (IconLoad *)closure;
+
+        if (!load->has_key) {
+                load->key = WindowIconKey(load->source, load->window);
+                load->has_key = TRUE;
+                if (load->wants_disk_icon && load->key != NULL &&
+                    DiskCacheGet(s_disk_cache, load->key, s_icon_width, s_icon_height, &load->disk_icon)) {
+                        IconLoadFinish(load);
+                        return;
+                }
+        }
+
+        if (GetWindowMipChain(load->source, load->window, &load->mips)) {
+                if (BitmapFromMipChain(load->mips, s_icon_width, s_icon_height, &load->icon) != Ok) {
+                        load->icon = NULL;
+                } else if (BitmapHash(load->icon, &load->hash) != Ok) {
+                        delete load->icon;
+                        load->icon = NULL;
+                }
+        }
 
-        return SetupWindowIconFromHIcon(window, small_icon, SetToDefaultIcon, icon);
+        IconLoadFinish(load);
 }
 
-/* Gets WINDOW’s (small) icon.  Always succeeds, unless WindowIconInitialize() hasn’t
- * been called, in which case WrongState is returned. */
+/* Queues a background load of WINDOW’s icon in SOURCE, unless one is
+ * already underway, handing over the icon kept on disk for it first if
+ * WANTS_DISK_ICON.  Returns FALSE if the load couldn’t be queued. */
+static BOOL 
+WindowIconLoaderRequest(WindowSource *source, HWND window, BOOL wants_disk_icon)
+{
+        if (HashTableLookup(s_pending, HASH_KEY(window)) != NULL)
+                return TRUE;
+
+        IconLoad *load = ALLOC_STRUCT(IconLoad);
+        if (load == NULL)
+                return FALSE;
+        load->source = source;
+        load->window = window;
+        load->wants_disk_icon = wants_disk_icon;
+
+        if (!HashTableInsert(s_pending, HASH_KEY(window), load)) {
+                FREE(load);
+                return FALSE;
+        }
+
+        if (WorkerPoolSubmit(s_loader, IconLoadRun, (FreeFunc)IconLoadFree, load))
+                return TRUE;
+
+        HashTableRemove(s_pending, HASH_KEY(window));
+        FREE(load);
+
+        return FALSE;
+}
+
+/* Gets WINDOW’s (small) icon in SOURCE.  Always succeeds, unless WindowIconInitialize() hasn’t
+ * been called, in which case WrongState is returned.  If the icon isn’t cached
+ * and the loader has been started, the default icon is returned while the real
+ * one is loaded in the background, the one kept on disk from an earlier run, if
+ * any, being delivered first; see WindowIconLoaderStart().  Otherwise, the one
+ * kept on disk is returned, if any, without asking WINDOW for it. */
 Status 
-WindowIconNew(HWND window, Bitmap **icon)
+WindowIconNew(WindowSource *source, HWND window, WindowIcon **icon)
 {
         if (CacheGet(window, icon))
                 return Ok;
 
-        return WindowIconNewCached(window, icon);
+        if (s_loader != NULL && s_default_icon != NULL && WindowIconLoaderRequest(source, window, TRUE))
+                return SetToDefaultIcon(icon);
+
+        LPTSTR key = WindowIconKey(source, window);
+
+        Status status = Ok;
+        if (!WindowIconFromDisk(window, key, icon))
+                status = WindowIconNewCached(source, window, key, icon);
+
+        if (key != NULL)
+                FREE(key);
+
+        return status;
+}
+
+/* Draws ICON, as set by WindowIconNew(), on GRAPHICS at X and Y.  All
+ * icons are drawn from the same atlas. */
+Status
+WindowIconDraw(Graphics *graphics, WindowIcon const *icon, INT x, INT y)
+{
+        if (icon == NULL)
+                return Ok;
+
+        return IconAtlasDraw(s_atlas, graphics, &icon->slot, x, y);
 }
 
+/* Gets the WIDTH and HEIGHT of ICON, which are zero if there’s no icon. */
+void
+WindowIconGetDimensions(WindowIcon const *icon, INT *width, INT *height)
+{
+        *width = (icon != NULL) ? icon->slot.Width : 0;
+        *height = (icon != NULL) ? icon->slot.Height : 0;
+}
+
+/* Gets the COUNTERS of the icon cache. */
+void
+WindowIconCountersGet(WindowIconCounters *counters)
+{
+        *counters = s_counters;
+}
+
+/* Drops the cached icon of WINDOW, which was destroyed at the tick count
+ * TIME, e.g., the time of the message telling of it.  Any load of its
+ * icon that’s underway is dropped when it’s finished. */
+void
+WindowIconWindowDestroyed(HWND window, DWORD time)
+{
+        if (s_pending != NULL)
+                HashTableRemove(s_pending, HASH_KEY(window));
+
+        if (s_cache == NULL)
+                return;
+
+        CacheEntry *entry = CacheLookup(window);
+        if (entry == NULL)
+                return;
+
+        CacheEvictDead(entry, GetTickCount() - time);
+        s_counters.destroyed++;
+}
+
+/* Visits at most N entries of the cache, checking whether the windows of
+ * those not yet known to exist during this pass still exist in SOURCE,
+ * dropping those that don’t, and picking up where the last call left
+ * off.  This catches windows whose destruction wasn’t told of, a few at
+ * a time, so that no call takes long.  The latency of such an eviction
+ * is counted from when the window was last known to exist. */
+void
+WindowIconSweep(WindowSource *source, UINT n)
+{
+        if (s_cache == NULL || s_oldest == NULL)
+                return;
+
+        LARGE_INTEGER frequency, start, end;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        DWORD now = GetTickCount();
+        BOOL has_restarted = FALSE;
+        for (UINT i = 0; i < n; i++) {
+                if (s_sweep_next == NULL) {
+                        if (has_restarted)
+                                break;
+                        has_restarted = TRUE;
+                        s_sweep_generation++;
+                        s_sweep_next = s_oldest;
+                        if (s_sweep_next == NULL)
+                                break;
+                }
+
+                CacheEntry *entry = s_sweep_next;
+                s_sweep_next = entry->newer;
+                if (entry->generation == s_sweep_generation)
+                        continue;
+
+                s_counters.sweep_checks++;
+                if (WindowSourceExists(source, entry->window)) {
+                        entry->generation = s_sweep_generation;
+                        entry->seen = now;
+                } else {
+                        CacheEvictDead(entry, now - entry->seen);
+                        s_counters.swept++;
+                }
+        }
+
+        QueryPerformanceCounter(&end);
+
+        DWORD time = (DWORD)((end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart);
+        s_counters.sweep_time += time;
+        s_counters.max_sweep_time = max(s_counters.max_sweep_time, time);
+}
+
+/* Scales ICON anew from its chain to the size icons are displayed in,
+ * moving it to a slot of that size on the atlas and keying it by its new
+ * pixels.  ICON is left as it was if this fails. */
+static Status
+WindowIconRescale(WindowIcon *icon)
+{
+        Bitmap *bitmap;
+        RETURN_GDI_FAILURE(BitmapFromMipChain(icon->mips, s_icon_width, s_icon_height, &bitmap));
+
+        HashKey hash;
+        Rect slot;
+        Status status = BitmapHash(bitmap, &hash);
+        if (status == Ok)
+                status = IconAtlasAdd(s_atlas, bitmap, &slot);
+        delete bitmap;
+        if (status != Ok)
+                return status;
+
+        s_counters.bytes -= WindowIconBytes(icon);
+        if (HashTableLookup(s_icons, icon->hash) == icon)
+                HashTableRemove(s_icons, icon->hash);
+        IconAtlasRemove(s_atlas, &icon->slot);
+
+        icon->hash = hash;
+        icon->slot = slot;
+        if (HashTableLookup(s_icons, hash) == NULL)
+                HashTableInsert(s_icons, hash, icon);
+        s_counters.bytes += WindowIconBytes(icon);
+
+        return Ok;
+}
+
+/* Scales all icons anew from their chains if the size of small icons
+ * has changed since it was last looked at, e.g., as the user changed
+ * the icon metrics or the DPI.  Windows aren’t asked for their icons
+ * again and nothing is decoded anew.  Returns TRUE if the size changed,
+ * in which case anything measured by the size of icons should be
+ * measured again. */
+BOOL
+WindowIconMetricsChanged(VOID)
+{
+        UINT width, height;
+        IconSizeFromMetrics(&width, &height);
+        if (s_atlas == NULL || (width == s_icon_width && height == s_icon_height))
+                return FALSE;
+
+        s_icon_width = width;
+        s_icon_height = height;
+
+        for (WindowIcon *icon = s_first_icon; icon != NULL; icon = icon->next)
+                WindowIconRescale(icon);
+
+        CacheTrim();
+
+        return TRUE;
+}
+
+/* Starts loading icons that aren’t cached on background threads.
+ * WINDOW is sent WM_WINDOWICON_LOADED when loaded icons are ready to
+ * be picked up by WindowIconLoaderDeliver().  Returns FALSE if the
+ * loader couldn’t be started, in which case icons keep being loaded
+ * as they’re requested. */
+BOOL 
+WindowIconLoaderStart(HWND window)
+{
+        if (s_loader != NULL)
+                return TRUE;
+
+        s_pending = HashTableNew();
+        if (s_pending == NULL)
+                return FALSE;
+
+        AtomicQueueInit(&s_loaded);
+
+        s_loader = WorkerPoolNew(LOADER_THREADS);
+        if (s_loader == NULL) {
+                HashTableFree(s_pending, NullFreeFunc);
+                return FALSE;
+        }
+
+        s_loader_window = window;
+
+        return TRUE;
+}
+
+/* Stops the loader, waiting for loads in progress and dropping the
+ * rest. */
 void 
-WindowIconIconChanged(HWND window)
+WindowIconLoaderStop(VOID)
 {
-        Bitmap *icon;
-        WindowIconNewCached(window, &icon);
+        if (s_loader == NULL)
+                return;
+
+        WorkerPoolFree(s_loader);
+        s_loader = NULL;
+
+        AtomicQueueNode *next;
+        for (AtomicQueueNode *p = AtomicQueueTake(&s_loaded); p != NULL; p = next) {
+                next = p->next;
+                IconLoadFree((IconLoad *)p);
+        }
+
+        HashTableFree(s_pending, NullFreeFunc);
+}
+
+/* Scales the icon of LOAD anew from its chain if the size icons are
+ * displayed in changed while it was being loaded. */
+static Status
+IconLoadRescale(IconLoad *load)
+{
+        UINT width, height;
+        RETURN_GDI_FAILURE(BitmapGetDimensions(load->icon, &width, &height));
+        if (width == s_icon_width && height == s_icon_height)
+                return Ok;
+
+        delete load->icon;
+        load->icon = NULL;
+
+        Bitmap *scaled;
+        RETURN_GDI_FAILURE(BitmapFromMipChain(load->mips, s_icon_width, s_icon_height, &scaled));
+
+        Status status = BitmapHash(scaled, &load->hash);
+        if (status != Ok) {
+                delete scaled;
+                return status;
+        }
+        load->icon = scaled;
+
+        return Ok;
+}
+
+/* Caches the icon kept on disk that LOAD handed over as the icon of its
+ * window and calls F with the window and CLOSURE, unless the window was
+ * destroyed or got an icon of its own in the meantime, and then queues
+ * LOAD again to load the window’s own icon.  Returns FALSE if LOAD is
+ * done with, as it wasn’t queued again. */
+static BOOL
+IconLoadDeliverFromDisk(IconLoad *load, WindowIconLoadedFunc f, VOID *closure)
+{
+        if (HashTableLookup(s_pending, HASH_KEY(load->window)) != load)
+                return FALSE;
+
+        Bitmap *bitmap = load->disk_icon;
+        load->disk_icon = NULL;
+
+        UINT width, height;
+        WindowIcon *icon;
+        if (CacheLookup(load->window) != NULL ||
+            BitmapGetDimensions(bitmap, &width, &height) != Ok ||
+            width != s_icon_width || height != s_icon_height) {
+                delete bitmap;
+        } else if (WindowIconFromBitmap(bitmap, &icon) == Ok) {
+                s_counters.disk_hits++;
+                CachePut(load->window, icon);
+                WindowIconFree(icon);
+                f(load->window, closure);
+        }
+
+        if (WorkerPoolSubmit(s_loader, IconLoadRun, (FreeFunc)IconLoadFree, load))
+                return TRUE;
+
+        HashTableRemove(s_pending, HASH_KEY(load->window));
+
+        return FALSE;
+}
+
+/* Caches the icon of the finished LOAD, if any, and calls F with its
+ * window and CLOSURE, unless the icon cached already has the same
+ * pixels or the window was destroyed while it was loaded.  The icon
+ * replaces the one cached in one go, so the window’s old icon is shown
+ * until then. */
+static void
+IconLoadDeliver(IconLoad *load, WindowIconLoadedFunc f, VOID *closure)
+{
+        if (HashTableLookup(s_pending, HASH_KEY(load->window)) != load)
+                return;
+
+        HashTableRemove(s_pending, HASH_KEY(load->window));
+        if (load->icon == NULL || IconLoadRescale(load) != Ok)
+                return;
+
+        if (load->key != NULL)
+                DiskCacheRemember(s_disk_cache, load->key, load->icon);
+
+        WindowIcon *icon;
+        Status status = WindowIconIntern(load->icon, load->hash, load->mips, &icon);
+        load->icon = NULL;
+        load->mips = NULL;
+        if (status != Ok)
+                return;
+
+        CacheEntry *entry = CacheLookup(load->window);
+        BOOL is_unchanged = entry != NULL && entry->icon == icon;
+
+        CachePut(load->window, icon);
+        WindowIconFree(icon);
+        if (!is_unchanged)
+                f(load->window, closure);
+}
+
+/* Caches the icons that have been loaded since the last call and calls
+ * F with the window of each one and CLOSURE, so that anything showing
+ * the default icon, or an old icon, in its place may be updated.
+ * Windows without an icon of their own aren’t reported, as they keep
+ * the default one, and neither are windows whose icons didn’t change. */
+void 
+WindowIconLoaderDeliver(WindowIconLoadedFunc f, VOID *closure)
+{
+        if (s_loader == NULL)
+                return;
+
+        AtomicQueueNode *next;
+        for (AtomicQueueNode *p = AtomicQueueTake(&s_loaded); p != NULL; p = next) {
+                next = p->next;
+
+                IconLoad *load = (IconLoad *)p;
+                if (load->disk_icon != NULL) {
+                        if (IconLoadDeliverFromDisk(load, f, closure))
+                                continue;
+                } else {
+                        IconLoadDeliver(load, f, closure);
+                }
+                IconLoadFree(load);
+        }
+}
+
+/* Loads WINDOW’s icon in SOURCE anew in the background, e.g., after it
+ * changed, keeping the cached one until WindowIconLoaderDeliver()
+ * replaces it.  Returns FALSE if the loader isn’t running, the load
+ * couldn’t be queued, or one is underway already, in which case it may
+ * have started before the icon changed and this should be tried again
+ * later. */
+BOOL
+WindowIconLoaderReload(WindowSource *source, HWND window)
+{
+        if (s_loader == NULL || HashTableLookup(s_pending, HASH_KEY(window)) != NULL)
+                return FALSE;
+
+        return WindowIconLoaderRequest(source, window, FALSE);
+}
+
+/* Loads WINDOW’s icon in SOURCE anew after it changed, in the background
+ * if the loader is running and not already loading it. */
+void 
+WindowIconIconChanged(WindowSource *source, HWND window)
+{
+        if (WindowIconLoaderReload(source, window))
+                return;
+
+        LPTSTR key = WindowIconKey(source, window);
+
+        WindowIcon *icon;
+        if (WindowIconNewCached(source, window, key, &icon) == Ok)
+                WindowIconFree(icon);
+
+        if (key != NULL)
+                FREE(key);
 }
@@ -1,8 +1,75 @@
-﻿/* The default width and height of an icon. */
+﻿typedef struct _WindowSource WindowSource;
+
+/* A window icon, shared by all windows whose icons have the same
+ * pixels. */
+typedef struct _WindowIcon WindowIcon;
+
+/* Counters of the icon cache.
+ *
+ * HITS and MISSES count the lookups of windows’ icons that were and
+ * weren’t cached.
+ * DISK_HITS counts the misses that were served by icons kept on disk.
+ * DEDUPS counts the icons found to have the same pixels as an icon that
+ * was already kept.
+ * EVICTIONS counts the windows dropped to keep within the cache’s budget.
+ * DESTROYED counts the windows dropped as they were told to have been
+ * destroyed, and SWEPT those found to no longer exist by the sweep.
+ * EVICTION_LATENCY is the total, and MAX_EVICTION_LATENCY the largest,
+ * number of milliseconds between a window going away and it being
+ * dropped.
+ * SWEEP_CHECKS counts the windows checked by the sweep, and SWEEP_TIME
+ * is the total, and MAX_SWEEP_TIME the largest, number of microseconds
+ * spent by a call to WindowIconSweep().
+ * N_ICONS and BYTES are the number and size of the distinct icons kept,
+ * including the chains they’re scaled from.
+ * N_WINDOWS is the number of windows cached. */
+typedef struct _WindowIconCounters WindowIconCounters;
+
+struct _WindowIconCounters
+{
+        UINT hits;
+        UINT misses;
+        UINT disk_hits;
+        UINT dedups;
+        UINT evictions;
+        UINT destroyed;
+        UINT swept;
+        ULONGLONG eviction_latency;
+        DWORD max_eviction_latency;
+        UINT sweep_checks;
+        ULONGLONG sweep_time;
+        DWORD max_sweep_time;
+        UINT n_icons;
+        UINT n_windows;
+        SIZE_T bytes;
+};
+
+/* The default width and height of an icon. */
 #define DEFAULT_ICON_DELTA          16
 
+/* Sent to the window passed to WindowIconLoaderStart() when icons loaded
+ * in the background are ready to be delivered.
+ *
+ * void Cls_OnWindowIconLoaded(HWND hwnd) */
+#define WM_WINDOWICON_LOADED        (WM_USER + 347)
+#define HANDLE_WM_WINDOWICON_LOADED(hwnd, wParam, lParam, fn) \
+        ((fn)(hwnd), 0L)
+
+/* Called with each window whose icon has been loaded in the background. */
+typedef void (*WindowIconLoadedFunc)(HWND window, VOID *closure);
+
 BOOL WindowIconInitialize(Error **error);
 void WindowIconFinalize(VOID);
-Status WindowIconNew(HWND window, Bitmap **icon);
-void WindowIconFree(Bitmap *icon);
-void WindowIconIconChanged(HWND window);
+Status WindowIconNew(WindowSource *source, HWND window, WindowIcon **icon);
+void WindowIconFree(WindowIcon *icon);
+Status WindowIconDraw(Graphics *graphics, WindowIcon const *icon, INT x, INT y);
+void WindowIconGetDimensions(WindowIcon const *icon, INT *width, INT *height);
+void WindowIconCountersGet(WindowIconCounters *counters);
+void WindowIconWindowDestroyed(HWND window, DWORD time);
+void WindowIconSweep(WindowSource *source, UINT n);
+BOOL WindowIconMetricsChanged(VOID);
+void WindowIconIconChanged(WindowSource *source, HWND window);
+BOOL WindowIconLoaderStart(HWND window);
+void WindowIconLoaderStop(VOID);
+void WindowIconLoaderDeliver(WindowIconLoadedFunc f, VOID *closure);
+BOOL WindowIconLoaderReload(WindowSource *source, HWND window);
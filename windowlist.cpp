@@ -1,16 +1,66 @@
 ﻿#include "stdafx.h"
 #include "list.h"
+#include "hashtable.h"
+#include "windowsource.h"
 #include "windowlistitem.h"
 #include "windowlist.h"
 #include "resource.h"
 
-/* A LIST of windows to display using FONT, numbering items inside an
- * area of width NUMBER_WIDTH. */
+typedef struct _WindowListNode WindowListNode;
+
+/* A node of a WindowList, linking ITEM to the items before and after
+ * it, and to the other items with the same owner, in no particular
+ * order. */
+struct _WindowListNode
+{
+        WindowListItem *item;
+        WindowListNode *previous;
+        WindowListNode *next;
+        WindowListNode *previous_same_owner;
+        WindowListNode *next_same_owner;
+};
+
+typedef struct _WindowListDrawnRow WindowListDrawnRow;
+
+/* A row as it was last drawn: the item of version VERSION, at Y and of
+ * HEIGHT. */
+struct _WindowListDrawnRow
+{
+        UINT version;
+        REAL y;
+        REAL height;
+};
+
+/* A list of windows to display using FONT, numbering items inside an
+ * area of width NUMBER_WIDTH.
+ *
+ * The N_ITEMS items are kept in most-recently-activated order, from
+ * FIRST to LAST, in a doubly linked chain of nodes, so that an activated
+ * item can be moved to the front in constant time.  NODES indexes the
+ * nodes by the window of their item, and OWNERS by the owner of their
+ * item, mapping each owner to the first of the chain of nodes with that
+ * owner.
+ *
+ * IS_DRAWN is TRUE once the list has been drawn inside DRAWN_AREA, and
+ * until drawing it fails.  It was drawn as DRAWN_MESSAGE, if it was
+ * empty, or as the N_DRAWN_ROWS DRAWN_ROWS, which have room for
+ * N_ALLOCATED_DRAWN_ROWS, so that WindowListDamage() may tell which
+ * rows changed since. */
 struct _WindowList
 {
-        List *list;
+        WindowListNode *first;
+        WindowListNode *last;
+        int n_items;
+        HashTable *nodes;
+        HashTable *owners;
         Font *font;
         REAL number_width;
+        BOOL is_drawn;
+        RectF drawn_area;
+        LPCTSTR drawn_message;
+        WindowListDrawnRow *drawn_rows;
+        int n_drawn_rows;
+        int n_allocated_drawn_rows;
 };
 
 /* Numbers drawn for the first ten items in the list for fast access using
@@ -65,15 +115,15 @@ WindowListSemiAddedItemFree(WindowListSemiAddedItem *semi_item)
         FREE(semi_item);
 }
 
-/* Gets the top-most window that owns WINDOW. */
+/* Gets the top-most window that owns WINDOW in SOURCE. */
 static HWND 
-GetTopmostOwner(HWND window)
+GetTopmostOwner(WindowSource *source, HWND window)
 {
-        HWND shell = GetShellWindow();
+        HWND shell = WindowSourceShell(source);
         HWND owner = window;
 
         while (TRUE) {
-                HWND owner_owner = GetWindow(owner, GW_OWNER);
+                HWND owner_owner = WindowSourceOwner(source, owner);
 
                 if (owner_owner == NULL || owner_owner == shell)
                         break;
@@ -84,138 +134,391 @@ GetTopmostOwner(HWND window)
         return owner;
 }
 
-/* A closure for determining if the window list already contains a window
- * owned by the same window as another one.
+/* Closure used while collecting the windows to add to the window list.
  *
- * OWNER is the window */
-typedef struct _WindowListFindSameOwnerClosure WindowListFindSameOwnerClosure;
-
-struct _WindowListFindSameOwnerClosure
+ * SOURCE is where windows come from.
+ * LIST is the list of WindowListSemiAddedItems collected so far.
+ * OWNERS indexes the items of LIST by their OWNER, so that finding an
+ * item with the same owner as another window doesn’t require a scan of
+ * LIST. */
+typedef struct _WindowListConsClosure WindowListConsClosure;
+
+struct _WindowListConsClosure
 {
-        HWND owner;
-        WindowListSemiAddedItem *item;
+        WindowSource *source;
+        List *list;
+        HashTable *owners;
 };
 
-static IterationState 
-WindowListFindSameOwnerIterator(void *list_item, void *v_closure)
+static BOOL 
+IsAppWindow(WindowSource *source, HWND window)
 {
-        WindowListSemiAddedItem *item = (WindowListSemiAddedItem *)list_item;
-        WindowListFindSameOwnerClosure *closure = (WindowListFindSameOwnerClosure *)v_closure;
-
-        if (item->owner != closure->owner)
-                return IterationContinue;
-
-        closure->item = item;
-
-        return IterationStop;
+        return WindowSourceExStyle(source, window) & WS_EX_APPWINDOW;
 }
 
 static BOOL 
-IsAppWindow(HWND window)
+IsControlParent(WindowSource *source, HWND window)
 {
-        return GetWindowLongPtr(window, GWL_EXSTYLE) & WS_EX_APPWINDOW;
+        return WindowSourceExStyle(source, window) & WS_EX_CONTROLPARENT;
 }
 
 static BOOL 
-IsControlParent(HWND window)
+IsSourceToolWindow(WindowSource *source, HWND window)
 {
-        return GetWindowLongPtr(window, GWL_EXSTYLE) & WS_EX_CONTROLPARENT;
+        return WindowSourceExStyle(source, window) & WS_EX_TOOLWINDOW;
 }
 
-static BOOL 
-HasSameOwnerAsAnotherWindow(List *windows, HWND window, HWND owner)
+/* Determines whether WINDOW, whose top-most owner is OWNER, should be
+ * left out of the window list, as it’s a tool window or a part of
+ * one. */
+static BOOL
+IsToolWindowPart(WindowSource *source, HWND window, HWND owner)
 {
-        WindowListFindSameOwnerClosure closure = { owner, NULL };
-        ListItemsIterate(windows, WindowListFindSameOwnerIterator, &closure);
+        return IsSourceToolWindow(source, owner) && !IsAppWindow(source, window) && (IsSourceToolWindow(source, window) || !IsControlParent(source, window));
+}
 
-        if (closure.item == NULL)
+static BOOL 
+HasSameOwnerAsAnotherWindow(WindowListConsClosure *closure, HWND window, HWND owner)
+{
+        WindowListSemiAddedItem *item = (WindowListSemiAddedItem *)HashTableLookup(closure->owners, HASH_KEY(owner));
+        if (item == NULL)
                 return FALSE;
 
-        if (!IsToolWindow(window)) {
+        WindowSource *source = closure->source;
+        if (!IsSourceToolWindow(source, window)) {
                 /* If this window isn’t a tool window and we actually own the window that’s already in the list and that window isn’t already kept, replace
 		 * it with this window, given that it would pass all the tests.  (The algorithm previously assumed that an appwindow would be in the list
 		 * before any of its tool windows, but that’s not always the case. An example is Adobe Illustrator. */
-                if (closure.item->owner == window && !(IsToolWindow(owner) && !IsAppWindow(window) && (IsToolWindow(window) || !IsControlParent(window)))) {
-                        closure.item->window = window;
-                        closure.item->owner = owner;
+                if (item->owner == window && !IsToolWindowPart(source, window, owner)) {
+                        item->window = window;
+                        item->owner = owner;
                 }
-                if (!IsToolWindow(closure.item->window))
-                        closure.item->keep = TRUE;
+                if (!IsSourceToolWindow(source, item->window))
+                        item->keep = TRUE;
         }
 
         return TRUE;
 }
 
+/* Adds SEMI_ITEM to the list being collected in CLOSURE. */
+static void
+WindowListConsSemiAddedItem(WindowListConsClosure *closure, WindowListSemiAddedItem *semi_item)
+{
+        if (!HashTableInsert(closure->owners, HASH_KEY(semi_item->owner), semi_item)) {
+                WindowListSemiAddedItemFree(semi_item);
+                return;
+        }
+
+        if (!ListCons(&closure->list, semi_item)) {
+                HashTableRemove(closure->owners, HASH_KEY(semi_item->owner));
+                WindowListSemiAddedItemFree(semi_item);
+        }
+}
+
 static BOOL CALLBACK 
 WindowListConsProc(HWND window, LPARAM lParam)
 {
-        if (!IsWindowVisible(window))
-                return TRUE;
+        WindowListConsClosure *closure = (WindowListConsClosure *)lParam;
+        WindowSource *source = closure->source;
 
-        List **list = (List **)lParam;
+        if (!WindowSourceIsVisible(source, window))
+                return TRUE;
 
-        HWND owner = GetTopmostOwner(window);
+        HWND owner = GetTopmostOwner(source, window);
         HWND saved_owner = owner;
 
         /* IsAppWindow windows should appear in the window list even though they are owned. */
-        if (window != owner && IsAppWindow(window))
+        if (window != owner && IsAppWindow(source, window))
                 owner = window;
-        else if (HasSameOwnerAsAnotherWindow(*list, window, owner))
+        else if (HasSameOwnerAsAnotherWindow(closure, window, owner))
                 return TRUE;
 
-        if (IsToolWindow(saved_owner) && !IsAppWindow(window) && (IsToolWindow(window) || !IsControlParent(window)))
+        if (IsToolWindowPart(source, window, saved_owner))
                 return TRUE;
 
-        BOOL keep = IsToolWindow(saved_owner) || !IsToolWindow(window);
+        BOOL keep = IsSourceToolWindow(source, saved_owner) || !IsSourceToolWindow(source, window);
         WindowListSemiAddedItem *semi_item = WindowListSemiAddedItemNew(window, owner, keep);
         if (semi_item == NULL)
                 return TRUE;
 
-        if (!ListCons(list, semi_item))
-                WindowListSemiAddedItemFree(semi_item);
+        WindowListConsSemiAddedItem(closure, semi_item);
 
         return TRUE;
 }
 
-/* Converts a single WindowListSemiAddedItem to a WindowListItem and
- * adds it to the WindowList.  Only items we want to KEEP are added to
- * the list. */
-static IterationState 
-SemiAddedWindowListToWindowListIterator(void *list_item, void *closure)
+/* Links NODE to the front of LIST. */
+static void
+WindowListLinkFirst(WindowList *list, WindowListNode *node)
+{
+        node->previous = NULL;
+        node->next = list->first;
+        if (list->first != NULL)
+                list->first->previous = node;
+        else
+                list->last = node;
+        list->first = node;
+        list->n_items++;
+}
+
+/* Unlinks NODE from LIST. */
+static void
+WindowListUnlink(WindowList *list, WindowListNode *node)
+{
+        if (node->previous != NULL)
+                node->previous->next = node->next;
+        else
+                list->first = node->next;
+
+        if (node->next != NULL)
+                node->next->previous = node->previous;
+        else
+                list->last = node->previous;
+
+        node->previous = node->next = NULL;
+        list->n_items--;
+}
+
+/* Makes room for OWNER in the owner index of LIST, so that linking a node
+ * to it can’t fail.  Returns FALSE if there’s no memory for it. */
+static BOOL
+WindowListReserveOwner(WindowList *list, HWND owner)
+{
+        return HashTableLookup(list->owners, HASH_KEY(owner)) != NULL ||
+               HashTableInsert(list->owners, HASH_KEY(owner), NULL);
+}
+
+/* Links NODE to the front of the chain of nodes of LIST owned by OWNER,
+ * for which room must have been made with WindowListReserveOwner(). */
+static void
+WindowListLinkOwner(WindowList *list, WindowListNode *node, HWND owner)
+{
+        WindowListNode *head = (WindowListNode *)HashTableLookup(list->owners, HASH_KEY(owner));
+
+        node->previous_same_owner = NULL;
+        node->next_same_owner = head;
+        if (head != NULL)
+                head->previous_same_owner = node;
+        HashTableInsert(list->owners, HASH_KEY(owner), node);
+}
+
+/* Unlinks NODE from the chain of nodes of LIST owned by OWNER. */
+static void
+WindowListUnlinkOwner(WindowList *list, WindowListNode *node, HWND owner)
+{
+        if (node->previous_same_owner != NULL)
+                node->previous_same_owner->next_same_owner = node->next_same_owner;
+        else if (node->next_same_owner != NULL)
+                HashTableInsert(list->owners, HASH_KEY(owner), node->next_same_owner);
+        else
+                HashTableRemove(list->owners, HASH_KEY(owner));
+
+        if (node->next_same_owner != NULL)
+                node->next_same_owner->previous_same_owner = node->previous_same_owner;
+
+        node->previous_same_owner = node->next_same_owner = NULL;
+}
+
+/* Adds ITEM to the front of LIST.  ITEM is freed if it can’t be added,
+ * in which case FALSE is returned. */
+static BOOL
+WindowListAddFirst(WindowList *list, WindowListItem *item)
+{
+        WindowListNode *node = ALLOC_STRUCT(WindowListNode);
+        if (node == NULL) {
+                WindowListItemFree(item);
+                return FALSE;
+        }
+
+        node->item = item;
+        if (!WindowListReserveOwner(list, WindowListItemOwner(item)) ||
+            !HashTableInsert(list->nodes, HASH_KEY(WindowListItemWindow(item)), node)) {
+                FREE(node);
+                WindowListItemFree(item);
+                return FALSE;
+        }
+
+        WindowListLinkOwner(list, node, WindowListItemOwner(item));
+        WindowListLinkFirst(list, node);
+
+        return TRUE;
+}
+
+/* Removes NODE from LIST, freeing it along with its item. */
+static void
+WindowListRemoveNode(WindowList *list, WindowListNode *node)
+{
+        HashTableRemove(list->nodes, HASH_KEY(WindowListItemWindow(node->item)));
+        WindowListUnlinkOwner(list, node, WindowListItemOwner(node->item));
+        WindowListUnlink(list, node);
+        WindowListItemFree(node->item);
+        FREE(node);
+}
+
+/* Replaces the item of NODE of LIST by ITEM, keeping its position.  ITEM
+ * is freed if it can’t be set, in which case FALSE is returned. */
+static BOOL
+WindowListNodeSetItem(WindowList *list, WindowListNode *node, WindowListItem *item)
+{
+        HWND old_window = WindowListItemWindow(node->item);
+        HWND window = WindowListItemWindow(item);
+        HWND old_owner = WindowListItemOwner(node->item);
+        HWND owner = WindowListItemOwner(item);
+
+        if (owner != old_owner && !WindowListReserveOwner(list, owner)) {
+                WindowListItemFree(item);
+                return FALSE;
+        }
+
+        if (window != old_window) {
+                if (!HashTableInsert(list->nodes, HASH_KEY(window), node)) {
+                        WindowListItemFree(item);
+                        return FALSE;
+                }
+                HashTableRemove(list->nodes, HASH_KEY(old_window));
+        }
+
+        if (owner != old_owner) {
+                WindowListUnlinkOwner(list, node, old_owner);
+                WindowListLinkOwner(list, node, owner);
+        }
+
+        WindowListItemFree(node->item);
+        node->item = item;
+
+        return TRUE;
+}
+
+/* Finds the node of LIST whose item deals with WINDOW. */
+static WindowListNode *
+WindowListFindNode(WindowList *list, HWND window)
+{
+        return (WindowListNode *)HashTableLookup(list->nodes, HASH_KEY(window));
+}
+
+/* Finds a node of LIST whose item is owned by OWNER, the first of the
+ * chain of them. */
+static WindowListNode *
+WindowListFindOwnerNode(WindowList *list, HWND owner)
+{
+        return (WindowListNode *)HashTableLookup(list->owners, HASH_KEY(owner));
+}
+
+/* Determines whether a node of LIST other than EXCEPT has an item owned
+ * by OWNER. */
+static BOOL
+WindowListHasOwner(WindowList *list, HWND owner, WindowListNode const *except)
+{
+        WindowListNode *node = WindowListFindOwnerNode(list, owner);
+
+        return node != NULL && (node != except || node->next_same_owner != NULL);
+}
+
+/* Closure used when refreshing a WindowList from a list of
+ * WindowListSemiAddedItems.
+ *
+ * LIST is the WindowList being refreshed.
+ * SOURCE is the WindowSource the windows come from.
+ * SEEN indexes the nodes of LIST whose windows are still around.
+ * DIFF counts how LIST changed. */
+typedef struct _WindowListRefreshClosure WindowListRefreshClosure;
+
+struct _WindowListRefreshClosure
+{
+        WindowList *list;
+        WindowSource *source;
+        HashTable *seen;
+        WindowListDiff *diff;
+};
+
+/* Brings the item for SEMI_ITEM in line with it, reusing the item for
+ * the same window if there is one, in which case only its title is
+ * fetched anew, keeping its icon and measured size unless the title
+ * changed.  Items for new windows are added to the front of the list. */
+static IterationState
+WindowListRefreshIterator(void *list_item, void *v_closure)
 {
         WindowListSemiAddedItem *semi_item = (WindowListSemiAddedItem *)list_item;
         if (!semi_item->keep)
                 return IterationContinue;
 
-        WindowListItem *item = WindowListItemNew(semi_item->window, semi_item->owner);
-        if (item == NULL)
+        WindowListRefreshClosure *closure = (WindowListRefreshClosure *)v_closure;
+        WindowList *list = closure->list;
+
+        if (HashTableLookup(closure->seen, HASH_KEY(semi_item->window)) != NULL)
                 return IterationContinue;
 
-        if (!ListCons((List **)closure, item))
-                WindowListItemFree(item);
+        WindowListNode *node = WindowListFindNode(list, semi_item->window);
+        if (node != NULL && WindowListItemOwner(node->item) == semi_item->owner) {
+                if (WindowListItemRefresh(node->item))
+                        closure->diff->changed++;
+        } else {
+                WindowListItem *item = WindowListItemNew(closure->source, semi_item->window, semi_item->owner);
+                if (item == NULL)
+                        return IterationContinue;
+
+                if (node != NULL) {
+                        if (!WindowListNodeSetItem(list, node, item))
+                                return IterationContinue;
+                        closure->diff->changed++;
+                } else {
+                        if (!WindowListAddFirst(list, item))
+                                return IterationContinue;
+                        node = list->first;
+                        closure->diff->added++;
+                }
+        }
+
+        HashTableInsert(closure->seen, HASH_KEY(semi_item->window), node);
 
         return IterationContinue;
 }
 
-/* Converts a list of WindowListSemiAddedItems to a list of WindowListItems. */
+/* Collects the windows of SOURCE that should be in the window list as
+ * a list of WindowListSemiAddedItems, in reverse z-order. */
 static List *
-SemiAddedWindowListToWindowList(List *list)
+WindowListCollect(WindowSource *source)
 {
-        List *window_list = ListNew();
-        ListItemsIterate(list, SemiAddedWindowListToWindowListIterator, &window_list);
-        return window_list;
+        WindowListConsClosure closure = { source, ListNew(), HashTableNew() };
+        if (closure.owners == NULL)
+                return closure.list;
+
+        WindowSourceEnumerate(source, WindowListConsProc, (LPARAM)&closure);
+
+        HashTableFree(closure.owners, NullFreeFunc);
+
+        return closure.list;
 }
 
-/* Creates a new WindowList, using FONT for drawing. */
+/* Creates a new WindowList of the windows on the desktop, using FONT for
+ * drawing. */
 WindowList *
 WindowListNew(Font *font)
+{
+        return WindowListNewFromSource(WindowSourceDesktop(), font);
+}
+
+/* Creates a new WindowList of the windows in SOURCE, using FONT for
+ * drawing.  The items start out in z-order. */
+WindowList *
+WindowListNewFromSource(WindowSource *source, Font *font)
 {
         WindowList *list = ALLOC_STRUCT(WindowList);
+        if (list == NULL)
+                return NULL;
 
-        List *semi_added_list = ListNew();
-        EnumDesktopWindows(NULL, WindowListConsProc, (LPARAM)&semi_added_list);
-        list->list = SemiAddedWindowListToWindowList(semi_added_list);
-        ListFree(semi_added_list, (FreeFunc)WindowListSemiAddedItemFree);
+        list->nodes = HashTableNew();
+        list->owners = HashTableNew();
+        if (list->nodes == NULL || list->owners == NULL) {
+                if (list->nodes != NULL)
+                        HashTableFree(list->nodes, NullFreeFunc);
+                if (list->owners != NULL)
+                        HashTableFree(list->owners, NullFreeFunc);
+                FREE(list);
+                return NULL;
+        }
+
+        WindowListDiff diff;
+        WindowListRefresh(list, source, &diff);
 
         list->font = font;
         list->number_width = -1;
@@ -223,26 +526,228 @@ WindowListNew(Font *font)
         return list;
 }
 
+/* Brings the items of LIST in line with the windows in SOURCE.  Items
+ * for windows that are still around are kept, along with their order,
+ * so that their icons and measured sizes don’t have to be fetched
+ * again.  Items for new windows are added to the front, in z-order.
+ * DIFF is set to how many items were added, removed, and changed. */
+void
+WindowListRefresh(WindowList *list, WindowSource *source, WindowListDiff *diff)
+{
+        ZeroMemory(diff, sizeof(*diff));
+
+        WindowListRefreshClosure closure = { list, source, HashTableNew(), diff };
+        if (closure.seen == NULL)
+                return;
+
+        List *semi_added_list = WindowListCollect(source);
+        ListItemsIterate(semi_added_list, WindowListRefreshIterator, &closure);
+        ListFree(semi_added_list, (FreeFunc)WindowListSemiAddedItemFree);
+
+        WindowListNode *node = list->first;
+        while (node != NULL) {
+                WindowListNode *next = node->next;
+
+                if (HashTableLookup(closure.seen, HASH_KEY(WindowListItemWindow(node->item))) == NULL) {
+                        WindowListRemoveNode(list, node);
+                        diff->removed++;
+                }
+
+                node = next;
+        }
+
+        HashTableFree(closure.seen, NullFreeFunc);
+}
+
+/* Determines the owner that an item for WINDOW in SOURCE would have,
+ * returning FALSE if WINDOW shouldn’t be in the window list on its own
+ * account.  This applies the same rules as WindowListConsProc() to a
+ * single window, given the items already in LIST, except for that of
+ * REPLACED, which WINDOW is to take the place of, if not NULL. */
+static BOOL
+WindowListOwnerForWindow(WindowList *list, WindowSource *source, HWND window,
+                         WindowListNode const *replaced, HWND *owner)
+{
+        if (!WindowSourceIsVisible(source, window))
+                return FALSE;
+
+        HWND topmost_owner = GetTopmostOwner(source, window);
+
+        *owner = topmost_owner;
+        if (window != topmost_owner && IsAppWindow(source, window))
+                *owner = window;
+        else if (WindowListHasOwner(list, topmost_owner, replaced))
+                return FALSE;
+
+        if (IsToolWindowPart(source, window, topmost_owner))
+                return FALSE;
+
+        return IsSourceToolWindow(source, topmost_owner) || !IsSourceToolWindow(source, window);
+}
+
+/* Adds WINDOW of SOURCE to the front of LIST, unless it’s already in
+ * LIST or shouldn’t be in it.  Returns TRUE if LIST changed. */
+BOOL
+WindowListInsertWindow(WindowList *list, WindowSource *source, HWND window)
+{
+        if (WindowListFindNode(list, window) != NULL)
+                return FALSE;
+
+        HWND owner;
+        if (!WindowListOwnerForWindow(list, source, window, NULL, &owner))
+                return FALSE;
+
+        WindowListItem *item = WindowListItemNew(source, window, owner);
+        if (item == NULL)
+                return FALSE;
+
+        return WindowListAddFirst(list, item);
+}
+
+/* Removes the items of LIST dealing with, or owned by, WINDOW.  Returns
+ * TRUE if LIST changed. */
+BOOL
+WindowListRemoveWindow(WindowList *list, HWND window)
+{
+        BOOL removed = FALSE;
+
+        WindowListNode *node;
+        while ((node = WindowListFindOwnerNode(list, window)) != NULL) {
+                WindowListRemoveNode(list, node);
+                removed = TRUE;
+        }
+
+        node = WindowListFindNode(list, window);
+        if (node != NULL) {
+                WindowListRemoveNode(list, node);
+                removed = TRUE;
+        }
+
+        return removed;
+}
+
+/* Replaces the item of LIST dealing with WINDOW by one dealing with
+ * NEW_WINDOW of SOURCE, keeping its position.  The item is removed
+ * instead if NEW_WINDOW shouldn’t be in LIST, as when inserting it.
+ * Returns TRUE if LIST changed. */
+BOOL
+WindowListReplaceWindow(WindowList *list, WindowSource *source, HWND window, HWND new_window)
+{
+        WindowListNode *node = WindowListFindNode(list, window);
+        if (node == NULL)
+                return WindowListInsertWindow(list, source, new_window);
+
+        HWND owner;
+        if (WindowListFindNode(list, new_window) != NULL ||
+            !WindowListOwnerForWindow(list, source, new_window, node, &owner)) {
+                WindowListRemoveNode(list, node);
+                return TRUE;
+        }
+
+        WindowListItem *item = WindowListItemNew(source, new_window, owner);
+        if (item == NULL)
+                return FALSE;
+
+        return WindowListNodeSetItem(list, node, item);
+}
+
+/* Moves the item of LIST for WINDOW of SOURCE, which has just been
+ * activated, to the front of LIST.  If WINDOW has no item of its own,
+ * that of its top-most owner is moved instead.  Returns TRUE if LIST
+ * changed. */
+BOOL
+WindowListActivateWindow(WindowList *list, WindowSource *source, HWND window)
+{
+        WindowListNode *node = WindowListFindNode(list, window);
+        if (node == NULL)
+                node = WindowListFindOwnerNode(list, GetTopmostOwner(source, window));
+        if (node == NULL || node == list->first)
+                return FALSE;
+
+        WindowListUnlink(list, node);
+        WindowListLinkFirst(list, node);
+
+        return TRUE;
+}
+
+/* Fetches the title of the item of LIST dealing with WINDOW anew.
+ * Returns TRUE if LIST changed. */
+BOOL
+WindowListUpdateTitle(WindowList *list, HWND window)
+{
+        WindowListNode *node = WindowListFindNode(list, window);
+        if (node == NULL)
+                return FALSE;
+
+        WindowListItemUpdateTitle(node->item);
+
+        return TRUE;
+}
+
+/* Fetches the icons of the items of LIST owned by OWNER anew.  Returns
+ * TRUE if LIST changed. */
+BOOL
+WindowListUpdateIcon(WindowList *list, HWND owner)
+{
+        BOOL updated = FALSE;
+
+        for (WindowListNode *node = WindowListFindOwnerNode(list, owner); node != NULL; node = node->next_same_owner) {
+                WindowListItemUpdateIcon(node->item);
+                updated = TRUE;
+        }
+
+        return updated;
+}
+
+/* Determines whether any of the items of LIST owned by OWNER are shown,
+ * i.e., whether their rows are drawn. */
+BOOL
+WindowListShowsOwner(WindowList *list, HWND owner)
+{
+        for (WindowListNode *node = WindowListFindOwnerNode(list, owner); node != NULL; node = node->next_same_owner)
+                if (WindowListItemShown(node->item))
+                        return TRUE;
+
+        return FALSE;
+}
+
+/* Forgets the measured sizes of the items of LIST, e.g., after their
+ * icons were scaled anew. */
+void
+WindowListInvalidateSizes(WindowList *list)
+{
+        for (WindowListNode *node = list->first; node != NULL; node = node->next)
+                WindowListItemInvalidateSize(node->item);
+}
+
 /* Frees a WindowList LIST. */
 void 
 WindowListFree(WindowList *list)
 {
-        ListFree(list->list, (FreeFunc)WindowListItemFree);
+        while (list->first != NULL)
+                WindowListRemoveNode(list, list->first);
+        HashTableFree(list->nodes, NullFreeFunc);
+        HashTableFree(list->owners, NullFreeFunc);
+        if (list->drawn_rows != NULL)
+                FREE(list->drawn_rows);
         FREE(list);
 }
 
-/* Iterates over the WindowList LIST, calling ITERATOR with CLOSURE. */
+/* Iterates over the WindowList LIST, in order, calling ITERATOR with
+ * CLOSURE. */
 static void 
 WindowListIterate(WindowList *list, WindowListIterator iterator, void *closure)
 {
-        ListItemsIterate(list->list, (ListItemsIterator)iterator, closure);
+        for (WindowListNode *node = list->first; node != NULL; node = node->next)
+                if (iterator(node->item, closure) == IterationStop)
+                        break;
 }
 
 /* Determines the length of the WindowList LIST. */
 int 
 WindowListLength(WindowList *list)
 {
-        return ListLength(list->list);
+        return list->n_items;
 }
 
 /* Iterator calculating the number of shown WindowListItems in a WindowList. */
@@ -379,11 +884,83 @@ WindowListFilter(WindowList *list, LPCTSTR prefix)
         WindowListIterate(list, (WindowListIterator)WindowListItemFilter, (void *)prefix);
 }
 
+/* Closure used when matching the items of a WindowList.
+ *
+ * PREFIX is the filter to match against.
+ * MATCHES is where the result for the current item is stored.
+ * CANCELLED is checked before each item to see if we should give up,
+ * being passed CANCELLED_CLOSURE.
+ * WAS_CANCELLED is set to TRUE if CANCELLED told us to give up. */
+typedef struct _WindowListMatchClosure WindowListMatchClosure;
+
+struct _WindowListMatchClosure
+{
+        LPCTSTR prefix;
+        BOOL *matches;
+        WindowListCancelledFunc cancelled;
+        void *cancelled_closure;
+        BOOL was_cancelled;
+};
+
+/* Iterator matching a single WindowListItem. */
+static IterationState
+WindowListMatchIterator(WindowListItem *item, void *v_closure)
+{
+        WindowListMatchClosure *closure = (WindowListMatchClosure *)v_closure;
+
+        if (closure->cancelled(closure->cancelled_closure)) {
+                closure->was_cancelled = TRUE;
+                return IterationStop;
+        }
+
+        *closure->matches++ = WindowListItemMatches(item, closure->prefix);
+
+        return IterationContinue;
+}
+
+/* Matches the items of LIST against PREFIX without changing which items
+ * are shown, storing the result for each item, in list order, in
+ * MATCHES, which must have room for WindowListLength(LIST) entries.
+ * CANCELLED is called with CLOSURE before each item is matched and
+ * matching is abandoned if it returns TRUE.  Returns FALSE if matching
+ * was abandoned.  Only item titles are read, so this may be called from
+ * a worker thread as long as LIST isn’t freed meanwhile. */
+BOOL
+WindowListMatch(WindowList *list, LPCTSTR prefix, BOOL *matches,
+                WindowListCancelledFunc cancelled, void *closure)
+{
+        WindowListMatchClosure match_closure = { prefix, matches, cancelled, closure, FALSE };
+
+        WindowListIterate(list, WindowListMatchIterator, &match_closure);
+
+        return !match_closure.was_cancelled;
+}
+
+/* Iterator applying the result of WindowListMatch() to a single item. */
+static IterationState
+WindowListApplyMatchesIterator(WindowListItem *item, void *closure)
+{
+        BOOL const **matches = (BOOL const **)closure;
+
+        WindowListItemSetShown(item, *(*matches)++);
+
+        return IterationContinue;
+}
+
+/* Shows the items of LIST according to MATCHES, as calculated by
+ * WindowListMatch(). */
+void
+WindowListApplyMatches(WindowList *list, BOOL const *matches)
+{
+        WindowListIterate(list, WindowListApplyMatchesIterator, &matches);
+}
+
 /* Sets the FONT used to draw LIST. */
 void 
 WindowListSetFont(WindowList *list, Font *font)
 {
         list->font = font;
+        list->is_drawn = FALSE;
 }
 
 /* Draws the number associated with ROW in the window list inside AREA on CANVAS. */
@@ -415,6 +992,7 @@ WindowListDrawNumber(WindowListItem *item, Canvas *canvas, int row, RectF const
  * NUMBER_AREA is the area to draw numbers on.
  * ITEM_AREA is the area to draw items on.
  * ROW is the number of the current row being drawn.
+ * DRAWN_ROWS is where the rows drawn are noted, or NULL.
  * STATUS contains any failure Status returned while drawing. */
 typedef struct _WindowListDrawClosure WindowListDrawClosure;
 
@@ -424,10 +1002,27 @@ struct _WindowListDrawClosure
         RectF *number_area;
         RectF *item_area;
         int row;
+        WindowListDrawnRow *drawn_rows;
         Status status;
 };
 
-/* Draws a single row of a WindowList for ITEM, drawing numbers if appropriate. */
+/* Determines whether the row of HEIGHT at the top of CLOSURE’s
+ * ITEM_AREA is visible at all inside the clipping region of its canvas,
+ * e.g., as only the damage is being drawn. */
+static BOOL
+WindowListRowIsVisible(WindowListDrawClosure *closure, REAL height)
+{
+        RectF row(closure->item_area->X, closure->item_area->Y, closure->item_area->Width, height);
+        if (closure->number_area != NULL) {
+                row.X = closure->number_area->X;
+                row.Width += closure->number_area->Width;
+        }
+
+        return closure->canvas.graphics->IsVisible(row);
+}
+
+/* Draws a single row of a WindowList for ITEM, drawing numbers if
+ * appropriate, unless it’s clipped away, and notes it as drawn. */
 static IterationState 
 WindowListDrawIterator(WindowListItem *item, void *v_closure)
 {
@@ -436,23 +1031,58 @@ WindowListDrawIterator(WindowListItem *item, void *v_closure)
 
         WindowListDrawClosure *closure = (WindowListDrawClosure *)v_closure;
 
-        closure->status = WindowListDrawNumber(item, &closure->canvas,
-                                               closure->row, closure->number_area);
+        SizeF size;
+        closure->status = WindowListItemSize(item, &closure->canvas, &size);
         if (closure->status != Ok)
                 return IterationStop;
 
-        closure->status = WindowListItemDraw(item, &closure->canvas, closure->item_area);
-        if (closure->status != Ok)
-                return IterationStop;
+        if (WindowListRowIsVisible(closure, size.Height)) {
+                closure->status = WindowListDrawNumber(item, &closure->canvas,
+                                                       closure->row, closure->number_area);
+                if (closure->status != Ok)
+                        return IterationStop;
+
+                closure->status = WindowListItemDrawTitle(item, &closure->canvas, closure->item_area);
+                if (closure->status != Ok)
+                        return IterationStop;
+        }
+
+        if (closure->drawn_rows != NULL) {
+                closure->drawn_rows[closure->row].version = WindowListItemVersion(item);
+                closure->drawn_rows[closure->row].y = closure->item_area->Y;
+                closure->drawn_rows[closure->row].height = size.Height;
+        }
+
+        closure->number_area->Y += size.Height;
+        closure->item_area->Y += size.Height;
+        closure->row++;
+
+        return IterationContinue;
+}
+
+/* Draws the icon of a single row of a WindowList for ITEM, unless it’s
+ * clipped away.  NUMBER_AREA, ROW, and DRAWN_ROWS of the closure aren’t
+ * used. */
+static IterationState 
+WindowListDrawIconIterator(WindowListItem *item, void *v_closure)
+{
+        if (!WindowListItemShown(item))
+                return IterationContinue;
+
+        WindowListDrawClosure *closure = (WindowListDrawClosure *)v_closure;
 
         SizeF size;
         closure->status = WindowListItemSize(item, &closure->canvas, &size);
         if (closure->status != Ok)
                 return IterationStop;
 
-        closure->number_area->Y += size.Height;
+        if (WindowListRowIsVisible(closure, size.Height)) {
+                closure->status = WindowListItemDrawIcon(item, &closure->canvas, closure->item_area);
+                if (closure->status != Ok)
+                        return IterationStop;
+        }
+
         closure->item_area->Y += size.Height;
-        closure->row++;
 
         return IterationContinue;
 }
@@ -481,24 +1111,167 @@ WindowListDrawEmpty(WindowList *list, Graphics *graphics, RectF const *area, LPC
                                     &red_brush);
 }
 
-/* Draws LIST on GRAPHICS inside AREA. */
-Status 
-WindowListDraw(WindowList *list, Graphics *graphics, RectF const *area)
+/* Makes sure LIST has room for noting N rows as drawn. */
+static BOOL
+WindowListAssertDrawnRowsBigEnough(WindowList *list, int n)
+{
+        if (n <= list->n_allocated_drawn_rows)
+                return TRUE;
+
+        int new_size = max(n, list->n_allocated_drawn_rows * 2);
+        WindowListDrawnRow *new_rows = REALLOC_N(WindowListDrawnRow, list->drawn_rows, new_size);
+        if (new_rows == NULL)
+                return FALSE;
+
+        list->drawn_rows = new_rows;
+        list->n_allocated_drawn_rows = new_size;
+
+        return TRUE;
+}
+
+/* Draws the rows of LIST, or the message shown in their place, on
+ * GRAPHICS inside AREA, setting IS_NOTED if they could be noted as
+ * drawn. */
+static Status
+WindowListDrawRows(WindowList *list, Graphics *graphics, RectF const *area, BOOL *is_noted)
 {
         LPCTSTR message = WindowListEmpty(list);
+        list->drawn_message = message;
+        list->n_drawn_rows = 0;
+        *is_noted = TRUE;
         if (message)
                 return WindowListDrawEmpty(list, graphics, area, message);
 
         RectF number_area(area->X, area->Y, list->number_width, area->Height);
         RectF item_area(area->X + list->number_width, area->Y,
                         area->Width - list->number_width, area->Height);
-        WindowListDrawClosure closure = { { graphics, list->font }, &number_area, &item_area, 0, Ok };
+
+        RectF icon_area(item_area);
+        WindowListDrawClosure icon_closure = { { graphics, list->font }, NULL, &icon_area, 0, NULL, Ok };
+        WindowListIterate(list, WindowListDrawIconIterator, &icon_closure);
+        if (icon_closure.status != Ok)
+                return icon_closure.status;
+
+        WindowListDrawnRow *drawn_rows = WindowListAssertDrawnRowsBigEnough(list, list->n_items) ? list->drawn_rows : NULL;
+        WindowListDrawClosure closure = { { graphics, list->font }, &number_area, &item_area, 0, drawn_rows, Ok };
 
         WindowListIterate(list, WindowListDrawIterator, &closure);
 
+        list->n_drawn_rows = closure.row;
+        *is_noted = (drawn_rows != NULL);
+
         return closure.status;
 }
 
+/* Draws LIST on GRAPHICS inside AREA.  The icons of all rows are drawn
+ * first, one after the other from the icon atlas, followed by their
+ * numbers and titles.  Rows that are clipped away entirely aren’t drawn
+ * at all.  The rows drawn are noted for WindowListDamage(). */
+Status 
+WindowListDraw(WindowList *list, Graphics *graphics, RectF const *area)
+{
+        BOOL is_noted;
+        Status status = WindowListDrawRows(list, graphics, area, &is_noted);
+
+        list->is_drawn = (status == Ok && is_noted);
+        list->drawn_area = *area;
+
+        return status;
+}
+
+/* Closure used when finding the rows of a WindowList that changed
+ * since they were drawn.
+ *
+ * CANVAS is the Canvas the rows are measured on.
+ * LIST is the WindowList.
+ * AREA is the area the list is drawn inside.
+ * Y is the top of the current row, and ROW its number.
+ * F is called with the area of each row that changed, and CLOSURE.
+ * STATUS contains any failure Status returned while measuring. */
+typedef struct _WindowListDamageClosure WindowListDamageClosure;
+
+struct _WindowListDamageClosure
+{
+        Canvas canvas;
+        WindowList *list;
+        RectF const *area;
+        REAL y;
+        int row;
+        DamageFunc f;
+        VOID *closure;
+        Status status;
+};
+
+/* Reports the row of HEIGHT at Y across CLOSURE’s area as damaged. */
+static void
+WindowListDamageRow(WindowListDamageClosure *closure, REAL y, REAL height)
+{
+        RectF row(closure->area->X, y, closure->area->Width, height);
+        closure->f(&row, closure->closure);
+}
+
+/* Reports the row of ITEM as damaged, along with where it was drawn,
+ * unless it’s drawn just as it was. */
+static IterationState
+WindowListDamageIterator(WindowListItem *item, void *v_closure)
+{
+        if (!WindowListItemShown(item))
+                return IterationContinue;
+
+        WindowListDamageClosure *closure = (WindowListDamageClosure *)v_closure;
+
+        SizeF size;
+        closure->status = WindowListItemSize(item, &closure->canvas, &size);
+        if (closure->status != Ok)
+                return IterationStop;
+
+        WindowListDrawnRow const *drawn = (closure->row < closure->list->n_drawn_rows) ?
+                &closure->list->drawn_rows[closure->row] : NULL;
+        if (drawn == NULL ||
+            drawn->version != WindowListItemVersion(item) ||
+            drawn->y != closure->y ||
+            drawn->height != size.Height) {
+                WindowListDamageRow(closure, closure->y, size.Height);
+                if (drawn != NULL)
+                        WindowListDamageRow(closure, drawn->y, drawn->height);
+        }
+
+        closure->y += size.Height;
+        closure->row++;
+
+        return IterationContinue;
+}
+
+/* Calls F with CLOSURE and each area of LIST, drawn on GRAPHICS inside
+ * AREA, that has changed since it was last drawn: the rows whose items
+ * changed or moved, and those no longer shown.  All of AREA is reported
+ * if LIST hasn’t been drawn inside it yet, or if it’s become empty or
+ * is no longer. */
+Status
+WindowListDamage(WindowList *list, Graphics *graphics, RectF const *area, DamageFunc f, VOID *closure)
+{
+        LPCTSTR message = WindowListEmpty(list);
+        if (!list->is_drawn || !list->drawn_area.Equals(*area) ||
+            (message == NULL) != (list->drawn_message == NULL) ||
+            (message != NULL && lstrcmp(message, list->drawn_message) != 0)) {
+                f(area, closure);
+                return Ok;
+        }
+
+        if (message != NULL)
+                return Ok;
+
+        WindowListDamageClosure damage_closure = { { graphics, list->font }, list, area, area->Y, 0, f, closure, Ok };
+        WindowListIterate(list, WindowListDamageIterator, &damage_closure);
+        if (damage_closure.status != Ok)
+                return damage_closure.status;
+
+        for (int row = damage_closure.row; row < list->n_drawn_rows; row++)
+                WindowListDamageRow(&damage_closure, list->drawn_rows[row].y, list->drawn_rows[row].height);
+
+        return Ok;
+}
+
 /* Closure used when finding the Nth shown WindowListItem.
  *
  * N_LEFT is the number of items that remain to find before the Nth has been found.
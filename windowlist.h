@@ -1,13 +1,40 @@
 ﻿typedef struct _WindowList WindowList;
+typedef struct _WindowListDiff WindowListDiff;
+
+/* How a WindowList changed when refreshed.
+ *
+ * ADDED is the number of items created for new windows.
+ * REMOVED is the number of items whose windows are gone.
+ * CHANGED is the number of items kept whose title or owner changed. */
+struct _WindowListDiff
+{
+        int added;
+        int removed;
+        int changed;
+};
 
 typedef IterationState (*WindowListIterator)(WindowListItem *, void *);
+typedef BOOL (*WindowListCancelledFunc)(void *);
 
 WindowList *WindowListNew(Font *font);
+WindowList *WindowListNewFromSource(WindowSource *source, Font *font);
 void WindowListFree(WindowList *list);
+void WindowListRefresh(WindowList *list, WindowSource *source, WindowListDiff *diff);
+BOOL WindowListInsertWindow(WindowList *list, WindowSource *source, HWND window);
+BOOL WindowListRemoveWindow(WindowList *list, HWND window);
+BOOL WindowListReplaceWindow(WindowList *list, WindowSource *source, HWND window, HWND new_window);
+BOOL WindowListActivateWindow(WindowList *list, WindowSource *source, HWND window);
+BOOL WindowListUpdateTitle(WindowList *list, HWND window);
+BOOL WindowListUpdateIcon(WindowList *list, HWND owner);
+BOOL WindowListShowsOwner(WindowList *list, HWND owner);
+void WindowListInvalidateSizes(WindowList *list);
 int WindowListLength(WindowList *list);
 int WindowListLengthShown(WindowList *list);
 Status WindowListSize(WindowList *list, Graphics *g, SizeF *size);
 void WindowListFilter(WindowList *list, LPCTSTR prefix);
+BOOL WindowListMatch(WindowList *list, LPCTSTR prefix, BOOL *matches, WindowListCancelledFunc cancelled, void *closure);
+void WindowListApplyMatches(WindowList *list, BOOL const *matches);
 void WindowListSetFont(WindowList *list, Font *font);
 WindowListItem *WindowListNthShown(WindowList *list, int n);
 Status WindowListDraw(WindowList *list, Graphics *g, RectF const *rc);
+Status WindowListDamage(WindowList *list, Graphics *g, RectF const *rc, DamageFunc f, VOID *closure);
@@ -1,5 +1,6 @@
 ﻿#include "stdafx.h"
 
+#include "windowsource.h"
 #include "windowlistitem.h"
 
 /* The amount of padding of icons on the x-axis. */
@@ -10,49 +11,157 @@
 
 /* An item of the window list.
  *
+ * SOURCE is where the item’s window’s title and icon come from.
  * WINDOW is the window this item deals with.
+ * OWNER is the window whose icon is used for this item.
  * TITLE is the item’s window’s title.
  * ICON is the item’s window’s icon.
  * SIZE is the size of the item.
+ * VERSION changes whenever the item changes in a way that shows, and is
+ * never the same for two items.
  * SHOWN determines whether this item is currently being displayed. */
 struct _WindowListItem
 {
+        WindowSource *source;
         HWND window;
+        HWND owner;
         LPTSTR title;
-        Bitmap *icon;
+        WindowIcon *icon;
         SizeF size;
+        UINT version;
         BOOL shown;
 };
 
+/* The last version given to an item. */
+static UINT s_last_version;
 
-/* Creates a new window-list item for WINDOW, which is owned by OWNER. */
+/* Fetches the title of ITEM’s window, falling back on that of its owner. */
+static void
+WindowListItemFetchTitle(WindowListItem *item)
+{
+        if (!WindowSourceTitle(item->source, item->window, &item->title) &&
+            !WindowSourceTitle(item->source, item->owner, &item->title))
+                item->title = NO_TITLE_TITLE;
+}
+
+/* Notes that ITEM changed in a way that shows, forgetting its measured
+ * size and giving it a new version. */
+static void
+WindowListItemChanged(WindowListItem *item)
+{
+        item->size.Width = item->size.Height = INVALID_CXY;
+        item->version = ++s_last_version;
+}
+
+/* Creates a new window-list item for WINDOW in SOURCE, which is owned by
+ * OWNER. */
 WindowListItem *
-WindowListItemNew(HWND window, HWND owner)
+WindowListItemNew(WindowSource *source, HWND window, HWND owner)
 {
         WindowListItem *item = ALLOC_STRUCT(WindowListItem);
         if (item == NULL)
                 return NULL;
 
+        item->source = source;
         item->window = window;
-        if (!GetWindowTitle(item->window, &item->title) &&
-            !GetWindowTitle(owner, &item->title))
-                item->title = NO_TITLE_TITLE;
-        WindowIconNew(owner, &item->icon);
-        item->size.Width = item->size.Height = INVALID_CXY;
+        item->owner = owner;
+        WindowListItemFetchTitle(item);
+        WindowIconNew(source, owner, &item->icon);
+        WindowListItemChanged(item);
         item->shown = TRUE;
 
         return item;
 }
 
+static void
+WindowListItemFreeTitle(WindowListItem *item)
+{
+        if (item->title != NO_TITLE_TITLE)
+                FREE(item->title);
+}
+
 /* Frees a window-list item. */
 void 
 WindowListItemFree(WindowListItem *item)
 {
-        if (item->title != NO_TITLE_TITLE)
-                FREE(item->title);
+        WindowIconFree(item->icon);
+        WindowListItemFreeTitle(item);
         FREE(item);
 }
 
+/* Gets the window ITEM deals with. */
+HWND
+WindowListItemWindow(WindowListItem const *item)
+{
+        return item->window;
+}
+
+/* Gets the window whose icon is used for ITEM. */
+HWND
+WindowListItemOwner(WindowListItem const *item)
+{
+        return item->owner;
+}
+
+/* Fetches the title of ITEM’s window anew. */
+void
+WindowListItemUpdateTitle(WindowListItem *item)
+{
+        WindowListItemFreeTitle(item);
+        WindowListItemFetchTitle(item);
+        WindowListItemChanged(item);
+}
+
+/* Fetches the title of ITEM’s window anew, keeping its measured size
+ * if the title didn’t change.  Returns TRUE if the title changed. */
+BOOL
+WindowListItemRefresh(WindowListItem *item)
+{
+        LPTSTR old_title = item->title;
+
+        WindowListItemFetchTitle(item);
+        if (lstrcmp(old_title, item->title) == 0) {
+                if (item->title != NO_TITLE_TITLE)
+                        FREE(item->title);
+                item->title = old_title;
+                return FALSE;
+        }
+
+        if (old_title != NO_TITLE_TITLE)
+                FREE(old_title);
+        WindowListItemChanged(item);
+
+        return TRUE;
+}
+
+/* Fetches the icon of ITEM’s owner anew, e.g., after the cached icon
+ * has been replaced. */
+void
+WindowListItemUpdateIcon(WindowListItem *item)
+{
+        WindowIcon *old_icon = item->icon;
+
+        if (WindowIconNew(item->source, item->owner, &item->icon) == Ok)
+                WindowIconFree(old_icon);
+        WindowListItemChanged(item);
+}
+
+/* Forgets the measured size of ITEM, e.g., after its icon was scaled
+ * anew. */
+void
+WindowListItemInvalidateSize(WindowListItem *item)
+{
+        WindowListItemChanged(item);
+}
+
+/* Gets the version of ITEM, which changes whenever ITEM changes in a way
+ * that shows, so that its row may be drawn anew. */
+UINT
+WindowListItemVersion(WindowListItem const *item)
+{
+        return item->version;
+}
+
 /* Determines whether ITEM is currently being shown in the window list. */
 BOOL 
 WindowListItemShown(WindowListItem const *item)
@@ -64,7 +173,7 @@ WindowListItemShown(WindowListItem const *item)
 BOOL 
 WindowListItemSwitchTo(WindowListItem const *item)
 {
-        return MySwitchToThisWindow(item->window);
+        return WindowSourceSwitchTo(item->source, item->window);
 }
 
 static BOOL
@@ -109,11 +218,26 @@ IsSubMatch(LPCTSTR string, LPCTSTR chars)
         return *chars == L'\0';
 }
 
+/* Determines whether ITEM matches PREFIX.  This only reads ITEM’s title,
+ * so it may be called from a thread other than the one owning ITEM. */
+BOOL
+WindowListItemMatches(WindowListItem const *item, LPCTSTR prefix)
+{
+        return IsSubMatch(item->title, prefix);
+}
+
+/* Sets whether ITEM should be displayed. */
+void
+WindowListItemSetShown(WindowListItem *item, BOOL shown)
+{
+        item->shown = shown;
+}
+
 /* Updates whether ITEM should be displayed, given PREFIX as a filter. */
 IterationState 
 WindowListItemFilter(WindowListItem *item, LPCTSTR prefix)
 {
-        item->shown = IsSubMatch(item->title, prefix);
+        item->shown = WindowListItemMatches(item, prefix);
 
         return IterationContinue;
 }
@@ -139,8 +263,8 @@ WindowListItemValidateSize(WindowListItem *item, Canvas const *canvas)
         default_height = max(default_height, font_height);
         default_height += ICON_X_PADDING * 2;
 
-        UINT icon_width = item->icon->GetWidth();
-        RETURN_GDI_FAILURE(item->icon->GetLastStatus());
+        INT icon_width, icon_height;
+        WindowIconGetDimensions(item->icon, &icon_width, &icon_height);
 
         item->size.Width = icon_width + ICON_X_PADDING + title_area.Width;
         item->size.Height = (REAL)GetSystemMetricsDefault(SM_CYCAPTION, (INT)default_height);
@@ -165,8 +289,8 @@ WindowListItemIconYPadding(WindowListItem *item, Canvas const *canvas, REAL *pad
 {
         RETURN_GDI_FAILURE(WindowListItemValidateSize(item, canvas));
 
-        UINT icon_height = item->icon->GetHeight();
-        RETURN_GDI_FAILURE(item->icon->GetLastStatus());
+        INT icon_width, icon_height;
+        WindowIconGetDimensions(item->icon, &icon_width, &icon_height);
 
         *padding = (item->size.Height - icon_height) / 2;
 
@@ -190,22 +314,24 @@ WindowListItemTextYPadding(WindowListItem *item, Canvas const *canvas, REAL *pad
         return Ok;
 }
 
-static Status 
-ItemDrawIcon(WindowListItem *item, Canvas const *canvas, RectF const *area)
+/* Draws ITEM’s icon on CANVAS inside AREA.  Icons are drawn in a pass of
+ * their own, so that they’re all drawn from the icon atlas in one go. */
+Status 
+WindowListItemDrawIcon(WindowListItem *item, Canvas const *canvas, RectF const *area)
 {
         REAL icon_y_padding;
         RETURN_GDI_FAILURE(WindowListItemIconYPadding(item, canvas, &icon_y_padding));
 
-        Point icon_origo((INT)area->X, (INT)area->Y + (INT)icon_y_padding);
-
-        return canvas->graphics->DrawImage(item->icon, icon_origo);
+        return WindowIconDraw(canvas->graphics, item->icon, (INT)area->X, (INT)area->Y + (INT)icon_y_padding);
 }
 
 static Status 
 ItemDrawString(WindowListItem *item, Canvas const *canvas, RectF const *area)
 {
-        UINT dx_icon = item->icon->GetWidth() + ICON_X_PADDING;
-        RETURN_GDI_FAILURE(item->icon->GetLastStatus());
+        INT icon_width, icon_height;
+        WindowIconGetDimensions(item->icon, &icon_width, &icon_height);
+
+        INT dx_icon = icon_width + ICON_X_PADDING;
 
         REAL text_y_padding;
         RETURN_GDI_FAILURE(WindowListItemTextYPadding(item, canvas, &text_y_padding));
@@ -223,13 +349,12 @@ ItemDrawString(WindowListItem *item, Canvas const *canvas, RectF const *area)
                                             title_area, &format, &white_brush);
 }
 
-/* Draws ITEM on CANVAS inside AREA. */
+/* Draws ITEM’s title on CANVAS inside AREA, leaving room for its icon,
+ * which is drawn by WindowListItemDrawIcon(). */
 Status 
-WindowListItemDraw(WindowListItem *item, Canvas const *canvas, RectF const *area)
+WindowListItemDrawTitle(WindowListItem *item, Canvas const *canvas, RectF const *area)
 {
         RETURN_GDI_FAILURE(WindowListItemValidateSize(item, canvas));
 
-        RETURN_GDI_FAILURE(ItemDrawIcon(item, canvas, area));
-
         return ItemDrawString(item, canvas, area);
 }
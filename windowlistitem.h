@@ -1,10 +1,20 @@
 ﻿typedef struct _WindowListItem WindowListItem;
 
-WindowListItem *WindowListItemNew(HWND window, HWND owner);
+WindowListItem *WindowListItemNew(WindowSource *source, HWND window, HWND owner);
 void WindowListItemFree(WindowListItem *item);
+HWND WindowListItemWindow(WindowListItem const *item);
+HWND WindowListItemOwner(WindowListItem const *item);
+void WindowListItemUpdateTitle(WindowListItem *item);
+BOOL WindowListItemRefresh(WindowListItem *item);
+void WindowListItemUpdateIcon(WindowListItem *item);
+void WindowListItemInvalidateSize(WindowListItem *item);
+UINT WindowListItemVersion(WindowListItem const *item);
 Status WindowListItemSize(WindowListItem *item, Canvas const *canvas, SizeF *size);
 BOOL WindowListItemShown(WindowListItem const *item);
 BOOL WindowListItemSwitchTo(WindowListItem const *item);
+BOOL WindowListItemMatches(WindowListItem const *item, LPCTSTR prefix);
+void WindowListItemSetShown(WindowListItem *item, BOOL shown);
 IterationState WindowListItemFilter(WindowListItem *item, LPCTSTR prefix);
 Status WindowListItemTextYPadding(WindowListItem *item, Canvas const *canvas, REAL *padding);
-Status WindowListItemDraw(WindowListItem *item, Canvas const *canvas, RectF const *rc);
+Status WindowListItemDrawIcon(WindowListItem *item, Canvas const *canvas, RectF const *rc);
+Status WindowListItemDrawTitle(WindowListItem *item, Canvas const *canvas, RectF const *rc);
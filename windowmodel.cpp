@@ -0,0 +1,93 @@
+﻿#include "stdafx.h"
+
+#include "windowsource.h"
+#include "windowlistitem.h"
+#include "windowlist.h"
+#include "windowmodel.h"
+
+/* A WindowModel keeps a WindowList up to date for as long as the
+ * application runs, so that it doesn’t have to be built each time the
+ * window list is displayed.  It is updated from WindowEvents, which on
+ * the live desktop come from the shell hook, and reconciled with its
+ * WindowSource every now and then to recover from missed events. */
+
+/* A model of the windows in SOURCE, kept in LIST. */
+struct _WindowModel
+{
+        WindowSource *source;
+        WindowList *list;
+};
+
+/* Creates a new WindowModel of the windows in SOURCE, using FONT for
+ * drawing its WindowList. */
+WindowModel *
+WindowModelNew(WindowSource *source, Font *font)
+{
+        WindowModel *model = ALLOC_STRUCT(WindowModel);
+        if (model == NULL)
+                return NULL;
+
+        model->source = source;
+        model->list = WindowListNewFromSource(source, font);
+        if (model->list == NULL) {
+                FREE(model);
+                return NULL;
+        }
+
+        return model;
+}
+
+void
+WindowModelFree(WindowModel *model)
+{
+        WindowListFree(model->list);
+        FREE(model);
+}
+
+/* Gets the WindowList of MODEL.  It stays the same for the lifetime of
+ * MODEL, but its items change as events are handled. */
+WindowList *
+WindowModelList(WindowModel const *model)
+{
+        return model->list;
+}
+
+/* Gets the WindowSource whose windows MODEL keeps track of. */
+WindowSource *
+WindowModelSource(WindowModel const *model)
+{
+        return model->source;
+}
+
+/* Updates MODEL according to EVENT.  Returns TRUE if its WindowList
+ * changed. */
+BOOL
+WindowModelHandleEvent(WindowModel *model, WindowEvent const *event)
+{
+        switch (event->type) {
+        case WINDOW_EVENT_CREATED:
+                return WindowListInsertWindow(model->list, model->source, event->window);
+        case WINDOW_EVENT_DESTROYED:
+                return WindowListRemoveWindow(model->list, event->window);
+        case WINDOW_EVENT_REPLACED:
+                return WindowListReplaceWindow(model->list, model->source,
+                                               event->window, event->new_window);
+        case WINDOW_EVENT_ACTIVATED:
+                return WindowListActivateWindow(model->list, model->source, event->window) ||
+                       WindowListInsertWindow(model->list, model->source, event->window);
+        case WINDOW_EVENT_TITLE_CHANGED:
+                return WindowListUpdateTitle(model->list, event->window);
+        case WINDOW_EVENT_ICON_CHANGED:
+                return WindowListUpdateIcon(model->list, event->window);
+        default:
+                return FALSE;
+        }
+}
+
+/* Brings MODEL in line with its WindowSource, in case any events were
+ * missed, setting DIFF to what had to be changed. */
+void
+WindowModelReconcile(WindowModel *model, WindowListDiff *diff)
+{
+        WindowListRefresh(model->list, model->source, diff);
+}
@@ -0,0 +1,34 @@
+﻿typedef struct _WindowModel WindowModel;
+typedef struct _WindowEvent WindowEvent;
+
+/* Events that change the set of windows a WindowModel keeps track of.
+ *
+ * WINDOW_EVENT_CREATED is sent when WINDOW is created.
+ * WINDOW_EVENT_DESTROYED is sent when WINDOW is destroyed.
+ * WINDOW_EVENT_REPLACED is sent when WINDOW is replaced by NEW_WINDOW.
+ * WINDOW_EVENT_ACTIVATED is sent when WINDOW is activated.
+ * WINDOW_EVENT_TITLE_CHANGED is sent when the title of WINDOW changes.
+ * WINDOW_EVENT_ICON_CHANGED is sent when the icon of WINDOW changes. */
+typedef enum {
+        WINDOW_EVENT_CREATED,
+        WINDOW_EVENT_DESTROYED,
+        WINDOW_EVENT_REPLACED,
+        WINDOW_EVENT_ACTIVATED,
+        WINDOW_EVENT_TITLE_CHANGED,
+        WINDOW_EVENT_ICON_CHANGED,
+} WindowEventType;
+
+/* An event of TYPE concerning WINDOW, and NEW_WINDOW if replaced. */
+struct _WindowEvent
+{
+        WindowEventType type;
+        HWND window;
+        HWND new_window;
+};
+
+WindowModel *WindowModelNew(WindowSource *source, Font *font);
+void WindowModelFree(WindowModel *model);
+WindowList *WindowModelList(WindowModel const *model);
+WindowSource *WindowModelSource(WindowModel const *model);
+BOOL WindowModelHandleEvent(WindowModel *model, WindowEvent const *event);
+void WindowModelReconcile(WindowModel *model, WindowListDiff *diff);
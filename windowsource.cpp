@@ -0,0 +1,386 @@
+﻿#include "stdafx.h"
+#include <psapi.h>
+
+#include "windowsource.h"
+
+/* The WindowSource of the live desktop just forwards to the Windows API. */
+
+static BOOL
+DesktopEnumerate(VOID *closure, WNDENUMPROC f, LPARAM lParam)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return EnumDesktopWindows(NULL, f, lParam);
+}
+
+static HWND
+DesktopOwner(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return GetWindow(window, GW_OWNER);
+}
+
+static HWND
+DesktopShell(VOID *closure)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return GetShellWindow();
+}
+
+static BOOL
+DesktopIsVisible(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return IsWindowVisible(window);
+}
+
+static LONG_PTR
+DesktopExStyle(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return GetWindowLongPtr(window, GWL_EXSTYLE);
+}
+
+static BOOL
+DesktopTitle(VOID *closure, HWND window, LPTSTR *title)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return GetWindowTitle(window, title);
+}
+
+/* Gets the HICON for ICON_ID ({ICON_BIG, ICON_SMALL, ICON_SMALL2}) associated
+ * with WINDOW.  Returns FALSE if unable to retrieve this icon and sets
+ * WAS_HUNG to true if the reason it fail was because the message timed out. */
+static BOOL 
+GetWindowHIconByMessage(HWND window, WPARAM icon_id, HICON *icon, BOOL *was_hung)
+{
+        *icon = NULL;
+        *was_hung = FALSE;
+
+        if (SendMessageTimeout(window, WM_GETICON, icon_id, 0, SMTO_ABORTIFHUNG, HUNG_TIMEOUT, (PDWORD_PTR)icon))
+                return *icon != NULL;
+
+        *was_hung = LastErrorWasTimeout();
+
+        return FALSE;
+}
+
+/* Gets the HICON for ICON_ID ({ICON_BIG, ICON_SMALL, ICON_SMALL2}) associated
+ * with WINDOW, also trying to get it by calling GetClassLongPtr(WINDOW, CLASS_LONG_ICON).
+ * Returns FALSE if unable to retrieve both of these icons. */
+static BOOL 
+GetWindowHIcon(HWND window, WPARAM icon_id, int class_long_icon, HICON *icon)
+{
+        BOOL was_hung;
+
+        if (GetWindowHIconByMessage(window, icon_id, icon, &was_hung))
+                return TRUE;
+
+        if (was_hung)
+                return FALSE;
+
+        *icon = (HICON)(UINT_PTR)GetClassLongPtr(window, class_long_icon);
+        return *icon != NULL;
+}
+
+static BOOL
+DesktopSmallIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        HICON hicon;
+        if (!GetWindowHIconByMessage(window, ICON_SMALL, &hicon, was_hung) &&
+            (*was_hung || !GetWindowHIcon(window, ICON_SMALL2, GCLP_HICONSM, &hicon)))
+                return FALSE;
+
+        return WindowSourceIconFromHIcon(hicon, icon);
+}
+
+static BOOL
+DesktopBigIcon(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        HICON hicon;
+        if (!GetWindowHIconByMessage(window, ICON_BIG, &hicon, was_hung)) {
+                if (*was_hung)
+                        return FALSE;
+
+                hicon = (HICON)(UINT_PTR)GetClassLongPtr(window, GCLP_HICON);
+                if (hicon == NULL)
+                        return FALSE;
+        }
+
+        return WindowSourceIconFromHIcon(hicon, icon);
+}
+
+/* The longest window-class name there is. */
+#define MAX_CLASS_NAME          256
+
+/* Keys a window’s icon by the path of its process’ executable and its
+ * class, as the resources an icon is loaded from aren’t known to anyone
+ * but the window itself.  Executables keep their icons, and windows of
+ * the same class usually share one. */
+static BOOL
+DesktopIconKey(VOID *closure, HWND window, LPTSTR *key)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        DWORD id;
+        if (GetWindowThreadProcessId(window, &id) == 0)
+                return FALSE;
+
+        HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, id);
+        if (process == NULL)
+                return FALSE;
+
+        TCHAR path[MAX_PATH];
+        DWORD path_length = GetModuleFileNameEx(process, NULL, path, _countof(path));
+        CloseHandle(process);
+        if (path_length == 0)
+                return FALSE;
+
+        TCHAR name[MAX_CLASS_NAME];
+        if (GetClassName(window, name, _countof(name)) == 0)
+                return FALSE;
+
+        int size = MAX_PATH + 1 + MAX_CLASS_NAME;
+        *key = ALLOC_N(TCHAR, size);
+        if (*key == NULL)
+                return FALSE;
+
+        if (SUCCEEDED(StringCchPrintf(*key, size, L"%s|%s", path, name)))
+                return TRUE;
+
+        FREE(*key);
+        *key = NULL;
+
+        return FALSE;
+}
+
+static BOOL
+DesktopExists(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return IsWindow(window);
+}
+
+static BOOL
+DesktopSwitchTo(VOID *closure, HWND window)
+{
+        UNREFERENCED_PARAMETER(closure);
+
+        return MySwitchToThisWindow(window);
+}
+
+static WindowSourceFuncs const s_desktop_funcs = {
+        DesktopEnumerate,
+        DesktopOwner,
+        DesktopShell,
+        DesktopIsVisible,
+        DesktopExStyle,
+        DesktopTitle,
+        DesktopSmallIcon,
+        DesktopBigIcon,
+        DesktopIconKey,
+        DesktopExists,
+        DesktopSwitchTo,
+};
+
+static WindowSource s_desktop = { &s_desktop_funcs, NULL };
+
+/* Gets the WindowSource of the live desktop. */
+WindowSource *
+WindowSourceDesktop(VOID)
+{
+        return &s_desktop;
+}
+
+/* Calls F with LPARAM for each top-level window of SOURCE. */
+BOOL
+WindowSourceEnumerate(WindowSource *source, WNDENUMPROC f, LPARAM lParam)
+{
+        return source->funcs->enumerate(source->closure, f, lParam);
+}
+
+/* Gets the owner of WINDOW in SOURCE. */
+HWND
+WindowSourceOwner(WindowSource *source, HWND window)
+{
+        return source->funcs->owner(source->closure, window);
+}
+
+/* Gets the shell’s desktop window of SOURCE. */
+HWND
+WindowSourceShell(WindowSource *source)
+{
+        return source->funcs->shell(source->closure);
+}
+
+/* Determines whether WINDOW is visible in SOURCE. */
+BOOL
+WindowSourceIsVisible(WindowSource *source, HWND window)
+{
+        return source->funcs->is_visible(source->closure, window);
+}
+
+/* Gets the extended style of WINDOW in SOURCE. */
+LONG_PTR
+WindowSourceExStyle(WindowSource *source, HWND window)
+{
+        return source->funcs->ex_style(source->closure, window);
+}
+
+/* Gets the title of WINDOW in SOURCE, which should be freed with FREE().
+ * Returns FALSE if WINDOW has no title. */
+BOOL
+WindowSourceTitle(WindowSource *source, HWND window, LPTSTR *title)
+{
+        return source->funcs->title(source->closure, window, title);
+}
+
+/* Gets the pixels of WINDOW’s small icon in SOURCE, which should be freed
+ * with WindowSourceIconFree().  Returns FALSE if WINDOW has no icon of
+ * its own, setting WAS_HUNG if that’s because it didn’t respond in
+ * time. */
+BOOL
+WindowSourceSmallIcon(WindowSource *source, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        return source->funcs->small_icon(source->closure, window, icon, was_hung);
+}
+
+/* Gets the pixels of WINDOW’s big icon in SOURCE, like
+ * WindowSourceSmallIcon(). */
+BOOL
+WindowSourceBigIcon(WindowSource *source, HWND window, WindowSourceIcon *icon, BOOL *was_hung)
+{
+        return source->funcs->big_icon(source->closure, window, icon, was_hung);
+}
+
+/* Gets a KEY identifying WINDOW’s icon in SOURCE across runs, which should
+ * be freed with FREE().  Returns FALSE if there’s no telling where it
+ * comes from. */
+BOOL
+WindowSourceIconKey(WindowSource *source, HWND window, LPTSTR *key)
+{
+        return source->funcs->icon_key(source->closure, window, key);
+}
+
+/* Determines whether WINDOW still exists in SOURCE. */
+BOOL
+WindowSourceExists(WindowSource *source, HWND window)
+{
+        return source->funcs->exists(source->closure, window);
+}
+
+/* Switches to WINDOW of SOURCE.  Returns FALSE if it couldn’t be made the
+ * foreground window. */
+BOOL
+WindowSourceSwitchTo(WindowSource *source, HWND window)
+{
+        return source->funcs->switch_to(source->closure, window);
+}
+
+/* Gets the size of the color bits of an icon of WIDTH by HEIGHT. */
+SIZE_T
+WindowSourceIconColorSize(UINT width, UINT height)
+{
+        return (SIZE_T)width * height * 4;
+}
+
+/* Gets the size of the mask bits of an icon of WIDTH by HEIGHT. */
+SIZE_T
+WindowSourceIconMaskSize(UINT width, UINT height)
+{
+        return (SIZE_T)((width + 15) / 16) * 2 * height;
+}
+
+/* Allocates the color and mask bits of ICON, of WIDTH by HEIGHT.  Returns
+ * FALSE if there’s no memory for them, leaving nothing to free. */
+BOOL
+WindowSourceIconNew(UINT width, UINT height, WindowSourceIcon *icon)
+{
+        icon->width = width;
+        icon->height = height;
+        icon->color = ALLOC_N(BYTE, WindowSourceIconColorSize(width, height));
+        icon->mask = ALLOC_N(BYTE, WindowSourceIconMaskSize(width, height));
+        if (icon->color != NULL && icon->mask != NULL)
+                return TRUE;
+
+        WindowSourceIconFree(icon);
+
+        return FALSE;
+}
+
+/* Gets the pixels of the color and mask bitmaps of an icon. */
+static BOOL
+WindowSourceIconFromBitmaps(HBITMAP hb_color, HBITMAP hb_mask, WindowSourceIcon *icon)
+{
+        BITMAP color, mask;
+        if (GetObject(hb_color, sizeof(color), &color) == 0 ||
+            GetObject(hb_mask, sizeof(mask), &mask) == 0 ||
+            mask.bmWidth != color.bmWidth || mask.bmHeight != color.bmHeight ||
+            !WindowSourceIconNew(color.bmWidth, color.bmHeight, icon))
+                return FALSE;
+
+        BITMAPINFO info;
+        INITSTRUCT(info.bmiHeader, TRUE);
+        info.bmiHeader.biWidth = icon->width;
+        info.bmiHeader.biHeight = -(LONG)icon->height;
+        info.bmiHeader.biPlanes = 1;
+        info.bmiHeader.biBitCount = 32;
+        info.bmiHeader.biCompression = BI_RGB;
+
+        HDC dc = GetDC(HDC_OF_SCREEN);
+        if (dc == NULL)
+                return FALSE;
+        int lines = GetDIBits(dc, hb_color, 0, icon->height, icon->color, &info, DIB_RGB_COLORS);
+        ReleaseDC(HDC_OF_SCREEN, dc);
+
+        LONG mask_size = (LONG)WindowSourceIconMaskSize(icon->width, icon->height);
+
+        return lines == (int)icon->height &&
+               GetBitmapBits(hb_mask, mask_size, icon->mask) == mask_size;
+}
+
+/* Gets the pixels of HICON into ICON, which should be freed with
+ * WindowSourceIconFree().  Monochrome icons aren’t supported. */
+BOOL
+WindowSourceIconFromHIcon(HICON hicon, WindowSourceIcon *icon)
+{
+        ZeroMemory(icon, sizeof(*icon));
+
+        ICONINFO info;
+        if (!GetIconInfo(hicon, &info))
+                return FALSE;
+
+        BOOL got = info.hbmColor != NULL &&
+                   WindowSourceIconFromBitmaps(info.hbmColor, info.hbmMask, icon);
+
+        if (info.hbmColor != NULL)
+                DeleteObject(info.hbmColor);
+        DeleteObject(info.hbmMask);
+
+        if (!got)
+                WindowSourceIconFree(icon);
+
+        return got;
+}
+
+/* Frees the pixels of ICON. */
+void
+WindowSourceIconFree(WindowSourceIcon *icon)
+{
+        if (icon->color != NULL)
+                FREE(icon->color);
+        if (icon->mask != NULL)
+                FREE(icon->mask);
+        icon->color = NULL;
+        icon->mask = NULL;
+}
@@ -0,0 +1,76 @@
+﻿typedef struct _WindowSource WindowSource;
+typedef struct _WindowSourceFuncs WindowSourceFuncs;
+typedef struct _WindowSourceIcon WindowSourceIcon;
+
+/* The pixels of a window’s icon of WIDTH by HEIGHT, as got from a
+ * WindowSource.  COLOR holds 32-bit BGRA rows and MASK 1-bit rows, each
+ * padded to 16 bits, both top-down, as GetDIBits() and GetBitmapBits()
+ * get them from the bitmaps of an HICON.  Pixels whose mask bit is set
+ * are transparent, unless COLOR has an alpha channel of its own.  Keeping
+ * them as data, rather than as an HICON, lets sources that aren’t the
+ * live desktop hand them over without creating GDI objects. */
+struct _WindowSourceIcon
+{
+        UINT width;
+        UINT height;
+        BYTE *color;
+        BYTE *mask;
+};
+
+/* The operations of a WindowSource.  Each function is passed the
+ * WindowSource’s closure.
+ *
+ * ENUMERATE calls its callback for each top-level window, in z-order.
+ * OWNER gets the owner of a window, as GetWindow(window, GW_OWNER).
+ * SHELL gets the shell’s desktop window, as GetShellWindow().
+ * IS_VISIBLE determines whether a window is visible.
+ * EX_STYLE gets a window’s extended style.
+ * TITLE gets a window’s title, as GetWindowTitle().
+ * SMALL_ICON gets the pixels of a window’s small icon, setting WAS_HUNG
+ * if the window didn’t respond in time.  It may be called from any
+ * thread.
+ * BIG_ICON gets the pixels of a window’s big icon, like SMALL_ICON.
+ * ICON_KEY gets a string that identifies where a window’s icon comes
+ * from across runs, so that icons may be kept on disk.
+ * EXISTS determines whether a window still exists, as IsWindow().
+ * SWITCH_TO makes a window the foreground window. */
+struct _WindowSourceFuncs
+{
+        BOOL (*enumerate)(VOID *closure, WNDENUMPROC f, LPARAM lParam);
+        HWND (*owner)(VOID *closure, HWND window);
+        HWND (*shell)(VOID *closure);
+        BOOL (*is_visible)(VOID *closure, HWND window);
+        LONG_PTR (*ex_style)(VOID *closure, HWND window);
+        BOOL (*title)(VOID *closure, HWND window, LPTSTR *title);
+        BOOL (*small_icon)(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung);
+        BOOL (*big_icon)(VOID *closure, HWND window, WindowSourceIcon *icon, BOOL *was_hung);
+        BOOL (*icon_key)(VOID *closure, HWND window, LPTSTR *key);
+        BOOL (*exists)(VOID *closure, HWND window);
+        BOOL (*switch_to)(VOID *closure, HWND window);
+};
+
+/* A source of windows and information about them, so that the window
+ * list can be built from something other than the live desktop. */
+struct _WindowSource
+{
+        WindowSourceFuncs const *funcs;
+        VOID *closure;
+};
+
+WindowSource *WindowSourceDesktop(VOID);
+BOOL WindowSourceEnumerate(WindowSource *source, WNDENUMPROC f, LPARAM lParam);
+HWND WindowSourceOwner(WindowSource *source, HWND window);
+HWND WindowSourceShell(WindowSource *source);
+BOOL WindowSourceIsVisible(WindowSource *source, HWND window);
+LONG_PTR WindowSourceExStyle(WindowSource *source, HWND window);
+BOOL WindowSourceTitle(WindowSource *source, HWND window, LPTSTR *title);
+BOOL WindowSourceSmallIcon(WindowSource *source, HWND window, WindowSourceIcon *icon, BOOL *was_hung);
+BOOL WindowSourceBigIcon(WindowSource *source, HWND window, WindowSourceIcon *icon, BOOL *was_hung);
+BOOL WindowSourceIconKey(WindowSource *source, HWND window, LPTSTR *key);
+BOOL WindowSourceExists(WindowSource *source, HWND window);
+BOOL WindowSourceSwitchTo(WindowSource *source, HWND window);
+BOOL WindowSourceIconNew(UINT width, UINT height, WindowSourceIcon *icon);
+BOOL WindowSourceIconFromHIcon(HICON hicon, WindowSourceIcon *icon);
+SIZE_T WindowSourceIconColorSize(UINT width, UINT height);
+SIZE_T WindowSourceIconMaskSize(UINT width, UINT height);
+void WindowSourceIconFree(WindowSourceIcon *icon);
@@ -0,0 +1,183 @@
+﻿#include "stdafx.h"
+#include <process.h>
+
+#include "list.h"
+#include "workerpool.h"
+
+/* A WorkerPool runs jobs on a fixed number of threads, in the order
+ * they were submitted.  This bounds the number of threads used no
+ * matter how many jobs there are, e.g., one per window. */
+
+/* A job waiting to be run, calling RUN with CLOSURE.  FREE_CLOSURE is
+ * called with CLOSURE if the job is dropped without being run. */
+typedef struct _WorkerPoolJob WorkerPoolJob;
+
+struct _WorkerPoolJob
+{
+        WorkerPoolJobFunc run;
+        FreeFunc free_closure;
+        VOID *closure;
+};
+
+/* A pool of N_THREADS THREADS.
+ *
+ * LOCK protects JOBS, LAST_JOB, and QUIT.
+ * JOBS is the queue of jobs waiting to be run, LAST_JOB being its last
+ * node, so that appending doesn’t require a scan.
+ * AVAILABLE is a semaphore counting the jobs in JOBS, plus one per
+ * thread once QUIT is set. */
+struct _WorkerPool
+{
+        HANDLE *threads;
+        int n_threads;
+        CRITICAL_SECTION lock;
+        List *jobs;
+        List *last_job;
+        HANDLE available;
+        BOOL quit;
+};
+
+static void
+WorkerPoolJobFree(WorkerPoolJob *job)
+{
+        if (job->free_closure != NULL)
+                job->free_closure(job->closure);
+        FREE(job);
+}
+
+/* Takes the first job off the queue of POOL, or returns NULL if the
+ * pool is shutting down. */
+static WorkerPoolJob *
+WorkerPoolTakeJob(WorkerPool *pool)
+{
+        WorkerPoolJob *job = NULL;
+
+        EnterCriticalSection(&pool->lock);
+
+        if (!pool->quit && pool->jobs != NULL) {
+                List *node = pool->jobs;
+                job = (WorkerPoolJob *)node->item;
+                pool->jobs = ListRemoveNode(pool->jobs, node, NULL, NullFreeFunc);
+                if (pool->jobs == NULL)
+                        pool->last_job = NULL;
+        }
+
+        LeaveCriticalSection(&pool->lock);
+
+        return job;
+}
+
+static unsigned __stdcall
+WorkerPoolThreadProc(void *closure)
+{
+        WorkerPool *pool = (WorkerPool *)closure;
+
+        while (WaitForSingleObject(pool->available, INFINITE) == WAIT_OBJECT_0) {
+                WorkerPoolJob *job = WorkerPoolTakeJob(pool);
+                if (job == NULL)
+                        break;
+
+                job->run(job->closure);
+                FREE(job);
+        }
+
+        return 0;
+}
+
+/* Creates a new WorkerPool running jobs on N_THREADS threads. */
+WorkerPool *
+WorkerPoolNew(int n_threads)
+{
+        WorkerPool *pool = ALLOC_STRUCT(WorkerPool);
+        if (pool == NULL)
+                return NULL;
+
+        InitializeCriticalSection(&pool->lock);
+
+        pool->available = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+        if (pool->available == NULL)
+                goto cleanup;
+
+        pool->threads = ALLOC_N(HANDLE, n_threads);
+        if (pool->threads == NULL)
+                goto cleanup;
+
+        for (pool->n_threads = 0; pool->n_threads < n_threads; pool->n_threads++) {
+                HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, WorkerPoolThreadProc, pool, 0, NULL);
+                if (thread == NULL)
+                        break;
+                pool->threads[pool->n_threads] = thread;
+        }
+
+        if (pool->n_threads > 0)
+                return pool;
+
+cleanup:
+        WorkerPoolFree(pool);
+
+        return NULL;
+}
+
+/* Stops the threads of POOL, waiting for any running jobs to finish,
+ * and frees it.  Jobs that haven’t been started are dropped. */
+void
+WorkerPoolFree(WorkerPool *pool)
+{
+        EnterCriticalSection(&pool->lock);
+        pool->quit = TRUE;
+        LeaveCriticalSection(&pool->lock);
+
+        if (pool->n_threads > 0) {
+                ReleaseSemaphore(pool->available, pool->n_threads, NULL);
+                WaitForMultipleObjects(pool->n_threads, pool->threads, TRUE, INFINITE);
+        }
+
+        for (int i = 0; i < pool->n_threads; i++)
+                CloseHandle(pool->threads[i]);
+        if (pool->threads != NULL)
+                FREE(pool->threads);
+
+        if (pool->available != NULL)
+                CloseHandle(pool->available);
+
+        ListFree(pool->jobs, (FreeFunc)WorkerPoolJobFree);
+        DeleteCriticalSection(&pool->lock);
+        FREE(pool);
+}
+
+/* Queues a job on POOL that calls RUN with CLOSURE on one of its
+ * threads.  FREE_CLOSURE, if not NULL, is called with CLOSURE should
+ * the job be dropped.  Returns FALSE if the job couldn’t be queued. */
+BOOL
+WorkerPoolSubmit(WorkerPool *pool, WorkerPoolJobFunc run, FreeFunc free_closure, VOID *closure)
+{
+        WorkerPoolJob *job = ALLOC_STRUCT(WorkerPoolJob);
+        if (job == NULL)
+                return FALSE;
+
+        job->run = run;
+        job->free_closure = free_closure;
+        job->closure = closure;
+
+        EnterCriticalSection(&pool->lock);
+
+        List *node = ListAppend(NULL, job);
+        if (node != NULL) {
+                if (pool->last_job == NULL)
+                        pool->jobs = node;
+                else
+                        pool->last_job->next = node;
+                pool->last_job = node;
+        }
+
+        LeaveCriticalSection(&pool->lock);
+
+        if (node == NULL) {
+                FREE(job);
+                return FALSE;
+        }
+
+        ReleaseSemaphore(pool->available, 1, NULL);
+
+        return TRUE;
+}
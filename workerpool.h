@@ -0,0 +1,8 @@
+﻿typedef struct _WorkerPool WorkerPool;
+
+/* A job run by a WorkerPool on one of its threads. */
+typedef void (*WorkerPoolJobFunc)(VOID *closure);
+
+WorkerPool *WorkerPoolNew(int n_threads);
+void WorkerPoolFree(WorkerPool *pool);
+BOOL WorkerPoolSubmit(WorkerPool *pool, WorkerPoolJobFunc run, FreeFunc free_closure, VOID *closure);